@@ -16,4 +16,4 @@ NCFLAGS=`nc-config --cflags --libs`
 RPATH=`wx-config --prefix`/lib
 
 # build the executable
-cd src && $CXX -std=c++11 -fpermissive -Wl,-rpath,${RPATH} -o ${PREFIX}/ncvis ncvis.cpp kdtree.cpp wxNcVisFrame.cpp wxNcVisOptionsDialog.cpp wxNcVisExportDialog.cpp wxImagePanel.cpp GridDataSampler.cpp ColorMap.cpp netcdf.cpp ncvalues.cpp Announce.cpp TimeObj.cpp ShpFile.cpp schrift.cpp lodepng.cpp ${WXFLAGS} ${NCFLAGS}
+cd src && $CXX -std=c++11 -fpermissive -pthread -Wl,-rpath,${RPATH} -o ${PREFIX}/ncvis ncvis.cpp wxNcVisFrame.cpp wxNcVisOptionsDialog.cpp wxNcVisExportDialog.cpp wxImagePanel.cpp GridDataSampler.cpp ThreadPool.cpp IndexCache.cpp DiskIndex.cpp DataPrefetcher.cpp ColorMap.cpp netcdf.cpp ncvalues.cpp Announce.cpp TimeObj.cpp ShpFile.cpp schrift.cpp lodepng.cpp ${WXFLAGS} ${NCFLAGS}
@@ -14,6 +14,8 @@
 #include <cstdio>
 #include <cstring>
 #include <cstdarg>
+#include <atomic>
+#include <mutex>
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -59,6 +61,16 @@ static int s_nIndentationLevel = 0;
 ///	</summary>
 static bool s_fBlockFlag = false;
 
+///	<summary>
+///		Mutex serializing announcements from multiple threads.
+///	</summary>
+static std::recursive_mutex s_mutexAnnounce;
+
+///	<summary>
+///		Most recent percentage given to AnnounceProgress.
+///	</summary>
+static std::atomic<int> s_iProgress(-1);
+
 ///////////////////////////////////////////////////////////////////////////////
 
 FILE * AnnounceGetOutputBuffer() {
@@ -95,6 +107,7 @@ void AnnounceStartBlock(
 	const char * szText,
 	...
 ) {
+	std::lock_guard<std::recursive_mutex> lock(s_mutexAnnounce);
 
 	// Do not start a block at maximum indentation level
 	if (s_nIndentationLevel == MaximumIndentationLevel) {
@@ -166,6 +179,8 @@ void AnnounceEndBlock(
 	const char * szText,
 	...
 ) {
+	std::lock_guard<std::recursive_mutex> lock(s_mutexAnnounce);
+
 	// Do not remove a block at minimum indentation level
 	if (s_nIndentationLevel == 0) {
 		return;
@@ -241,6 +256,7 @@ void AnnounceEndBlock(
 ///////////////////////////////////////////////////////////////////////////////
 
 void Announce(const char * szText, ...) {
+	std::lock_guard<std::recursive_mutex> lock(s_mutexAnnounce);
 
 #ifdef TEMPEST_MPIOMP
 	// Only output on rank zero
@@ -304,6 +320,7 @@ void Announce(
 	const char * szText,
 	...
 ) {
+	std::lock_guard<std::recursive_mutex> lock(s_mutexAnnounce);
 
 #ifdef TEMPEST_MPIOMP
 	// Only output on rank zero
@@ -368,6 +385,7 @@ void Announce(
 ///////////////////////////////////////////////////////////////////////////////
 
 void AnnounceBanner(const char * szText) {
+	std::lock_guard<std::recursive_mutex> lock(s_mutexAnnounce);
 
 #ifdef TEMPEST_MPIOMP
 	// Only output on rank zero
@@ -417,3 +435,23 @@ void AnnounceBanner(const char * szText) {
 
 ///////////////////////////////////////////////////////////////////////////////
 
+void AnnounceProgress(int iPercent) {
+	s_iProgress = iPercent;
+
+	Announce("%i%% complete", iPercent);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void AnnounceResetProgress() {
+	s_iProgress = (-1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int AnnounceGetProgress() {
+	return s_iProgress;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
@@ -80,6 +80,23 @@ void Announce(int iVerbosity, const char * szText, ...);
 ///	</summary>
 void AnnounceBanner(const char * szText = NULL);
 
+///	<summary>
+///		Announce the percentage of the current task that is complete.
+///	</summary>
+void AnnounceProgress(int iPercent);
+
+///	<summary>
+///		Reset the percentage returned by AnnounceGetProgress.
+///	</summary>
+void AnnounceResetProgress();
+
+///	<summary>
+///		Get the most recent percentage given to AnnounceProgress, or (-1)
+///		if none has been given since AnnounceResetProgress.  May be called
+///		from any thread.
+///	</summary>
+int AnnounceGetProgress();
+
 ///////////////////////////////////////////////////////////////////////////////
 
 #endif
@@ -9,6 +9,7 @@
 #define _COORDTRANSFORMS_H_
 
 #include <cmath>
+#include <cstddef>
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -86,5 +87,95 @@ inline void RLLtoXYZ_Deg(
 
 ///////////////////////////////////////////////////////////////////////////////
 
+///	<summary>
+///		Translate an array of longitude values to the range [0,360).
+///	</summary>
+inline void LonDegToStandardRange(
+	const double * pLonDeg,
+	size_t sPoints,
+	double * pLonStandardDeg
+) {
+	for (size_t i = 0; i < sPoints; i++) {
+		pLonStandardDeg[i] = LonDegToStandardRange(pLonDeg[i]);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+///	<summary>
+///		Calculate the sine and cosine of an array of angles, in degrees.
+///	</summary>
+inline void SinCosDeg(
+	const double * pDeg,
+	size_t sPoints,
+	double * pSin,
+	double * pCos
+) {
+	for (size_t i = 0; i < sPoints; i++) {
+		const double dRad = DegToRad(pDeg[i]);
+		pSin[i] = sin(dRad);
+		pCos[i] = cos(dRad);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+///	<summary>
+///		Calculate 3D Cartesian coordinates from arrays of longitude and
+///		latitude, in degrees.  The sine and cosine of latitude are only
+///		recomputed when the latitude changes, so that runs of constant
+///		latitude (such as image rows) cost two evaluations per point.
+///	</summary>
+inline void RLLtoXYZ_Deg(
+	const double * pLonDeg,
+	const double * pLatDeg,
+	size_t sPoints,
+	double * pX,
+	double * pY,
+	double * pZ
+) {
+	double dLatDeg = 0.0;
+	double dSinLat = 0.0;
+	double dCosLat = 1.0;
+
+	for (size_t i = 0; i < sPoints; i++) {
+		if (pLatDeg[i] != dLatDeg) {
+			dLatDeg = pLatDeg[i];
+			dSinLat = sin(DegToRad(dLatDeg));
+			dCosLat = cos(DegToRad(dLatDeg));
+		}
+
+		const double dLonRad = DegToRad(pLonDeg[i]);
+		pX[i] = cos(dLonRad) * dCosLat;
+		pY[i] = sin(dLonRad) * dCosLat;
+		pZ[i] = dSinLat;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+///	<summary>
+///		Calculate 3D Cartesian coordinates of a row of constant latitude,
+///		given the sine and cosine of each longitude and of the latitude.
+///	</summary>
+inline void RLLtoXYZ_Row(
+	const double * pSinLon,
+	const double * pCosLon,
+	double dSinLat,
+	double dCosLat,
+	size_t sPoints,
+	double * pX,
+	double * pY,
+	double * pZ
+) {
+	for (size_t i = 0; i < sPoints; i++) {
+		pX[i] = pCosLon[i] * dCosLat;
+		pY[i] = pSinLon[i] * dCosLat;
+		pZ[i] = dSinLat;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 #endif // _COORDTRANSFORMS_H_
 
@@ -0,0 +1,642 @@
+///////////////////////////////////////////////////////////////////////////////
+///
+///	\file    DataPrefetcher.cpp
+///	\author  Paul Ullrich
+///	\version October 16, 2026
+///
+
+#include "DataPrefetcher.h"
+#include "Exception.h"
+
+#include <algorithm>
+#include <chrono>
+
+///////////////////////////////////////////////////////////////////////////////
+
+///	<summary>
+///		Lock serializing netCDF calls between threads.
+///	</summary>
+static std::recursive_timed_mutex s_mutexNetCDF;
+
+///	<summary>
+///		Interval at which the prefetch thread waiting for the netCDF lock
+///		checks if it has been stopped.
+///	</summary>
+static const std::chrono::milliseconds NetCDFLockPollInterval(10);
+
+///	<summary>
+///		Estimated cost of each separate run of values read from a file, in
+///		bytes.  The netCDF library reads strided hyperslabs one value at a
+///		time, so each value of a strided read is a run.
+///	</summary>
+static const size_t ReadRunCostBytes = 4096;
+
+///	<summary>
+///		Maximum size of an enclosing hyperslab read into memory, in bytes.
+///	</summary>
+static const size_t ReadBufferMaxBytes = 256 * 1024 * 1024;
+
+///	<summary>
+///		Edge length of the tiles copied by the in-memory gather.
+///	</summary>
+static const size_t GatherTileSize = 32;
+
+///////////////////////////////////////////////////////////////////////////////
+
+void DataPrefetcher::LockNetCDF() {
+	s_mutexNetCDF.lock();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void DataPrefetcher::UnlockNetCDF() {
+	s_mutexNetCDF.unlock();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+///	<summary>
+///		Number of values in a hyperslab with the given count.
+///	</summary>
+static size_t CountValues(
+	const std::vector<long> & vecCount
+) {
+	size_t sValues = 1;
+	for (size_t d = 0; d < vecCount.size(); d++) {
+		sValues *= static_cast<size_t>(vecCount[d]);
+	}
+	return sValues;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+///	<summary>
+///		Estimate the cost of reading a hyperslab with the given count and
+///		stride (empty if contiguous) from a variable of the given size.
+///	</summary>
+static size_t EstimateReadCost(
+	const std::vector<long> & vecDimSize,
+	const std::vector<long> & vecCount,
+	const std::vector<long> & vecStride,
+	size_t sValueBytes
+) {
+	const size_t sValues = CountValues(vecCount);
+	bool fStrided = false;
+	for (size_t d = 0; d < vecCount.size(); d++) {
+		if ((vecStride.size() != 0) && (vecCount[d] > 1) && (vecStride[d] != 1)) {
+			fStrided = true;
+		}
+	}
+
+	// Values are contiguous in the file along the fastest varying
+	// dimensions that are read in full, plus the next one
+	size_t sRuns = sValues;
+	if (!fStrided) {
+		size_t sRunLength = 1;
+		for (size_t d = vecCount.size(); d-- > 0;) {
+			sRunLength *= static_cast<size_t>(vecCount[d]);
+			if (vecCount[d] != vecDimSize[d]) {
+				break;
+			}
+		}
+		sRuns = sValues / sRunLength;
+	}
+
+	return (sValues * sValueBytes + sRuns * ReadRunCostBytes);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+///	<summary>
+///		Copy values with the given count from a hyperslab of vecInSize
+///		values held in pIn, beginning at vecInOffset with stride
+///		vecInStride, into pOut with dimensions laid out in vecOrder.
+///		The two fastest varying dimensions of the output are copied in
+///		tiles so that transposed reads stay in cache.
+///	</summary>
+template <typename T>
+static void GatherSlab(
+	const T * pIn,
+	const std::vector<long> & vecInSize,
+	const std::vector<long> & vecInOffset,
+	const std::vector<long> & vecInStride,
+	const std::vector<long> & vecCount,
+	const std::vector<long> & vecOrder,
+	T * pOut
+) {
+	const size_t nDims = vecInSize.size();
+
+	// Offset of the first value and step along each output dimension
+	std::vector<size_t> vecInElementStride(nDims);
+	size_t sInBase = 0;
+	size_t sElements = 1;
+	for (size_t d = nDims; d-- > 0;) {
+		vecInElementStride[d] = sElements;
+		sInBase += static_cast<size_t>(vecInOffset[d]) * sElements;
+		sElements *= static_cast<size_t>(vecInSize[d]);
+	}
+
+	const size_t nOutDims = vecOrder.size();
+	if (nOutDims == 0) {
+		pOut[0] = pIn[sInBase];
+		return;
+	}
+
+	std::vector<size_t> vecStep(nOutDims);
+	std::vector<size_t> vecOutCount(nOutDims);
+	for (size_t m = 0; m < nOutDims; m++) {
+		vecStep[m] = static_cast<size_t>(vecInStride[vecOrder[m]]) * vecInElementStride[vecOrder[m]];
+		vecOutCount[m] = static_cast<size_t>(vecCount[vecOrder[m]]);
+	}
+
+	if (nOutDims == 1) {
+		for (size_t i = 0; i < vecOutCount[0]; i++) {
+			pOut[i] = pIn[sInBase + i * vecStep[0]];
+		}
+		return;
+	}
+
+	const size_t sRows = vecOutCount[nOutDims-2];
+	const size_t sCols = vecOutCount[nOutDims-1];
+	const size_t sRowStep = vecStep[nOutDims-2];
+	const size_t sColStep = vecStep[nOutDims-1];
+
+	size_t sOuter = 1;
+	for (size_t m = 0; m < nOutDims-2; m++) {
+		sOuter *= vecOutCount[m];
+	}
+
+	for (size_t o = 0; o < sOuter; o++) {
+		size_t sIn = sInBase;
+		size_t sRemainder = o;
+		for (size_t m = nOutDims-2; m-- > 0;) {
+			sIn += (sRemainder % vecOutCount[m]) * vecStep[m];
+			sRemainder /= vecOutCount[m];
+		}
+
+		T * pOutBlock = pOut + o * sRows * sCols;
+
+		for (size_t jb = 0; jb < sRows; jb += GatherTileSize) {
+			const size_t jEnd = std::min(jb + GatherTileSize, sRows);
+			for (size_t ib = 0; ib < sCols; ib += GatherTileSize) {
+				const size_t iEnd = std::min(ib + GatherTileSize, sCols);
+				for (size_t j = jb; j < jEnd; j++) {
+					const T * pInRow = pIn + sIn + j * sRowStep;
+					T * pOutRow = pOutBlock + j * sCols;
+					for (size_t i = ib; i < iEnd; i++) {
+						pOutRow[i] = pInRow[i * sColStep];
+					}
+				}
+			}
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+///	<summary>
+///		Read a hyperslab of var beginning at vecCur into pData.
+///	</summary>
+template <typename T>
+static bool ReadSlabT(
+	NcVar * var,
+	const DataPrefetcher::Slab & slab,
+	const std::vector<long> & vecCur,
+	T * pData
+) {
+	const size_t nDims = static_cast<size_t>(var->num_dims());
+	_ASSERT(nDims != 0);
+	_ASSERT(vecCur.size() == nDims);
+	_ASSERT(slab.vecSize.size() == nDims);
+
+	std::vector<long> vecDimSize(nDims);
+	for (size_t d = 0; d < nDims; d++) {
+		vecDimSize[d] = var->get_dim(d)->size();
+	}
+
+	std::vector<long> vecStride(nDims, 1);
+	bool fStrided = false;
+	for (size_t d = 0; d < slab.vecStride.size(); d++) {
+		vecStride[d] = slab.vecStride[d];
+		if ((slab.vecSize[d] > 1) && (vecStride[d] != 1)) {
+			fStrided = true;
+		}
+	}
+
+	// Dimensions of the output, slowest varying first
+	std::vector<long> vecOrder;
+	if (slab.vecOrder.size() == 0) {
+		for (size_t d = 0; d < nDims; d++) {
+			if (slab.vecSize[d] > 1) {
+				vecOrder.push_back(d);
+			}
+		}
+	} else {
+		for (size_t m = 0; m < slab.vecOrder.size(); m++) {
+			if (slab.vecSize[slab.vecOrder[m]] > 1) {
+				vecOrder.push_back(slab.vecOrder[m]);
+			}
+		}
+	}
+	const bool fTranspose = !std::is_sorted(vecOrder.begin(), vecOrder.end());
+
+	// Candidate reads are the hyperslab as requested, the smallest
+	// hyperslab enclosing it and the smallest contiguous one enclosing it
+	std::vector<long> vecEncloseSize(slab.vecSize);
+	for (size_t d = 0; d < nDims; d++) {
+		if (slab.vecSize[d] > 1) {
+			vecEncloseSize[d] = (slab.vecSize[d] - 1) * vecStride[d] + 1;
+		}
+	}
+
+	std::vector<long> vecContigCur(vecCur);
+	std::vector<long> vecContigSize(vecEncloseSize);
+	for (size_t d = 0; d < nDims; d++) {
+		if (vecEncloseSize[d] > 1) {
+			for (size_t d2 = d+1; d2 < nDims; d2++) {
+				vecContigCur[d2] = 0;
+				vecContigSize[d2] = vecDimSize[d2];
+			}
+			break;
+		}
+	}
+
+	// Enclosing hyperslabs are only read if they fit in the buffer; the
+	// cost estimate is only used to rank the candidates
+	const std::vector<long> vecNoStride;
+
+	const std::vector<long> * pvecReadCur = &vecCur;
+	const std::vector<long> * pvecReadSize = &(slab.vecSize);
+	size_t sCost = EstimateReadCost(vecDimSize, slab.vecSize, vecStride, sizeof(T));
+
+	if (fStrided && (CountValues(vecEncloseSize) * sizeof(T) <= ReadBufferMaxBytes)) {
+		size_t sEncloseCost = EstimateReadCost(vecDimSize, vecEncloseSize, vecNoStride, sizeof(T));
+		if (sEncloseCost < sCost) {
+			pvecReadSize = &vecEncloseSize;
+			sCost = sEncloseCost;
+		}
+	}
+
+	size_t sContigCost = EstimateReadCost(vecDimSize, vecContigSize, vecNoStride, sizeof(T));
+	if ((sContigCost < sCost) && (CountValues(vecContigSize) * sizeof(T) <= ReadBufferMaxBytes)) {
+		pvecReadCur = &vecContigCur;
+		pvecReadSize = &vecContigSize;
+		sCost = sContigCost;
+	}
+
+	const bool fDirect = (pvecReadSize == &(slab.vecSize));
+
+	// Read as requested
+	if (fDirect && !fTranspose) {
+		var->set_cur(const_cast<long *>(&(vecCur[0])));
+		if (fStrided) {
+			return var->gets(pData, &(slab.vecSize[0]), &(vecStride[0]));
+		} else {
+			return var->get(pData, &(slab.vecSize[0]));
+		}
+	}
+
+	// Read into memory and gather
+	std::vector<T> vecBuffer(CountValues(*pvecReadSize));
+
+	var->set_cur(const_cast<long *>(&((*pvecReadCur)[0])));
+	if (fDirect && fStrided) {
+		if (!var->gets(&(vecBuffer[0]), &(slab.vecSize[0]), &(vecStride[0]))) {
+			return false;
+		}
+	} else {
+		if (!var->get(&(vecBuffer[0]), &((*pvecReadSize)[0]))) {
+			return false;
+		}
+	}
+
+	if (fDirect) {
+		GatherSlab<T>(
+			&(vecBuffer[0]),
+			slab.vecSize,
+			std::vector<long>(nDims, 0),
+			std::vector<long>(nDims, 1),
+			slab.vecSize,
+			vecOrder,
+			pData);
+
+	} else {
+		std::vector<long> vecOffset(nDims);
+		for (size_t d = 0; d < nDims; d++) {
+			vecOffset[d] = vecCur[d] - (*pvecReadCur)[d];
+		}
+		GatherSlab<T>(
+			&(vecBuffer[0]),
+			*pvecReadSize,
+			vecOffset,
+			vecStride,
+			slab.vecSize,
+			vecOrder,
+			pData);
+	}
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool DataPrefetcher::ReadSlab(
+	NcVar * var,
+	const Slab & slab,
+	float * pData
+) {
+	NetCDFLock lockNetCDF;
+	return ReadSlabT<float>(var, slab, slab.vecCur, pData);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool DataPrefetcher::ReadSlab(
+	NcVar * var,
+	const Slab & slab,
+	double * pData
+) {
+	NetCDFLock lockNetCDF;
+	return ReadSlabT<double>(var, slab, slab.vecCur, pData);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool DataPrefetcher::ReadSlabs(
+	NcVar * var,
+	const std::vector<Slab> & vecSlabs,
+	long lDim,
+	long lIndex,
+	float * pData
+) {
+	NetCDFLock lockNetCDF;
+
+	bool fSuccess = true;
+	for (size_t i = 0; i < vecSlabs.size(); i++) {
+		const Slab & slab = vecSlabs[i];
+
+		if (lDim == (-1)) {
+			fSuccess &= ReadSlabT<float>(var, slab, slab.vecCur, pData + slab.sOffset);
+
+		} else {
+			std::vector<long> vecCur(slab.vecCur);
+			vecCur[lDim] = lIndex;
+			fSuccess &= ReadSlabT<float>(var, slab, vecCur, pData + slab.sOffset);
+		}
+	}
+	return fSuccess;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+DataPrefetcher::DataPrefetcher() :
+	m_var(NULL),
+	m_sSize(0),
+	m_lDim(-1),
+	m_lBegin(0),
+	m_lEnd(0),
+	m_lFirst(0),
+	m_fCyclic(false),
+	m_sNextPosition(0),
+	m_fStop(false)
+{ }
+
+///////////////////////////////////////////////////////////////////////////////
+
+DataPrefetcher::~DataPrefetcher() {
+	Stop();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void DataPrefetcher::Start(
+	NcVar * var,
+	const std::vector<Slab> & vecSlabs,
+	size_t sSize,
+	long lDim,
+	long lBegin,
+	long lEnd,
+	long lFirst,
+	bool fCyclic,
+	size_t sFrames
+) {
+	Stop();
+
+	if ((var == NULL) || (lEnd < lBegin) || (lFirst < lBegin) || (lFirst > lEnd) || (sFrames == 0)) {
+		return;
+	}
+
+	m_var = var;
+	m_vecSlabs = vecSlabs;
+	m_sSize = sSize;
+	m_lDim = lDim;
+	m_lBegin = lBegin;
+	m_lEnd = lEnd;
+	m_lFirst = lFirst;
+	m_fCyclic = fCyclic;
+	m_sNextPosition = 0;
+	m_fStop = false;
+
+	// Allocate all buffers up front
+	m_vecFrames.resize(sFrames);
+	for (size_t f = 0; f < sFrames; f++) {
+		m_vecFrames[f].sPosition = static_cast<size_t>(-1);
+		m_vecFrames[f].fReady = false;
+		m_vecFrames[f].data.resize(sSize);
+	}
+
+	m_thread = std::thread(&DataPrefetcher::PrefetchLoop, this);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void DataPrefetcher::Stop() {
+	if (!m_thread.joinable()) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_fStop = true;
+	}
+	m_cond.notify_all();
+
+	// The prefetch thread gives up waiting for the netCDF lock once
+	// stopped, so this thread may hold it while joining
+	m_thread.join();
+
+	m_var = NULL;
+	m_vecSlabs.clear();
+	m_lDim = (-1);
+	m_vecFrames.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool DataPrefetcher::Matches(
+	NcVar * var,
+	const std::vector<Slab> & vecSlabs,
+	size_t sSize
+) const {
+	if ((var != m_var) || (sSize != m_sSize) || (vecSlabs.size() != m_vecSlabs.size())) {
+		return false;
+	}
+	for (size_t i = 0; i < vecSlabs.size(); i++) {
+		const Slab & slab = vecSlabs[i];
+		const Slab & slabPrefetch = m_vecSlabs[i];
+		if ((slab.sOffset != slabPrefetch.sOffset) ||
+		    (slab.vecSize != slabPrefetch.vecSize) ||
+		    (slab.vecStride != slabPrefetch.vecStride) ||
+		    (slab.vecOrder != slabPrefetch.vecOrder) ||
+		    (slab.vecCur.size() != slabPrefetch.vecCur.size())
+		) {
+			return false;
+		}
+		for (long d = 0; d < static_cast<long>(slab.vecCur.size()); d++) {
+			if ((d != m_lDim) && (slab.vecCur[d] != slabPrefetch.vecCur[d])) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+size_t DataPrefetcher::PositionLimit() const {
+	if (m_fCyclic) {
+		return static_cast<size_t>(-1);
+	}
+	return static_cast<size_t>(m_lEnd - m_lFirst + 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool DataPrefetcher::Take(
+	long lIndex,
+	std::vector<float> & data
+) {
+	if (!m_thread.joinable()) {
+		return false;
+	}
+
+	if ((lIndex < m_lBegin) || (lIndex > m_lEnd)) {
+		return false;
+	}
+	if (!m_fCyclic && (lIndex < m_lFirst)) {
+		return false;
+	}
+
+	bool fFound = false;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		const size_t sLength = static_cast<size_t>(m_lEnd - m_lBegin + 1);
+
+		// Position of lIndex, at or after the next expected position if
+		// indices wrap around
+		size_t sPosition;
+		if (!m_fCyclic) {
+			sPosition = static_cast<size_t>(lIndex - m_lFirst);
+		} else {
+			long lNextIndex = FrameIndex(m_sNextPosition);
+			if (lIndex >= lNextIndex) {
+				sPosition = m_sNextPosition + static_cast<size_t>(lIndex - lNextIndex);
+			} else {
+				sPosition = m_sNextPosition + sLength - static_cast<size_t>(lNextIndex - lIndex);
+			}
+		}
+
+		// Buffers at earlier positions are reused by the prefetch thread
+		Frame & frame = m_vecFrames[sPosition % m_vecFrames.size()];
+		if ((frame.sPosition == sPosition) && frame.fReady) {
+			data.swap(frame.data);
+			frame.sPosition = static_cast<size_t>(-1);
+			frame.fReady = false;
+			fFound = true;
+		}
+
+		m_sNextPosition = sPosition + 1;
+	}
+	m_cond.notify_all();
+
+	return fFound;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void DataPrefetcher::PrefetchLoop() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	for (;;) {
+		if (m_fStop) {
+			return;
+		}
+
+		// Find the first position ahead that is not held by a buffer; never
+		// read further ahead than the number of distinct indices
+		const size_t sLength = static_cast<size_t>(m_lEnd - m_lBegin + 1);
+		const size_t sAhead = std::min(m_vecFrames.size(), sLength);
+		const size_t sLimit = std::min(m_sNextPosition + sAhead, PositionLimit());
+
+		Frame * pframe = NULL;
+		size_t sPosition = m_sNextPosition;
+		for (; sPosition < sLimit; sPosition++) {
+			Frame & frame = m_vecFrames[sPosition % m_vecFrames.size()];
+			if (frame.sPosition == sPosition) {
+				continue;
+			}
+			if ((frame.sPosition != static_cast<size_t>(-1)) &&
+			    (frame.sPosition >= m_sNextPosition) &&
+			    (frame.sPosition < sPosition)
+			) {
+				continue;
+			}
+			pframe = &frame;
+			break;
+		}
+
+		if (pframe == NULL) {
+			m_cond.wait(lock);
+			continue;
+		}
+
+		// Claim the buffer and read without holding the state lock; the
+		// main thread never touches a buffer that is not ready
+		pframe->sPosition = sPosition;
+		pframe->fReady = false;
+		if (pframe->data.size() != m_sSize) {
+			pframe->data.resize(m_sSize);
+		}
+
+		long lIndex = FrameIndex(sPosition);
+		float * pData = &(pframe->data[0]);
+
+		lock.unlock();
+
+		bool fLocked = false;
+		while (!m_fStop) {
+			if (s_mutexNetCDF.try_lock_for(NetCDFLockPollInterval)) {
+				fLocked = true;
+				break;
+			}
+		}
+
+		bool fSuccess = false;
+		if (fLocked) {
+			fSuccess = ReadSlabs(m_var, m_vecSlabs, m_lDim, lIndex, pData);
+			s_mutexNetCDF.unlock();
+		}
+
+		lock.lock();
+
+		// A failed read leaves the buffer claimed, so that Take() reads the
+		// slice on the main thread and reports the error
+		if (fSuccess && (pframe->sPosition == sPosition)) {
+			pframe->fReady = true;
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
@@ -0,0 +1,294 @@
+///////////////////////////////////////////////////////////////////////////////
+///
+///	\file    DataPrefetcher.h
+///	\author  Paul Ullrich
+///	\version October 16, 2026
+///
+
+#ifndef _DATAPREFETCHER_H_
+#define _DATAPREFETCHER_H_
+
+#include "netcdfcpp.h"
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+///////////////////////////////////////////////////////////////////////////////
+
+///	<summary>
+///		Reads upcoming slices of a variable along one dimension on a
+///		background thread into a ring of buffers, so that stepping through
+///		the dimension only exchanges buffers.
+///
+///		The netCDF library is not thread-safe, so every netCDF call must be
+///		made with the netCDF lock held.  The main thread holds it around
+///		each group of netCDF calls; the prefetch thread holds it while
+///		reading each slice.
+///	</summary>
+class DataPrefetcher {
+
+public:
+	///	<summary>
+	///		A hyperslab of a variable read into a slice at sOffset.
+	///	</summary>
+	struct Slab {
+		///	<summary>
+		///		Start, count and stride of the hyperslab.  The stride is
+		///		empty if the hyperslab is contiguous.
+		///	</summary>
+		std::vector<long> vecCur;
+		std::vector<long> vecSize;
+		std::vector<long> vecStride;
+
+		///	<summary>
+		///		Dimensions with count greater than one in the order they are
+		///		laid out in the slice, slowest varying first.  Empty if the
+		///		slice is laid out in variable order.
+		///	</summary>
+		std::vector<long> vecOrder;
+
+		///	<summary>
+		///		Offset of the hyperslab in the slice.
+		///	</summary>
+		size_t sOffset;
+
+		///	<summary>
+		///		Equality operator.
+		///	</summary>
+		bool operator==(const Slab & slab) const {
+			return (
+			    (vecCur == slab.vecCur) &&
+			    (vecSize == slab.vecSize) &&
+			    (vecStride == slab.vecStride) &&
+			    (vecOrder == slab.vecOrder) &&
+			    (sOffset == slab.sOffset));
+		}
+	};
+
+	///	<summary>
+	///		Holds the netCDF lock for its lifetime.  The lock is recursive.
+	///	</summary>
+	class NetCDFLock {
+	public:
+		NetCDFLock() {
+			LockNetCDF();
+		}
+
+		~NetCDFLock() {
+			UnlockNetCDF();
+		}
+
+	private:
+		NetCDFLock(const NetCDFLock &);
+		NetCDFLock & operator=(const NetCDFLock &);
+	};
+
+public:
+	///	<summary>
+	///		Acquire the netCDF lock.
+	///	</summary>
+	static void LockNetCDF();
+
+	///	<summary>
+	///		Release the netCDF lock.
+	///	</summary>
+	static void UnlockNetCDF();
+
+	///	<summary>
+	///		Read a hyperslab of var into pData with the netCDF lock held.
+	///		Values are read either as requested or through an enclosing
+	///		hyperslab that is gathered in memory, whichever is estimated to
+	///		be cheaper.  Returns false if the read failed.
+	///	</summary>
+	static bool ReadSlab(
+		NcVar * var,
+		const Slab & slab,
+		float * pData
+	);
+
+	static bool ReadSlab(
+		NcVar * var,
+		const Slab & slab,
+		double * pData
+	);
+
+	///	<summary>
+	///		Read a slice of var into pData with the netCDF lock held.  If
+	///		lDim is not (-1) index lIndex is read along dimension lDim in
+	///		place of the index in each slab.  Returns false if any read
+	///		failed.
+	///	</summary>
+	static bool ReadSlabs(
+		NcVar * var,
+		const std::vector<Slab> & vecSlabs,
+		long lDim,
+		long lIndex,
+		float * pData
+	);
+
+public:
+	///	<summary>
+	///		Constructor.
+	///	</summary>
+	DataPrefetcher();
+
+	///	<summary>
+	///		Destructor.
+	///	</summary>
+	~DataPrefetcher();
+
+	///	<summary>
+	///		Check if the prefetch thread is running.
+	///	</summary>
+	bool IsRunning() const {
+		return m_thread.joinable();
+	}
+
+	///	<summary>
+	///		Dimension along which slices are read ahead.
+	///	</summary>
+	long GetDim() const {
+		return m_lDim;
+	}
+
+	///	<summary>
+	///		Start reading up to sFrames slices of var ahead along dimension
+	///		lDim, beginning with index lFirst and proceeding to lEnd.  If
+	///		fCyclic is set indices wrap around from lEnd to lBegin.  Each
+	///		slice has sSize values and is read with vecSlabs.
+	///	</summary>
+	void Start(
+		NcVar * var,
+		const std::vector<Slab> & vecSlabs,
+		size_t sSize,
+		long lDim,
+		long lBegin,
+		long lEnd,
+		long lFirst,
+		bool fCyclic,
+		size_t sFrames
+	);
+
+	///	<summary>
+	///		Stop the prefetch thread and discard all slices.  Called from the
+	///		main thread, which may hold the netCDF lock.
+	///	</summary>
+	void Stop();
+
+	///	<summary>
+	///		Check if slices read ahead are read from var with vecSlabs,
+	///		ignoring the index along the prefetched dimension.
+	///	</summary>
+	bool Matches(
+		NcVar * var,
+		const std::vector<Slab> & vecSlabs,
+		size_t sSize
+	) const;
+
+	///	<summary>
+	///		If the slice at index lIndex has been read exchange it with data
+	///		and return true.  Reading ahead continues from the index after
+	///		lIndex either way.
+	///	</summary>
+	bool Take(
+		long lIndex,
+		std::vector<float> & data
+	);
+
+private:
+	///	<summary>
+	///		Index along the prefetched dimension at the given position.
+	///	</summary>
+	long FrameIndex(
+		size_t sPosition
+	) const {
+		return m_lBegin + static_cast<long>(
+			(static_cast<size_t>(m_lFirst - m_lBegin) + sPosition)
+			% static_cast<size_t>(m_lEnd - m_lBegin + 1));
+	}
+
+	///	<summary>
+	///		Number of positions that may be read, beginning at position 0.
+	///	</summary>
+	size_t PositionLimit() const;
+
+	///	<summary>
+	///		Main loop of the prefetch thread.
+	///	</summary>
+	void PrefetchLoop();
+
+private:
+	///	<summary>
+	///		A buffer in the ring.
+	///	</summary>
+	struct Frame {
+		///	<summary>
+		///		Position of the slice being read or held, or (-1) if empty.
+		///	</summary>
+		size_t sPosition;
+
+		///	<summary>
+		///		Flag indicating the slice has been read.
+		///	</summary>
+		bool fReady;
+
+		///	<summary>
+		///		Values of the slice.
+		///	</summary>
+		std::vector<float> data;
+	};
+
+	///	<summary>
+	///		Variable and hyperslabs being read.
+	///	</summary>
+	NcVar * m_var;
+	std::vector<Slab> m_vecSlabs;
+	size_t m_sSize;
+
+	///	<summary>
+	///		Dimension and range of indices being read.
+	///	</summary>
+	long m_lDim;
+	long m_lBegin;
+	long m_lEnd;
+	long m_lFirst;
+	bool m_fCyclic;
+
+	///	<summary>
+	///		Ring of buffers; position p is held in m_vecFrames[p % size].
+	///	</summary>
+	std::vector<Frame> m_vecFrames;
+
+	///	<summary>
+	///		Position of the next slice expected by Take().
+	///	</summary>
+	size_t m_sNextPosition;
+
+	///	<summary>
+	///		Flag indicating the prefetch thread should exit.
+	///	</summary>
+	std::atomic<bool> m_fStop;
+
+	///	<summary>
+	///		Prefetch thread.
+	///	</summary>
+	std::thread m_thread;
+
+	///	<summary>
+	///		Mutex protecting the state above once the thread is running.
+	///	</summary>
+	std::mutex m_mutex;
+
+	///	<summary>
+	///		Condition signalled when the prefetch thread has work.
+	///	</summary>
+	std::condition_variable m_cond;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // _DATAPREFETCHER_H_
+
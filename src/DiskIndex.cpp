@@ -0,0 +1,817 @@
+///////////////////////////////////////////////////////////////////////////////
+///
+///	\file    DiskIndex.cpp
+///	\author  Paul Ullrich
+///	\version October 16, 2026
+///
+
+#include "DiskIndex.h"
+#include "Announce.h"
+#include "Exception.h"
+
+#if defined(_WIN32)
+# define WIN32_LEAN_AND_MEAN 1
+# include <windows.h>
+#else
+# include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <queue>
+
+///////////////////////////////////////////////////////////////////////////////
+// DiskIndex::BuildState
+///////////////////////////////////////////////////////////////////////////////
+
+DiskIndex::BuildState::~BuildState() {
+	for (size_t r = 0; r < vecRunFilenames.size(); r++) {
+		remove(vecRunFilenames[r].c_str());
+	}
+	if (strBoxFilename.length() != 0) {
+		remove(strBoxFilename.c_str());
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DiskIndex::MappedFile
+///////////////////////////////////////////////////////////////////////////////
+
+DiskIndex::MappedFile::~MappedFile() {
+	reader.reset();
+	if (strRemoveFilename.length() != 0) {
+		remove(strRemoveFilename.c_str());
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DiskIndex
+///////////////////////////////////////////////////////////////////////////////
+
+std::string DiskIndex::scratch_filename(
+	const std::string & strScratchDir,
+	const char * szSuffix
+) {
+	static std::atomic<unsigned long> s_ulCounter(0);
+
+#if defined(_WIN32)
+	unsigned long ulPid = static_cast<unsigned long>(GetCurrentProcessId());
+#else
+	unsigned long ulPid = static_cast<unsigned long>(getpid());
+#endif
+	char szName[64];
+	snprintf(szName, sizeof(szName), "/ncvis.%lu.%lu.%s",
+		ulPid, s_ulCounter++, szSuffix);
+
+	return strScratchDir + szName;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+DiskIndex::DiskIndex() :
+	m_sPoints(0),
+	m_nLevels(0),
+	m_pLeaves(NULL)
+{
+	for (int l = 0; l < DISKINDEX_MAX_LEVELS; l++) {
+		m_uLevelSize[l] = 0;
+		m_pLevel[l] = NULL;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void DiskIndex::clear() {
+	m_pbuild.reset();
+	m_pmapped.reset();
+	m_sPoints = 0;
+	m_nLevels = 0;
+	m_pLeaves = NULL;
+	for (int l = 0; l < DISKINDEX_MAX_LEVELS; l++) {
+		m_uLevelSize[l] = 0;
+		m_pLevel[l] = NULL;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+size_t DiskIndex::memory_usage() const {
+	size_t sBytes = 0;
+	for (int l = 0; l < m_nLevels; l++) {
+		sBytes += group_count(m_uLevelSize[l]) * sizeof(NodeGroup);
+	}
+	return sBytes;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+uint64_t DiskIndex::morton_key(
+	float flX,
+	float flY,
+	float flZ
+) {
+	const float fl[3] = {flX, flY, flZ};
+
+	uint64_t uKey = 0;
+	for (int d = 0; d < 3; d++) {
+		double dXi = 0.5 * (static_cast<double>(fl[d]) + 1.0) * 2097151.0;
+		uint64_t x = 0;
+		if (dXi >= 2097151.0) {
+			x = 2097151;
+		} else if (dXi > 0.0) {
+			x = static_cast<uint64_t>(dXi);
+		}
+
+		// Spread the 21 bits of x into every third bit
+		x = (x | (x << 32)) & 0x001F00000000FFFFULL;
+		x = (x | (x << 16)) & 0x001F0000FF0000FFULL;
+		x = (x | (x << 8))  & 0x100F00F00F00F00FULL;
+		x = (x | (x << 4))  & 0x10C30C30C30C30C3ULL;
+		x = (x | (x << 2))  & 0x1249249249249249ULL;
+
+		uKey |= (x << d);
+	}
+	return uKey;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int DiskIndex::level_sizes(
+	size_t sPoints,
+	uint64_t * pLevelSize
+) {
+	if (sPoints == 0) {
+		return 0;
+	}
+
+	int nLevels = 1;
+	pLevelSize[0] = (sPoints + DISKINDEX_BUCKET_SIZE - 1) / DISKINDEX_BUCKET_SIZE;
+	while (pLevelSize[nLevels-1] > 1) {
+		if (nLevels == DISKINDEX_MAX_LEVELS) {
+			_EXCEPTIONT("DiskIndex exceeds maximum number of levels");
+		}
+		pLevelSize[nLevels] =
+			(pLevelSize[nLevels-1] + DISKINDEX_FANOUT - 1) / DISKINDEX_FANOUT;
+		nLevels++;
+	}
+	return nLevels;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void DiskIndex::pack_group(
+	const Node * pNodes,
+	size_t sNodes,
+	NodeGroup & group
+) {
+	_ASSERT(sNodes <= DISKINDEX_FANOUT);
+
+	for (uint32_t i = 0; i < DISKINDEX_FANOUT; i++) {
+		for (int d = 0; d < 3; d++) {
+			if (i < sNodes) {
+				group.min[d][i] = pNodes[i].min[d];
+				group.max[d][i] = pNodes[i].max[d];
+			} else {
+				group.min[d][i] = HUGE_VALF;
+				group.max[d][i] = -HUGE_VALF;
+			}
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void DiskIndex::begin_build(
+	const std::string & strScratchDir,
+	size_t sMemoryBytes
+) {
+	clear();
+
+	m_pbuild.reset(new BuildState);
+	m_pbuild->strScratchDir = strScratchDir;
+	m_pbuild->sBufferPoints =
+		std::max(sMemoryBytes / sizeof(BuildPoint),
+			static_cast<size_t>(DISKINDEX_LEAF_SIZE));
+	m_pbuild->sPoints = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void DiskIndex::insert(
+	double dX,
+	double dY,
+	double dZ,
+	size_t sI
+) {
+	_ASSERT(m_pbuild != NULL);
+
+	if (sI >= static_cast<size_t>(static_cast<uint32_t>(-1))) {
+		_EXCEPTION1("ERROR: DiskIndex index out of range %lu\n", sI);
+	}
+
+	BuildState & bs = *m_pbuild;
+
+	// Grow the buffer without exceeding its maximum size
+	if (bs.vecPoints.size() == bs.vecPoints.capacity()) {
+		bs.vecPoints.reserve(
+			std::min(
+				std::max(2 * bs.vecPoints.capacity(), static_cast<size_t>(DISKINDEX_LEAF_SIZE)),
+				bs.sBufferPoints));
+	}
+
+	BuildPoint pt;
+	pt.x[0] = static_cast<float>(dX);
+	pt.x[1] = static_cast<float>(dY);
+	pt.x[2] = static_cast<float>(dZ);
+	pt.key = morton_key(pt.x[0], pt.x[1], pt.x[2]);
+	pt.index = static_cast<uint32_t>(sI);
+	bs.vecPoints.push_back(pt);
+	bs.sPoints++;
+
+	if (bs.vecPoints.size() >= bs.sBufferPoints) {
+		spill_run(bs);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void DiskIndex::spill_run(
+	BuildState & bs
+) {
+	std::sort(bs.vecPoints.begin(), bs.vecPoints.end());
+
+	const std::string strFilename = scratch_filename(bs.strScratchDir, "run");
+	bs.vecRunFilenames.push_back(strFilename);
+
+	FILE * fp = fopen(strFilename.c_str(), "wb");
+	if (fp == NULL) {
+		_EXCEPTION1("Unable to open scratch file \"%s\"", strFilename.c_str());
+	}
+	size_t sWritten =
+		fwrite(&(bs.vecPoints[0]), sizeof(BuildPoint), bs.vecPoints.size(), fp);
+	if ((fclose(fp) != 0) || (sWritten != bs.vecPoints.size())) {
+		_EXCEPTION1("Unable to write scratch file \"%s\"", strFilename.c_str());
+	}
+
+	bs.vecPoints.clear();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+///	<summary>
+///		Scratch file handle, closed when it goes out of scope so that no
+///		handle is leaked if the build throws.
+///	</summary>
+struct DiskIndexScratchFile {
+	FILE * fp;
+
+	DiskIndexScratchFile() :
+		fp(NULL)
+	{ }
+
+	DiskIndexScratchFile(DiskIndexScratchFile && file) :
+		fp(file.fp)
+	{
+		file.fp = NULL;
+	}
+
+	~DiskIndexScratchFile() {
+		close();
+	}
+
+	int close() {
+		int iResult = 0;
+		if (fp != NULL) {
+			iResult = fclose(fp);
+			fp = NULL;
+		}
+		return iResult;
+	}
+
+private:
+	DiskIndexScratchFile(const DiskIndexScratchFile &);
+	DiskIndexScratchFile & operator=(const DiskIndexScratchFile &);
+};
+
+///	<summary>
+///		Buffered sequential reader of a run file.
+///	</summary>
+struct DiskIndexRunReader {
+	DiskIndexScratchFile file;
+	std::vector<char> vecBuffer;
+	size_t sCount;
+	size_t sNext;
+
+	DiskIndexRunReader() :
+		sCount(0),
+		sNext(0)
+	{ }
+};
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool DiskIndex::build(
+	IndexCacheWriter & writer
+) {
+	_ASSERT(m_pbuild != NULL);
+
+	// The build state is released (and runs removed) on return
+	std::shared_ptr<BuildState> pbuild;
+	pbuild.swap(m_pbuild);
+	BuildState & bs = *pbuild;
+
+	const size_t sPoints = bs.sPoints;
+
+	uint64_t uLevelSize[DISKINDEX_MAX_LEVELS];
+	const int nLevels = level_sizes(sPoints, uLevelSize);
+
+	// Header
+	const uint32_t uPageSize = DISKINDEX_PAGE_SIZE;
+	const uint32_t uLeafSize = DISKINDEX_LEAF_SIZE;
+	const uint32_t uBucketSize = DISKINDEX_BUCKET_SIZE;
+	const uint32_t uFanout = DISKINDEX_FANOUT;
+	const uint64_t uPoints = sPoints;
+	const uint32_t uLevels = static_cast<uint32_t>(nLevels);
+
+	writer.WriteValue(uPageSize);
+	writer.WriteValue(uLeafSize);
+	writer.WriteValue(uBucketSize);
+	writer.WriteValue(uFanout);
+	writer.WriteValue(uPoints);
+	writer.WriteValue(uLevels);
+	for (int l = 0; l < nLevels; l++) {
+		writer.WriteValue(uLevelSize[l]);
+	}
+	writer.Align(DISKINDEX_PAGE_SIZE);
+
+	// If any run has been spilled, spill the remaining points and merge
+	// all runs; otherwise the points are sorted in memory
+	std::vector<DiskIndexRunReader> vecRuns;
+	if (bs.vecRunFilenames.size() != 0) {
+		if (bs.vecPoints.size() != 0) {
+			spill_run(bs);
+		}
+		std::vector<BuildPoint>().swap(bs.vecPoints);
+
+		const size_t sRunBufferPoints =
+			std::max(bs.sBufferPoints / bs.vecRunFilenames.size(),
+				static_cast<size_t>(DISKINDEX_LEAF_SIZE));
+
+		vecRuns.resize(bs.vecRunFilenames.size());
+		for (size_t r = 0; r < vecRuns.size(); r++) {
+			vecRuns[r].file.fp = fopen(bs.vecRunFilenames[r].c_str(), "rb");
+			if (vecRuns[r].file.fp == NULL) {
+				_EXCEPTION1("Unable to open scratch file \"%s\"",
+					bs.vecRunFilenames[r].c_str());
+			}
+			vecRuns[r].vecBuffer.resize(sRunBufferPoints * sizeof(BuildPoint));
+		}
+
+		Announce("Merging %lu sorted runs", vecRuns.size());
+
+	} else {
+		std::sort(bs.vecPoints.begin(), bs.vecPoints.end());
+	}
+
+	// Next point from run r, or false if the run is exhausted
+	auto next_point = [&](size_t r, BuildPoint & pt) -> bool {
+		DiskIndexRunReader & run = vecRuns[r];
+		if (run.sNext == run.sCount) {
+			run.sCount =
+				fread(&(run.vecBuffer[0]), sizeof(BuildPoint),
+					run.vecBuffer.size() / sizeof(BuildPoint), run.file.fp);
+			run.sNext = 0;
+			if (run.sCount == 0) {
+				return false;
+			}
+		}
+		memcpy(&pt, &(run.vecBuffer[run.sNext * sizeof(BuildPoint)]), sizeof(BuildPoint));
+		run.sNext++;
+		return true;
+	};
+
+	// Min-heap of the next point of each run
+	typedef std::pair<BuildPoint, size_t> HeapEntry;
+	struct HeapEntryGreater {
+		bool operator()(const HeapEntry & a, const HeapEntry & b) const {
+			return (b.first < a.first);
+		}
+	};
+	std::priority_queue<HeapEntry, std::vector<HeapEntry>, HeapEntryGreater> heap;
+
+	for (size_t r = 0; r < vecRuns.size(); r++) {
+		BuildPoint pt;
+		if (next_point(r, pt)) {
+			heap.push(HeapEntry(pt, r));
+		}
+	}
+
+	// Write leaves in Morton order.  Level 0 is written to a scratch file
+	// and appended after the leaves; level 1 bounds one leaf per node and
+	// is kept in memory along with all higher levels.
+	bs.strBoxFilename = scratch_filename(bs.strScratchDir, "box");
+	DiskIndexScratchFile fileBox;
+	fileBox.fp = fopen(bs.strBoxFilename.c_str(), "w+b");
+	if (fileBox.fp == NULL) {
+		_EXCEPTION1("Unable to open scratch file \"%s\"", bs.strBoxFilename.c_str());
+	}
+
+	const size_t sLeaves = (sPoints + DISKINDEX_LEAF_SIZE - 1) / DISKINDEX_LEAF_SIZE;
+
+	std::vector<Node> vecLevel;
+	vecLevel.reserve(sLeaves);
+
+	Leaf leaf;
+	Node nodeBucket[DISKINDEX_FANOUT];
+	Node nodeLeaf;
+	NodeGroup group;
+	uint32_t uInLeaf = 0;
+	size_t sBuckets = 0;
+
+	const size_t sReportSize = std::max(sPoints / 100, static_cast<size_t>(1));
+
+	for (size_t i = 0; i < sPoints; i++) {
+		BuildPoint pt;
+		if (vecRuns.size() == 0) {
+			pt = bs.vecPoints[i];
+		} else {
+			if (heap.empty()) {
+				break;
+			}
+			pt = heap.top().first;
+			size_t r = heap.top().second;
+			heap.pop();
+			BuildPoint ptNext;
+			if (next_point(r, ptNext)) {
+				heap.push(HeapEntry(ptNext, r));
+			}
+		}
+
+		Node & node = nodeBucket[uInLeaf / DISKINDEX_BUCKET_SIZE];
+		if (uInLeaf % DISKINDEX_BUCKET_SIZE == 0) {
+			for (int d = 0; d < 3; d++) {
+				node.min[d] = pt.x[d];
+				node.max[d] = pt.x[d];
+			}
+		}
+		for (int d = 0; d < 3; d++) {
+			node.min[d] = std::min(node.min[d], pt.x[d]);
+			node.max[d] = std::max(node.max[d], pt.x[d]);
+		}
+
+		leaf.x[uInLeaf] = pt.x[0];
+		leaf.y[uInLeaf] = pt.x[1];
+		leaf.z[uInLeaf] = pt.x[2];
+		leaf.index[uInLeaf] = pt.index;
+		uInLeaf++;
+
+		const bool fLast = (i == sPoints - 1);
+
+		// Pad the last leaf with copies of the last point
+		uint32_t uLeafBuckets = DISKINDEX_FANOUT;
+		if (fLast) {
+			uLeafBuckets = (uInLeaf + DISKINDEX_BUCKET_SIZE - 1) / DISKINDEX_BUCKET_SIZE;
+			for (uint32_t j = uInLeaf; j < DISKINDEX_LEAF_SIZE; j++) {
+				leaf.x[j] = pt.x[0];
+				leaf.y[j] = pt.x[1];
+				leaf.z[j] = pt.x[2];
+				leaf.index[j] = pt.index;
+			}
+			uInLeaf = DISKINDEX_LEAF_SIZE;
+		}
+
+		// Leaf complete; the bounding boxes of its buckets form one group
+		// of level 0 and their union is one node of level 1
+		if (uInLeaf == DISKINDEX_LEAF_SIZE) {
+			writer.Write(&leaf, sizeof(Leaf));
+
+			pack_group(nodeBucket, uLeafBuckets, group);
+			if (fwrite(&group, sizeof(NodeGroup), 1, fileBox.fp) != 1) {
+				_EXCEPTION1("Unable to write scratch file \"%s\"", bs.strBoxFilename.c_str());
+			}
+
+			nodeLeaf = nodeBucket[0];
+			for (uint32_t b = 1; b < uLeafBuckets; b++) {
+				for (int d = 0; d < 3; d++) {
+					nodeLeaf.min[d] = std::min(nodeLeaf.min[d], nodeBucket[b].min[d]);
+					nodeLeaf.max[d] = std::max(nodeLeaf.max[d], nodeBucket[b].max[d]);
+				}
+			}
+			vecLevel.push_back(nodeLeaf);
+
+			sBuckets += uLeafBuckets;
+			uInLeaf = 0;
+		}
+
+		if ((i+1) % sReportSize == 0) {
+			AnnounceProgress(static_cast<int>((i+1) / sReportSize));
+		}
+	}
+
+	for (size_t r = 0; r < vecRuns.size(); r++) {
+		vecRuns[r].file.close();
+	}
+
+	if ((vecLevel.size() != sLeaves) || ((nLevels > 0) && (sBuckets != uLevelSize[0]))) {
+		_EXCEPTIONT("Inconsistent number of points in DiskIndex runs");
+	}
+
+	// Append level 0 from the scratch file
+	if (nLevels > 0) {
+		writer.Align(DISKINDEX_PAGE_SIZE);
+
+		std::vector<char> vecBuffer(1024 * 1024);
+		rewind(fileBox.fp);
+		for (;;) {
+			size_t sRead = fread(&(vecBuffer[0]), 1, vecBuffer.size(), fileBox.fp);
+			if (sRead == 0) {
+				break;
+			}
+			writer.Write(&(vecBuffer[0]), sRead);
+		}
+	}
+	fileBox.close();
+
+	// Write each higher level and compute the next
+	for (int l = 1; l < nLevels; l++) {
+		_ASSERT(vecLevel.size() == uLevelSize[l]);
+
+		writer.Align(DISKINDEX_PAGE_SIZE);
+		for (size_t i = 0; i < vecLevel.size(); i += DISKINDEX_FANOUT) {
+			pack_group(
+				&(vecLevel[i]),
+				std::min(vecLevel.size() - i, static_cast<size_t>(DISKINDEX_FANOUT)),
+				group);
+			writer.Write(&group, sizeof(NodeGroup));
+		}
+
+		std::vector<Node> vecNextLevel;
+		for (size_t i = 0; i < vecLevel.size(); i += DISKINDEX_FANOUT) {
+			Node nodeParent = vecLevel[i];
+			size_t sEnd = std::min(i + DISKINDEX_FANOUT, vecLevel.size());
+			for (size_t j = i + 1; j < sEnd; j++) {
+				for (int d = 0; d < 3; d++) {
+					nodeParent.min[d] = std::min(nodeParent.min[d], vecLevel[j].min[d]);
+					nodeParent.max[d] = std::max(nodeParent.max[d], vecLevel[j].max[d]);
+				}
+			}
+			vecNextLevel.push_back(nodeParent);
+		}
+		vecLevel.swap(vecNextLevel);
+	}
+
+	return writer.IsValid();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool DiskIndex::map(
+	const std::string & strFilename,
+	const IndexCacheKey & key,
+	bool fTemporary
+) {
+	std::shared_ptr<MappedFile> pmapped(new MappedFile);
+	if (fTemporary) {
+		pmapped->strRemoveFilename = strFilename;
+	}
+	pmapped->reader.reset(new IndexCacheReader(strFilename, key));
+
+	IndexCacheReader & reader = *(pmapped->reader);
+	if (!reader.IsValid()) {
+		return false;
+	}
+
+	// Header
+	uint32_t uPageSize;
+	uint32_t uLeafSize;
+	uint32_t uBucketSize;
+	uint32_t uFanout;
+	uint64_t uPoints;
+	uint32_t uLevels;
+	if (!reader.ReadValue(uPageSize) ||
+	    !reader.ReadValue(uLeafSize) ||
+	    !reader.ReadValue(uBucketSize) ||
+	    !reader.ReadValue(uFanout) ||
+	    !reader.ReadValue(uPoints) ||
+	    !reader.ReadValue(uLevels)
+	) {
+		return false;
+	}
+	if ((uPageSize != DISKINDEX_PAGE_SIZE) ||
+	    (uLeafSize != DISKINDEX_LEAF_SIZE) ||
+	    (uBucketSize != DISKINDEX_BUCKET_SIZE) ||
+	    (uFanout != DISKINDEX_FANOUT) ||
+	    (uLevels > static_cast<uint32_t>(DISKINDEX_MAX_LEVELS)) ||
+	    (uPoints >= static_cast<uint64_t>(static_cast<uint32_t>(-1)))
+	) {
+		return false;
+	}
+
+	uint64_t uLevelSize[DISKINDEX_MAX_LEVELS];
+	const int nLevels = level_sizes(static_cast<size_t>(uPoints), uLevelSize);
+	if (nLevels != static_cast<int>(uLevels)) {
+		return false;
+	}
+	for (int l = 0; l < nLevels; l++) {
+		uint64_t uSize;
+		if (!reader.ReadValue(uSize) || (uSize != uLevelSize[l])) {
+			return false;
+		}
+	}
+
+	// Leaves and levels are referenced directly in the mapping
+	const Leaf * pLeaves = NULL;
+	const NodeGroup * pLevel[DISKINDEX_MAX_LEVELS];
+	if (nLevels > 0) {
+		if (!reader.Align(DISKINDEX_PAGE_SIZE)) {
+			return false;
+		}
+		const size_t sLeaves =
+			(static_cast<size_t>(uPoints) + DISKINDEX_LEAF_SIZE - 1) / DISKINDEX_LEAF_SIZE;
+		pLeaves = static_cast<const Leaf *>(reader.Map(sLeaves * sizeof(Leaf)));
+		if (pLeaves == NULL) {
+			return false;
+		}
+	}
+	for (int l = 0; l < nLevels; l++) {
+		if (!reader.Align(DISKINDEX_PAGE_SIZE)) {
+			return false;
+		}
+		pLevel[l] =
+			static_cast<const NodeGroup *>(
+				reader.Map(group_count(uLevelSize[l]) * sizeof(NodeGroup)));
+		if (pLevel[l] == NULL) {
+			return false;
+		}
+	}
+	if (!reader.IsComplete()) {
+		return false;
+	}
+
+	reader.AdviseRandom();
+
+	// Any build in progress is no longer needed
+	clear();
+
+	m_pmapped = pmapped;
+	m_sPoints = static_cast<size_t>(uPoints);
+	m_nLevels = nLevels;
+	m_pLeaves = pLeaves;
+	for (int l = 0; l < nLevels; l++) {
+		m_uLevelSize[l] = uLevelSize[l];
+		m_pLevel[l] = pLevel[l];
+	}
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void DiskIndex::scan_bucket(
+	uint32_t uBucket,
+	float flX,
+	float flY,
+	float flZ,
+	uint32_t & uBest,
+	float & flBestDist2
+) const {
+	const uint32_t uFirst = uBucket * DISKINDEX_BUCKET_SIZE;
+	const Leaf & leaf = m_pLeaves[uFirst / DISKINDEX_LEAF_SIZE];
+	const uint32_t uOffset = uFirst % DISKINDEX_LEAF_SIZE;
+
+	float flDist2[DISKINDEX_BUCKET_SIZE];
+	for (uint32_t i = 0; i < DISKINDEX_BUCKET_SIZE; i++) {
+		const float flDX = leaf.x[uOffset + i] - flX;
+		const float flDY = leaf.y[uOffset + i] - flY;
+		const float flDZ = leaf.z[uOffset + i] - flZ;
+		flDist2[i] = flDX * flDX + flDY * flDY + flDZ * flDZ;
+	}
+	for (uint32_t i = 0; i < DISKINDEX_BUCKET_SIZE; i++) {
+		if (flDist2[i] < flBestDist2) {
+			flBestDist2 = flDist2[i];
+			uBest = uFirst + i;
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+uint32_t DiskIndex::find_nearest(
+	float flX,
+	float flY,
+	float flZ,
+	uint32_t uHint
+) const {
+	if (m_nLevels == 0) {
+		return static_cast<uint32_t>(-1);
+	}
+
+	uint32_t uBest = static_cast<uint32_t>(-1);
+	float flBestDist2 = HUGE_VALF;
+
+	if (uHint < m_uLevelSize[0] * DISKINDEX_BUCKET_SIZE) {
+		const Leaf & leaf = m_pLeaves[uHint / DISKINDEX_LEAF_SIZE];
+		const uint32_t i = uHint % DISKINDEX_LEAF_SIZE;
+		const float flDX = leaf.x[i] - flX;
+		const float flDY = leaf.y[i] - flY;
+		const float flDZ = leaf.z[i] - flZ;
+		uBest = uHint;
+		flBestDist2 = flDX * flDX + flDY * flDY + flDZ * flDZ;
+	}
+
+	const float flQ[3] = {flX, flY, flZ};
+
+	// Stack of nodes remaining to visit and their distance lower bound
+	static const int StackSize = DISKINDEX_MAX_LEVELS * DISKINDEX_FANOUT;
+	uint32_t uStackNode[StackSize];
+	int iStackLevel[StackSize];
+	float flStackDist2[StackSize];
+	int iStackSize = 1;
+
+	uStackNode[0] = 0;
+	iStackLevel[0] = m_nLevels - 1;
+	flStackDist2[0] = 0.0f;
+
+	while (iStackSize > 0) {
+		iStackSize--;
+		if (flStackDist2[iStackSize] >= flBestDist2) {
+			continue;
+		}
+
+		const uint32_t uNode = uStackNode[iStackSize];
+		const int iLevel = iStackLevel[iStackSize];
+
+		if (iLevel == 0) {
+			scan_bucket(uNode, flX, flY, flZ, uBest, flBestDist2);
+			continue;
+		}
+
+		// Push children that may contain a closer point, farthest first
+		const NodeGroup & group = m_pLevel[iLevel-1][uNode];
+
+		float flDist2[DISKINDEX_FANOUT];
+		for (uint32_t c = 0; c < DISKINDEX_FANOUT; c++) {
+			flDist2[c] = 0.0f;
+		}
+		for (int d = 0; d < 3; d++) {
+			for (uint32_t c = 0; c < DISKINDEX_FANOUT; c++) {
+				// Clamp to the box without branches, so that the loop is
+				// compiled to min/max instructions
+				float flClamp = (flQ[d] > group.min[d][c]) ? flQ[d] : group.min[d][c];
+				flClamp = (flClamp < group.max[d][c]) ? flClamp : group.max[d][c];
+				const float flOut = flQ[d] - flClamp;
+				flDist2[c] += flOut * flOut;
+			}
+		}
+
+		const int iStackBase = iStackSize;
+		for (uint32_t c = 0; c < DISKINDEX_FANOUT; c++) {
+			if (flDist2[c] >= flBestDist2) {
+				continue;
+			}
+
+			_ASSERT(iStackSize < StackSize);
+			int k = iStackSize;
+			while ((k > iStackBase) && (flStackDist2[k-1] < flDist2[c])) {
+				uStackNode[k] = uStackNode[k-1];
+				iStackLevel[k] = iStackLevel[k-1];
+				flStackDist2[k] = flStackDist2[k-1];
+				k--;
+			}
+			uStackNode[k] = uNode * DISKINDEX_FANOUT + c;
+			iStackLevel[k] = iLevel - 1;
+			flStackDist2[k] = flDist2[c];
+			iStackSize++;
+		}
+	}
+
+	return uBest;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void DiskIndex::find_nearest(
+	const float * pX,
+	const float * pY,
+	const float * pZ,
+	size_t sPoints,
+	uint32_t * pIndex
+) const {
+	uint32_t uHint = static_cast<uint32_t>(-1);
+	for (size_t i = 0; i < sPoints; i++) {
+		uHint = find_nearest(pX[i], pY[i], pZ[i], uHint);
+		if (uHint == static_cast<uint32_t>(-1)) {
+			pIndex[i] = static_cast<uint32_t>(-1);
+		} else {
+			pIndex[i] = index(uHint);
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
@@ -0,0 +1,387 @@
+///////////////////////////////////////////////////////////////////////////////
+///
+///	\file    DiskIndex.h
+///	\author  Paul Ullrich
+///	\version October 16, 2026
+///
+
+#ifndef _DISKINDEX_H_
+#define _DISKINDEX_H_
+
+#include "IndexCache.h"
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdio>
+#include <cstddef>
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+///	<summary>
+///		A nearest-neighbor index of points on the unit sphere that is built
+///		and queried out of core, for meshes too large to index in memory.
+///		Points are inserted in any order with insert(); once the build
+///		buffer is full it is sorted by 3D Morton (Z-order) key and spilled
+///		to a run file in the scratch directory.  build() merges all runs
+///		into an index file of page-sized leaves, each holding a contiguous
+///		range of the sorted points, followed by a packed bounding box tree
+///		over buckets of consecutive points.  The index file is then memory
+///		mapped, so leaves and boxes are paged in on demand and can be
+///		evicted by the operating system.
+///	</summary>
+class DiskIndex {
+
+public:
+	///	<summary>
+	///		Size of a leaf page in bytes.
+	///	</summary>
+	static const uint32_t DISKINDEX_PAGE_SIZE = 4096;
+
+	///	<summary>
+	///		Number of points in a leaf page.
+	///	</summary>
+	static const uint32_t DISKINDEX_LEAF_SIZE = 256;
+
+	///	<summary>
+	///		Number of children of each internal node.
+	///	</summary>
+	static const uint32_t DISKINDEX_FANOUT = 16;
+
+	///	<summary>
+	///		Number of points bounded by each node of level 0.  The product
+	///		with DISKINDEX_FANOUT must be DISKINDEX_LEAF_SIZE, so that each
+	///		node of level 1 bounds exactly one leaf.
+	///	</summary>
+	static const uint32_t DISKINDEX_BUCKET_SIZE = 16;
+
+	///	<summary>
+	///		Maximum number of levels of bounding boxes.
+	///	</summary>
+	static const int DISKINDEX_MAX_LEVELS = 16;
+
+	///	<summary>
+	///		A leaf page, storing single-precision coordinates as a
+	///		structure-of-arrays.  The last leaf is padded with copies of
+	///		the last point.
+	///	</summary>
+	struct Leaf {
+		float x[DISKINDEX_LEAF_SIZE];
+		float y[DISKINDEX_LEAF_SIZE];
+		float z[DISKINDEX_LEAF_SIZE];
+		uint32_t index[DISKINDEX_LEAF_SIZE];
+	};
+
+	///	<summary>
+	///		A bounding box.  Node i of level 0 bounds the points at positions
+	///		[BUCKET_SIZE * i, BUCKET_SIZE * (i+1)); node i of level k bounds
+	///		nodes [FANOUT * i, FANOUT * (i+1)) of level k-1.
+	///	</summary>
+	struct Node {
+		float min[3];
+		float max[3];
+	};
+
+	///	<summary>
+	///		Bounding boxes of DISKINDEX_FANOUT consecutive nodes of one
+	///		level, stored as a structure-of-arrays so that all children of
+	///		a node are tested at once.  Group i of level k holds the children
+	///		of node i of level k+1.  Unused entries are empty boxes.
+	///	</summary>
+	struct NodeGroup {
+		float min[3][DISKINDEX_FANOUT];
+		float max[3][DISKINDEX_FANOUT];
+	};
+
+protected:
+	///	<summary>
+	///		A point used during construction.
+	///	</summary>
+	struct BuildPoint {
+		uint64_t key;
+		float x[3];
+		uint32_t index;
+
+		bool operator<(const BuildPoint & pt) const {
+			if (key != pt.key) {
+				return (key < pt.key);
+			}
+			return (index < pt.index);
+		}
+	};
+
+	///	<summary>
+	///		State of an index under construction.
+	///	</summary>
+	struct BuildState {
+		///	<summary>
+		///		Destructor.  Removes all run files.
+		///	</summary>
+		~BuildState();
+
+		///	<summary>
+		///		Directory in which run files are written.
+		///	</summary>
+		std::string strScratchDir;
+
+		///	<summary>
+		///		Maximum number of points in vecPoints.
+		///	</summary>
+		size_t sBufferPoints;
+
+		///	<summary>
+		///		Total number of points inserted.
+		///	</summary>
+		size_t sPoints;
+
+		///	<summary>
+		///		Points not yet written to a run.
+		///	</summary>
+		std::vector<BuildPoint> vecPoints;
+
+		///	<summary>
+		///		Names of run files, each sorted by Morton key.
+		///	</summary>
+		std::vector<std::string> vecRunFilenames;
+
+		///	<summary>
+		///		Name of the scratch file holding level 0 during the merge.
+		///	</summary>
+		std::string strBoxFilename;
+	};
+
+	///	<summary>
+	///		A memory mapped index file, removed on release if temporary.
+	///	</summary>
+	struct MappedFile {
+		///	<summary>
+		///		Destructor.
+		///	</summary>
+		~MappedFile();
+
+		///	<summary>
+		///		Reader holding the mapping.
+		///	</summary>
+		std::unique_ptr<IndexCacheReader> reader;
+
+		///	<summary>
+		///		File to remove once unmapped, if any.
+		///	</summary>
+		std::string strRemoveFilename;
+	};
+
+public:
+	///	<summary>
+	///		Constructor.
+	///	</summary>
+	DiskIndex();
+
+	///	<summary>
+	///		Unmap the index and discard any build in progress.
+	///	</summary>
+	void clear();
+
+	///	<summary>
+	///		Get a unique name for a scratch file in the given directory.
+	///	</summary>
+	static std::string scratch_filename(
+		const std::string & strScratchDir,
+		const char * szSuffix
+	);
+
+	///	<summary>
+	///		Check if the index contains no points.
+	///	</summary>
+	bool empty() const {
+		return (m_sPoints == 0);
+	}
+
+	///	<summary>
+	///		Number of points in the index.
+	///	</summary>
+	size_t size() const {
+		return m_sPoints;
+	}
+
+	///	<summary>
+	///		Memory used by the bounding box tree, in bytes.  Leaves are
+	///		not included since they are paged in on demand.
+	///	</summary>
+	size_t memory_usage() const;
+
+	///	<summary>
+	///		Begin building an index.  At most sMemoryBytes are used for
+	///		buffering points; runs are spilled to strScratchDir.
+	///	</summary>
+	void begin_build(
+		const std::string & strScratchDir,
+		size_t sMemoryBytes
+	);
+
+	///	<summary>
+	///		Add a point to the index.  The point is not searchable until
+	///		build() is called.
+	///	</summary>
+	void insert(
+		double dX,
+		double dY,
+		double dZ,
+		size_t sI
+	);
+
+	///	<summary>
+	///		Merge all inserted points into an index file and discard the
+	///		runs.  Returns false if the index could not be written.
+	///	</summary>
+	bool build(
+		IndexCacheWriter & writer
+	);
+
+	///	<summary>
+	///		Map an index file written by build(), replacing the current
+	///		index and discarding any build in progress.  If fTemporary is
+	///		set the file is removed once it is no longer mapped.  Returns
+	///		false and leaves this index unchanged if the file does not
+	///		exist or is invalid.
+	///	</summary>
+	bool map(
+		const std::string & strFilename,
+		const IndexCacheKey & key,
+		bool fTemporary
+	);
+
+	///	<summary>
+	///		Find the nearest point to (flX, flY, flZ).  If uHint is a valid
+	///		position (such as the result of the previous query) the distance
+	///		to it is used as the initial search radius.  Returns the position
+	///		of the nearest point, which can be converted to an index with
+	///		index(), or static_cast<uint32_t>(-1) if the index is empty.
+	///	</summary>
+	uint32_t find_nearest(
+		float flX,
+		float flY,
+		float flZ,
+		uint32_t uHint = static_cast<uint32_t>(-1)
+	) const;
+
+	///	<summary>
+	///		Find the nearest point to each of sPoints query points, storing
+	///		the index of each in pIndex.  Successive queries are seeded with
+	///		the previous result, so batches of nearby points are fastest.
+	///		Indices are static_cast<uint32_t>(-1) if the index is empty.
+	///	</summary>
+	void find_nearest(
+		const float * pX,
+		const float * pY,
+		const float * pZ,
+		size_t sPoints,
+		uint32_t * pIndex
+	) const;
+
+	///	<summary>
+	///		Index of the point at the given position.
+	///	</summary>
+	uint32_t index(
+		uint32_t uPos
+	) const {
+		return m_pLeaves[uPos / DISKINDEX_LEAF_SIZE].index[uPos % DISKINDEX_LEAF_SIZE];
+	}
+
+protected:
+	///	<summary>
+	///		Compute the 63-bit Morton key of a point in [-1,1]^3.
+	///	</summary>
+	static uint64_t morton_key(
+		float flX,
+		float flY,
+		float flZ
+	);
+
+	///	<summary>
+	///		Pack up to DISKINDEX_FANOUT nodes into a NodeGroup.
+	///	</summary>
+	static void pack_group(
+		const Node * pNodes,
+		size_t sNodes,
+		NodeGroup & group
+	);
+
+	///	<summary>
+	///		Number of NodeGroups storing a level of the given size.
+	///	</summary>
+	static size_t group_count(
+		uint64_t uLevelSize
+	) {
+		return static_cast<size_t>((uLevelSize + DISKINDEX_FANOUT - 1) / DISKINDEX_FANOUT);
+	}
+
+	///	<summary>
+	///		Sort the build buffer and write it to a new run file.
+	///	</summary>
+	static void spill_run(
+		BuildState & bs
+	);
+
+	///	<summary>
+	///		Number of nodes in each level for the given number of points.
+	///		Returns the number of levels.
+	///	</summary>
+	static int level_sizes(
+		size_t sPoints,
+		uint64_t * pLevelSize
+	);
+
+	///	<summary>
+	///		Scan a bucket for a point closer than flBestDist2.
+	///	</summary>
+	void scan_bucket(
+		uint32_t uBucket,
+		float flX,
+		float flY,
+		float flZ,
+		uint32_t & uBest,
+		float & flBestDist2
+	) const;
+
+protected:
+	///	<summary>
+	///		Index under construction, or NULL.
+	///	</summary>
+	std::shared_ptr<BuildState> m_pbuild;
+
+	///	<summary>
+	///		Mapped index file, or NULL.  Shared by copies of this index.
+	///	</summary>
+	std::shared_ptr<MappedFile> m_pmapped;
+
+	///	<summary>
+	///		Number of points in the index.
+	///	</summary>
+	size_t m_sPoints;
+
+	///	<summary>
+	///		Number of levels of bounding boxes.
+	///	</summary>
+	int m_nLevels;
+
+	///	<summary>
+	///		Number of nodes in each level.
+	///	</summary>
+	uint64_t m_uLevelSize[DISKINDEX_MAX_LEVELS];
+
+	///	<summary>
+	///		Nodes of each level, in the mapped file.
+	///	</summary>
+	const NodeGroup * m_pLevel[DISKINDEX_MAX_LEVELS];
+
+	///	<summary>
+	///		Leaves, in the mapped file.
+	///	</summary>
+	const Leaf * m_pLeaves;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // _DISKINDEX_H_
+
@@ -8,6 +8,8 @@
 #include "GridDataSampler.h"
 #include "CoordTransforms.h"
 #include <algorithm>
+#include <atomic>
+#include <limits>
 
 ///////////////////////////////////////////////////////////////////////////////
 // GridDataSampler
@@ -20,6 +22,424 @@ void GridDataSampler::Initialize(
 	m_fIsInitialized = true;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+
+bool GridDataSampler::ReadIndexCache(
+	const IndexCacheKey & key
+) {
+	const std::string strFilename =
+		m_strIndexCacheDir + "/" + key.ToString() + ".idx";
+
+	IndexCacheReader reader(strFilename, key);
+	if (!reader.IsValid()) {
+		return false;
+	}
+	if (!ReadIndex(reader) || !reader.IsComplete()) {
+		Announce("Ignoring invalid index cache \"%s\"", strFilename.c_str());
+		return false;
+	}
+
+	Announce("Loaded index from cache \"%s\"", strFilename.c_str());
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void GridDataSampler::WriteIndexCache(
+	const IndexCacheKey & key
+) const {
+	const std::string strFilename =
+		m_strIndexCacheDir + "/" + key.ToString() + ".idx";
+
+	IndexCacheWriter writer(strFilename, key);
+	if (!WriteIndex(writer)) {
+		return;
+	}
+	if (!writer.Commit()) {
+		Announce("Unable to write index cache \"%s\"", strFilename.c_str());
+		return;
+	}
+
+	Announce("Wrote index to cache \"%s\"", strFilename.c_str());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void GridDataSampler::Sample(
+	const std::vector<double> & dSampleLon,
+	const std::vector<double> & dSampleLat,
+	std::vector<int> & dImageMap
+) const {
+	const size_t sWidth = dSampleLon.size();
+	const size_t sHeight = dSampleLat.size();
+
+	dImageMap.resize(sWidth * sHeight);
+
+	if ((sWidth == 0) || (sHeight == 0)) {
+		return;
+	}
+
+	if ((m_nAdaptiveTileSize > 1) && (sWidth > 1) && (sHeight > 1)) {
+		SampleAdaptive(dSampleLon, dSampleLat, dImageMap);
+		return;
+	}
+
+	// Trigonometric functions of longitude are shared by all rows
+	std::vector<double> dSinLon(sWidth);
+	std::vector<double> dCosLon(sWidth);
+	SinCosDeg(&(dSampleLon[0]), sWidth, &(dSinLon[0]), &(dCosLon[0]));
+
+	// Sample a band of rows; each row shares the same latitude
+	auto fnSampleRows = [&](size_t jBegin, size_t jEnd) {
+		for (size_t j = jBegin; j < jEnd; j++) {
+			SampleRow(
+				&(dSampleLon[0]),
+				&(dSinLon[0]),
+				&(dCosLon[0]),
+				dSampleLat[j],
+				sWidth,
+				&(dImageMap[j * sWidth]));
+		}
+	};
+
+	if (m_pThreadPool == NULL) {
+		fnSampleRows(0, sHeight);
+
+	} else {
+		size_t sBandSize = sHeight / (4 * m_pThreadPool->GetThreadCount());
+		if (sBandSize < 1) {
+			sBandSize = 1;
+		}
+		m_pThreadPool->ParallelFor(0, sHeight, sBandSize, fnSampleRows);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void GridDataSampler::SampleRow(
+	const double * pLon,
+	const double * pSinLon,
+	const double * pCosLon,
+	double dLat,
+	size_t sPoints,
+	int * pImageMap
+) const {
+	std::vector<double> dRowLat(sPoints, dLat);
+
+	SamplePoints(pLon, &(dRowLat[0]), sPoints, pImageMap);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void GridDataSampler::SampleAdaptive(
+	const std::vector<double> & dSampleLon,
+	const std::vector<double> & dSampleLat,
+	std::vector<int> & dImageMap
+) const {
+	struct Tile {
+		int i0;
+		int i1;
+		int j0;
+		int j1;
+	};
+
+	const int nWidth = static_cast<int>(dSampleLon.size());
+	const int nHeight = static_cast<int>(dSampleLat.size());
+	const int nTile = m_nAdaptiveTileSize;
+
+	_ASSERT((nWidth > 1) && (nHeight > 1) && (nTile > 1));
+
+	// Number of rows of tiles; tile row t spans image rows
+	// [t * nTile, min((t+1) * nTile, nHeight - 1)]
+	const size_t sTileRows = static_cast<size_t>((nHeight - 2) / nTile + 1);
+
+	std::atomic<size_t> sQueries(0);
+
+	// Execute a function over a range in parallel, if possible
+	auto fnParallelFor = [&](size_t sCount, const ThreadPool::RangeFunction & fn) {
+		if (m_pThreadPool == NULL) {
+			fn(0, sCount);
+		} else {
+			m_pThreadPool->ParallelFor(0, sCount, 1, fn);
+		}
+	};
+
+	// Sample all rows on tile boundaries, subdividing each row in one
+	// dimension only
+	auto fnSampleBoundaryRows = [&](size_t rBegin, size_t rEnd) {
+		std::vector<char> cState(nWidth);
+		std::vector<int> vecQueued;
+		std::vector<double> dQueuedLon;
+		std::vector<double> dQueuedLat;
+		std::vector<int> iQueuedValue;
+		std::vector<int> vecSegments;
+		std::vector<int> vecNextSegments;
+
+		for (size_t r = rBegin; r < rEnd; r++) {
+			const int j = std::min(static_cast<int>(r) * nTile, nHeight - 1);
+			int * pRow = &(dImageMap[static_cast<size_t>(j) * nWidth]);
+
+			std::fill(cState.begin(), cState.end(), 0);
+
+			auto fnQueue = [&](int i) {
+				if (cState[i] == 0) {
+					cState[i] = 2;
+					vecQueued.push_back(i);
+				}
+			};
+
+			auto fnFlush = [&]() {
+				const size_t sQueued = vecQueued.size();
+				if (sQueued == 0) {
+					return;
+				}
+				dQueuedLon.resize(sQueued);
+				dQueuedLat.resize(sQueued);
+				iQueuedValue.resize(sQueued);
+				for (size_t k = 0; k < sQueued; k++) {
+					dQueuedLon[k] = dSampleLon[vecQueued[k]];
+					dQueuedLat[k] = dSampleLat[j];
+				}
+				SamplePoints(&(dQueuedLon[0]), &(dQueuedLat[0]), sQueued, &(iQueuedValue[0]));
+				for (size_t k = 0; k < sQueued; k++) {
+					pRow[vecQueued[k]] = iQueuedValue[k];
+					cState[vecQueued[k]] = 1;
+				}
+				sQueries += sQueued;
+				vecQueued.clear();
+			};
+
+			// Segments are stored by their first pixel; segment k ends
+			// at the first pixel of the next segment
+			vecSegments.clear();
+			for (int i = 0; i < nWidth - 1; i += nTile) {
+				fnQueue(i);
+				vecSegments.push_back(i);
+				vecSegments.push_back(std::min(i + nTile, nWidth - 1));
+			}
+			fnQueue(nWidth - 1);
+			fnFlush();
+
+			while (vecSegments.size() != 0) {
+				vecNextSegments.clear();
+				for (size_t k = 0; k < vecSegments.size(); k += 2) {
+					const int i0 = vecSegments[k];
+					const int i1 = vecSegments[k+1];
+					if (pRow[i0] == pRow[i1]) {
+						for (int i = i0 + 1; i < i1; i++) {
+							if (cState[i] == 0) {
+								cState[i] = 1;
+								pRow[i] = pRow[i0];
+							}
+						}
+					} else if (i1 - i0 > 1) {
+						const int im = (i0 + i1) / 2;
+						fnQueue(im);
+						vecNextSegments.push_back(i0);
+						vecNextSegments.push_back(im);
+						vecNextSegments.push_back(im);
+						vecNextSegments.push_back(i1);
+					}
+				}
+				fnFlush();
+				vecSegments.swap(vecNextSegments);
+			}
+		}
+	};
+
+	fnParallelFor(sTileRows + 1, fnSampleBoundaryRows);
+
+	// Sample the interior of each row of tiles.  Boundary rows are
+	// already known, so rows of tiles are independent and the imagemap
+	// does not depend on the number of threads.
+	auto fnSampleTileRows = [&](size_t tBegin, size_t tEnd) {
+		std::vector<char> cState;
+		std::vector<int> iValue;
+		std::vector<int> vecQueued;
+		std::vector<double> dQueuedLon;
+		std::vector<double> dQueuedLat;
+		std::vector<int> iQueuedValue;
+		std::vector<Tile> vecTiles;
+		std::vector<Tile> vecNextTiles;
+
+		for (size_t t = tBegin; t < tEnd; t++) {
+			const int j0 = static_cast<int>(t) * nTile;
+			const int j1 = std::min(j0 + nTile, nHeight - 1);
+			const int nRows = j1 - j0 + 1;
+
+			if (nRows <= 2) {
+				continue;
+			}
+
+			// Count tiles whose corners differ; if nearly all tiles are
+			// not homogeneous the interior rows are sampled directly
+			int nTiles = 0;
+			int nMixedTiles = 0;
+			{
+				const int * pRow0 = &(dImageMap[static_cast<size_t>(j0) * nWidth]);
+				const int * pRow1 = &(dImageMap[static_cast<size_t>(j1) * nWidth]);
+				for (int i = 0; i < nWidth - 1; i += nTile) {
+					const int i1 = std::min(i + nTile, nWidth - 1);
+					if ((pRow0[i] != pRow0[i1]) ||
+					    (pRow0[i] != pRow1[i]) ||
+					    (pRow0[i] != pRow1[i1])
+					) {
+						nMixedTiles++;
+					}
+					nTiles++;
+				}
+			}
+
+			if (10 * nMixedTiles > 9 * nTiles) {
+				dQueuedLat.resize(nWidth);
+				for (int j = j0 + 1; j < j1; j++) {
+					std::fill(dQueuedLat.begin(), dQueuedLat.end(), dSampleLat[j]);
+					SamplePoints(
+						&(dSampleLon[0]),
+						&(dQueuedLat[0]),
+						nWidth,
+						&(dImageMap[static_cast<size_t>(j) * nWidth]));
+				}
+				sQueries += static_cast<size_t>(nWidth) * (nRows - 2);
+				continue;
+			}
+
+			// State of each pixel: 0 = unknown, 1 = known, 2 = queued
+			cState.resize(nWidth * nRows);
+			iValue.resize(nWidth * nRows);
+			std::fill(cState.begin(), cState.end(), 0);
+			std::fill(cState.begin(), cState.begin() + nWidth, 1);
+			std::fill(cState.end() - nWidth, cState.end(), 1);
+			std::copy(
+				dImageMap.begin() + static_cast<size_t>(j0) * nWidth,
+				dImageMap.begin() + static_cast<size_t>(j0 + 1) * nWidth,
+				iValue.begin());
+			std::copy(
+				dImageMap.begin() + static_cast<size_t>(j1) * nWidth,
+				dImageMap.begin() + static_cast<size_t>(j1 + 1) * nWidth,
+				iValue.end() - nWidth);
+
+			auto fnQueue = [&](int i, int j) {
+				const int ix = (j - j0) * nWidth + i;
+				if (cState[ix] == 0) {
+					cState[ix] = 2;
+					vecQueued.push_back(ix);
+				}
+			};
+
+			auto fnFlush = [&]() {
+				const size_t sQueued = vecQueued.size();
+				if (sQueued == 0) {
+					return;
+				}
+				dQueuedLon.resize(sQueued);
+				dQueuedLat.resize(sQueued);
+				iQueuedValue.resize(sQueued);
+				for (size_t k = 0; k < sQueued; k++) {
+					dQueuedLon[k] = dSampleLon[vecQueued[k] % nWidth];
+					dQueuedLat[k] = dSampleLat[j0 + vecQueued[k] / nWidth];
+				}
+				SamplePoints(&(dQueuedLon[0]), &(dQueuedLat[0]), sQueued, &(iQueuedValue[0]));
+				for (size_t k = 0; k < sQueued; k++) {
+					iValue[vecQueued[k]] = iQueuedValue[k];
+					cState[vecQueued[k]] = 1;
+				}
+				sQueries += sQueued;
+				vecQueued.clear();
+			};
+
+			vecTiles.clear();
+			for (int i = 0; i < nWidth - 1; i += nTile) {
+				Tile tile;
+				tile.i0 = i;
+				tile.i1 = std::min(i + nTile, nWidth - 1);
+				tile.j0 = j0;
+				tile.j1 = j1;
+				vecTiles.push_back(tile);
+			}
+
+			// Fill homogeneous tiles and subdivide the others
+			while (vecTiles.size() != 0) {
+				vecNextTiles.clear();
+
+				for (size_t k = 0; k < vecTiles.size(); k++) {
+					const Tile & tile = vecTiles[k];
+
+					const int iv00 = iValue[(tile.j0 - j0) * nWidth + tile.i0];
+					const int iv10 = iValue[(tile.j0 - j0) * nWidth + tile.i1];
+					const int iv01 = iValue[(tile.j1 - j0) * nWidth + tile.i0];
+					const int iv11 = iValue[(tile.j1 - j0) * nWidth + tile.i1];
+
+					if ((iv00 == iv10) && (iv00 == iv01) && (iv00 == iv11)) {
+						for (int j = tile.j0; j <= tile.j1; j++) {
+							for (int i = tile.i0; i <= tile.i1; i++) {
+								const int ix = (j - j0) * nWidth + i;
+								if (cState[ix] == 0) {
+									cState[ix] = 1;
+									iValue[ix] = iv00;
+								}
+							}
+						}
+						continue;
+					}
+
+					const int nTileWidth = tile.i1 - tile.i0;
+					const int nTileHeight = tile.j1 - tile.j0;
+					if ((nTileWidth <= 1) && (nTileHeight <= 1)) {
+						continue;
+					}
+
+					int iSplit[3] = {tile.i0, tile.i1, tile.i1};
+					int jSplit[3] = {tile.j0, tile.j1, tile.j1};
+					int nSplitI = 1;
+					int nSplitJ = 1;
+					if (nTileWidth > 1) {
+						iSplit[1] = (tile.i0 + tile.i1) / 2;
+						nSplitI = 2;
+					}
+					if (nTileHeight > 1) {
+						jSplit[1] = (tile.j0 + tile.j1) / 2;
+						nSplitJ = 2;
+					}
+
+					for (int b = 0; b < nSplitJ; b++) {
+					for (int a = 0; a < nSplitI; a++) {
+						Tile tileChild;
+						tileChild.i0 = iSplit[a];
+						tileChild.i1 = iSplit[a+1];
+						tileChild.j0 = jSplit[b];
+						tileChild.j1 = jSplit[b+1];
+						vecNextTiles.push_back(tileChild);
+
+						fnQueue(tileChild.i0, tileChild.j0);
+						fnQueue(tileChild.i1, tileChild.j0);
+						fnQueue(tileChild.i0, tileChild.j1);
+						fnQueue(tileChild.i1, tileChild.j1);
+					}
+					}
+				}
+
+				fnFlush();
+				vecTiles.swap(vecNextTiles);
+			}
+
+			// Copy interior rows to the imagemap
+			std::copy(
+				iValue.begin() + nWidth,
+				iValue.end() - nWidth,
+				dImageMap.begin() + static_cast<size_t>(j0 + 1) * nWidth);
+		}
+	};
+
+	fnParallelFor(sTileRows, fnSampleTileRows);
+
+	const size_t sPixels = dImageMap.size();
+	Announce("Adaptive sampling: %lu queries for %lu pixels (%1.1f%% saved)",
+		static_cast<unsigned long>(sQueries.load()),
+		static_cast<unsigned long>(sPixels),
+		100.0 * (1.0 - static_cast<double>(sQueries.load()) / static_cast<double>(sPixels)));
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // GridDataSamplerUsingCubedSphereQuadTree
 ///////////////////////////////////////////////////////////////////////////////
@@ -31,20 +451,27 @@ void GridDataSamplerUsingCubedSphereQuadTree::ABPFromRLL(
 	double & dB,
 	int & nP
 ) {
-	const double dLonRad = DegToRad(dLonDeg);
-	const double dLatRad = DegToRad(dLatDeg);
+	// Translate from RLL coordinates to XYZ space
+	double xx, yy, zz;
+	RLLtoXYZ_Deg(dLonDeg, dLatDeg, xx, yy, zz);
 
-	// Default panel to unattainable value
-	nP = 6;
+	ABPFromXYZ(xx, yy, zz, dA, dB, nP);
+}
 
-	// Translate from RLL coordinates to XYZ space
-	double xx, yy, zz, pm;
+////////////////////////////////////////////////////////////////////////////////
 
-	xx = cos(dLonRad) * cos(dLatRad);
-	yy = sin(dLonRad) * cos(dLatRad);
-	zz = sin(dLatRad);
+void GridDataSamplerUsingCubedSphereQuadTree::ABPFromXYZ(
+	double xx,
+	double yy,
+	double zz,
+	double & dA,
+	double & dB,
+	int & nP
+) {
+	// Default panel to unattainable value
+	nP = 6;
 
-	pm = std::max(fabs(xx), std::max(fabs(yy), fabs(zz)));
+	double pm = std::max(fabs(xx), std::max(fabs(yy), fabs(zz)));
 
 	// Check maxmality of the x coordinate
 	if (pm == fabs(xx)) {
@@ -75,6 +502,24 @@ void GridDataSamplerUsingCubedSphereQuadTree::ABPFromRLL(
 
 	// Panel assignments
 	double sx, sy, sz;
+	PanelFromXYZ(nP, xx, yy, zz, sx, sy, sz);
+
+	// Convert to equiangular coordinates
+	dA = atan(sx / sz);
+	dB = atan(sy / sz);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void GridDataSamplerUsingCubedSphereQuadTree::PanelFromXYZ(
+	int nP,
+	double xx,
+	double yy,
+	double zz,
+	double & sx,
+	double & sy,
+	double & sz
+) {
 	if (nP == 0) {
 		sx = yy;
 		sy = zz;
@@ -108,10 +553,52 @@ void GridDataSamplerUsingCubedSphereQuadTree::ABPFromRLL(
 	} else {
 		_EXCEPTIONT("Logic error.");
 	}
+}
 
-	// Convert to equiangular coordinates
-	dA = atan(sx / sz);
-	dB = atan(sy / sz);
+////////////////////////////////////////////////////////////////////////////////
+
+void GridDataSamplerUsingCubedSphereQuadTree::XYZFromPanel(
+	int nP,
+	double sx,
+	double sy,
+	double sz,
+	double & xx,
+	double & yy,
+	double & zz
+) {
+	if (nP == 0) {
+		xx = sz;
+		yy = sx;
+		zz = sy;
+
+	} else if (nP == 1) {
+		xx = -sx;
+		yy = sz;
+		zz = sy;
+
+	} else if (nP == 2) {
+		xx = -sz;
+		yy = -sx;
+		zz = sy;
+
+	} else if (nP == 3) {
+		xx = sx;
+		yy = -sz;
+		zz = sy;
+
+	} else if (nP == 4) {
+		xx = -sy;
+		yy = sx;
+		zz = sz;
+
+	} else if (nP == 5) {
+		xx = sy;
+		yy = sx;
+		zz = -sz;
+
+	} else {
+		_EXCEPTIONT("Logic error.");
+	}
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -128,6 +615,21 @@ void GridDataSamplerUsingCubedSphereQuadTree::Initialize(
 
 	_ASSERT(dLon.size() == dLat.size());
 
+	// Load the index from the cache if available
+	const bool fUseIndexCache = UseIndexCache(dLon.size());
+
+	IndexCacheKey key("csqt");
+	if (fUseIndexCache) {
+		key.Add(dLon);
+		key.Add(dLat);
+		key.Add(dFillValue);
+		key.Add(dMaxCellRadius);
+
+		if (ReadIndexCache(key)) {
+			return;
+		}
+	}
+
 	for (int i = 0; i < m_vecquadtree.size(); i++) {
 		m_vecquadtree[i].clear();
 	}
@@ -135,7 +637,7 @@ void GridDataSamplerUsingCubedSphereQuadTree::Initialize(
 
 	AnnounceStartBlock("Generating quadtree from lat/lon arrays");
 
-	m_vecquadtree.resize(6, QuadTreeNode(-0.5*M_PI, 0.5*M_PI, -0.5*M_PI, 0.5*M_PI));
+	m_vecquadtree.resize(6, QuadTree(-0.5*M_PI, 0.5*M_PI, -0.5*M_PI, 0.5*M_PI));
 
 	m_fDistanceFilter = false;
 	if (dMaxCellRadius > 0.0) {
@@ -144,32 +646,75 @@ void GridDataSamplerUsingCubedSphereQuadTree::Initialize(
 
 	int iMaxLevel = 0;
 
-	long iReportSize = static_cast<long>(dLon.size()) / 100;
+	// Compute equiangular coordinates of all points (panel -1 for missing)
+	std::vector<double> dA(dLon.size());
+	std::vector<double> dB(dLon.size());
+	std::vector<signed char> nP(dLon.size());
+
+	auto fnABPFromRLL = [&](size_t sBegin, size_t sEnd) {
+		for (size_t i = sBegin; i < sEnd; i++) {
+			if (std::isnan(dLon[i]) || std::isnan(dLat[i])) {
+				nP[i] = (-1);
+			} else if ((dLon[i] == dFillValue) || (dLat[i] == dFillValue)) {
+				nP[i] = (-1);
+			} else {
+				int iP;
+				ABPFromRLL(dLon[i], dLat[i], dA[i], dB[i], iP);
+				_ASSERT((iP >= 0) && (iP <= 5));
+				nP[i] = static_cast<signed char>(iP);
+			}
+		}
+	};
+
+	if (m_pThreadPool == NULL) {
+		fnABPFromRLL(0, dLon.size());
+	} else {
+		m_pThreadPool->ParallelFor(0, dLon.size(), 65536, fnABPFromRLL);
+	}
+
+	long iReportSize = std::max(static_cast<long>(dLon.size()) / 100, 1L);
+	int iProgressLast = (-1);
 	for (long i = 0; i < dLon.size(); i++) {
 
-		if (std::isnan(dLon[i]) || std::isnan(dLat[i])) {
+		if (nP[i] == (-1)) {
 			m_fDistanceFilter = true;
-		} else if ((dLon[i] == dFillValue) || (dLat[i] == dFillValue)) {
-			m_fDistanceFilter = true;
-		} else {	
-			double dA;
-			double dB;
-			int nP;
+		} else {
+			m_vecquadtree[nP[i]].insert(dA[i], dB[i], i);
+		}
 
-			ABPFromRLL(dLon[i], dLat[i], dA, dB, nP);
+		if ((i+1) % iReportSize == 0) {
+			const int iPercent = static_cast<int>(i / iReportSize) / 10;
+			if (iPercent != iProgressLast) {
+				iProgressLast = iPercent;
+				AnnounceProgress(iPercent);
+			}
+		}
+	}
 
-			_ASSERT((nP >= 0) && (nP <= 5));
+	// Inserting points is the first 10% of the work; building the
+	// quadtree of each panel takes a share of the rest by size
+	size_t sPointsBuilt = 0;
+	size_t sPointsTotal = 0;
+	for (int p = 0; p < m_vecquadtree.size(); p++) {
+		sPointsTotal += m_vecquadtree[p].size();
+	}
 
-			int iLevel = m_vecquadtree[nP].insert(dA, dB, i);
-			if (iLevel > iMaxLevel) {
-				iMaxLevel = iLevel;
-			}
+	size_t sMemoryUsage = 0;
+	for (int p = 0; p < m_vecquadtree.size(); p++) {
+		if (sPointsTotal != 0) {
+			m_vecquadtree[p].set_build_progress(
+				10 + static_cast<int>(90 * sPointsBuilt / sPointsTotal),
+				10 + static_cast<int>(90 * (sPointsBuilt + m_vecquadtree[p].size()) / sPointsTotal));
 		}
+		sPointsBuilt += m_vecquadtree[p].size();
 
-		if ((i+1) % iReportSize == 0) {
-			Announce("%li%% complete", i / iReportSize);
+		int iLevel = m_vecquadtree[p].build(m_pThreadPool);
+		if (iLevel > iMaxLevel) {
+			iMaxLevel = iLevel;
 		}
+		sMemoryUsage += m_vecquadtree[p].memory_usage();
 	}
+	Announce("QuadTree memory usage: %1.2f MB", static_cast<double>(sMemoryUsage) / (1024.0 * 1024.0));
 
 	// Try to generate max cell radius dynamically
 	if (dMaxCellRadius == 0.0) {
@@ -181,214 +726,703 @@ void GridDataSamplerUsingCubedSphereQuadTree::Initialize(
 		Announce("Maximum render distance: %1.5e (%i)", m_dMaxCellRadius, iMaxLevel);
 	}
 
+	if (fUseIndexCache) {
+		WriteIndexCache(key);
+	}
+
 	AnnounceEndBlock("Done");
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-void GridDataSamplerUsingCubedSphereQuadTree::Sample(
-	const std::vector<double> & dSampleLon,
-	const std::vector<double> & dSampleLat,
-	std::vector<int> & dImageMap
+bool GridDataSamplerUsingCubedSphereQuadTree::ReadIndex(
+	IndexCacheReader & reader
+) {
+	if (!reader.ReadValue(m_fDistanceFilter) ||
+	    !reader.ReadValue(m_dMaxCellRadius)
+	) {
+		return false;
+	}
+
+	m_vecquadtree.clear();
+	m_vecquadtree.resize(6, QuadTree(-0.5*M_PI, 0.5*M_PI, -0.5*M_PI, 0.5*M_PI));
+	for (int p = 0; p < m_vecquadtree.size(); p++) {
+		if (!m_vecquadtree[p].read(reader)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool GridDataSamplerUsingCubedSphereQuadTree::WriteIndex(
+	IndexCacheWriter & writer
+) const {
+	writer.WriteValue(m_fDistanceFilter);
+	writer.WriteValue(m_dMaxCellRadius);
+	for (int p = 0; p < m_vecquadtree.size(); p++) {
+		m_vecquadtree[p].write(writer);
+	}
+	return writer.IsValid();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void GridDataSamplerUsingCubedSphereQuadTree::SamplePoints(
+	const double * pLon,
+	const double * pLat,
+	size_t sPoints,
+	int * pImageMap
 ) const {
-	dImageMap.resize(dSampleLon.size() * dSampleLat.size());
+	std::vector<double> dX(sPoints);
+	std::vector<double> dY(sPoints);
+	std::vector<double> dZ(sPoints);
 
-	int s = 0;
-	for (int j = 0; j < dSampleLat.size(); j++) {
-	for (int i = 0; i < dSampleLon.size(); i++) {
+	RLLtoXYZ_Deg(pLon, pLat, sPoints, &(dX[0]), &(dY[0]), &(dZ[0]));
 
-		double dA;
-		double dB;
-		int nP;
+	SamplePointsXYZ(&(dX[0]), &(dY[0]), &(dZ[0]), sPoints, pImageMap);
+}
 
-		double dAref;
-		double dBref;
+///////////////////////////////////////////////////////////////////////////////
 
-		ABPFromRLL(dSampleLon[i], dSampleLat[j], dA, dB, nP);
+void GridDataSamplerUsingCubedSphereQuadTree::SampleRow(
+	const double * pLon,
+	const double * pSinLon,
+	const double * pCosLon,
+	double dLat,
+	size_t sPoints,
+	int * pImageMap
+) const {
+	std::vector<double> dX(sPoints);
+	std::vector<double> dY(sPoints);
+	std::vector<double> dZ(sPoints);
 
-		_ASSERT((nP >= 0) && (nP <= 5));
+	RLLtoXYZ_Row(
+		pSinLon, pCosLon,
+		sin(DegToRad(dLat)), cos(DegToRad(dLat)),
+		sPoints, &(dX[0]), &(dY[0]), &(dZ[0]));
 
-		size_t sI = m_vecquadtree[nP].find_inexact(dA, dB, dAref, dBref);
+	SamplePointsXYZ(&(dX[0]), &(dY[0]), &(dZ[0]), sPoints, pImageMap);
+}
 
-		if (m_fDistanceFilter) {
-			if (fabs(dA - dAref) > m_dMaxCellRadius) {
-				sI = static_cast<size_t>(-1);
-			}
-			if (fabs(dB - dBref) > m_dMaxCellRadius) {
-				sI = static_cast<size_t>(-1);
+///////////////////////////////////////////////////////////////////////////////
+
+void GridDataSamplerUsingCubedSphereQuadTree::SamplePointsXYZ(
+	const double * pX,
+	const double * pY,
+	const double * pZ,
+	size_t sPoints,
+	int * pImageMap
+) const {
+	static const size_t BatchSize = 256;
+
+	double dA[BatchSize];
+	double dB[BatchSize];
+	int nP[BatchSize];
+
+	// One cursor per panel, so that queries alternating between panels
+	// still traverse coherently
+	QuadTree::Cursor cursor[6];
+
+	for (size_t s = 0; s < sPoints; s += BatchSize) {
+		const size_t sBatch = std::min(BatchSize, sPoints - s);
+
+		// Transform to equiangular coordinates and find the extent of
+		// the batch on each panel
+		double dAmin[6];
+		double dAmax[6];
+		double dBmin[6];
+		double dBmax[6];
+		bool fPanelUsed[6] = {false, false, false, false, false, false};
+
+		for (size_t i = 0; i < sBatch; i++) {
+			ABPFromXYZ(pX[s+i], pY[s+i], pZ[s+i], dA[i], dB[i], nP[i]);
+
+			_ASSERT((nP[i] >= 0) && (nP[i] <= 5));
+
+			const int p = nP[i];
+			if (!fPanelUsed[p]) {
+				fPanelUsed[p] = true;
+				dAmin[p] = dAmax[p] = dA[i];
+				dBmin[p] = dBmax[p] = dB[i];
+			} else {
+				dAmin[p] = std::min(dAmin[p], dA[i]);
+				dAmax[p] = std::max(dAmax[p], dA[i]);
+				dBmin[p] = std::min(dBmin[p], dB[i]);
+				dBmax[p] = std::max(dBmax[p], dB[i]);
 			}
 		}
 
-		if (sI == static_cast<size_t>(-1)) {
-			dImageMap[s] = 0;
-		} else {
-			dImageMap[s] = sI;
+		for (int p = 0; p < 6; p++) {
+			if (fPanelUsed[p]) {
+				m_vecquadtree[p].set_viewport(
+					cursor[p], dAmin[p], dAmax[p], dBmin[p], dBmax[p]);
+			}
 		}
 
-		s++;
-	}
+		for (size_t i = 0; i < sBatch; i++) {
+			double dAref;
+			double dBref;
+
+			size_t sI =
+				m_vecquadtree[nP[i]].find_inexact(
+					dA[i], dB[i], dAref, dBref, cursor[nP[i]]);
+
+			if (m_fDistanceFilter) {
+				if (fabs(dA[i] - dAref) > m_dMaxCellRadius) {
+					sI = static_cast<size_t>(-1);
+				}
+				if (fabs(dB[i] - dBref) > m_dMaxCellRadius) {
+					sI = static_cast<size_t>(-1);
+				}
+			}
+
+			if (sI == static_cast<size_t>(-1)) {
+				pImageMap[s+i] = 0;
+			} else {
+				pImageMap[s+i] = sI;
+			}
+		}
 	}
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// GridDataSamplerUsingQuadTree
+// GridDataSamplerUsingCubedSphereLattice
 ///////////////////////////////////////////////////////////////////////////////
 
-void GridDataSamplerUsingQuadTree::SetRegionalBounds(
-	double dLonBounds0,
-	double dLonBounds1,
-	double dLatBounds0,
-	double dLatBounds1
+void GridDataSamplerUsingCubedSphereLattice::Initialize(
+	const std::vector<double> & dLon,
+	const std::vector<double> & dLat,
+	double dFillValue,
+	double dMaxCellRadius
 ) {
-	m_quadtree.clear();
-	m_quadtree = QuadTreeNode(dLonBounds0, dLonBounds1, dLatBounds0, dLatBounds1);
-	m_fRegional = true;
+	AnnounceStartBlock("Detecting cubed-sphere lattice");
+	m_fLattice = DetectLattice(dLon, dLat, dFillValue);
+	AnnounceEndBlock("Done");
+
+	if (m_fLattice) {
+		GridDataSampler::Initialize(dLon, dLat);
+
+		for (int p = 0; p < m_vecquadtree.size(); p++) {
+			m_vecquadtree[p].clear();
+		}
+		m_vecquadtree.clear();
+
+	} else {
+		m_dLatticeCoord.clear();
+		m_dLatticeMid.clear();
+		m_vecLatticeBucket.clear();
+		m_vecLatticeColumn.clear();
+
+		GridDataSamplerUsingCubedSphereQuadTree::Initialize(
+			dLon, dLat, dFillValue, dMaxCellRadius);
+	}
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-void GridDataSamplerUsingQuadTree::Initialize(
+bool GridDataSamplerUsingCubedSphereLattice::DetectLattice(
 	const std::vector<double> & dLon,
 	const std::vector<double> & dLat,
-	double dFillValue,
-	double dMaxCellRadius
+	double dFillValue
 ) {
-	_ASSERT(dMaxCellRadius >= 0.0);
+	// Points must lie within this many radians of a lattice node
+	static const double LatticeTolerance = 1.0e-5;
 
-	GridDataSampler::Initialize(dLon, dLat);
-
-	_ASSERT(dLon.size() == dLat.size());
+	// Resolution of the histogram used to find distinct coordinates
+	static const size_t HistogramBins = (1 << 24);
 
-	m_quadtree.clear();
+	const size_t sPoints = dLon.size();
+	if (sPoints < 24) {
+		Announce("Too few points");
+		return false;
+	}
 
-	AnnounceStartBlock("Generating quadtree from lat/lon arrays");
+	// Equiangular coordinates of all points
+	std::vector<double> dA(sPoints);
+	std::vector<double> dB(sPoints);
+	std::vector<signed char> nP(sPoints);
+
+	std::atomic<bool> fMissing(false);
+
+	auto fnABPFromRLL = [&](size_t sBegin, size_t sEnd) {
+		for (size_t i = sBegin; i < sEnd; i++) {
+			if (std::isnan(dLon[i]) || std::isnan(dLat[i]) ||
+			    (dLon[i] == dFillValue) || (dLat[i] == dFillValue)
+			) {
+				fMissing = true;
+				nP[i] = (-1);
+				continue;
+			}
+			int iP;
+			ABPFromRLL(dLon[i], dLat[i], dA[i], dB[i], iP);
+			nP[i] = static_cast<signed char>(iP);
+		}
+	};
 
-	m_fDistanceFilter = false;
-	if (dMaxCellRadius > 0.0) {
-		m_fDistanceFilter = true;
+	if (m_pThreadPool == NULL) {
+		fnABPFromRLL(0, sPoints);
+	} else {
+		m_pThreadPool->ParallelFor(0, sPoints, 65536, fnABPFromRLL);
 	}
 
-	int iMaxLevel = 0;
+	if (fMissing) {
+		Announce("Missing coordinates");
+		return false;
+	}
 
-	long iReportSize = static_cast<long>(dLon.size()) / 100;
-	for (long i = 0; i < dLon.size(); i++) {
+	// Find the distinct coordinates along either axis of any panel from a
+	// histogram; runs of occupied bins separated by less than the
+	// tolerance are one coordinate
+	const double dRange = 0.5 * M_PI + 4.0 * LatticeTolerance;
+	const double dLow = -0.25 * M_PI - 2.0 * LatticeTolerance;
+	const double dBinScale = static_cast<double>(HistogramBins) / dRange;
+
+	std::vector<char> vecOccupied(HistogramBins, 0);
+	for (size_t i = 0; i < sPoints; i++) {
+		size_t sBinA = static_cast<size_t>((dA[i] - dLow) * dBinScale);
+		size_t sBinB = static_cast<size_t>((dB[i] - dLow) * dBinScale);
+		vecOccupied[std::min(sBinA, HistogramBins-1)] = 1;
+		vecOccupied[std::min(sBinB, HistogramBins-1)] = 1;
+	}
 
-		if (std::isnan(dLon[i]) || std::isnan(dLat[i])) {
-			m_fDistanceFilter = true;
-		} else if ((dLon[i] == dFillValue) || (dLat[i] == dFillValue)) {
-			m_fDistanceFilter = true;
-		} else {
-			double dStandardLonDeg;
-			if (!m_fRegional) {
-				dStandardLonDeg = LonDegToStandardRange(dLon[i]);
-			} else {
-				dStandardLonDeg = dLon[i];
-			}
+	const size_t sMergeBins = static_cast<size_t>(LatticeTolerance * dBinScale) + 1;
+	const size_t sMaxCoords = static_cast<size_t>(2.0 * sqrt(static_cast<double>(sPoints) / 6.0)) + 2;
 
-			int iLevel = m_quadtree.insert(dStandardLonDeg, dLat[i], i);
-			if (iLevel > iMaxLevel) {
-				iMaxLevel = iLevel;
+	m_dLatticeCoord.clear();
+	for (size_t b = 0; b < HistogramBins; b++) {
+		if (!vecOccupied[b]) {
+			continue;
+		}
+		size_t bFirst = b;
+		size_t bLast = b;
+		for (; b < HistogramBins; b++) {
+			if (vecOccupied[b]) {
+				bLast = b;
+			} else if (b - bLast > sMergeBins) {
+				break;
 			}
 		}
+		m_dLatticeCoord.push_back(
+			dLow + (0.5 * static_cast<double>(bFirst + bLast) + 0.5) / dBinScale);
 
-		if ((i+1) % iReportSize == 0) {
-			Announce("%li%% complete", i / iReportSize);
+		if (m_dLatticeCoord.size() > sMaxCoords) {
+			Announce("Too many distinct coordinates");
+			return false;
 		}
 	}
 
-	// Try to generate max cell radius dynamically
-	if (dMaxCellRadius == 0.0) {
-		dMaxCellRadius = 2.0 * 360.0 * pow(0.5, static_cast<double>(iMaxLevel));
+	const size_t sN = m_dLatticeCoord.size();
+	if (sN < 2) {
+		Announce("Too few distinct coordinates");
+		return false;
 	}
 
-	if (m_fDistanceFilter) {
-		if (m_fRegional) {
-			_EXCEPTIONT("DistanceFilter cannot be combined with regional bounds");
-		}
-		m_dMaxCellRadius = dMaxCellRadius;
-		Announce("Maximum render distance: %1.5e (%i)", m_dMaxCellRadius, iMaxLevel);
+	// Replace each coordinate, which is only known to the width of a
+	// histogram bin, by the mean of the point coordinates in its cluster
+	m_dLatticeMid.resize(sN-1);
+	for (size_t k = 0; k < sN-1; k++) {
+		m_dLatticeMid[k] = 0.5 * (m_dLatticeCoord[k] + m_dLatticeCoord[k+1]);
 	}
 
-	AnnounceEndBlock("Done");
-}
-
-///////////////////////////////////////////////////////////////////////////////
+	std::vector<double> dCoordSum(sN, 0.0);
+	std::vector<size_t> sCoordCount(sN, 0);
+	for (size_t i = 0; i < sPoints; i++) {
+		size_t sI = std::lower_bound(m_dLatticeMid.begin(), m_dLatticeMid.end(), dA[i]) - m_dLatticeMid.begin();
+		size_t sJ = std::lower_bound(m_dLatticeMid.begin(), m_dLatticeMid.end(), dB[i]) - m_dLatticeMid.begin();
+		dCoordSum[sI] += dA[i];
+		dCoordSum[sJ] += dB[i];
+		sCoordCount[sI]++;
+		sCoordCount[sJ]++;
+	}
+	for (size_t k = 0; k < sN; k++) {
+		m_dLatticeCoord[k] = dCoordSum[k] / static_cast<double>(sCoordCount[k]);
+	}
 
-void GridDataSamplerUsingQuadTree::Sample(
-	const std::vector<double> & dSampleLon,
-	const std::vector<double> & dSampleLat,
-	std::vector<int> & dImageMap
-) const {
-	//long lTotal = 0;
-	//long lReportSize = static_cast<long>(dSampleLat.size()) * static_cast<long>(dSampleLon.size()) / 100;
-	AnnounceStartBlock("Querying data points within the quadtree");
+	// Uniform buckets for constant-time nearest-coordinate lookup
+	double dMinSpacing = m_dLatticeCoord[1] - m_dLatticeCoord[0];
+	for (size_t k = 0; k < sN-1; k++) {
+		m_dLatticeMid[k] = 0.5 * (m_dLatticeCoord[k] + m_dLatticeCoord[k+1]);
+		dMinSpacing = std::min(dMinSpacing, m_dLatticeCoord[k+1] - m_dLatticeCoord[k]);
+	}
 
-	dImageMap.resize(dSampleLon.size() * dSampleLat.size());
+	size_t sBuckets = std::max<size_t>(4 * sN,
+		static_cast<size_t>(std::min(dRange / dMinSpacing, 16.0 * static_cast<double>(sN))));
+	m_dLatticeBucketLow = dLow;
+	m_dLatticeBucketScale = static_cast<double>(sBuckets) / dRange;
+	m_vecLatticeBucket.resize(sBuckets);
+	for (size_t b = 0, k = 0; b < sBuckets; b++) {
+		double dEdge = m_dLatticeBucketLow + static_cast<double>(b) / m_dLatticeBucketScale;
+		while ((k < sN-1) && (dEdge > m_dLatticeMid[k])) {
+			k++;
+		}
+		m_vecLatticeBucket[b] = static_cast<uint32_t>(k);
+	}
 
-	double dLonRef;
-	double dLatRef;
+	// Assign every point to a lattice node
+	m_vecLatticeColumn.clear();
+	m_vecLatticeColumn.resize(6 * sN * sN, (-1));
+
+	for (size_t i = 0; i < sPoints; i++) {
+		size_t sI = LatticeIndex(dA[i]);
+		size_t sJ = LatticeIndex(dB[i]);
+		if ((fabs(dA[i] - m_dLatticeCoord[sI]) > LatticeTolerance) ||
+		    (fabs(dB[i] - m_dLatticeCoord[sJ]) > LatticeTolerance)
+		) {
+			Announce("Point %lu is not on the lattice", i);
+			return false;
+		}
 
-	double dMaxDeltaLon = 2.0 * fabs(dSampleLon[1] - dSampleLon[0]);
-	double dMaxDeltaLat = 2.0 * fabs(dSampleLat[1] - dSampleLat[0]);
+		int & iColumn = m_vecLatticeColumn[(nP[i] * sN + sJ) * sN + sI];
+		if (iColumn != (-1)) {
+			Announce("Points %i and %lu coincide", iColumn, i);
+			return false;
+		}
+		iColumn = static_cast<int>(i);
+	}
 
-	int s = 0;
-	for (int j = 0; j < dSampleLat.size(); j++) {
-	for (int i = 0; i < dSampleLon.size(); i++) {
-		double dSampleStandardLonDeg;
-		if (!m_fRegional) {
-			dSampleStandardLonDeg = LonDegToStandardRange(dSampleLon[i]);
-		} else {
-			dSampleStandardLonDeg = dSampleLon[i];
+	// Nodes on panel edges belong to only one panel; fill the others by
+	// projecting the node onto each neighboring panel
+	size_t sEmpty = 0;
+	for (size_t sNode = 0; sNode < m_vecLatticeColumn.size(); sNode++) {
+		if (m_vecLatticeColumn[sNode] != (-1)) {
+			continue;
 		}
 
-		size_t sI =
-			m_quadtree.find_inexact(
-				dSampleStandardLonDeg,
-				dSampleLat[j],
-				dLonRef,
-				dLatRef);
+		const int p = static_cast<int>(sNode / (sN * sN));
+		const size_t sJ = (sNode / sN) % sN;
+		const size_t sI = sNode % sN;
+
+		double xx, yy, zz;
+		XYZFromPanel(p, tan(m_dLatticeCoord[sI]), tan(m_dLatticeCoord[sJ]), 1.0, xx, yy, zz);
 
-		if (m_fDistanceFilter) {
-			double dDeltaLon = LonDegToStandardRange(dSampleLon[i] - dLonRef);
-			if (dDeltaLon > 180.0) {
-				dDeltaLon -= 360.0;
+		for (int q = 0; q < 6; q++) {
+			if (q == p) {
+				continue;
 			}
 
-			if (fabs(dDeltaLon * cos(dSampleLat[j] / 180.0 * M_PI)) > m_dMaxCellRadius) {
-				sI = static_cast<size_t>(-1);
+			double sx, sy, sz;
+			PanelFromXYZ(q, xx, yy, zz, sx, sy, sz);
+			if (sz <= 0.0) {
+				continue;
 			}
-			if (fabs(dSampleLat[j] - dLatRef) > m_dMaxCellRadius) {
-				sI = static_cast<size_t>(-1);
+
+			double dAq = atan(sx / sz);
+			double dBq = atan(sy / sz);
+
+			size_t sIq = LatticeIndex(dAq);
+			size_t sJq = LatticeIndex(dBq);
+			if ((fabs(dAq - m_dLatticeCoord[sIq]) > LatticeTolerance) ||
+			    (fabs(dBq - m_dLatticeCoord[sJq]) > LatticeTolerance)
+			) {
+				continue;
+			}
+
+			int iColumn = m_vecLatticeColumn[(q * sN + sJq) * sN + sIq];
+			if (iColumn != (-1)) {
+				m_vecLatticeColumn[sNode] = iColumn;
+				break;
 			}
 		}
 
-		if (sI == static_cast<size_t>(-1)) {
-			dImageMap[s] = 0;
+		if (m_vecLatticeColumn[sNode] == (-1)) {
+			sEmpty++;
+		}
+	}
+
+	if (sEmpty != 0) {
+		Announce("%lu lattice nodes have no point", sEmpty);
+		return false;
+	}
+
+	Announce("Detected %lu x %lu lattice on each panel (%1.2f MB)",
+		sN, sN,
+		static_cast<double>(
+			m_vecLatticeColumn.capacity() * sizeof(int)
+			+ m_vecLatticeBucket.capacity() * sizeof(uint32_t)) / (1024.0 * 1024.0));
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+size_t GridDataSamplerUsingCubedSphereLattice::LatticeIndex(
+	double dA
+) const {
+	long lBucket = static_cast<long>((dA - m_dLatticeBucketLow) * m_dLatticeBucketScale);
+	lBucket = std::max<long>(0, std::min<long>(lBucket, m_vecLatticeBucket.size() - 1));
+
+	size_t k = m_vecLatticeBucket[lBucket];
+	while ((k < m_dLatticeMid.size()) && (dA > m_dLatticeMid[k])) {
+		k++;
+	}
+	return k;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void GridDataSamplerUsingCubedSphereLattice::SamplePointsXYZ(
+	const double * pX,
+	const double * pY,
+	const double * pZ,
+	size_t sPoints,
+	int * pImageMap
+) const {
+	if (!m_fLattice) {
+		GridDataSamplerUsingCubedSphereQuadTree::SamplePointsXYZ(
+			pX, pY, pZ, sPoints, pImageMap);
+		return;
+	}
+
+	const size_t sN = m_dLatticeCoord.size();
+
+	for (size_t s = 0; s < sPoints; s++) {
+		double dA;
+		double dB;
+		int nP;
+
+		ABPFromXYZ(pX[s], pY[s], pZ[s], dA, dB, nP);
+
+		pImageMap[s] = m_vecLatticeColumn[(nP * sN + LatticeIndex(dB)) * sN + LatticeIndex(dA)];
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GridDataSamplerUsingQuadTree
+///////////////////////////////////////////////////////////////////////////////
+
+void GridDataSamplerUsingQuadTree::SetRegionalBounds(
+	double dLonBounds0,
+	double dLonBounds1,
+	double dLatBounds0,
+	double dLatBounds1
+) {
+	m_quadtree.clear();
+	m_quadtree = QuadTree(dLonBounds0, dLonBounds1, dLatBounds0, dLatBounds1);
+	m_fRegional = true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void GridDataSamplerUsingQuadTree::Initialize(
+	const std::vector<double> & dLon,
+	const std::vector<double> & dLat,
+	double dFillValue,
+	double dMaxCellRadius
+) {
+	_ASSERT(dMaxCellRadius >= 0.0);
+
+	GridDataSampler::Initialize(dLon, dLat);
+
+	_ASSERT(dLon.size() == dLat.size());
+
+	// Load the index from the cache if available
+	const bool fUseIndexCache = UseIndexCache(dLon.size());
+
+	IndexCacheKey key("qt");
+	if (fUseIndexCache) {
+		key.Add(dLon);
+		key.Add(dLat);
+		key.Add(dFillValue);
+		key.Add(dMaxCellRadius);
+		key.Add(m_fRegional ? 1.0 : 0.0);
+
+		if (ReadIndexCache(key)) {
+			return;
+		}
+	}
+
+	m_quadtree.clear();
+	m_quadtree.reserve(dLon.size());
+
+	AnnounceStartBlock("Generating quadtree from lat/lon arrays");
+
+	m_fDistanceFilter = false;
+	if (dMaxCellRadius > 0.0) {
+		m_fDistanceFilter = true;
+	}
+
+	int iMaxLevel = 0;
+
+	long iReportSize = std::max(static_cast<long>(dLon.size()) / 100, 1L);
+	int iProgressLast = (-1);
+	for (long i = 0; i < dLon.size(); i++) {
+
+		if (std::isnan(dLon[i]) || std::isnan(dLat[i])) {
+			m_fDistanceFilter = true;
+		} else if ((dLon[i] == dFillValue) || (dLat[i] == dFillValue)) {
+			m_fDistanceFilter = true;
 		} else {
-			dImageMap[s] = sI;
+			double dStandardLonDeg;
+			if (!m_fRegional) {
+				dStandardLonDeg = LonDegToStandardRange(dLon[i]);
+			} else {
+				dStandardLonDeg = dLon[i];
+			}
+
+			m_quadtree.insert(dStandardLonDeg, dLat[i], i);
+		}
+
+		if ((i+1) % iReportSize == 0) {
+			const int iPercent = static_cast<int>(i / iReportSize) / 10;
+			if (iPercent != iProgressLast) {
+				iProgressLast = iPercent;
+				AnnounceProgress(iPercent);
+			}
 		}
+	}
+
+	// Inserting points is the first 10% of the work
+	m_quadtree.set_build_progress(10, 100);
+	iMaxLevel = m_quadtree.build(m_pThreadPool);
 
-		//lTotal++;
-		//if (lTotal % lReportSize == 0) {
-		//	Announce("%li%% complete", lTotal / lReportSize);
-		//}
+	Announce("QuadTree memory usage: %1.2f MB",
+		static_cast<double>(m_quadtree.memory_usage()) / (1024.0 * 1024.0));
 
-		s++;
+	// Try to generate max cell radius dynamically
+	if (dMaxCellRadius == 0.0) {
+		dMaxCellRadius = 2.0 * 360.0 * pow(0.5, static_cast<double>(iMaxLevel));
+	}
+
+	if (m_fDistanceFilter) {
+		if (m_fRegional) {
+			_EXCEPTIONT("DistanceFilter cannot be combined with regional bounds");
+		}
+		m_dMaxCellRadius = dMaxCellRadius;
+		Announce("Maximum render distance: %1.5e (%i)", m_dMaxCellRadius, iMaxLevel);
 	}
+
+	if (fUseIndexCache) {
+		WriteIndexCache(key);
 	}
+
 	AnnounceEndBlock("Done");
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// GridDataSamplerUsingKDTree
+
+bool GridDataSamplerUsingQuadTree::ReadIndex(
+	IndexCacheReader & reader
+) {
+	if (!reader.ReadValue(m_fDistanceFilter) ||
+	    !reader.ReadValue(m_dMaxCellRadius)
+	) {
+		return false;
+	}
+	return m_quadtree.read(reader);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool GridDataSamplerUsingQuadTree::WriteIndex(
+	IndexCacheWriter & writer
+) const {
+	writer.WriteValue(m_fDistanceFilter);
+	writer.WriteValue(m_dMaxCellRadius);
+	m_quadtree.write(writer);
+	return writer.IsValid();
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
-GridDataSamplerUsingKDTree::~GridDataSamplerUsingKDTree() {
-	if (m_kdtree != NULL) {
-		kd_free(m_kdtree);
+void GridDataSamplerUsingQuadTree::Sample(
+	const std::vector<double> & dSampleLon,
+	const std::vector<double> & dSampleLat,
+	std::vector<int> & dImageMap
+) const {
+	AnnounceStartBlock("Querying data points within the quadtree");
+
+	GridDataSampler::Sample(dSampleLon, dSampleLat, dImageMap);
+
+	AnnounceEndBlock("Done");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void GridDataSamplerUsingQuadTree::SamplePoints(
+	const double * pLon,
+	const double * pLat,
+	size_t sPoints,
+	int * pImageMap
+) const {
+	static const size_t BatchSize = 256;
+
+	double dSampleStandardLonDeg[BatchSize];
+
+	QuadTree::Cursor cursor;
+
+	// Cosine of the latitude of the previous sample, for the distance filter
+	double dCosLatDeg = 0.0;
+	double dCosLat = 1.0;
+
+	for (size_t s = 0; s < sPoints; s += BatchSize) {
+		const size_t sBatch = std::min(BatchSize, sPoints - s);
+
+		if (!m_fRegional) {
+			LonDegToStandardRange(pLon + s, sBatch, dSampleStandardLonDeg);
+		} else {
+			std::copy(pLon + s, pLon + s + sBatch, dSampleStandardLonDeg);
+		}
+
+		// Find the extent of this batch and start all queries from the
+		// smallest node that encloses it
+		double dLonMin = dSampleStandardLonDeg[0];
+		double dLonMax = dSampleStandardLonDeg[0];
+		double dLatMin = pLat[s];
+		double dLatMax = pLat[s];
+
+		for (size_t i = 0; i < sBatch; i++) {
+			dLonMin = std::min(dLonMin, dSampleStandardLonDeg[i]);
+			dLonMax = std::max(dLonMax, dSampleStandardLonDeg[i]);
+			dLatMin = std::min(dLatMin, pLat[s+i]);
+			dLatMax = std::max(dLatMax, pLat[s+i]);
+		}
+
+		m_quadtree.set_viewport(cursor, dLonMin, dLonMax, dLatMin, dLatMax);
+
+		for (size_t i = 0; i < sBatch; i++) {
+			double dLonRef;
+			double dLatRef;
+
+			size_t sI =
+				m_quadtree.find_inexact(
+					dSampleStandardLonDeg[i],
+					pLat[s+i],
+					dLonRef,
+					dLatRef,
+					cursor);
+
+			if (m_fDistanceFilter) {
+				double dDeltaLon = LonDegToStandardRange(pLon[s+i] - dLonRef);
+				if (dDeltaLon > 180.0) {
+					dDeltaLon -= 360.0;
+				}
+
+				if (pLat[s+i] != dCosLatDeg) {
+					dCosLatDeg = pLat[s+i];
+					dCosLat = cos(pLat[s+i] / 180.0 * M_PI);
+				}
+
+				if (fabs(dDeltaLon * dCosLat) > m_dMaxCellRadius) {
+					sI = static_cast<size_t>(-1);
+				}
+				if (fabs(pLat[s+i] - dLatRef) > m_dMaxCellRadius) {
+					sI = static_cast<size_t>(-1);
+				}
+			}
+
+			if (sI == static_cast<size_t>(-1)) {
+				pImageMap[s+i] = 0;
+			} else {
+				pImageMap[s+i] = sI;
+			}
+		}
 	}
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// GridDataSamplerUsingKDTree
 ///////////////////////////////////////////////////////////////////////////////
 
 void GridDataSamplerUsingKDTree::Initialize(
@@ -398,21 +1432,34 @@ void GridDataSamplerUsingKDTree::Initialize(
 ) {
 	GridDataSampler::Initialize(dLon, dLat);
 
-	if (m_kdtree != NULL) {
-		kd_free(m_kdtree);
-	}
+	_ASSERT(dLon.size() == dLat.size());
 
-	AnnounceStartBlock("Generating kdtree from from lat/lon arrays");
+	// Load the index from the cache if available
+	const bool fUseIndexCache = UseIndexCache(dLon.size());
+
+	IndexCacheKey key("kd");
+	if (fUseIndexCache) {
+		key.Add(dLon);
+		key.Add(dLat);
+		key.Add(dFillValue);
 
-	m_kdtree = kd_create(3);
-	if (m_kdtree == NULL) {
-		_EXCEPTIONT("kd_create(3) failed");
+		if (ReadIndexCache(key)) {
+			return;
+		}
 	}
 
-	long iReportSize = static_cast<long>(dLon.size()) / 100;
+	m_kdtree.clear();
+	m_kdtree.reserve(dLon.size());
+
+	AnnounceStartBlock("Generating kdtree from from lat/lon arrays");
+
+	long iReportSize = std::max(static_cast<long>(dLon.size()) / 100, 1L);
+	int iProgressLast = (-1);
 	for (long i = 0; i < static_cast<long>(dLon.size()); i++) {
 
-		if ((dLon[i] != dFillValue) && (dLat[i] != dFillValue)) {
+		if (!std::isnan(dLon[i]) && !std::isnan(dLat[i]) &&
+		    (dLon[i] != dFillValue) && (dLat[i] != dFillValue)
+		) {
 
 			double dX;
 			double dY;
@@ -420,58 +1467,1951 @@ void GridDataSamplerUsingKDTree::Initialize(
 
 			RLLtoXYZ_Deg(dLon[i], dLat[i], dX, dY, dZ);
 
-			kd_insert3(m_kdtree, dX, dY, dZ, (void*)(&m_iRef + i));
+			m_kdtree.insert(dX, dY, dZ, i);
 		}
 
 		if ((i+1) % iReportSize == 0) {
-			Announce("%li%% complete", i / iReportSize);
+			const int iPercent = static_cast<int>(i / iReportSize) / 10;
+			if (iPercent != iProgressLast) {
+				iProgressLast = iPercent;
+				AnnounceProgress(iPercent);
+			}
 		}
 	}
 
+	// Inserting points is the first 10% of the work
+	m_kdtree.set_build_progress(10, 100);
+	m_kdtree.build();
+
+	Announce("kdtree memory usage: %1.2f MB",
+		static_cast<double>(m_kdtree.memory_usage()) / (1024.0 * 1024.0));
+
+	if (fUseIndexCache) {
+		WriteIndexCache(key);
+	}
+
 	AnnounceEndBlock("Done");
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-void GridDataSamplerUsingKDTree::Sample(
-	const std::vector<double> & dSampleLon,
-	const std::vector<double> & dSampleLat,
-	std::vector<int> & dImageMap
+bool GridDataSamplerUsingKDTree::ReadIndex(
+	IndexCacheReader & reader
+) {
+	return m_kdtree.read(reader);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool GridDataSamplerUsingKDTree::WriteIndex(
+	IndexCacheWriter & writer
+) const {
+	m_kdtree.write(writer);
+	return writer.IsValid();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void GridDataSamplerUsingKDTree::SamplePoints(
+	const double * pLon,
+	const double * pLat,
+	size_t sPoints,
+	int * pImageMap
 ) const {
+	std::vector<double> dX(sPoints);
+	std::vector<double> dY(sPoints);
+	std::vector<double> dZ(sPoints);
 
-	//long lTotal = 0;
-	//long lReportSize = static_cast<long>(dSampleLat.size()) * static_cast<long>(dSampleLon.size()) / 100;
-	//AnnounceStartBlock("Querying data points within the kdtree");
+	RLLtoXYZ_Deg(pLon, pLat, sPoints, &(dX[0]), &(dY[0]), &(dZ[0]));
 
-	dImageMap.resize(dSampleLon.size() * dSampleLat.size());
+	SamplePointsXYZ(&(dX[0]), &(dY[0]), &(dZ[0]), sPoints, pImageMap);
+}
 
-	int s = 0;
-	for (int j = 0; j < dSampleLat.size(); j++) {
-	for (int i = 0; i < dSampleLon.size(); i++) {
+///////////////////////////////////////////////////////////////////////////////
 
-		double dX;
-		double dY;
-		double dZ;
+void GridDataSamplerUsingKDTree::SampleRow(
+	const double * pLon,
+	const double * pSinLon,
+	const double * pCosLon,
+	double dLat,
+	size_t sPoints,
+	int * pImageMap
+) const {
+	std::vector<double> dX(sPoints);
+	std::vector<double> dY(sPoints);
+	std::vector<double> dZ(sPoints);
+
+	RLLtoXYZ_Row(
+		pSinLon, pCosLon,
+		sin(DegToRad(dLat)), cos(DegToRad(dLat)),
+		sPoints, &(dX[0]), &(dY[0]), &(dZ[0]));
+
+	SamplePointsXYZ(&(dX[0]), &(dY[0]), &(dZ[0]), sPoints, pImageMap);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void GridDataSamplerUsingKDTree::SamplePointsXYZ(
+	const double * pX,
+	const double * pY,
+	const double * pZ,
+	size_t sPoints,
+	int * pImageMap
+) const {
+	static const size_t BatchSize = 256;
+
+	float flX[BatchSize];
+	float flY[BatchSize];
+	float flZ[BatchSize];
+	uint32_t uIndex[BatchSize];
+
+	for (size_t s = 0; s < sPoints; s += BatchSize) {
+		const size_t sBatch = std::min(BatchSize, sPoints - s);
+
+		for (size_t i = 0; i < sBatch; i++) {
+			flX[i] = static_cast<float>(pX[s+i]);
+			flY[i] = static_cast<float>(pY[s+i]);
+			flZ[i] = static_cast<float>(pZ[s+i]);
+		}
+
+		m_kdtree.find_nearest(flX, flY, flZ, sBatch, uIndex);
+
+		for (size_t i = 0; i < sBatch; i++) {
+			if (uIndex[i] == static_cast<uint32_t>(-1)) {
+				pImageMap[s+i] = 0;
+			} else {
+				pImageMap[s+i] = static_cast<int>(uIndex[i]);
+			}
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GridDataSamplerUsingDiskIndex
+///////////////////////////////////////////////////////////////////////////////
+
+const size_t GridDataSamplerUsingDiskIndex::InitializeChunkSize;
+
+const size_t GridDataSamplerUsingDiskIndex::DefaultBuildMemoryBytes;
+
+///////////////////////////////////////////////////////////////////////////////
+
+void GridDataSamplerUsingDiskIndex::Initialize(
+	const std::vector<double> & dLon,
+	const std::vector<double> & dLat,
+	double dFillValue
+) {
+	_ASSERT(dLon.size() == dLat.size());
 
-		RLLtoXYZ_Deg(dSampleLon[i], dSampleLat[j], dX, dY, dZ);
+	BeginInitialize(dFillValue, dLon.size());
 
-		kdres * kdres = kd_nearest3(m_kdtree, dX, dY, dZ);
-		if (kdres == NULL) {
-			_EXCEPTIONT("Unexpected query failure in kdtree");
+	if (IsIndexCacheUsed()) {
+		for (size_t i = 0; i < dLon.size(); i += InitializeChunkSize) {
+			HashPoints(
+				&(dLon[i]),
+				&(dLat[i]),
+				std::min(InitializeChunkSize, dLon.size() - i));
+		}
+		if (InitializeFromCache()) {
+			return;
 		}
+	}
+
+	for (size_t i = 0; i < dLon.size(); i += InitializeChunkSize) {
+		AddPoints(
+			&(dLon[i]),
+			&(dLat[i]),
+			std::min(InitializeChunkSize, dLon.size() - i));
+	}
+
+	EndInitialize();
+}
+
+///////////////////////////////////////////////////////////////////////////////
 
-		dImageMap[s] = static_cast<size_t>(reinterpret_cast<int*>(kd_res_item_data(kdres)) - &m_iRef);
+void GridDataSamplerUsingDiskIndex::BeginInitialize(
+	double dFillValue,
+	size_t sPoints
+) {
+	m_key = IndexCacheKey("disk");
+	m_key.Add(dFillValue);
 
-		//lTotal++;
-		//if (lTotal % lReportSize == 0) {
-		//	Announce("%li%% complete", lTotal / lReportSize);
-		//}
+	m_dFillValue = dFillValue;
+	m_sPoints = sPoints;
+	m_sHashedPoints = 0;
+	m_sNextIndex = 0;
 
-		s++;
+	// Without the cache there is nothing to check before building
+	if (!IsIndexCacheUsed()) {
+		BeginBuild();
 	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void GridDataSamplerUsingDiskIndex::BeginBuild() {
+	if (m_strScratchDir.length() == 0) {
+		m_diskindex.begin_build(".", m_sBuildMemoryBytes);
+	} else {
+		m_diskindex.begin_build(m_strScratchDir, m_sBuildMemoryBytes);
 	}
-	//AnnounceEndBlock("Done");
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
+void GridDataSamplerUsingDiskIndex::HashPoints(
+	const double * pLon,
+	const double * pLat,
+	size_t sPoints
+) {
+	m_key.Add(pLon, sPoints * sizeof(double));
+	m_key.Add(pLat, sPoints * sizeof(double));
+
+	m_sHashedPoints += sPoints;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool GridDataSamplerUsingDiskIndex::InitializeFromCache() {
+
+	if (IsIndexCacheUsed() && (m_sHashedPoints == m_sPoints)) {
+		const std::string strFilename =
+			m_strIndexCacheDir + "/" + m_key.ToString() + ".idx";
+
+		if (m_diskindex.map(strFilename, m_key, false)) {
+			GridDataSampler::Initialize(std::vector<double>(), std::vector<double>());
+			Announce("Loaded index of %lu points from cache \"%s\"",
+				m_sPoints, strFilename.c_str());
+			return true;
+		}
+	}
+
+	BeginBuild();
+	return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void GridDataSamplerUsingDiskIndex::AddPoints(
+	const double * pLon,
+	const double * pLat,
+	size_t sPoints
+) {
+	for (size_t i = 0; i < sPoints; i++) {
+		if (std::isnan(pLon[i]) || std::isnan(pLat[i]) ||
+		    (pLon[i] == m_dFillValue) || (pLat[i] == m_dFillValue)
+		) {
+			continue;
+		}
+
+		double dX;
+		double dY;
+		double dZ;
+
+		RLLtoXYZ_Deg(pLon[i], pLat[i], dX, dY, dZ);
+
+		m_diskindex.insert(dX, dY, dZ, m_sNextIndex + i);
+	}
+
+	m_sNextIndex += sPoints;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void GridDataSamplerUsingDiskIndex::EndInitialize() {
+
+	GridDataSampler::Initialize(std::vector<double>(), std::vector<double>());
+
+	AnnounceStartBlock("Generating out-of-core index of %lu points", m_sNextIndex);
+
+	// The cache was checked by InitializeFromCache; the index is written
+	// to the cache only if its key covers every point, and otherwise to a
+	// scratch file which is removed once no longer in use
+	const bool fUseIndexCache =
+		UseIndexCache(m_sNextIndex) && (m_sHashedPoints == m_sNextIndex);
+
+	std::string strFilename;
+	if (fUseIndexCache) {
+		strFilename = m_strIndexCacheDir + "/" + m_key.ToString() + ".idx";
+
+	} else if (m_strScratchDir.length() == 0) {
+		strFilename = DiskIndex::scratch_filename(".", "idx");
+	} else {
+		strFilename = DiskIndex::scratch_filename(m_strScratchDir, "idx");
+	}
+
+	{
+		IndexCacheWriter writer(strFilename, m_key);
+		if (!m_diskindex.build(writer) || !writer.Commit()) {
+			_EXCEPTION1("Unable to write index \"%s\"", strFilename.c_str());
+		}
+	}
+	if (!m_diskindex.map(strFilename, m_key, !fUseIndexCache)) {
+		_EXCEPTION1("Unable to map index \"%s\"", strFilename.c_str());
+	}
+
+	if (fUseIndexCache) {
+		Announce("Wrote index to cache \"%s\"", strFilename.c_str());
+	}
+	Announce("Index resident tree: %1.2f MB",
+		static_cast<double>(m_diskindex.memory_usage()) / (1024.0 * 1024.0));
+
+	AnnounceEndBlock("Done");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void GridDataSamplerUsingDiskIndex::SamplePoints(
+	const double * pLon,
+	const double * pLat,
+	size_t sPoints,
+	int * pImageMap
+) const {
+	std::vector<double> dX(sPoints);
+	std::vector<double> dY(sPoints);
+	std::vector<double> dZ(sPoints);
+
+	RLLtoXYZ_Deg(pLon, pLat, sPoints, &(dX[0]), &(dY[0]), &(dZ[0]));
+
+	SamplePointsXYZ(&(dX[0]), &(dY[0]), &(dZ[0]), sPoints, pImageMap);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void GridDataSamplerUsingDiskIndex::SampleRow(
+	const double * pLon,
+	const double * pSinLon,
+	const double * pCosLon,
+	double dLat,
+	size_t sPoints,
+	int * pImageMap
+) const {
+	std::vector<double> dX(sPoints);
+	std::vector<double> dY(sPoints);
+	std::vector<double> dZ(sPoints);
+
+	RLLtoXYZ_Row(
+		pSinLon, pCosLon,
+		sin(DegToRad(dLat)), cos(DegToRad(dLat)),
+		sPoints, &(dX[0]), &(dY[0]), &(dZ[0]));
+
+	SamplePointsXYZ(&(dX[0]), &(dY[0]), &(dZ[0]), sPoints, pImageMap);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void GridDataSamplerUsingDiskIndex::SamplePointsXYZ(
+	const double * pX,
+	const double * pY,
+	const double * pZ,
+	size_t sPoints,
+	int * pImageMap
+) const {
+	static const size_t BatchSize = 256;
+
+	float flX[BatchSize];
+	float flY[BatchSize];
+	float flZ[BatchSize];
+	uint32_t uIndex[BatchSize];
+
+	for (size_t s = 0; s < sPoints; s += BatchSize) {
+		const size_t sBatch = std::min(BatchSize, sPoints - s);
+
+		for (size_t i = 0; i < sBatch; i++) {
+			flX[i] = static_cast<float>(pX[s+i]);
+			flY[i] = static_cast<float>(pY[s+i]);
+			flZ[i] = static_cast<float>(pZ[s+i]);
+		}
+
+		m_diskindex.find_nearest(flX, flY, flZ, sBatch, uIndex);
+
+		for (size_t i = 0; i < sBatch; i++) {
+			if (uIndex[i] == static_cast<uint32_t>(-1)) {
+				pImageMap[s+i] = 0;
+			} else {
+				pImageMap[s+i] = static_cast<int>(uIndex[i]);
+			}
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GridDataSamplerUsingMeshWalk
+///////////////////////////////////////////////////////////////////////////////
+
+void GridDataSamplerUsingMeshWalk::Initialize(
+	const std::vector<double> & dLon,
+	const std::vector<double> & dLat,
+	double dFillValue,
+	const std::vector<uint32_t> & vecAdjacencyFirst,
+	const std::vector<uint32_t> & vecAdjacency
+) {
+	GridDataSampler::Initialize(dLon, dLat);
+
+	_ASSERT(dLon.size() == dLat.size());
+	_ASSERT((vecAdjacencyFirst.size() == 0) || (vecAdjacencyFirst.size() == dLon.size()+1));
+
+	AnnounceStartBlock("Generating mesh walk from lat/lon arrays");
+
+	const size_t sPoints = dLon.size();
+
+	m_quadtree.clear();
+	m_quadtree.reserve(sPoints);
+
+	m_dXYZ.resize(3 * sPoints);
+
+	std::vector<bool> vecValid(sPoints, false);
+
+	for (size_t i = 0; i < sPoints; i++) {
+		if (std::isnan(dLon[i]) || std::isnan(dLat[i])) {
+			continue;
+		}
+		if ((dLon[i] == dFillValue) || (dLat[i] == dFillValue)) {
+			continue;
+		}
+
+		vecValid[i] = true;
+
+		m_quadtree.insert(LonDegToStandardRange(dLon[i]), dLat[i], i);
+
+		RLLtoXYZ_Deg(dLon[i], dLat[i], m_dXYZ[3*i+0], m_dXYZ[3*i+1], m_dXYZ[3*i+2]);
+	}
+
+	m_quadtree.set_build_progress(0, 100);
+	int iMaxLevel = m_quadtree.build(m_pThreadPool);
+
+	m_dMaxCellRadius = 2.0 * 360.0 * pow(0.5, static_cast<double>(iMaxLevel));
+
+	// Copy the adjacency, dropping links to missing or out-of-range points
+	m_vecAdjacencyFirst.clear();
+	m_vecAdjacency.clear();
+	m_flCellExtent.clear();
+
+	if (vecAdjacencyFirst.size() != 0) {
+		m_vecAdjacencyFirst.resize(sPoints+1);
+		m_vecAdjacency.reserve(vecAdjacency.size());
+
+		for (size_t i = 0; i < sPoints; i++) {
+			m_vecAdjacencyFirst[i] = static_cast<uint32_t>(m_vecAdjacency.size());
+			if (!vecValid[i]) {
+				continue;
+			}
+			for (uint32_t k = vecAdjacencyFirst[i]; k < vecAdjacencyFirst[i+1]; k++) {
+				uint32_t uNeighbor = vecAdjacency[k];
+				if ((uNeighbor < sPoints) && (uNeighbor != i) && vecValid[uNeighbor]) {
+					m_vecAdjacency.push_back(uNeighbor);
+				}
+			}
+		}
+		m_vecAdjacencyFirst[sPoints] = static_cast<uint32_t>(m_vecAdjacency.size());
+
+		// Extent of each cell, from the dot product with its farthest neighbor
+		m_flCellExtent.resize(sPoints, 2.0f);
+
+		for (size_t i = 0; i < sPoints; i++) {
+			if (m_vecAdjacencyFirst[i] == m_vecAdjacencyFirst[i+1]) {
+				continue;
+			}
+			double dMinDot = 1.0;
+			for (uint32_t k = m_vecAdjacencyFirst[i]; k < m_vecAdjacencyFirst[i+1]; k++) {
+				const uint32_t uNeighbor = m_vecAdjacency[k];
+				const double dDot =
+					m_dXYZ[3*i+0] * m_dXYZ[3*uNeighbor+0]
+					+ m_dXYZ[3*i+1] * m_dXYZ[3*uNeighbor+1]
+					+ m_dXYZ[3*i+2] * m_dXYZ[3*uNeighbor+2];
+				dMinDot = std::min(dMinDot, dDot);
+			}
+			m_flCellExtent[i] = static_cast<float>(1.0 - dMinDot);
+		}
+
+		Announce("Mesh adjacency: %lu links", m_vecAdjacency.size());
+
+	} else {
+		Announce("WARNING: No mesh adjacency available; using quadtree lookups only");
+	}
+
+	Announce("Mesh walk memory usage: %1.2f MB",
+		static_cast<double>(
+			m_quadtree.memory_usage()
+			+ m_dXYZ.capacity() * sizeof(double)
+			+ m_vecAdjacencyFirst.capacity() * sizeof(uint32_t)
+			+ m_vecAdjacency.capacity() * sizeof(uint32_t)
+			+ m_flCellExtent.capacity() * sizeof(float)) / (1024.0 * 1024.0));
+
+	AnnounceEndBlock("Done");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+uint32_t GridDataSamplerUsingMeshWalk::Seed(
+	double dLon,
+	double dLat,
+	QuadTree::Cursor & cursor,
+	bool fDistanceFilter
+) const {
+	double dLonRef;
+	double dLatRef;
+
+	size_t sI =
+		m_quadtree.find_inexact(
+			LonDegToStandardRange(dLon),
+			dLat,
+			dLonRef,
+			dLatRef,
+			cursor);
+
+	if (fDistanceFilter && (sI != static_cast<size_t>(-1))) {
+		double dDeltaLon = LonDegToStandardRange(dLon - dLonRef);
+		if (dDeltaLon > 180.0) {
+			dDeltaLon -= 360.0;
+		}
+		if (fabs(dDeltaLon * cos(dLat / 180.0 * M_PI)) > m_dMaxCellRadius) {
+			sI = static_cast<size_t>(-1);
+		}
+		if (fabs(dLat - dLatRef) > m_dMaxCellRadius) {
+			sI = static_cast<size_t>(-1);
+		}
+	}
+
+	return static_cast<uint32_t>(sI);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool GridDataSamplerUsingMeshWalk::Walk(
+	double dX,
+	double dY,
+	double dZ,
+	uint32_t & uPoint,
+	size_t sMaxSteps
+) const {
+	// Nearest on the unit sphere is largest dot product
+	const double * pXYZ = &(m_dXYZ[0]);
+
+	double dBest =
+		dX * pXYZ[3*uPoint+0] + dY * pXYZ[3*uPoint+1] + dZ * pXYZ[3*uPoint+2];
+
+	for (size_t sStep = 0; sStep < sMaxSteps; sStep++) {
+		uint32_t uNext = uPoint;
+
+		const uint32_t kEnd = m_vecAdjacencyFirst[uPoint+1];
+		for (uint32_t k = m_vecAdjacencyFirst[uPoint]; k < kEnd; k++) {
+			const uint32_t uNeighbor = m_vecAdjacency[k];
+			const double dDot =
+				dX * pXYZ[3*uNeighbor+0]
+				+ dY * pXYZ[3*uNeighbor+1]
+				+ dZ * pXYZ[3*uNeighbor+2];
+
+			if (dDot > dBest) {
+				dBest = dDot;
+				uNext = uNeighbor;
+			}
+		}
+
+		if (uNext == uPoint) {
+			return true;
+		}
+		uPoint = uNext;
+	}
+
+	return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void GridDataSamplerUsingMeshWalk::SamplePoints(
+	const double * pLon,
+	const double * pLat,
+	size_t sPoints,
+	int * pImageMap
+) const {
+	if (!HasAdjacency()) {
+		SamplePointsXYZ(pLon, pLat, NULL, NULL, NULL, sPoints, pImageMap);
+		return;
+	}
+
+	std::vector<double> dX(sPoints);
+	std::vector<double> dY(sPoints);
+	std::vector<double> dZ(sPoints);
+
+	RLLtoXYZ_Deg(pLon, pLat, sPoints, &(dX[0]), &(dY[0]), &(dZ[0]));
+
+	SamplePointsXYZ(pLon, pLat, &(dX[0]), &(dY[0]), &(dZ[0]), sPoints, pImageMap);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void GridDataSamplerUsingMeshWalk::SampleRow(
+	const double * pLon,
+	const double * pSinLon,
+	const double * pCosLon,
+	double dLat,
+	size_t sPoints,
+	int * pImageMap
+) const {
+	if (!HasAdjacency()) {
+		GridDataSampler::SampleRow(pLon, pSinLon, pCosLon, dLat, sPoints, pImageMap);
+		return;
+	}
+
+	std::vector<double> dRowLat(sPoints, dLat);
+	std::vector<double> dX(sPoints);
+	std::vector<double> dY(sPoints);
+	std::vector<double> dZ(sPoints);
+
+	RLLtoXYZ_Row(
+		pSinLon, pCosLon,
+		sin(DegToRad(dLat)), cos(DegToRad(dLat)),
+		sPoints, &(dX[0]), &(dY[0]), &(dZ[0]));
+
+	SamplePointsXYZ(pLon, &(dRowLat[0]), &(dX[0]), &(dY[0]), &(dZ[0]), sPoints, pImageMap);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void GridDataSamplerUsingMeshWalk::SamplePointsXYZ(
+	const double * pLon,
+	const double * pLat,
+	const double * pX,
+	const double * pY,
+	const double * pZ,
+	size_t sPoints,
+	int * pImageMap
+) const {
+
+	// Walks longer than this are abandoned and reseeded from the quadtree;
+	// consecutive pixels are normally within a few cells of one another
+	static const size_t MaxWalkSteps = 64;
+
+	static const uint32_t InvalidPoint = static_cast<uint32_t>(-1);
+
+	QuadTree::Cursor cursor;
+
+	const bool fHasAdjacency = HasAdjacency();
+
+	uint32_t uPoint = InvalidPoint;
+
+	for (size_t s = 0; s < sPoints; s++) {
+
+		// Seed the first pixel of each run (or every pixel without adjacency,
+		// in which case the quadtree distance criteria apply)
+		if ((uPoint == InvalidPoint) || (!fHasAdjacency)) {
+			uPoint = Seed(pLon[s], pLat[s], cursor, !fHasAdjacency);
+			if (uPoint == InvalidPoint) {
+				pImageMap[s] = 0;
+				continue;
+			}
+		}
+
+		if (fHasAdjacency) {
+			if (!Walk(pX[s], pY[s], pZ[s], uPoint, MaxWalkSteps)) {
+				uPoint = Seed(pLon[s], pLat[s], cursor, false);
+				if (uPoint == InvalidPoint) {
+					pImageMap[s] = 0;
+					continue;
+				}
+
+				// A walk that does not converge ends on an arbitrary cell,
+				// so keep the seed, which is the nearest point
+				const uint32_t uSeed = uPoint;
+				if (!Walk(pX[s], pY[s], pZ[s], uPoint, m_vecAdjacency.size())) {
+					uPoint = uSeed;
+					pImageMap[s] = static_cast<int>(uPoint);
+					continue;
+				}
+			}
+
+			// Walks that end farther from their point than its farthest
+			// neighbor have left the mesh (regional or masked grids)
+			const double dDot =
+				pX[s] * m_dXYZ[3*uPoint+0]
+				+ pY[s] * m_dXYZ[3*uPoint+1]
+				+ pZ[s] * m_dXYZ[3*uPoint+2];
+
+			if (1.0 - dDot > static_cast<double>(m_flCellExtent[uPoint])) {
+				pImageMap[s] = 0;
+				continue;
+			}
+		}
+
+		pImageMap[s] = static_cast<int>(uPoint);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GridDataSamplerUsingCellPolygons
+///////////////////////////////////////////////////////////////////////////////
+
+void GridDataSamplerUsingCellPolygons::Initialize(
+	const std::vector<uint32_t> & vecVertexFirst,
+	const std::vector<double> & dVertexLon,
+	const std::vector<double> & dVertexLat,
+	double dFillValue
+) {
+	GridDataSampler::Initialize(dVertexLon, dVertexLat);
+
+	_ASSERT(vecVertexFirst.size() >= 1);
+	_ASSERT(dVertexLon.size() == dVertexLat.size());
+	_ASSERT(vecVertexFirst.back() <= dVertexLon.size());
+
+	AnnounceStartBlock("Generating cell polygons from vertex arrays");
+
+	const size_t sCells = vecVertexFirst.size() - 1;
+
+	m_vecVertexFirst.resize(sCells+1);
+	m_flVertexLon.clear();
+	m_flVertexLat.clear();
+	m_flVertexLon.reserve(dVertexLon.size());
+	m_flVertexLat.reserve(dVertexLat.size());
+	m_flCellBox.resize(4 * sCells);
+
+	size_t sPolarCells = 0;
+
+	for (size_t c = 0; c < sCells; c++) {
+		const size_t sCellFirst = m_flVertexLon.size();
+
+		double dPrevLon = 0.0;
+
+		m_vecVertexFirst[c] = static_cast<uint32_t>(sCellFirst);
+
+		// Unwrap longitudes so that consecutive vertices are within 180 degrees
+		for (uint32_t k = vecVertexFirst[c]; k < vecVertexFirst[c+1]; k++) {
+			double dLon = dVertexLon[k];
+			double dLat = dVertexLat[k];
+
+			if (std::isnan(dLon) || std::isnan(dLat)) {
+				continue;
+			}
+			if ((dLon == dFillValue) || (dLat == dFillValue)) {
+				continue;
+			}
+
+			if (m_flVertexLon.size() != sCellFirst) {
+				double dDelta = dLon - dPrevLon;
+				dDelta -= 360.0 * floor((dDelta + 180.0) / 360.0);
+				dLon = dPrevLon + dDelta;
+			}
+			dPrevLon = dLon;
+
+			m_flVertexLon.push_back(static_cast<float>(dLon));
+			m_flVertexLat.push_back(static_cast<float>(dLat));
+		}
+
+		float * flBox = &(m_flCellBox[4*c]);
+
+		// Degenerate cells cover nothing
+		if (m_flVertexLon.size() - sCellFirst < 3) {
+			m_flVertexLon.resize(sCellFirst);
+			m_flVertexLat.resize(sCellFirst);
+
+			flBox[0] = std::numeric_limits<float>::max();
+			flBox[1] = -std::numeric_limits<float>::max();
+			flBox[2] = std::numeric_limits<float>::max();
+			flBox[3] = -std::numeric_limits<float>::max();
+			continue;
+		}
+
+		// A cell whose boundary winds once around the sphere contains a pole;
+		// close it through the pole on the side of its mean latitude
+		const double dLon0 = m_flVertexLon[sCellFirst];
+		const double dLat0 = m_flVertexLat[sCellFirst];
+
+		double dClose = dLon0 - dPrevLon;
+		dClose -= 360.0 * floor((dClose + 180.0) / 360.0);
+
+		const double dWinding = dPrevLon + dClose - dLon0;
+
+		if (fabs(dWinding) > 180.0) {
+			double dLatSum = 0.0;
+			for (size_t k = sCellFirst; k < m_flVertexLat.size(); k++) {
+				dLatSum += m_flVertexLat[k];
+			}
+			const double dPoleLat = (dLatSum >= 0.0)?(90.0):(-90.0);
+
+			m_flVertexLon.push_back(static_cast<float>(dLon0 + dWinding));
+			m_flVertexLat.push_back(static_cast<float>(dLat0));
+			m_flVertexLon.push_back(static_cast<float>(dLon0 + dWinding));
+			m_flVertexLat.push_back(static_cast<float>(dPoleLat));
+			m_flVertexLon.push_back(static_cast<float>(dLon0));
+			m_flVertexLat.push_back(static_cast<float>(dPoleLat));
+
+			sPolarCells++;
+		}
+
+		flBox[0] = flBox[1] = m_flVertexLon[sCellFirst];
+		flBox[2] = flBox[3] = m_flVertexLat[sCellFirst];
+		for (size_t k = sCellFirst; k < m_flVertexLon.size(); k++) {
+			flBox[0] = std::min(flBox[0], m_flVertexLon[k]);
+			flBox[1] = std::max(flBox[1], m_flVertexLon[k]);
+			flBox[2] = std::min(flBox[2], m_flVertexLat[k]);
+			flBox[3] = std::max(flBox[3], m_flVertexLat[k]);
+		}
+	}
+	m_vecVertexFirst[sCells] = static_cast<uint32_t>(m_flVertexLon.size());
+
+	if (sPolarCells != 0) {
+		Announce("%lu cell(s) closed through a pole", sPolarCells);
+	}
+
+	// Bin cells by bounding box for point location, with about one bin
+	// per cell up to a fixed maximum
+	m_sBinsLon = static_cast<size_t>(sqrt(2.0 * static_cast<double>(sCells)));
+	m_sBinsLon = std::max<size_t>(1, std::min<size_t>(m_sBinsLon, 2896));
+	m_sBinsLat = std::max<size_t>(1, m_sBinsLon / 2);
+
+	const double dBinLon = 360.0 / static_cast<double>(m_sBinsLon);
+	const double dBinLat = 180.0 / static_cast<double>(m_sBinsLat);
+
+	auto fnBinRange = [&](size_t c, long & iLon0, long & iLon1, long & jLat0, long & jLat1) {
+		const float * flBox = &(m_flCellBox[4*c]);
+		if (flBox[0] > flBox[1]) {
+			return false;
+		}
+
+		double dLonStart = LonDegToStandardRange(flBox[0]);
+		iLon0 = static_cast<long>(floor(dLonStart / dBinLon));
+		iLon1 = static_cast<long>(floor((dLonStart + flBox[1] - flBox[0]) / dBinLon));
+		if (iLon1 - iLon0 + 1 >= static_cast<long>(m_sBinsLon)) {
+			iLon0 = 0;
+			iLon1 = static_cast<long>(m_sBinsLon) - 1;
+		}
+
+		jLat0 = static_cast<long>(floor((flBox[2] + 90.0) / dBinLat));
+		jLat1 = static_cast<long>(floor((flBox[3] + 90.0) / dBinLat));
+		jLat0 = std::max<long>(0, std::min<long>(jLat0, m_sBinsLat - 1));
+		jLat1 = std::max<long>(0, std::min<long>(jLat1, m_sBinsLat - 1));
+		return true;
+	};
+
+	m_vecBinFirst.clear();
+	m_vecBinFirst.resize(m_sBinsLon * m_sBinsLat + 1, 0);
+
+	for (int iPass = 0; iPass < 2; iPass++) {
+		std::vector<uint32_t> vecNext;
+		if (iPass == 1) {
+			for (size_t b = 0; b < m_sBinsLon * m_sBinsLat; b++) {
+				m_vecBinFirst[b+1] += m_vecBinFirst[b];
+			}
+			m_vecBinCells.resize(m_vecBinFirst.back());
+			vecNext.assign(m_vecBinFirst.begin(), m_vecBinFirst.end()-1);
+		}
+
+		for (size_t c = 0; c < sCells; c++) {
+			long iLon0, iLon1, jLat0, jLat1;
+			if (!fnBinRange(c, iLon0, iLon1, jLat0, jLat1)) {
+				continue;
+			}
+			for (long j = jLat0; j <= jLat1; j++) {
+			for (long i = iLon0; i <= iLon1; i++) {
+				size_t b = static_cast<size_t>(j) * m_sBinsLon + static_cast<size_t>(i) % m_sBinsLon;
+				if (iPass == 0) {
+					m_vecBinFirst[b+1]++;
+				} else {
+					m_vecBinCells[vecNext[b]++] = static_cast<uint32_t>(c);
+				}
+			}
+			}
+		}
+	}
+
+	Announce("Cell polygon memory usage: %1.2f MB",
+		static_cast<double>(
+			m_vecVertexFirst.capacity() * sizeof(uint32_t)
+			+ (m_flVertexLon.capacity() + m_flVertexLat.capacity()) * sizeof(float)
+			+ m_flCellBox.capacity() * sizeof(float)
+			+ (m_vecBinFirst.capacity() + m_vecBinCells.capacity()) * sizeof(uint32_t))
+		/ (1024.0 * 1024.0));
+
+	AnnounceEndBlock("Done");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool GridDataSamplerUsingCellPolygons::CellContains(
+	uint32_t uCell,
+	double dLon,
+	double dLat
+) const {
+	const float * flBox = &(m_flCellBox[4*uCell]);
+	if ((dLat < flBox[2]) || (dLat > flBox[3])) {
+		return false;
+	}
+
+	const float * flX = &(m_flVertexLon[m_vecVertexFirst[uCell]]);
+	const float * flY = &(m_flVertexLat[m_vecVertexFirst[uCell]]);
+	const size_t sVertices = m_vecVertexFirst[uCell+1] - m_vecVertexFirst[uCell];
+
+	// Test each periodic image of the point within the cell's longitudes,
+	// using the same half-open crossing rule as the rasterizer
+	double dX0 = dLon + 360.0 * ceil((flBox[0] - dLon) / 360.0);
+
+	for (double dXp = dX0; dXp <= flBox[1]; dXp += 360.0) {
+		bool fInside = false;
+		for (size_t k = 0, kPrev = sVertices-1; k < sVertices; kPrev = k++) {
+			if ((flY[k] <= dLat) != (flY[kPrev] <= dLat)) {
+				double dXcross =
+					static_cast<double>(flX[k])
+					+ (dLat - flY[k]) * (static_cast<double>(flX[kPrev]) - flX[k])
+					/ (static_cast<double>(flY[kPrev]) - flY[k]);
+				if (dXp < dXcross) {
+					fInside = !fInside;
+				}
+			}
+		}
+		if (fInside) {
+			return true;
+		}
+	}
+	return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void GridDataSamplerUsingCellPolygons::SamplePoints(
+	const double * pLon,
+	const double * pLat,
+	size_t sPoints,
+	int * pImageMap
+) const {
+	if ((m_sBinsLon == 0) || (m_sBinsLat == 0)) {
+		std::fill(pImageMap, pImageMap + sPoints, 0);
+		return;
+	}
+
+	const double dBinLon = 360.0 / static_cast<double>(m_sBinsLon);
+	const double dBinLat = 180.0 / static_cast<double>(m_sBinsLat);
+
+	for (size_t s = 0; s < sPoints; s++) {
+		pImageMap[s] = 0;
+
+		double dLon = LonDegToStandardRange(pLon[s]);
+
+		long i = static_cast<long>(dLon / dBinLon);
+		long j = static_cast<long>(floor((pLat[s] + 90.0) / dBinLat));
+		i = std::max<long>(0, std::min<long>(i, m_sBinsLon - 1));
+		j = std::max<long>(0, std::min<long>(j, m_sBinsLat - 1));
+
+		const size_t b = static_cast<size_t>(j) * m_sBinsLon + static_cast<size_t>(i);
+
+		for (uint32_t k = m_vecBinFirst[b]; k < m_vecBinFirst[b+1]; k++) {
+			if (CellContains(m_vecBinCells[k], dLon, pLat[s])) {
+				pImageMap[s] = static_cast<int>(m_vecBinCells[k]);
+				break;
+			}
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void GridDataSamplerUsingCellPolygons::Sample(
+	const std::vector<double> & dSampleLon,
+	const std::vector<double> & dSampleLat,
+	std::vector<int> & dImageMap
+) const {
+	const size_t sWidth = dSampleLon.size();
+	const size_t sHeight = dSampleLat.size();
+
+	dImageMap.resize(sWidth * sHeight);
+
+	if ((sWidth == 0) || (sHeight == 0)) {
+		return;
+	}
+	if ((m_sBinsLon == 0) || (m_sBinsLat == 0)) {
+		std::fill(dImageMap.begin(), dImageMap.end(), 0);
+		return;
+	}
+
+	// Rasterization requires uniformly spaced, increasing sample coordinates
+	auto fnIsUniform = [](const std::vector<double> & dSample, double & dDelta) {
+		if (dSample.size() < 2) {
+			return false;
+		}
+		dDelta = (dSample.back() - dSample.front()) / static_cast<double>(dSample.size()-1);
+		if (!(dDelta > 0.0)) {
+			return false;
+		}
+		for (size_t i = 0; i < dSample.size(); i++) {
+			double dExpected = dSample.front() + static_cast<double>(i) * dDelta;
+			if (fabs(dSample[i] - dExpected) > 1.0e-6 * dDelta) {
+				return false;
+			}
+		}
+		return true;
+	};
+
+	double dDeltaLon;
+	double dDeltaLat;
+	if (!fnIsUniform(dSampleLon, dDeltaLon) || !fnIsUniform(dSampleLat, dDeltaLat)) {
+		GridDataSampler::Sample(dSampleLon, dSampleLat, dImageMap);
+		return;
+	}
+
+	const double dViewLon0 = dSampleLon.front() - 0.5 * dDeltaLon;
+	const double dViewLon1 = dSampleLon.back() + 0.5 * dDeltaLon;
+	const double dViewLat0 = dSampleLat.front() - 0.5 * dDeltaLat;
+	const double dViewLat1 = dSampleLat.back() + 0.5 * dDeltaLat;
+
+	// Find each periodic image of each cell that overlaps the view; if
+	// there are more of these than pixels, per-pixel location is cheaper
+	struct VisibleCell {
+		uint32_t uCell;
+		double dShift;
+	};
+
+	std::vector<VisibleCell> vecVisible;
+
+	// Candidate cells are those binned in any bin overlapping the view
+	const double dBinLon = 360.0 / static_cast<double>(m_sBinsLon);
+	const double dBinLat = 180.0 / static_cast<double>(m_sBinsLat);
+
+	long iBin0 = 0;
+	long iBin1 = static_cast<long>(m_sBinsLon) - 1;
+	if (dViewLon1 - dViewLon0 < 360.0) {
+		double dLonStart = LonDegToStandardRange(dViewLon0);
+		iBin0 = static_cast<long>(floor(dLonStart / dBinLon));
+		iBin1 = static_cast<long>(floor((dLonStart + dViewLon1 - dViewLon0) / dBinLon));
+		if (iBin1 - iBin0 + 1 >= static_cast<long>(m_sBinsLon)) {
+			iBin0 = 0;
+			iBin1 = static_cast<long>(m_sBinsLon) - 1;
+		}
+	}
+
+	long jBin0 = static_cast<long>(floor((dViewLat0 + 90.0) / dBinLat));
+	long jBin1 = static_cast<long>(floor((dViewLat1 + 90.0) / dBinLat));
+	jBin0 = std::max<long>(0, std::min<long>(jBin0, m_sBinsLat - 1));
+	jBin1 = std::max<long>(0, std::min<long>(jBin1, m_sBinsLat - 1));
+
+	std::vector<uint32_t> vecCandidates;
+	if ((iBin1 - iBin0 + 1 == static_cast<long>(m_sBinsLon))
+	 && (jBin1 - jBin0 + 1 == static_cast<long>(m_sBinsLat))
+	) {
+		vecCandidates.resize(m_flCellBox.size() / 4);
+		for (size_t c = 0; c < vecCandidates.size(); c++) {
+			vecCandidates[c] = static_cast<uint32_t>(c);
+		}
+
+	} else {
+		for (long j = jBin0; j <= jBin1; j++) {
+		for (long i = iBin0; i <= iBin1; i++) {
+			size_t b = static_cast<size_t>(j) * m_sBinsLon + static_cast<size_t>(i) % m_sBinsLon;
+			vecCandidates.insert(vecCandidates.end(),
+				m_vecBinCells.begin() + m_vecBinFirst[b],
+				m_vecBinCells.begin() + m_vecBinFirst[b+1]);
+		}
+		}
+
+		// Cells spanning several bins are found more than once
+		std::sort(vecCandidates.begin(), vecCandidates.end());
+		vecCandidates.erase(
+			std::unique(vecCandidates.begin(), vecCandidates.end()),
+			vecCandidates.end());
+	}
+
+	for (size_t n = 0; n < vecCandidates.size(); n++) {
+		const uint32_t c = vecCandidates[n];
+		const float * flBox = &(m_flCellBox[4*c]);
+		if ((flBox[3] < dViewLat0) || (flBox[2] > dViewLat1) || (flBox[0] > flBox[1])) {
+			continue;
+		}
+
+		long kMin = static_cast<long>(ceil((dViewLon0 - flBox[1]) / 360.0));
+		long kMax = static_cast<long>(floor((dViewLon1 - flBox[0]) / 360.0));
+		for (long k = kMin; k <= kMax; k++) {
+			VisibleCell vis;
+			vis.uCell = static_cast<uint32_t>(c);
+			vis.dShift = 360.0 * static_cast<double>(k);
+			vecVisible.push_back(vis);
+		}
+
+		if (vecVisible.size() > sWidth * sHeight) {
+			GridDataSampler::Sample(dSampleLon, dSampleLat, dImageMap);
+			return;
+		}
+	}
+
+	std::fill(dImageMap.begin(), dImageMap.end(), 0);
+
+	// Scan-convert visible cells one band of rows at a time; pixel (i,j)
+	// belongs to a cell if its center is inside the half-open spans
+	// between successive edge crossings of row j
+	auto fnRasterizeRows = [&](size_t jBegin, size_t jEnd) {
+		std::vector<double> dCrossings;
+
+		const double dBandLat0 = dSampleLat[jBegin];
+		const double dBandLat1 = dSampleLat[jEnd-1];
+
+		for (size_t v = 0; v < vecVisible.size(); v++) {
+			const uint32_t uCell = vecVisible[v].uCell;
+			const double dShift = vecVisible[v].dShift;
+			const float * flBox = &(m_flCellBox[4*uCell]);
+
+			if ((flBox[3] < dBandLat0) || (flBox[2] > dBandLat1)) {
+				continue;
+			}
+
+			long j0 = static_cast<long>(ceil((flBox[2] - dSampleLat.front()) / dDeltaLat));
+			long j1 = static_cast<long>(floor((flBox[3] - dSampleLat.front()) / dDeltaLat));
+			j0 = std::max<long>(j0, static_cast<long>(jBegin));
+			j1 = std::min<long>(j1, static_cast<long>(jEnd) - 1);
+
+			const float * flX = &(m_flVertexLon[m_vecVertexFirst[uCell]]);
+			const float * flY = &(m_flVertexLat[m_vecVertexFirst[uCell]]);
+			const size_t sVertices = m_vecVertexFirst[uCell+1] - m_vecVertexFirst[uCell];
+
+			for (long j = j0; j <= j1; j++) {
+				const double dLat = dSampleLat[j];
+
+				dCrossings.clear();
+				for (size_t k = 0, kPrev = sVertices-1; k < sVertices; kPrev = k++) {
+					if ((flY[k] <= dLat) != (flY[kPrev] <= dLat)) {
+						dCrossings.push_back(
+							static_cast<double>(flX[k])
+							+ (dLat - flY[k]) * (static_cast<double>(flX[kPrev]) - flX[k])
+							/ (static_cast<double>(flY[kPrev]) - flY[k]));
+					}
+				}
+				std::sort(dCrossings.begin(), dCrossings.end());
+
+				int * pRow = &(dImageMap[static_cast<size_t>(j) * sWidth]);
+
+				for (size_t m = 0; m + 1 < dCrossings.size(); m += 2) {
+					double dI0 = ceil((dCrossings[m] + dShift - dSampleLon.front()) / dDeltaLon);
+					double dI1 = ceil((dCrossings[m+1] + dShift - dSampleLon.front()) / dDeltaLon) - 1.0;
+					dI0 = std::max(dI0, 0.0);
+					dI1 = std::min(dI1, static_cast<double>(sWidth) - 1.0);
+
+					for (long i = static_cast<long>(dI0); i <= static_cast<long>(dI1); i++) {
+						pRow[i] = static_cast<int>(uCell);
+					}
+				}
+			}
+		}
+	};
+
+	if (m_pThreadPool == NULL) {
+		fnRasterizeRows(0, sHeight);
+
+	} else {
+		size_t sBandSize = sHeight / (4 * m_pThreadPool->GetThreadCount());
+		if (sBandSize < 1) {
+			sBandSize = 1;
+		}
+		m_pThreadPool->ParallelFor(0, sHeight, sBandSize, fnRasterizeRows);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GridDataSamplerUsingCurvilinear
+///////////////////////////////////////////////////////////////////////////////
+
+void GridDataSamplerUsingCurvilinear::Initialize(
+	const std::vector<double> & dLon,
+	const std::vector<double> & dLat,
+	size_t sNy,
+	size_t sNx,
+	double dFillValue
+) {
+	// Every CoarseStride-th center in each direction is used to seed walks
+	static const size_t CoarseStride = 4;
+
+	GridDataSampler::Initialize(dLon, dLat);
+
+	_ASSERT(dLon.size() == dLat.size());
+	_ASSERT(dLon.size() == sNy * sNx);
+
+	if ((sNy < 2) || (sNx < 2)) {
+		_EXCEPTIONT("Curvilinear grid must have at least two rows and columns");
+	}
+
+	AnnounceStartBlock("Generating curvilinear grid from lat/lon arrays");
+
+	m_sNy = sNy;
+	m_sNx = sNx;
+
+	const size_t sW = sNx + 2;
+	const double dNaN = std::numeric_limits<double>::quiet_NaN();
+
+	m_dNodeXYZ.resize(3 * (sNy + 2) * sW);
+
+	// Interior nodes are the grid centers
+	for (size_t j = 0; j < sNy; j++) {
+	for (size_t i = 0; i < sNx; i++) {
+		const size_t k = j * sNx + i;
+		double * pNode = &(m_dNodeXYZ[3 * ((j+1) * sW + (i+1))]);
+
+		if (std::isnan(dLon[k]) || std::isnan(dLat[k]) ||
+		    (dLon[k] == dFillValue) || (dLat[k] == dFillValue)
+		) {
+			pNode[0] = pNode[1] = pNode[2] = dNaN;
+		} else {
+			RLLtoXYZ_Deg(dLon[k], dLat[k], pNode[0], pNode[1], pNode[2]);
+		}
+	}
+	}
+
+	// Extrapolate the ring of ghost nodes linearly from the two nearest
+	// nodes, first along rows and then along columns (including corners)
+	auto fnExtrapolate = [&](size_t sGhost, size_t sNear, size_t sFar) {
+		double * pGhost = &(m_dNodeXYZ[3 * sGhost]);
+		const double * pNear = &(m_dNodeXYZ[3 * sNear]);
+		const double * pFar = &(m_dNodeXYZ[3 * sFar]);
+
+		double dX = 2.0 * pNear[0] - pFar[0];
+		double dY = 2.0 * pNear[1] - pFar[1];
+		double dZ = 2.0 * pNear[2] - pFar[2];
+		double dMag = sqrt(dX * dX + dY * dY + dZ * dZ);
+
+		pGhost[0] = dX / dMag;
+		pGhost[1] = dY / dMag;
+		pGhost[2] = dZ / dMag;
+	};
+
+	for (size_t i = 1; i <= sNx; i++) {
+		fnExtrapolate(i, sW + i, 2 * sW + i);
+		fnExtrapolate((sNy + 1) * sW + i, sNy * sW + i, (sNy - 1) * sW + i);
+	}
+	for (size_t j = 0; j <= sNy + 1; j++) {
+		fnExtrapolate(j * sW, j * sW + 1, j * sW + 2);
+		fnExtrapolate(j * sW + sNx + 1, j * sW + sNx, j * sW + sNx - 1);
+	}
+
+	// Spherical cap about the mean node containing all valid nodes
+	m_dCapCenter[0] = 0.0;
+	m_dCapCenter[1] = 0.0;
+	m_dCapCenter[2] = 0.0;
+	for (size_t n = 0; n < m_dNodeXYZ.size(); n += 3) {
+		if (!std::isnan(m_dNodeXYZ[n])) {
+			m_dCapCenter[0] += m_dNodeXYZ[n+0];
+			m_dCapCenter[1] += m_dNodeXYZ[n+1];
+			m_dCapCenter[2] += m_dNodeXYZ[n+2];
+		}
+	}
+
+	const double dCapMag =
+		sqrt(m_dCapCenter[0] * m_dCapCenter[0]
+			+ m_dCapCenter[1] * m_dCapCenter[1]
+			+ m_dCapCenter[2] * m_dCapCenter[2]);
+
+	m_dCapCos = -1.0;
+	if (dCapMag > 1.0e-8 * static_cast<double>(m_dNodeXYZ.size())) {
+		m_dCapCenter[0] /= dCapMag;
+		m_dCapCenter[1] /= dCapMag;
+		m_dCapCenter[2] /= dCapMag;
+
+		m_dCapCos = 1.0;
+		for (size_t n = 0; n < m_dNodeXYZ.size(); n += 3) {
+			if (!std::isnan(m_dNodeXYZ[n])) {
+				m_dCapCos = std::min(m_dCapCos,
+					m_dCapCenter[0] * m_dNodeXYZ[n+0]
+					+ m_dCapCenter[1] * m_dNodeXYZ[n+1]
+					+ m_dCapCenter[2] * m_dNodeXYZ[n+2]);
+			}
+		}
+
+		// Great circle arcs between points of a cap smaller than a
+		// hemisphere remain within it
+		const double dCapRadius = acos(std::min(1.0, m_dCapCos)) + 1.0e-6;
+		if (dCapRadius < 0.5 * M_PI) {
+			m_dCapCos = cos(dCapRadius);
+		} else {
+			m_dCapCos = -1.0;
+		}
+	}
+
+	// Coarse index of centers
+	m_quadtree.clear();
+
+	for (size_t j = 0; j < sNy; j += CoarseStride) {
+	for (size_t i = 0; i < sNx; i += CoarseStride) {
+		const size_t k = j * sNx + i;
+		if (std::isnan(m_dNodeXYZ[3 * ((j+1) * sW + (i+1))])) {
+			continue;
+		}
+		m_quadtree.insert(LonDegToStandardRange(dLon[k]), dLat[k], k);
+	}
+	}
+
+	m_quadtree.build(m_pThreadPool);
+
+	Announce("Curvilinear grid %lu x %lu, memory usage: %1.2f MB",
+		sNy, sNx,
+		static_cast<double>(
+			m_quadtree.memory_usage()
+			+ m_dNodeXYZ.capacity() * sizeof(double)) / (1024.0 * 1024.0));
+
+	AnnounceEndBlock("Done");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void GridDataSamplerUsingCurvilinear::BuildQuad(
+	long lJ,
+	long lI,
+	Quad & quad
+) const {
+	const size_t sW = m_sNx + 2;
+	const size_t sNode = static_cast<size_t>(lJ) * sW + static_cast<size_t>(lI);
+
+	quad.lJ = lJ;
+	quad.lI = lI;
+	quad.fValid = false;
+
+	const double * pV[4] = {
+		&(m_dNodeXYZ[3 * sNode]),
+		&(m_dNodeXYZ[3 * (sNode + 1)]),
+		&(m_dNodeXYZ[3 * (sNode + sW + 1)]),
+		&(m_dNodeXYZ[3 * (sNode + sW)])
+	};
+
+	double dC[3];
+	for (int d = 0; d < 3; d++) {
+		dC[d] = pV[0][d] + pV[1][d] + pV[2][d] + pV[3][d];
+	}
+	if (std::isnan(dC[0] + dC[1] + dC[2])) {
+		return;
+	}
+
+	auto fnCross = [](const double * dA, const double * dB, double * dN) {
+		dN[0] = dA[1] * dB[2] - dA[2] * dB[1];
+		dN[1] = dA[2] * dB[0] - dA[0] * dB[2];
+		dN[2] = dA[0] * dB[1] - dA[1] * dB[0];
+	};
+
+	// Edge normals, oriented towards the mean of the corners
+	for (int k = 0; k < 4; k++) {
+		double * dN = quad.dEdge[k];
+		fnCross(pV[k], pV[(k+1)%4], dN);
+
+		double dMag = sqrt(dN[0] * dN[0] + dN[1] * dN[1] + dN[2] * dN[2]);
+		if (!(dMag > 0.0)) {
+			return;
+		}
+		if (dN[0] * dC[0] + dN[1] * dC[1] + dN[2] * dC[2] < 0.0) {
+			dMag = -dMag;
+		}
+		dN[0] /= dMag;
+		dN[1] /= dMag;
+		dN[2] /= dMag;
+	}
+
+	// Great circles through midpoints of opposite edges, oriented towards
+	// corners 1 and 3 respectively
+	double dM[4][3];
+	for (int d = 0; d < 3; d++) {
+		dM[0][d] = pV[0][d] + pV[1][d];
+		dM[1][d] = pV[3][d] + pV[2][d];
+		dM[2][d] = pV[0][d] + pV[3][d];
+		dM[3][d] = pV[1][d] + pV[2][d];
+	}
+
+	fnCross(dM[0], dM[1], quad.dMid[0]);
+	fnCross(dM[2], dM[3], quad.dMid[1]);
+
+	for (int m = 0; m < 2; m++) {
+		const double * pRef = pV[(m == 0)?(1):(3)];
+		double * dN = quad.dMid[m];
+		if (dN[0] * pRef[0] + dN[1] * pRef[1] + dN[2] * pRef[2] < 0.0) {
+			dN[0] = -dN[0];
+			dN[1] = -dN[1];
+			dN[2] = -dN[2];
+		}
+	}
+
+	quad.fValid = true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int GridDataSamplerUsingCurvilinear::LocateInQuad(
+	const Quad & quad,
+	const double * dP,
+	int & iCorner
+) const {
+	if (!quad.fValid) {
+		return 4;
+	}
+
+	// Find the edge beyond which the point lies furthest
+	int iEdge = (-1);
+	double dMinDist = 0.0;
+	for (int k = 0; k < 4; k++) {
+		const double * dN = quad.dEdge[k];
+		const double dDist = dN[0] * dP[0] + dN[1] * dP[1] + dN[2] * dP[2];
+		if (dDist < dMinDist) {
+			dMinDist = dDist;
+			iEdge = k;
+		}
+	}
+	if (iEdge != (-1)) {
+		return iEdge;
+	}
+
+	const double * dS = quad.dMid[0];
+	const double * dT = quad.dMid[1];
+
+	const bool fUpperS = (dS[0] * dP[0] + dS[1] * dP[1] + dS[2] * dP[2] >= 0.0);
+	const bool fUpperT = (dT[0] * dP[0] + dT[1] * dP[1] + dT[2] * dP[2] >= 0.0);
+
+	if (fUpperT) {
+		iCorner = (fUpperS)?(2):(3);
+	} else {
+		iCorner = (fUpperS)?(1):(0);
+	}
+
+	return (-1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool GridDataSamplerUsingCurvilinear::Walk(
+	const double * dP,
+	Quad & quad,
+	int & iCorner,
+	size_t sMaxSteps
+) const {
+	const long lQuadsY = static_cast<long>(m_sNy) + 1;
+	const long lQuadsX = static_cast<long>(m_sNx) + 1;
+
+	for (size_t sStep = 0; sStep < sMaxSteps; sStep++) {
+		int iEdge = LocateInQuad(quad, dP, iCorner);
+
+		long lJ = quad.lJ;
+		long lI = quad.lI;
+
+		if (iEdge == (-1)) {
+			return true;
+		} else if (iEdge == 0) {
+			lJ--;
+		} else if (iEdge == 1) {
+			lI++;
+		} else if (iEdge == 2) {
+			lJ++;
+		} else if (iEdge == 3) {
+			lI--;
+		} else {
+			return false;
+		}
+
+		if ((lJ < 0) || (lJ >= lQuadsY) || (lI < 0) || (lI >= lQuadsX)) {
+			return false;
+		}
+
+		BuildQuad(lJ, lI, quad);
+	}
+
+	return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int GridDataSamplerUsingCurvilinear::LocatePoint(
+	const double * dP,
+	double dLon,
+	double dLat,
+	Quad & quad,
+	bool & fHaveQuad,
+	QuadTree::Cursor & cursor
+) const {
+
+	// Walks longer than this are abandoned and reseeded from the coarse
+	// index; consecutive pixels are normally within a few quadrilaterals
+	static const size_t MaxWalkSteps = 64;
+
+	// Reject points far from the grid
+	if (m_dCapCenter[0] * dP[0] + m_dCapCenter[1] * dP[1] + m_dCapCenter[2] * dP[2] < m_dCapCos) {
+		return 0;
+	}
+
+	int iCorner = 0;
+
+	bool fFound = false;
+	if (fHaveQuad) {
+		fFound = Walk(dP, quad, iCorner, MaxWalkSteps);
+	}
+
+	// Seed from the nearest coarse center
+	if (!fFound) {
+		double dLonRef;
+		double dLatRef;
+
+		size_t sK =
+			m_quadtree.find_inexact(
+				LonDegToStandardRange(dLon),
+				dLat,
+				dLonRef,
+				dLatRef,
+				cursor);
+
+		if (sK == static_cast<size_t>(-1)) {
+			fHaveQuad = false;
+			return 0;
+		}
+
+		BuildQuad(
+			static_cast<long>(sK / m_sNx) + 1,
+			static_cast<long>(sK % m_sNx) + 1,
+			quad);
+
+		fFound = Walk(dP, quad, iCorner, MaxWalkSteps);
+	}
+
+	fHaveQuad = fFound;
+
+	if (!fFound) {
+		return 0;
+	}
+
+	// Center at the nearest corner, with ghost nodes mapped to the boundary
+	long lCenterJ = quad.lJ - 1 + (((iCorner == 2) || (iCorner == 3))?(1):(0));
+	long lCenterI = quad.lI - 1 + (((iCorner == 1) || (iCorner == 2))?(1):(0));
+
+	lCenterJ = std::max<long>(0, std::min<long>(lCenterJ, m_sNy - 1));
+	lCenterI = std::max<long>(0, std::min<long>(lCenterI, m_sNx - 1));
+
+	return static_cast<int>(lCenterJ * m_sNx + lCenterI);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void GridDataSamplerUsingCurvilinear::SamplePoints(
+	const double * pLon,
+	const double * pLat,
+	size_t sPoints,
+	int * pImageMap
+) const {
+	QuadTree::Cursor cursor;
+
+	Quad quad;
+	bool fHaveQuad = false;
+
+	for (size_t s = 0; s < sPoints; s++) {
+		double dP[3];
+		RLLtoXYZ_Deg(pLon[s], pLat[s], dP[0], dP[1], dP[2]);
+
+		pImageMap[s] = LocatePoint(dP, pLon[s], pLat[s], quad, fHaveQuad, cursor);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void GridDataSamplerUsingCurvilinear::SampleRow(
+	const double * pLon,
+	const double * pSinLon,
+	const double * pCosLon,
+	double dLat,
+	size_t sPoints,
+	int * pImageMap
+) const {
+	QuadTree::Cursor cursor;
+
+	Quad quad;
+	bool fHaveQuad = false;
+
+	const double dSinLat = sin(DegToRad(dLat));
+	const double dCosLat = cos(DegToRad(dLat));
+
+	for (size_t s = 0; s < sPoints; s++) {
+		double dP[3] = {dCosLat * pCosLon[s], dCosLat * pSinLon[s], dSinLat};
+
+		pImageMap[s] = LocatePoint(dP, pLon[s], dLat, quad, fHaveQuad, cursor);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GridDataSamplerUsingReducedGaussian
+///////////////////////////////////////////////////////////////////////////////
+
+bool GridDataSamplerUsingReducedGaussian::Initialize(
+	const std::vector<double> & dLon,
+	const std::vector<double> & dLat,
+	double dFillValue
+) {
+	// Tolerance on latitude within a row, in degrees
+	static const double RowLatTolerance = 1.0e-6;
+
+	// Tolerance on longitude, as a fraction of the row spacing
+	static const double RowLonTolerance = 0.01;
+
+	_ASSERT(dLon.size() == dLat.size());
+
+	m_dRowLat.clear();
+	m_vecRowFirst.clear();
+	m_vecRowCount.clear();
+	m_dRowLon0.clear();
+
+	const size_t sPoints = dLon.size();
+	if (sPoints < 2) {
+		return false;
+	}
+
+	// Divide the points into runs of constant latitude
+	for (size_t i = 0; i < sPoints; i++) {
+		if (std::isnan(dLon[i]) || std::isnan(dLat[i]) ||
+		    (dLon[i] == dFillValue) || (dLat[i] == dFillValue)
+		) {
+			return false;
+		}
+		if ((i == 0) || (fabs(dLat[i] - m_dRowLat.back()) > RowLatTolerance)) {
+			m_dRowLat.push_back(dLat[i]);
+			m_vecRowFirst.push_back(i);
+			m_vecRowCount.push_back(0);
+			m_dRowLon0.push_back(dLon[i]);
+		}
+		m_vecRowCount.back()++;
+	}
+
+	const size_t sRows = m_dRowLat.size();
+	if ((sRows < 2) || (sRows == sPoints)) {
+		return false;
+	}
+
+	// Rows must be stored in order of latitude
+	const bool fDescending = (m_dRowLat[1] < m_dRowLat[0]);
+	for (size_t r = 1; r < sRows; r++) {
+		if ((m_dRowLat[r] < m_dRowLat[r-1]) != fDescending) {
+			return false;
+		}
+	}
+
+	// Each row must be uniformly spaced around the circle
+	for (size_t r = 0; r < sRows; r++) {
+		const double dSpacing = 360.0 / static_cast<double>(m_vecRowCount[r]);
+		for (size_t k = 1; k < m_vecRowCount[r]; k++) {
+			double dDiff =
+				dLon[m_vecRowFirst[r] + k] - m_dRowLon0[r]
+				- static_cast<double>(k) * dSpacing;
+			dDiff -= 360.0 * floor(dDiff / 360.0 + 0.5);
+			if (fabs(dDiff) > RowLonTolerance * dSpacing) {
+				return false;
+			}
+		}
+	}
+
+	if (fDescending) {
+		std::reverse(m_dRowLat.begin(), m_dRowLat.end());
+		std::reverse(m_vecRowFirst.begin(), m_vecRowFirst.end());
+		std::reverse(m_vecRowCount.begin(), m_vecRowCount.end());
+		std::reverse(m_dRowLon0.begin(), m_dRowLon0.end());
+	}
+
+	Announce("Detected reduced Gaussian layout with %lu rows", sRows);
+
+	GridDataSampler::Initialize(dLon, dLat);
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+size_t GridDataSamplerUsingReducedGaussian::FindRow(
+	double dLat
+) const {
+	size_t r = std::upper_bound(m_dRowLat.begin(), m_dRowLat.end(), dLat) - m_dRowLat.begin();
+	if (r == 0) {
+		return 0;
+	}
+	if (r == m_dRowLat.size()) {
+		return r-1;
+	}
+	if (dLat - m_dRowLat[r-1] < m_dRowLat[r] - dLat) {
+		return r-1;
+	}
+	return r;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void GridDataSamplerUsingReducedGaussian::SamplePoints(
+	const double * pLon,
+	const double * pLat,
+	size_t sPoints,
+	int * pImageMap
+) const {
+	size_t r = 0;
+
+	for (size_t s = 0; s < sPoints; s++) {
+
+		// Successive points usually share the same latitude
+		if ((s == 0) || (pLat[s] != pLat[s-1])) {
+			r = FindRow(pLat[s]);
+		}
+
+		const double dCount = static_cast<double>(m_vecRowCount[r]);
+		double dK = floor((pLon[s] - m_dRowLon0[r]) * dCount / 360.0 + 0.5);
+		dK -= dCount * floor(dK / dCount);
+
+		size_t k = static_cast<size_t>(dK);
+		if (k >= m_vecRowCount[r]) {
+			k = 0;
+		}
+
+		pImageMap[s] = static_cast<int>(m_vecRowFirst[r] + k);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GridDataSamplerUsingHEALPix
+///////////////////////////////////////////////////////////////////////////////
+
+bool GridDataSamplerUsingHEALPix::Initialize(
+	const std::vector<double> & dLon,
+	const std::vector<double> & dLat,
+	double dFillValue
+) {
+	_ASSERT(dLon.size() == dLat.size());
+
+	m_lNside = 0;
+	m_fNested = false;
+
+	// A complete grid has 12 * Nside^2 pixels
+	const size_t sPoints = dLon.size();
+	if ((sPoints < 12) || (sPoints % 12 != 0)) {
+		return false;
+	}
+
+	long lNside = static_cast<long>(sqrt(static_cast<double>(sPoints / 12)) + 0.5);
+	if (12 * static_cast<size_t>(lNside) * static_cast<size_t>(lNside) != sPoints) {
+		return false;
+	}
+	if (sPoints > static_cast<size_t>(std::numeric_limits<int>::max())) {
+		return false;
+	}
+
+	// Determine the ordering from the first few points
+	const size_t sProbe = std::min<size_t>(sPoints, 1024);
+
+	bool fRing = true;
+	bool fNest = ((lNside & (lNside - 1)) == 0);
+	for (size_t i = 0; i < sProbe; i++) {
+		if (std::isnan(dLon[i]) || std::isnan(dLat[i]) ||
+		    (dLon[i] == dFillValue) || (dLat[i] == dFillValue)
+		) {
+			return false;
+		}
+		if (fRing && (Ang2PixRing(lNside, dLon[i], dLat[i]) != static_cast<long>(i))) {
+			fRing = false;
+		}
+		if (fNest && (Ang2PixNest(lNside, dLon[i], dLat[i]) != static_cast<long>(i))) {
+			fNest = false;
+		}
+		if (!fRing && !fNest) {
+			return false;
+		}
+	}
+
+	const bool fNested = !fRing;
+
+	// Every point must be the center of its own pixel
+	std::atomic<bool> fMatch(true);
+
+	auto fnCheckPoints = [&](size_t sBegin, size_t sEnd) {
+		for (size_t i = sBegin; (i < sEnd) && fMatch; i++) {
+			long lPix;
+			if (fNested) {
+				lPix = Ang2PixNest(lNside, dLon[i], dLat[i]);
+			} else {
+				lPix = Ang2PixRing(lNside, dLon[i], dLat[i]);
+			}
+			if (lPix != static_cast<long>(i)) {
+				fMatch = false;
+			}
+		}
+	};
+
+	if (m_pThreadPool == NULL) {
+		fnCheckPoints(sProbe, sPoints);
+	} else {
+		m_pThreadPool->ParallelFor(sProbe, sPoints, 65536, fnCheckPoints);
+	}
+
+	if (!fMatch) {
+		return false;
+	}
+
+	m_lNside = lNside;
+	m_fNested = fNested;
+
+	Announce("Detected HEALPix layout with Nside %li (%s)",
+		m_lNside, (m_fNested)?("NESTED"):("RING"));
+
+	GridDataSampler::Initialize(dLon, dLat);
+
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+long GridDataSamplerUsingHEALPix::Ang2PixRing(
+	long lNside,
+	double dLon,
+	double dLat
+) {
+	return Ang2PixRingZ(lNside, dLon, sin(DegToRad(dLat)));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+long GridDataSamplerUsingHEALPix::Ang2PixRingZ(
+	long lNside,
+	double dLon,
+	double dZ
+) {
+	const double dZa = fabs(dZ);
+
+	// Longitude in units of quarter circles, in [0,4)
+	double dTt = dLon / 90.0;
+	dTt -= 4.0 * floor(dTt / 4.0);
+	if (dTt >= 4.0) {
+		dTt = 0.0;
+	}
+
+	const long lNl4 = 4 * lNside;
+
+	// Equatorial region
+	if (dZa <= 2.0 / 3.0) {
+		const double dTemp1 = static_cast<double>(lNside) * (0.5 + dTt);
+		const double dTemp2 = static_cast<double>(lNside) * dZ * 0.75;
+
+		const long lJp = static_cast<long>(dTemp1 - dTemp2);
+		const long lJm = static_cast<long>(dTemp1 + dTemp2);
+
+		const long lIr = lNside + 1 + lJp - lJm;
+		const long lKshift = 1 - (lIr & 1);
+
+		long lIp = (lJp + lJm - lNside + lKshift + 1) / 2;
+		lIp = ((lIp % lNl4) + lNl4) % lNl4;
+
+		return 2 * lNside * (lNside - 1) + (lIr - 1) * lNl4 + lIp;
+	}
+
+	// Polar caps
+	const double dTp = dTt - floor(dTt);
+	const double dTmp = static_cast<double>(lNside) * sqrt(3.0 * (1.0 - dZa));
+
+	const long lJp = static_cast<long>(dTp * dTmp);
+	const long lJm = static_cast<long>((1.0 - dTp) * dTmp);
+
+	const long lIr = std::max<long>(1, std::min<long>(lJp + lJm + 1, lNside));
+	long lIp = static_cast<long>(dTt * static_cast<double>(lIr));
+	lIp = std::min(lIp, 4 * lIr - 1);
+
+	if (dZ > 0.0) {
+		return 2 * lIr * (lIr - 1) + lIp;
+	}
+	return 12 * lNside * lNside - 2 * lIr * (lIr + 1) + lIp;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+long GridDataSamplerUsingHEALPix::Ang2PixNest(
+	long lNside,
+	double dLon,
+	double dLat
+) {
+	return Ang2PixNestZ(lNside, dLon, sin(DegToRad(dLat)));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+long GridDataSamplerUsingHEALPix::Ang2PixNestZ(
+	long lNside,
+	double dLon,
+	double dZ
+) {
+	const double dZa = fabs(dZ);
+
+	// Longitude in units of quarter circles, in [0,4)
+	double dTt = dLon / 90.0;
+	dTt -= 4.0 * floor(dTt / 4.0);
+	if (dTt >= 4.0) {
+		dTt = 0.0;
+	}
+
+	long lFace;
+	long lIx;
+	long lIy;
+
+	// Equatorial region
+	if (dZa <= 2.0 / 3.0) {
+		const double dTemp1 = static_cast<double>(lNside) * (0.5 + dTt);
+		const double dTemp2 = static_cast<double>(lNside) * dZ * 0.75;
+
+		const long lJp = static_cast<long>(dTemp1 - dTemp2);
+		const long lJm = static_cast<long>(dTemp1 + dTemp2);
+
+		const long lIfp = lJp / lNside;
+		const long lIfm = lJm / lNside;
+
+		if (lIfp == lIfm) {
+			lFace = (lIfp | 4);
+		} else if (lIfp < lIfm) {
+			lFace = lIfp;
+		} else {
+			lFace = lIfm + 8;
+		}
+
+		lIx = lJm & (lNside - 1);
+		lIy = lNside - (lJp & (lNside - 1)) - 1;
+
+	// Polar caps
+	} else {
+		long lNtt = static_cast<long>(dTt);
+		if (lNtt >= 4) {
+			lNtt = 3;
+		}
+		const double dTp = dTt - static_cast<double>(lNtt);
+		const double dTmp = static_cast<double>(lNside) * sqrt(3.0 * (1.0 - dZa));
+
+		const long lJp = std::min<long>(static_cast<long>(dTp * dTmp), lNside - 1);
+		const long lJm = std::min<long>(static_cast<long>((1.0 - dTp) * dTmp), lNside - 1);
+
+		if (dZ >= 0.0) {
+			lFace = lNtt;
+			lIx = lNside - lJm - 1;
+			lIy = lNside - lJp - 1;
+		} else {
+			lFace = lNtt + 8;
+			lIx = lJp;
+			lIy = lJm;
+		}
+	}
+
+	// Interleave the bits of ix (even bits) and iy (odd bits)
+	long lPix = 0;
+	for (long b = 0; (1L << b) < lNside; b++) {
+		lPix |= ((lIx >> b) & 1L) << (2 * b);
+		lPix |= ((lIy >> b) & 1L) << (2 * b + 1);
+	}
+
+	return lFace * lNside * lNside + lPix;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void GridDataSamplerUsingHEALPix::SamplePoints(
+	const double * pLon,
+	const double * pLat,
+	size_t sPoints,
+	int * pImageMap
+) const {
+
+	// Sine of the latitude of the previous sample
+	double dZLat = 0.0;
+	double dZ = 0.0;
+
+	for (size_t s = 0; s < sPoints; s++) {
+		if (pLat[s] != dZLat) {
+			dZLat = pLat[s];
+			dZ = sin(DegToRad(pLat[s]));
+		}
+
+		if (m_fNested) {
+			pImageMap[s] = static_cast<int>(Ang2PixNestZ(m_lNside, pLon[s], dZ));
+		} else {
+			pImageMap[s] = static_cast<int>(Ang2PixRingZ(m_lNside, pLon[s], dZ));
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
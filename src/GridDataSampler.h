@@ -9,11 +9,15 @@
 #define _GRIDDATASAMPLER_H_
 
 #include "Announce.h"
+#include "DiskIndex.h"
+#include "IndexCache.h"
 #include "QuadTree.h"
-#include "kdtree.h"
+#include "StaticKDTree.h"
+#include "ThreadPool.h"
 #include "netcdfcpp.h"
 
 #include <vector>
+#include <string>
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -23,9 +27,17 @@ public:
 	///		Constructor.
 	///	</summary>
 	GridDataSampler() :
+		m_pThreadPool(NULL),
+		m_nAdaptiveTileSize(0),
 		m_fIsInitialized(false)
 	{ }
 
+	///	<summary>
+	///		Destructor.
+	///	</summary>
+	virtual ~GridDataSampler()
+	{ }
+
 	///	<summary>
 	///		Initialize.
 	///	</summary>
@@ -35,13 +47,44 @@ public:
 	);
 
 	///	<summary>
-	///		Sample.
+	///		Sample on the tensor product of dSampleLon and dSampleLat.
+	///		Rows of the image are divided into bands which are sampled
+	///		in parallel if a ThreadPool has been set.
 	///	</summary>
 	virtual void Sample(
 		const std::vector<double> & dSampleLon,
 		const std::vector<double> & dSampleLat,
 		std::vector<int> & dImageMap
-	) const = 0;
+	) const;
+
+	///	<summary>
+	///		Set the ThreadPool used for sampling (or NULL for serial).
+	///	</summary>
+	void SetThreadPool(
+		ThreadPool * pThreadPool
+	) {
+		m_pThreadPool = pThreadPool;
+	}
+
+	///	<summary>
+	///		Enable adaptive sampling with the given tile size in pixels
+	///		(or disable it if nTileSize < 2).
+	///	</summary>
+	void SetAdaptiveTileSize(
+		int nTileSize
+	) {
+		m_nAdaptiveTileSize = nTileSize;
+	}
+
+	///	<summary>
+	///		Set the directory in which built indices are cached (or an
+	///		empty string to disable the cache).
+	///	</summary>
+	void SetIndexCacheDir(
+		const std::string & strIndexCacheDir
+	) {
+		m_strIndexCacheDir = strIndexCacheDir;
+	}
 
 	///	<summary>
 	///		Check if initialized.
@@ -50,6 +93,121 @@ public:
 		return m_fIsInitialized;
 	}
 
+	///	<summary>
+	///		Approximate memory used by this GridDataSampler, in bytes.
+	///	</summary>
+	virtual size_t GetMemoryUsage() const {
+		return 0;
+	}
+
+protected:
+	///	<summary>
+	///		Minimum number of points for which built indices are cached.
+	///		Smaller indices are faster to rebuild than to hash and load.
+	///	</summary>
+	static const size_t IndexCacheMinimumPoints = 1000000;
+
+	///	<summary>
+	///		Check if the index cache should be used for a grid with the
+	///		given number of points.
+	///	</summary>
+	bool UseIndexCache(
+		size_t sPoints
+	) const {
+		return ((m_strIndexCacheDir.length() != 0) && (sPoints >= IndexCacheMinimumPoints));
+	}
+
+	///	<summary>
+	///		Load the index with the given key from the cache using
+	///		ReadIndex.  Returns false if the index is not in the cache.
+	///	</summary>
+	bool ReadIndexCache(
+		const IndexCacheKey & key
+	);
+
+	///	<summary>
+	///		Store the index under the given key in the cache using
+	///		WriteIndex.  Failure to write the cache is not an error.
+	///	</summary>
+	void WriteIndexCache(
+		const IndexCacheKey & key
+	) const;
+
+	///	<summary>
+	///		Read the index from a cache file.  Returns false if the index
+	///		could not be read.
+	///	</summary>
+	virtual bool ReadIndex(
+		IndexCacheReader & reader
+	) {
+		return false;
+	}
+
+	///	<summary>
+	///		Write the index to a cache file.  Returns false if this
+	///		GridDataSampler does not support caching.
+	///	</summary>
+	virtual bool WriteIndex(
+		IndexCacheWriter & writer
+	) const {
+		return false;
+	}
+
+	///	<summary>
+	///		Sample adaptively.  The image is divided into tiles and only
+	///		the tile corners are queried.  Tiles whose corners map to the
+	///		same index are filled without further queries; all other tiles
+	///		are subdivided and the process is repeated.  Features smaller
+	///		than a tile that do not touch a queried pixel may be missed.
+	///	</summary>
+	void SampleAdaptive(
+		const std::vector<double> & dSampleLon,
+		const std::vector<double> & dSampleLat,
+		std::vector<int> & dImageMap
+	) const;
+
+	///	<summary>
+	///		Sample at sPoints points (pLon[i], pLat[i]), storing the
+	///		result in pImageMap[i].  Must be safe to call concurrently.
+	///	</summary>
+	virtual void SamplePoints(
+		const double * pLon,
+		const double * pLat,
+		size_t sPoints,
+		int * pImageMap
+	) const = 0;
+
+	///	<summary>
+	///		Sample one row of the tensor product, at longitudes pLon and
+	///		constant latitude dLat.  The sine and cosine of each longitude
+	///		are computed once per image and given in pSinLon and pCosLon.
+	///		By default calls SamplePoints.
+	///	</summary>
+	virtual void SampleRow(
+		const double * pLon,
+		const double * pSinLon,
+		const double * pCosLon,
+		double dLat,
+		size_t sPoints,
+		int * pImageMap
+	) const;
+
+protected:
+	///	<summary>
+	///		ThreadPool used for sampling.
+	///	</summary>
+	ThreadPool * m_pThreadPool;
+
+	///	<summary>
+	///		Tile size used for adaptive sampling (disabled if less than 2).
+	///	</summary>
+	int m_nAdaptiveTileSize;
+
+	///	<summary>
+	///		Directory in which built indices are cached.
+	///	</summary>
+	std::string m_strIndexCacheDir;
+
 private:
 	///	<summary>
 	///		Flag indicating this GridDataSampler is initialized.
@@ -61,6 +219,14 @@ private:
 
 class GridDataSamplerUsingCubedSphereQuadTree : public GridDataSampler {
 public:
+	///	<summary>
+	///		Constructor.
+	///	</summary>
+	GridDataSamplerUsingCubedSphereQuadTree() :
+		m_fDistanceFilter(false),
+		m_dMaxCellRadius(0.0)
+	{ }
+
 	///	<summary>
 	///		Convert a RLL coordinate to an equiangular cubed-sphere ABP coordinate.
 	///	</summary>
@@ -72,6 +238,46 @@ public:
 		int & nP
 	);
 
+	///	<summary>
+	///		Convert a 3D Cartesian coordinate on the unit sphere to an
+	///		equiangular cubed-sphere ABP coordinate.
+	///	</summary>
+	static void ABPFromXYZ(
+		double xx,
+		double yy,
+		double zz,
+		double & dA,
+		double & dB,
+		int & nP
+	);
+
+	///	<summary>
+	///		Rotate a 3D Cartesian coordinate into the frame of panel nP, in
+	///		which the panel is centered on the positive z axis.
+	///	</summary>
+	static void PanelFromXYZ(
+		int nP,
+		double xx,
+		double yy,
+		double zz,
+		double & sx,
+		double & sy,
+		double & sz
+	);
+
+	///	<summary>
+	///		Inverse of PanelFromXYZ.
+	///	</summary>
+	static void XYZFromPanel(
+		int nP,
+		double sx,
+		double sy,
+		double sz,
+		double & xx,
+		double & yy,
+		double & zz
+	);
+
 	///	<summary>
 	///		Initialize.
 	///	</summary>
@@ -83,19 +289,69 @@ public:
 	);
 
 	///	<summary>
-	///		Generate
+	///		Approximate memory used by this GridDataSampler, in bytes.
 	///	</summary>
-	virtual void Sample(
-		const std::vector<double> & dSampleLon,
-		const std::vector<double> & dSampleLat,
-		std::vector<int> & dImageMap
+	virtual size_t GetMemoryUsage() const {
+		size_t sMemoryUsage = 0;
+		for (size_t p = 0; p < m_vecquadtree.size(); p++) {
+			sMemoryUsage += m_vecquadtree[p].memory_usage();
+		}
+		return sMemoryUsage;
+	}
+
+protected:
+	///	<summary>
+	///		Sample at a set of points.
+	///	</summary>
+	virtual void SamplePoints(
+		const double * pLon,
+		const double * pLat,
+		size_t sPoints,
+		int * pImageMap
+	) const;
+
+	///	<summary>
+	///		Sample one row of the tensor product.
+	///	</summary>
+	virtual void SampleRow(
+		const double * pLon,
+		const double * pSinLon,
+		const double * pCosLon,
+		double dLat,
+		size_t sPoints,
+		int * pImageMap
+	) const;
+
+	///	<summary>
+	///		Read the index from a cache file.
+	///	</summary>
+	virtual bool ReadIndex(
+		IndexCacheReader & reader
+	);
+
+	///	<summary>
+	///		Write the index to a cache file.
+	///	</summary>
+	virtual bool WriteIndex(
+		IndexCacheWriter & writer
+	) const;
+
+	///	<summary>
+	///		Sample at a set of points given in 3D Cartesian coordinates.
+	///	</summary>
+	virtual void SamplePointsXYZ(
+		const double * pX,
+		const double * pY,
+		const double * pZ,
+		size_t sPoints,
+		int * pImageMap
 	) const;
 
 public:
 	///	<summary>
 	///		QuadTree root node.
 	///	</summary>
-	std::vector<QuadTreeNode> m_vecquadtree;
+	std::vector<QuadTree> m_vecquadtree;
 
 	///	<summary>
 	///		Apply distance criteria for filtering sample points.
@@ -110,6 +366,121 @@ public:
 
 ///////////////////////////////////////////////////////////////////////////////
 
+class GridDataSamplerUsingCubedSphereLattice : public GridDataSamplerUsingCubedSphereQuadTree {
+
+public:
+	///	<summary>
+	///		Constructor.
+	///	</summary>
+	GridDataSamplerUsingCubedSphereLattice() :
+		m_fLattice(false),
+		m_dLatticeBucketLow(0.0),
+		m_dLatticeBucketScale(0.0)
+	{ }
+
+	///	<summary>
+	///		Initialize.  If the points form a tensor-product lattice in the
+	///		equiangular coordinates of each cubed-sphere panel (as for
+	///		equiangular or equidistant FV grids and spectral element GLL
+	///		nodes) a (panel, i, j) lookup table is built; otherwise the
+	///		cubed-sphere quadtree is built instead.
+	///	</summary>
+	virtual void Initialize(
+		const std::vector<double> & dLon,
+		const std::vector<double> & dLat,
+		double dFillValue,
+		double dMaxCellRadius
+	);
+
+	///	<summary>
+	///		Check if a lattice was detected.
+	///	</summary>
+	bool HasLattice() const {
+		return m_fLattice;
+	}
+
+	///	<summary>
+	///		Approximate memory used by this GridDataSampler, in bytes.
+	///	</summary>
+	virtual size_t GetMemoryUsage() const {
+		return
+			  GridDataSamplerUsingCubedSphereQuadTree::GetMemoryUsage()
+			+ m_dLatticeCoord.capacity() * sizeof(double)
+			+ m_dLatticeMid.capacity() * sizeof(double)
+			+ m_vecLatticeBucket.capacity() * sizeof(uint32_t)
+			+ m_vecLatticeColumn.capacity() * sizeof(int);
+	}
+
+protected:
+	///	<summary>
+	///		Detect the lattice and build the lookup table.
+	///	</summary>
+	///	<returns>
+	///		true if a lattice was detected, false otherwise.
+	///	</returns>
+	bool DetectLattice(
+		const std::vector<double> & dLon,
+		const std::vector<double> & dLat,
+		double dFillValue
+	);
+
+	///	<summary>
+	///		Index of the lattice coordinate nearest dA.
+	///	</summary>
+	size_t LatticeIndex(
+		double dA
+	) const;
+
+	///	<summary>
+	///		Sample at a set of points given in 3D Cartesian coordinates.
+	///	</summary>
+	virtual void SamplePointsXYZ(
+		const double * pX,
+		const double * pY,
+		const double * pZ,
+		size_t sPoints,
+		int * pImageMap
+	) const;
+
+public:
+	///	<summary>
+	///		Flag indicating a lattice was detected.
+	///	</summary>
+	bool m_fLattice;
+
+	///	<summary>
+	///		Equiangular coordinates of the lattice along either panel axis.
+	///	</summary>
+	std::vector<double> m_dLatticeCoord;
+
+	///	<summary>
+	///		Midpoints between successive lattice coordinates.
+	///	</summary>
+	std::vector<double> m_dLatticeMid;
+
+	///	<summary>
+	///		Lattice index nearest the left edge of each uniform bucket.
+	///	</summary>
+	std::vector<uint32_t> m_vecLatticeBucket;
+
+	///	<summary>
+	///		Coordinate of the left edge of the first bucket.
+	///	</summary>
+	double m_dLatticeBucketLow;
+
+	///	<summary>
+	///		Number of buckets per radian.
+	///	</summary>
+	double m_dLatticeBucketScale;
+
+	///	<summary>
+	///		Column at each lattice node, indexed by (panel * n + j) * n + i.
+	///	</summary>
+	std::vector<int> m_vecLatticeColumn;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
 class GridDataSamplerUsingQuadTree : public GridDataSampler {
 public:
 	///	<summary>
@@ -142,7 +513,7 @@ public:
 	);
 
 	///	<summary>
-	///		Generate
+	///		Sample on the tensor product of dSampleLon and dSampleLat.
 	///	</summary>
 	virtual void Sample(
 		const std::vector<double> & dSampleLon,
@@ -150,11 +521,43 @@ public:
 		std::vector<int> & dImageMap
 	) const;
 
+	///	<summary>
+	///		Approximate memory used by this GridDataSampler, in bytes.
+	///	</summary>
+	virtual size_t GetMemoryUsage() const {
+		return m_quadtree.memory_usage();
+	}
+
+protected:
+	///	<summary>
+	///		Sample at a set of points.
+	///	</summary>
+	virtual void SamplePoints(
+		const double * pLon,
+		const double * pLat,
+		size_t sPoints,
+		int * pImageMap
+	) const;
+
+	///	<summary>
+	///		Read the index from a cache file.
+	///	</summary>
+	virtual bool ReadIndex(
+		IndexCacheReader & reader
+	);
+
+	///	<summary>
+	///		Write the index to a cache file.
+	///	</summary>
+	virtual bool WriteIndex(
+		IndexCacheWriter & writer
+	) const;
+
 public:
 	///	<summary>
 	///		QuadTree root node.
 	///	</summary>
-	QuadTreeNode m_quadtree;
+	QuadTree m_quadtree;
 
 	///	<summary>
 	///		Do not wrap longitudes (unstructured regional data).
@@ -176,18 +579,6 @@ public:
 
 class GridDataSamplerUsingKDTree : public GridDataSampler {
 public:
-	///	<summary>
-	///		Constructor.
-	///	</summary>
-	GridDataSamplerUsingKDTree() :
-		m_kdtree(NULL)
-	{ }
-
-	///	<summary>
-	///		Destructor.
-	///	</summary>
-	~GridDataSamplerUsingKDTree();
-
 	///	<summary>
 	///		Initialize.
 	///	</summary>
@@ -198,26 +589,875 @@ public:
 	);
 
 	///	<summary>
-	///		Generate
+	///		Approximate memory used by this GridDataSampler, in bytes.
 	///	</summary>
-	virtual void Sample(
-		const std::vector<double> & dSampleLon,
-		const std::vector<double> & dSampleLat,
-		std::vector<int> & dImageMap
+	virtual size_t GetMemoryUsage() const {
+		return m_kdtree.memory_usage();
+	}
+
+protected:
+	///	<summary>
+	///		Sample at a set of points.
+	///	</summary>
+	virtual void SamplePoints(
+		const double * pLon,
+		const double * pLat,
+		size_t sPoints,
+		int * pImageMap
 	) const;
 
-public:
 	///	<summary>
-	///		Reference address.
+	///		Sample one row of the tensor product.
 	///	</summary>
-	int m_iRef;
+	virtual void SampleRow(
+		const double * pLon,
+		const double * pSinLon,
+		const double * pCosLon,
+		double dLat,
+		size_t sPoints,
+		int * pImageMap
+	) const;
 
 	///	<summary>
-	///		QuadTree root node.
+	///		Sample at a set of points given in 3D Cartesian coordinates.
+	///	</summary>
+	void SamplePointsXYZ(
+		const double * pX,
+		const double * pY,
+		const double * pZ,
+		size_t sPoints,
+		int * pImageMap
+	) const;
+
+	///	<summary>
+	///		Read the index from a cache file.
+	///	</summary>
+	virtual bool ReadIndex(
+		IndexCacheReader & reader
+	);
+
+	///	<summary>
+	///		Write the index to a cache file.
+	///	</summary>
+	virtual bool WriteIndex(
+		IndexCacheWriter & writer
+	) const;
+
+public:
+	///	<summary>
+	///		Static kd-tree of 3D Cartesian coordinates.
 	///	</summary>
-	kdtree * m_kdtree;
+	StaticKDTree m_kdtree;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
 
-#endif // _GRIDDATASAMPLER_H_
+class GridDataSamplerUsingDiskIndex : public GridDataSampler {
+
+public:
+	///	<summary>
+	///		Number of points passed to each call of AddPoints by
+	///		Initialize.  The index cache key depends on the chunking, so
+	///		callers streaming points should use the same chunk size.
+	///	</summary>
+	static const size_t InitializeChunkSize = 1024 * 1024;
+
+	///	<summary>
+	///		Default memory used for buffering points during construction.
+	///	</summary>
+	static const size_t DefaultBuildMemoryBytes = 1024 * 1024 * 1024;
+
+public:
+	///	<summary>
+	///		Constructor.
+	///	</summary>
+	GridDataSamplerUsingDiskIndex() :
+		m_sBuildMemoryBytes(DefaultBuildMemoryBytes),
+		m_key("disk"),
+		m_dFillValue(0.0),
+		m_sPoints(0),
+		m_sHashedPoints(0),
+		m_sNextIndex(0)
+	{ }
+
+	///	<summary>
+	///		Set the directory used for scratch files, and for the index if
+	///		no index cache directory has been set.
+	///	</summary>
+	void SetScratchDir(
+		const std::string & strScratchDir
+	) {
+		m_strScratchDir = strScratchDir;
+	}
+
+	///	<summary>
+	///		Set the memory used for buffering points during construction.
+	///	</summary>
+	void SetBuildMemory(
+		size_t sBuildMemoryBytes
+	) {
+		m_sBuildMemoryBytes = sBuildMemoryBytes;
+	}
+
+	///	<summary>
+	///		Initialize from arrays of longitudes and latitudes.
+	///	</summary>
+	virtual void Initialize(
+		const std::vector<double> & dLon,
+		const std::vector<double> & dLat,
+		double dFillValue
+	);
+
+	///	<summary>
+	///		Begin streaming sPoints points into the index.  If the index
+	///		cache is used, all points are first passed to HashPoints and
+	///		InitializeFromCache maps a cached index if one exists;
+	///		otherwise (or if none exists) points are added in order of
+	///		their index with AddPoints and the index is built with
+	///		EndInitialize.  AddPoints and EndInitialize may be called from
+	///		another thread.
+	///	</summary>
+	void BeginInitialize(
+		double dFillValue,
+		size_t sPoints
+	);
+
+	///	<summary>
+	///		Check if the points must be hashed before they are added.
+	///	</summary>
+	bool IsIndexCacheUsed() const {
+		return UseIndexCache(m_sPoints);
+	}
+
+	///	<summary>
+	///		Add the next sPoints points to the cache key only.
+	///	</summary>
+	void HashPoints(
+		const double * pLon,
+		const double * pLat,
+		size_t sPoints
+	);
+
+	///	<summary>
+	///		Map the index of the hashed points from the index cache.  If it
+	///		is not in the cache, begin building the index and return false.
+	///	</summary>
+	bool InitializeFromCache();
+
+	///	<summary>
+	///		Add the next sPoints points to the index.
+	///	</summary>
+	void AddPoints(
+		const double * pLon,
+		const double * pLat,
+		size_t sPoints
+	);
+
+	///	<summary>
+	///		Build the index from all added points, storing it in the index
+	///		cache if all points were hashed.
+	///	</summary>
+	void EndInitialize();
+
+	///	<summary>
+	///		Approximate memory used by this GridDataSampler, in bytes.
+	///	</summary>
+	virtual size_t GetMemoryUsage() const {
+		return m_diskindex.memory_usage();
+	}
+
+protected:
+	///	<summary>
+	///		Begin buffering points for the index in the scratch directory.
+	///	</summary>
+	void BeginBuild();
+
+	///	<summary>
+	///		Sample at a set of points.
+	///	</summary>
+	virtual void SamplePoints(
+		const double * pLon,
+		const double * pLat,
+		size_t sPoints,
+		int * pImageMap
+	) const;
+
+	///	<summary>
+	///		Sample one row of the tensor product.
+	///	</summary>
+	virtual void SampleRow(
+		const double * pLon,
+		const double * pSinLon,
+		const double * pCosLon,
+		double dLat,
+		size_t sPoints,
+		int * pImageMap
+	) const;
+
+	///	<summary>
+	///		Sample at a set of points given in 3D Cartesian coordinates.
+	///	</summary>
+	void SamplePointsXYZ(
+		const double * pX,
+		const double * pY,
+		const double * pZ,
+		size_t sPoints,
+		int * pImageMap
+	) const;
+
+protected:
+	///	<summary>
+	///		Directory used for scratch files.
+	///	</summary>
+	std::string m_strScratchDir;
+
+	///	<summary>
+	///		Memory used for buffering points during construction.
+	///	</summary>
+	size_t m_sBuildMemoryBytes;
+
+	///	<summary>
+	///		Key of the points hashed so far.
+	///	</summary>
+	IndexCacheKey m_key;
+
+	///	<summary>
+	///		Fill value of the points being added.
+	///	</summary>
+	double m_dFillValue;
+
+	///	<summary>
+	///		Total number of points being added.
+	///	</summary>
+	size_t m_sPoints;
+
+	///	<summary>
+	///		Number of points hashed into m_key.
+	///	</summary>
+	size_t m_sHashedPoints;
+
+	///	<summary>
+	///		Index of the next point to be added.
+	///	</summary>
+	size_t m_sNextIndex;
+
+	///	<summary>
+	///		Memory mapped index of 3D Cartesian coordinates.
+	///	</summary>
+	DiskIndex m_diskindex;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+class GridDataSamplerUsingMeshWalk : public GridDataSampler {
+
+public:
+	///	<summary>
+	///		Constructor.
+	///	</summary>
+	GridDataSamplerUsingMeshWalk() :
+		m_dMaxCellRadius(0.0)
+	{ }
+
+	///	<summary>
+	///		Initialize.  Mesh adjacency is given in compressed row form:
+	///		the neighbors of point i are vecAdjacency[vecAdjacencyFirst[i]]
+	///		through vecAdjacency[vecAdjacencyFirst[i+1]-1].  If no adjacency
+	///		is given every sample is located using the quadtree alone.
+	///	</summary>
+	virtual void Initialize(
+		const std::vector<double> & dLon,
+		const std::vector<double> & dLat,
+		double dFillValue,
+		const std::vector<uint32_t> & vecAdjacencyFirst,
+		const std::vector<uint32_t> & vecAdjacency
+	);
+
+	///	<summary>
+	///		Check if mesh adjacency is available.
+	///	</summary>
+	bool HasAdjacency() const {
+		return (m_vecAdjacencyFirst.size() != 0);
+	}
+
+	///	<summary>
+	///		Approximate memory used by this GridDataSampler, in bytes.
+	///	</summary>
+	virtual size_t GetMemoryUsage() const {
+		return
+			  m_quadtree.memory_usage()
+			+ m_dXYZ.capacity() * sizeof(double)
+			+ m_vecAdjacencyFirst.capacity() * sizeof(uint32_t)
+			+ m_vecAdjacency.capacity() * sizeof(uint32_t)
+			+ m_flCellExtent.capacity() * sizeof(float);
+	}
+
+protected:
+	///	<summary>
+	///		Find an initial point near (dLon, dLat) using the quadtree.
+	///		Returns -1 if the point found is farther than m_dMaxCellRadius
+	///		and fDistanceFilter is set.
+	///	</summary>
+	uint32_t Seed(
+		double dLon,
+		double dLat,
+		QuadTree::Cursor & cursor,
+		bool fDistanceFilter
+	) const;
+
+	///	<summary>
+	///		Walk greedily from uPoint to the neighbor nearest (dX, dY, dZ)
+	///		until no neighbor is nearer, which on a Voronoi / Delaunay mesh
+	///		is the nearest generator.
+	///	</summary>
+	///	<returns>
+	///		false if the walk did not converge within sMaxSteps.
+	///	</returns>
+	bool Walk(
+		double dX,
+		double dY,
+		double dZ,
+		uint32_t & uPoint,
+		size_t sMaxSteps
+	) const;
+
+	///	<summary>
+	///		Sample at a set of points.
+	///	</summary>
+	virtual void SamplePoints(
+		const double * pLon,
+		const double * pLat,
+		size_t sPoints,
+		int * pImageMap
+	) const;
+
+	///	<summary>
+	///		Sample one row of the tensor product.
+	///	</summary>
+	virtual void SampleRow(
+		const double * pLon,
+		const double * pSinLon,
+		const double * pCosLon,
+		double dLat,
+		size_t sPoints,
+		int * pImageMap
+	) const;
+
+	///	<summary>
+	///		Sample at a set of points given in both longitude-latitude
+	///		(used for seeding) and 3D Cartesian coordinates (used for
+	///		walking, and may be NULL if there is no adjacency).
+	///	</summary>
+	void SamplePointsXYZ(
+		const double * pLon,
+		const double * pLat,
+		const double * pX,
+		const double * pY,
+		const double * pZ,
+		size_t sPoints,
+		int * pImageMap
+	) const;
+
+public:
+	///	<summary>
+	///		QuadTree used to seed each walk.
+	///	</summary>
+	QuadTree m_quadtree;
+
+	///	<summary>
+	///		3D Cartesian coordinates of each point on the unit sphere.
+	///	</summary>
+	std::vector<double> m_dXYZ;
+
+	///	<summary>
+	///		Offset of the first neighbor of each point in m_vecAdjacency.
+	///	</summary>
+	std::vector<uint32_t> m_vecAdjacencyFirst;
+
+	///	<summary>
+	///		Neighbors of all points.
+	///	</summary>
+	std::vector<uint32_t> m_vecAdjacency;
+
+	///	<summary>
+	///		One minus the dot product of each point with its farthest
+	///		neighbor (kept in this form for precision on fine meshes); a
+	///		sample farther than this from the point it walks to lies outside
+	///		the mesh.  Points without neighbors store 2.
+	///	</summary>
+	std::vector<float> m_flCellExtent;
+
+	///	<summary>
+	///		Distance criteria for filtering sample points located with the
+	///		quadtree alone, in degrees.
+	///	</summary>
+	double m_dMaxCellRadius;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+class GridDataSamplerUsingCellPolygons : public GridDataSampler {
+
+public:
+	///	<summary>
+	///		Constructor.
+	///	</summary>
+	GridDataSamplerUsingCellPolygons() :
+		m_sBinsLon(0),
+		m_sBinsLat(0)
+	{ }
+
+	///	<summary>
+	///		Initialize from cell polygons in compressed row form: the
+	///		vertices of cell i are entries vecVertexFirst[i] through
+	///		vecVertexFirst[i+1]-1 of dVertexLon and dVertexLat, in degrees.
+	///		Vertices equal to dFillValue or NaN are ignored.
+	///	</summary>
+	virtual void Initialize(
+		const std::vector<uint32_t> & vecVertexFirst,
+		const std::vector<double> & dVertexLon,
+		const std::vector<double> & dVertexLat,
+		double dFillValue
+	);
+
+	///	<summary>
+	///		Sample on the tensor product of dSampleLon and dSampleLat.  If
+	///		the sample coordinates are uniformly spaced and there are more
+	///		pixels than visible cells, every visible cell polygon is
+	///		scan-converted into the image map; otherwise each pixel is
+	///		located individually.
+	///	</summary>
+	virtual void Sample(
+		const std::vector<double> & dSampleLon,
+		const std::vector<double> & dSampleLat,
+		std::vector<int> & dImageMap
+	) const;
+
+	///	<summary>
+	///		Approximate memory used by this GridDataSampler, in bytes.
+	///	</summary>
+	virtual size_t GetMemoryUsage() const {
+		return
+			  m_vecVertexFirst.capacity() * sizeof(uint32_t)
+			+ m_flVertexLon.capacity() * sizeof(float)
+			+ m_flVertexLat.capacity() * sizeof(float)
+			+ m_flCellBox.capacity() * sizeof(float)
+			+ m_vecBinFirst.capacity() * sizeof(uint32_t)
+			+ m_vecBinCells.capacity() * sizeof(uint32_t);
+	}
+
+protected:
+	///	<summary>
+	///		Check if cell uCell contains the point (dLon, dLat).
+	///	</summary>
+	bool CellContains(
+		uint32_t uCell,
+		double dLon,
+		double dLat
+	) const;
+
+	///	<summary>
+	///		Sample at a set of points.
+	///	</summary>
+	virtual void SamplePoints(
+		const double * pLon,
+		const double * pLat,
+		size_t sPoints,
+		int * pImageMap
+	) const;
+
+public:
+	///	<summary>
+	///		Offset of the first vertex of each cell.
+	///	</summary>
+	std::vector<uint32_t> m_vecVertexFirst;
+
+	///	<summary>
+	///		Vertex longitudes, unwrapped so that no edge of a cell crosses
+	///		the periodic boundary.  Cells surrounding a pole are closed
+	///		through the pole.
+	///	</summary>
+	std::vector<float> m_flVertexLon;
+
+	///	<summary>
+	///		Vertex latitudes.
+	///	</summary>
+	std::vector<float> m_flVertexLat;
+
+	///	<summary>
+	///		Bounding box of each cell (lon min, lon max, lat min, lat max).
+	///	</summary>
+	std::vector<float> m_flCellBox;
+
+	///	<summary>
+	///		Number of longitude bins used for point location.
+	///	</summary>
+	size_t m_sBinsLon;
+
+	///	<summary>
+	///		Number of latitude bins used for point location.
+	///	</summary>
+	size_t m_sBinsLat;
+
+	///	<summary>
+	///		Offset of the first cell of each bin in m_vecBinCells.
+	///	</summary>
+	std::vector<uint32_t> m_vecBinFirst;
+
+	///	<summary>
+	///		Cells whose bounding box overlaps each bin.
+	///	</summary>
+	std::vector<uint32_t> m_vecBinCells;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+class GridDataSamplerUsingCurvilinear : public GridDataSampler {
+
+public:
+	///	<summary>
+	///		Constructor.
+	///	</summary>
+	GridDataSamplerUsingCurvilinear() :
+		m_sNy(0),
+		m_sNx(0),
+		m_dCapCos(-1.0)
+	{
+		m_dCapCenter[0] = 0.0;
+		m_dCapCenter[1] = 0.0;
+		m_dCapCenter[2] = 1.0;
+	}
+
+	///	<summary>
+	///		Initialize from the centers of a logically rectangular grid of
+	///		sNy rows and sNx columns, with point (j,i) stored at index
+	///		j * sNx + i.  Each sample is assigned to the center nearest in
+	///		logical coordinates, by locating it within the quadrilateral
+	///		formed by four neighboring centers.  A ring of centers is
+	///		extrapolated around the grid so that the outer half of each
+	///		boundary cell is covered.
+	///	</summary>
+	void Initialize(
+		const std::vector<double> & dLon,
+		const std::vector<double> & dLat,
+		size_t sNy,
+		size_t sNx,
+		double dFillValue
+	);
+
+	///	<summary>
+	///		Approximate memory used by this GridDataSampler, in bytes.
+	///	</summary>
+	virtual size_t GetMemoryUsage() const {
+		return
+			  m_quadtree.memory_usage()
+			+ m_dNodeXYZ.capacity() * sizeof(double);
+	}
+
+protected:
+	///	<summary>
+	///		A quadrilateral of the extended grid, with corners at nodes
+	///		(lJ,lI), (lJ,lI+1), (lJ+1,lI+1) and (lJ+1,lI), described by the
+	///		inward unit normals of its great circle edges and the normals
+	///		of the great circles joining midpoints of opposite edges.
+	///	</summary>
+	struct Quad {
+		long lJ;
+		long lI;
+		bool fValid;
+		double dEdge[4][3];
+		double dMid[2][3];
+	};
+
+	///	<summary>
+	///		Build quadrilateral (lJ,lI).
+	///	</summary>
+	void BuildQuad(
+		long lJ,
+		long lI,
+		Quad & quad
+	) const;
+
+	///	<summary>
+	///		Locate the point dP (unit vector) relative to a quadrilateral.
+	///	</summary>
+	///	<returns>
+	///		(-1) if the point is inside the quadrilateral, in which case
+	///		iCorner is set to the nearest corner in logical coordinates;
+	///		0 through 3 for the edge beyond which the point lies furthest;
+	///		or 4 if the quadrilateral is invalid.
+	///	</returns>
+	int LocateInQuad(
+		const Quad & quad,
+		const double * dP,
+		int & iCorner
+	) const;
+
+	///	<summary>
+	///		Walk from the given quadrilateral towards the point dP until
+	///		the quadrilateral containing it is found.
+	///	</summary>
+	///	<returns>
+	///		false if the walk left the grid, reached an invalid
+	///		quadrilateral or did not finish within sMaxSteps.
+	///	</returns>
+	bool Walk(
+		const double * dP,
+		Quad & quad,
+		int & iCorner,
+		size_t sMaxSteps
+	) const;
+
+	///	<summary>
+	///		Locate the point dP (unit vector) with coordinates (dLon, dLat),
+	///		walking from quad if fHaveQuad is set.
+	///	</summary>
+	///	<returns>
+	///		The index of the center, or 0 if the point is outside the grid.
+	///	</returns>
+	int LocatePoint(
+		const double * dP,
+		double dLon,
+		double dLat,
+		Quad & quad,
+		bool & fHaveQuad,
+		QuadTree::Cursor & cursor
+	) const;
+
+	///	<summary>
+	///		Sample at a set of points.
+	///	</summary>
+	virtual void SamplePoints(
+		const double * pLon,
+		const double * pLat,
+		size_t sPoints,
+		int * pImageMap
+	) const;
+
+	///	<summary>
+	///		Sample one row of the tensor product, walking along the row.
+	///	</summary>
+	virtual void SampleRow(
+		const double * pLon,
+		const double * pSinLon,
+		const double * pCosLon,
+		double dLat,
+		size_t sPoints,
+		int * pImageMap
+	) const;
+
+public:
+	///	<summary>
+	///		Number of rows of grid centers.
+	///	</summary>
+	size_t m_sNy;
+
+	///	<summary>
+	///		Number of columns of grid centers.
+	///	</summary>
+	size_t m_sNx;
+
+	///	<summary>
+	///		3D Cartesian coordinates of the (m_sNy+2) x (m_sNx+2) nodes of
+	///		the extended grid, or NaN for missing centers.
+	///	</summary>
+	std::vector<double> m_dNodeXYZ;
+
+	///	<summary>
+	///		QuadTree of a subset of centers, used to seed each walk.
+	///	</summary>
+	QuadTree m_quadtree;
+
+	///	<summary>
+	///		Center of a spherical cap containing the extended grid.
+	///	</summary>
+	double m_dCapCenter[3];
+
+	///	<summary>
+	///		Cosine of the angular radius of the cap.
+	///	</summary>
+	double m_dCapCos;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+class GridDataSamplerUsingReducedGaussian : public GridDataSampler {
+
+public:
+	///	<summary>
+	///		Initialize if the points form a reduced (or full) Gaussian
+	///		layout: rows of constant latitude, stored consecutively in
+	///		order of latitude, with each row uniformly spaced around the
+	///		full circle.  Coordinates are in degrees.
+	///	</summary>
+	///	<returns>
+	///		true if the layout was detected, false otherwise.
+	///	</returns>
+	bool Initialize(
+		const std::vector<double> & dLon,
+		const std::vector<double> & dLat,
+		double dFillValue
+	);
+
+	///	<summary>
+	///		Number of latitude rows.
+	///	</summary>
+	size_t GetRowCount() const {
+		return m_dRowLat.size();
+	}
+
+	///	<summary>
+	///		Approximate memory used by this GridDataSampler, in bytes.
+	///	</summary>
+	virtual size_t GetMemoryUsage() const {
+		return
+			  m_dRowLat.capacity() * sizeof(double)
+			+ m_vecRowFirst.capacity() * sizeof(size_t)
+			+ m_vecRowCount.capacity() * sizeof(size_t)
+			+ m_dRowLon0.capacity() * sizeof(double);
+	}
+
+protected:
+	///	<summary>
+	///		Index of the row nearest dLat (in order of increasing latitude).
+	///	</summary>
+	size_t FindRow(
+		double dLat
+	) const;
+
+	///	<summary>
+	///		Sample at a set of points.
+	///	</summary>
+	virtual void SamplePoints(
+		const double * pLon,
+		const double * pLat,
+		size_t sPoints,
+		int * pImageMap
+	) const;
+
+public:
+	///	<summary>
+	///		Latitude of each row, in increasing order.
+	///	</summary>
+	std::vector<double> m_dRowLat;
+
+	///	<summary>
+	///		Index of the first point of each row.
+	///	</summary>
+	std::vector<size_t> m_vecRowFirst;
+
+	///	<summary>
+	///		Number of points in each row.
+	///	</summary>
+	std::vector<size_t> m_vecRowCount;
+
+	///	<summary>
+	///		Longitude of the first point of each row.
+	///	</summary>
+	std::vector<double> m_dRowLon0;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+class GridDataSamplerUsingHEALPix : public GridDataSampler {
+
+public:
+	///	<summary>
+	///		Constructor.
+	///	</summary>
+	GridDataSamplerUsingHEALPix() :
+		m_lNside(0),
+		m_fNested(false)
+	{ }
+
+	///	<summary>
+	///		Initialize if the points are the centers of a complete HEALPix
+	///		grid in RING or NESTED order.  Coordinates are in degrees.
+	///	</summary>
+	///	<returns>
+	///		true if the layout was detected, false otherwise.
+	///	</returns>
+	bool Initialize(
+		const std::vector<double> & dLon,
+		const std::vector<double> & dLat,
+		double dFillValue
+	);
+
+	///	<summary>
+	///		Index of the RING-ordered HEALPix pixel containing a point.
+	///	</summary>
+	static long Ang2PixRing(
+		long lNside,
+		double dLon,
+		double dLat
+	);
+
+	///	<summary>
+	///		Index of the NESTED-ordered HEALPix pixel containing a point;
+	///		lNside must be a power of two.
+	///	</summary>
+	static long Ang2PixNest(
+		long lNside,
+		double dLon,
+		double dLat
+	);
+
+	///	<summary>
+	///		As Ang2PixRing, given the sine of latitude dZ.
+	///	</summary>
+	static long Ang2PixRingZ(
+		long lNside,
+		double dLon,
+		double dZ
+	);
+
+	///	<summary>
+	///		As Ang2PixNest, given the sine of latitude dZ.
+	///	</summary>
+	static long Ang2PixNestZ(
+		long lNside,
+		double dLon,
+		double dZ
+	);
+
+	///	<summary>
+	///		Resolution parameter.
+	///	</summary>
+	long GetNside() const {
+		return m_lNside;
+	}
+
+	///	<summary>
+	///		Check if pixels are in NESTED order.
+	///	</summary>
+	bool IsNested() const {
+		return m_fNested;
+	}
+
+protected:
+	///	<summary>
+	///		Sample at a set of points.
+	///	</summary>
+	virtual void SamplePoints(
+		const double * pLon,
+		const double * pLat,
+		size_t sPoints,
+		int * pImageMap
+	) const;
+
+public:
+	///	<summary>
+	///		Resolution parameter.
+	///	</summary>
+	long m_lNside;
+
+	///	<summary>
+	///		Flag indicating pixels are in NESTED order.
+	///	</summary>
+	bool m_fNested;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // _GRIDDATASAMPLER_H_
+
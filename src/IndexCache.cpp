@@ -0,0 +1,501 @@
+///////////////////////////////////////////////////////////////////////////////
+///
+///	\file    IndexCache.cpp
+///	\author  Paul Ullrich
+///	\version October 16, 2026
+///
+
+#include "IndexCache.h"
+
+#if defined(_WIN32)
+# define WIN32_LEAN_AND_MEAN 1
+# include <windows.h>
+# include <sys/utime.h>
+#else
+# include <dirent.h>
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+# include <utime.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+
+///////////////////////////////////////////////////////////////////////////////
+
+///	<summary>
+///		Identifier at the start of every cache file.
+///	</summary>
+static const char c_szIndexCacheMagic[8] = {'N','C','V','I','S','I','D','X'};
+
+///	<summary>
+///		Version of the cache file format.  Increment whenever the layout
+///		of any serialized index changes.
+///	</summary>
+static const uint32_t c_uIndexCacheVersion = 1;
+
+///////////////////////////////////////////////////////////////////////////////
+
+static inline uint64_t RotL64(uint64_t x, int r) {
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t FMix64(uint64_t k) {
+	k ^= k >> 33;
+	k *= 0xff51afd7ed558ccdULL;
+	k ^= k >> 33;
+	k *= 0xc4ceb9fe1a85ec53ULL;
+	k ^= k >> 33;
+	return k;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// IndexCacheKey
+///////////////////////////////////////////////////////////////////////////////
+
+IndexCacheKey::IndexCacheKey(
+	const std::string & strType
+) :
+	m_strType(strType)
+{
+	m_uHash[0] = 0x9e3779b97f4a7c15ULL;
+	m_uHash[1] = 0x6a09e667f3bcc909ULL;
+	Add(strType.c_str(), strType.length());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void IndexCacheKey::Mix(
+	uint64_t uWord
+) {
+	const uint64_t c1 = 0x87c37b91114253d5ULL;
+	const uint64_t c2 = 0x4cf5ad432745937fULL;
+
+	uint64_t k1 = uWord * c1;
+	k1 = RotL64(k1, 31);
+	k1 *= c2;
+	m_uHash[0] ^= k1;
+	m_uHash[0] = RotL64(m_uHash[0], 27) + m_uHash[1];
+	m_uHash[0] = m_uHash[0] * 5 + 0x52dce729;
+
+	uint64_t k2 = uWord * c2;
+	k2 = RotL64(k2, 33);
+	k2 *= c1;
+	m_uHash[1] ^= k2;
+	m_uHash[1] = RotL64(m_uHash[1], 31) + m_uHash[0];
+	m_uHash[1] = m_uHash[1] * 5 + 0x38495ab5;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void IndexCacheKey::Add(
+	const void * pData,
+	size_t sBytes
+) {
+	const unsigned char * p = static_cast<const unsigned char *>(pData);
+
+	size_t sWords = sBytes / sizeof(uint64_t);
+	for (size_t i = 0; i < sWords; i++) {
+		uint64_t uWord;
+		memcpy(&uWord, p + i * sizeof(uint64_t), sizeof(uint64_t));
+		Mix(uWord);
+	}
+
+	// Remaining bytes and the length, so that blocks of different sizes
+	// never hash identically
+	uint64_t uTail = 0;
+	size_t sTail = sBytes - sWords * sizeof(uint64_t);
+	if (sTail != 0) {
+		memcpy(&uTail, p + sWords * sizeof(uint64_t), sTail);
+	}
+	Mix(uTail);
+	Mix(static_cast<uint64_t>(sBytes));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+std::string IndexCacheKey::ToString() const {
+	static const char szHex[] = "0123456789abcdef";
+
+	uint64_t h1 = m_uHash[0];
+	uint64_t h2 = m_uHash[1];
+	h1 += h2;
+	h2 += h1;
+	h1 = FMix64(h1);
+	h2 = FMix64(h2);
+	h1 += h2;
+	h2 += h1;
+
+	std::string str = m_strType + "-";
+	for (int i = 60; i >= 0; i -= 4) {
+		str += szHex[(h1 >> i) & 0xf];
+	}
+	for (int i = 60; i >= 0; i -= 4) {
+		str += szHex[(h2 >> i) & 0xf];
+	}
+	return str;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// IndexCacheWriter
+///////////////////////////////////////////////////////////////////////////////
+
+IndexCacheWriter::IndexCacheWriter(
+	const std::string & strFilename,
+	const IndexCacheKey & key
+) :
+	m_strFilename(strFilename),
+	m_fp(NULL),
+	m_sOffset(0)
+{
+#if defined(_WIN32)
+	unsigned long ulPid = static_cast<unsigned long>(GetCurrentProcessId());
+#else
+	unsigned long ulPid = static_cast<unsigned long>(getpid());
+#endif
+	char szPid[32];
+	snprintf(szPid, sizeof(szPid), ".%lu.tmp", ulPid);
+	m_strTempFilename = strFilename + szPid;
+
+	m_fp = fopen(m_strTempFilename.c_str(), "wb");
+	if (m_fp == NULL) {
+		return;
+	}
+
+	std::string strKey = key.ToString();
+	uint32_t uKeyLength = static_cast<uint32_t>(strKey.length());
+
+	Write(c_szIndexCacheMagic, sizeof(c_szIndexCacheMagic));
+	WriteValue(c_uIndexCacheVersion);
+	WriteValue(uKeyLength);
+	Write(strKey.c_str(), strKey.length());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+IndexCacheWriter::~IndexCacheWriter() {
+	if (m_fp != NULL) {
+		fclose(m_fp);
+		remove(m_strTempFilename.c_str());
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void IndexCacheWriter::Write(
+	const void * pData,
+	size_t sBytes
+) {
+	if (m_fp == NULL) {
+		return;
+	}
+	if (fwrite(pData, 1, sBytes, m_fp) != sBytes) {
+		fclose(m_fp);
+		remove(m_strTempFilename.c_str());
+		m_fp = NULL;
+		return;
+	}
+	m_sOffset += sBytes;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void IndexCacheWriter::Align(
+	size_t sAlignment
+) {
+	static const char szZeros[256] = {0};
+
+	size_t sPad = (sAlignment - m_sOffset % sAlignment) % sAlignment;
+	while ((sPad != 0) && (m_fp != NULL)) {
+		size_t sBytes = std::min(sPad, sizeof(szZeros));
+		Write(szZeros, sBytes);
+		sPad -= sBytes;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool IndexCacheWriter::Commit() {
+	if (m_fp == NULL) {
+		return false;
+	}
+
+	int iCloseResult = fclose(m_fp);
+	m_fp = NULL;
+
+	if (iCloseResult != 0) {
+		remove(m_strTempFilename.c_str());
+		return false;
+	}
+
+#if defined(_WIN32)
+	remove(m_strFilename.c_str());
+#endif
+	if (rename(m_strTempFilename.c_str(), m_strFilename.c_str()) != 0) {
+		remove(m_strTempFilename.c_str());
+		return false;
+	}
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// IndexCacheReader
+///////////////////////////////////////////////////////////////////////////////
+
+IndexCacheReader::IndexCacheReader(
+	const std::string & strFilename,
+	const IndexCacheKey & key
+) :
+	m_pData(NULL),
+	m_sSize(0),
+	m_sOffset(0)
+{
+#if defined(_WIN32)
+	HANDLE hFile =
+		CreateFileA(strFilename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+			NULL, OPEN_EXISTING, 0, NULL);
+	if (hFile == INVALID_HANDLE_VALUE) {
+		return;
+	}
+	LARGE_INTEGER liSize;
+	if (!GetFileSizeEx(hFile, &liSize) || (liSize.QuadPart == 0)) {
+		CloseHandle(hFile);
+		return;
+	}
+	HANDLE hMapping =
+		CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(hFile);
+	if (hMapping == NULL) {
+		return;
+	}
+	const void * pMap = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(hMapping);
+	if (pMap == NULL) {
+		return;
+	}
+	m_sSize = static_cast<size_t>(liSize.QuadPart);
+#else
+	int fd = open(strFilename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return;
+	}
+	struct stat info;
+	if ((fstat(fd, &info) < 0) || (info.st_size <= 0)) {
+		close(fd);
+		return;
+	}
+	void * pMap =
+		mmap(NULL, static_cast<size_t>(info.st_size),
+			PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (pMap == MAP_FAILED) {
+		return;
+	}
+	m_sSize = static_cast<size_t>(info.st_size);
+#endif
+	m_pData = static_cast<const char *>(pMap);
+
+	// Verify the header
+	char szMagic[sizeof(c_szIndexCacheMagic)];
+	uint32_t uVersion;
+	uint32_t uKeyLength;
+	if (!Read(szMagic, sizeof(szMagic))) {
+		return;
+	}
+	if (memcmp(szMagic, c_szIndexCacheMagic, sizeof(szMagic)) != 0) {
+		Invalidate();
+		return;
+	}
+	if (!ReadValue(uVersion) || !ReadValue(uKeyLength)) {
+		return;
+	}
+	std::string strKey = key.ToString();
+	if ((uVersion != c_uIndexCacheVersion) ||
+	    (uKeyLength != strKey.length()) ||
+	    (m_sSize - m_sOffset < uKeyLength) ||
+	    (memcmp(m_pData + m_sOffset, strKey.c_str(), uKeyLength) != 0)
+	) {
+		Invalidate();
+		return;
+	}
+	m_sOffset += uKeyLength;
+
+	// Mark the file as recently used so TrimIndexCache keeps it
+#if defined(_WIN32)
+	_utime(strFilename.c_str(), NULL);
+#else
+	utime(strFilename.c_str(), NULL);
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+IndexCacheReader::~IndexCacheReader() {
+	Invalidate();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void IndexCacheReader::Invalidate() {
+	if (m_pData == NULL) {
+		return;
+	}
+#if defined(_WIN32)
+	UnmapViewOfFile(m_pData);
+#else
+	munmap(const_cast<char *>(m_pData), m_sSize);
+#endif
+	m_pData = NULL;
+	m_sSize = 0;
+	m_sOffset = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool IndexCacheReader::Read(
+	void * pData,
+	size_t sBytes
+) {
+	if (m_pData == NULL) {
+		return false;
+	}
+	if (sBytes > m_sSize - m_sOffset) {
+		Invalidate();
+		return false;
+	}
+	memcpy(pData, m_pData + m_sOffset, sBytes);
+	m_sOffset += sBytes;
+	return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+const void * IndexCacheReader::Map(
+	size_t sBytes
+) {
+	if (m_pData == NULL) {
+		return NULL;
+	}
+	if (sBytes > m_sSize - m_sOffset) {
+		Invalidate();
+		return NULL;
+	}
+	const void * p = m_pData + m_sOffset;
+	m_sOffset += sBytes;
+	return p;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool IndexCacheReader::Align(
+	size_t sAlignment
+) {
+	size_t sPad = (sAlignment - m_sOffset % sAlignment) % sAlignment;
+	return (Map(sPad) != NULL);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void IndexCacheReader::AdviseRandom() {
+	if (m_pData == NULL) {
+		return;
+	}
+#if !defined(_WIN32)
+	madvise(const_cast<char *>(m_pData), m_sSize, MADV_RANDOM);
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// TrimIndexCache
+///////////////////////////////////////////////////////////////////////////////
+
+void TrimIndexCache(
+	const std::string & strDir,
+	size_t sMaxBytes
+) {
+	struct CacheFile {
+		std::string strFilename;
+		int64_t iModified;
+		size_t sBytes;
+
+		bool operator<(const CacheFile & file) const {
+			return (iModified < file.iModified);
+		}
+	};
+
+	static const std::string strSuffix(".idx");
+
+	std::vector<CacheFile> vecFiles;
+	size_t sTotalBytes = 0;
+
+#if defined(_WIN32)
+	WIN32_FIND_DATAA data;
+	HANDLE hFind = FindFirstFileA((strDir + "/*.idx").c_str(), &data);
+	if (hFind == INVALID_HANDLE_VALUE) {
+		return;
+	}
+	do {
+		if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+			continue;
+		}
+		CacheFile file;
+		file.strFilename = strDir + "/" + data.cFileName;
+		file.iModified =
+			(static_cast<int64_t>(data.ftLastWriteTime.dwHighDateTime) << 32)
+			| static_cast<int64_t>(data.ftLastWriteTime.dwLowDateTime);
+		file.sBytes =
+			(static_cast<size_t>(data.nFileSizeHigh) << 32)
+			| static_cast<size_t>(data.nFileSizeLow);
+		vecFiles.push_back(file);
+		sTotalBytes += file.sBytes;
+	} while (FindNextFileA(hFind, &data));
+	FindClose(hFind);
+#else
+	DIR * pDir = opendir(strDir.c_str());
+	if (pDir == NULL) {
+		return;
+	}
+	struct dirent * pEntry;
+	while ((pEntry = readdir(pDir)) != NULL) {
+		std::string strName(pEntry->d_name);
+		if ((strName.length() <= strSuffix.length()) ||
+		    (strName.compare(strName.length() - strSuffix.length(), strSuffix.length(), strSuffix) != 0)
+		) {
+			continue;
+		}
+		CacheFile file;
+		file.strFilename = strDir + "/" + strName;
+
+		struct stat info;
+		if ((stat(file.strFilename.c_str(), &info) != 0) || !S_ISREG(info.st_mode)) {
+			continue;
+		}
+		file.iModified = static_cast<int64_t>(info.st_mtime);
+		file.sBytes = static_cast<size_t>(info.st_size);
+		vecFiles.push_back(file);
+		sTotalBytes += file.sBytes;
+	}
+	closedir(pDir);
+#endif
+
+	if (sTotalBytes <= sMaxBytes) {
+		return;
+	}
+
+	// Remove the oldest files first; an index that is currently mapped
+	// remains valid until it is unmapped
+	std::sort(vecFiles.begin(), vecFiles.end());
+
+	for (size_t i = 0; (i < vecFiles.size()) && (sTotalBytes > sMaxBytes); i++) {
+		if (remove(vecFiles[i].strFilename.c_str()) == 0) {
+			sTotalBytes -= vecFiles[i].sBytes;
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
@@ -0,0 +1,331 @@
+///////////////////////////////////////////////////////////////////////////////
+///
+///	\file    IndexCache.h
+///	\author  Paul Ullrich
+///	\version October 16, 2026
+///
+
+#ifndef _INDEXCACHE_H_
+#define _INDEXCACHE_H_
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstddef>
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+///	<summary>
+///		A 128-bit hash identifying a sampler index, computed from the
+///		sampler type and everything the index is built from.
+///	</summary>
+class IndexCacheKey {
+
+public:
+	///	<summary>
+	///		Constructor.
+	///	</summary>
+	IndexCacheKey(
+		const std::string & strType
+	);
+
+	///	<summary>
+	///		Add a block of memory to the key.
+	///	</summary>
+	void Add(
+		const void * pData,
+		size_t sBytes
+	);
+
+	///	<summary>
+	///		Add a value to the key.
+	///	</summary>
+	void Add(
+		double dValue
+	) {
+		Add(&dValue, sizeof(double));
+	}
+
+	///	<summary>
+	///		Add an array to the key.
+	///	</summary>
+	void Add(
+		const std::vector<double> & vecValues
+	) {
+		const uint64_t uSize = vecValues.size();
+		Add(&uSize, sizeof(uint64_t));
+		if (uSize != 0) {
+			Add(&(vecValues[0]), uSize * sizeof(double));
+		}
+	}
+
+	///	<summary>
+	///		Hexadecimal representation of the key, prefixed by the type.
+	///	</summary>
+	std::string ToString() const;
+
+protected:
+	///	<summary>
+	///		Mix one word into the hash.
+	///	</summary>
+	void Mix(
+		uint64_t uWord
+	);
+
+protected:
+	///	<summary>
+	///		Sampler type.
+	///	</summary>
+	std::string m_strType;
+
+	///	<summary>
+	///		Hash state.
+	///	</summary>
+	uint64_t m_uHash[2];
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+///	<summary>
+///		Writes a sampler index to the cache.  Data is written to a
+///		temporary file which replaces the cache file on Commit(), so that
+///		an interrupted write never leaves a partial index behind.
+///	</summary>
+class IndexCacheWriter {
+
+public:
+	///	<summary>
+	///		Constructor.
+	///	</summary>
+	IndexCacheWriter(
+		const std::string & strFilename,
+		const IndexCacheKey & key
+	);
+
+	///	<summary>
+	///		Destructor.  Removes the temporary file if not committed.
+	///	</summary>
+	~IndexCacheWriter();
+
+	///	<summary>
+	///		Check if all writes so far have succeeded.
+	///	</summary>
+	bool IsValid() const {
+		return (m_fp != NULL);
+	}
+
+	///	<summary>
+	///		Write a block of memory.
+	///	</summary>
+	void Write(
+		const void * pData,
+		size_t sBytes
+	);
+
+	///	<summary>
+	///		Write a value of plain type.
+	///	</summary>
+	template <typename T>
+	void WriteValue(
+		const T & value
+	) {
+		Write(&value, sizeof(T));
+	}
+
+	///	<summary>
+	///		Write an array of plain type, preceded by its size.
+	///	</summary>
+	template <typename T>
+	void WriteVector(
+		const std::vector<T> & vec
+	) {
+		const uint64_t uSize = vec.size();
+		WriteValue(uSize);
+		if (uSize != 0) {
+			Write(&(vec[0]), uSize * sizeof(T));
+		}
+	}
+
+	///	<summary>
+	///		Write zeros up to the next multiple of sAlignment bytes from
+	///		the start of the file.
+	///	</summary>
+	void Align(
+		size_t sAlignment
+	);
+
+	///	<summary>
+	///		Number of bytes written so far, including the header.
+	///	</summary>
+	size_t Tell() const {
+		return m_sOffset;
+	}
+
+	///	<summary>
+	///		Close the file and move it into place.
+	///	</summary>
+	bool Commit();
+
+protected:
+	///	<summary>
+	///		Name of the cache file.
+	///	</summary>
+	std::string m_strFilename;
+
+	///	<summary>
+	///		Name of the temporary file.
+	///	</summary>
+	std::string m_strTempFilename;
+
+	///	<summary>
+	///		Temporary file, or NULL on error.
+	///	</summary>
+	FILE * m_fp;
+
+	///	<summary>
+	///		Number of bytes written.
+	///	</summary>
+	size_t m_sOffset;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+///	<summary>
+///		Reads a sampler index from the cache.  The cache file is memory
+///		mapped and arrays are copied directly out of the mapping.
+///	</summary>
+class IndexCacheReader {
+
+public:
+	///	<summary>
+	///		Constructor.  The reader is invalid if the file does not exist
+	///		or was written with a different key or format.
+	///	</summary>
+	IndexCacheReader(
+		const std::string & strFilename,
+		const IndexCacheKey & key
+	);
+
+	///	<summary>
+	///		Destructor.
+	///	</summary>
+	~IndexCacheReader();
+
+	///	<summary>
+	///		Check if all reads so far have succeeded.
+	///	</summary>
+	bool IsValid() const {
+		return (m_pData != NULL);
+	}
+
+	///	<summary>
+	///		Check if all data has been read.
+	///	</summary>
+	bool IsComplete() const {
+		return (IsValid() && (m_sOffset == m_sSize));
+	}
+
+	///	<summary>
+	///		Read a block of memory.
+	///	</summary>
+	bool Read(
+		void * pData,
+		size_t sBytes
+	);
+
+	///	<summary>
+	///		Read a value of plain type.
+	///	</summary>
+	template <typename T>
+	bool ReadValue(
+		T & value
+	) {
+		return Read(&value, sizeof(T));
+	}
+
+	///	<summary>
+	///		Read an array of plain type, preceded by its size.
+	///	</summary>
+	template <typename T>
+	bool ReadVector(
+		std::vector<T> & vec
+	) {
+		uint64_t uSize;
+		if (!ReadValue(uSize)) {
+			return false;
+		}
+		if (uSize > (m_sSize - m_sOffset) / sizeof(T)) {
+			Invalidate();
+			return false;
+		}
+		vec.resize(uSize);
+		if (uSize != 0) {
+			return Read(&(vec[0]), uSize * sizeof(T));
+		}
+		return true;
+	}
+
+	///	<summary>
+	///		Get a pointer to sBytes of mapped data and advance past it, or
+	///		NULL if the file is too short.  The pointer remains valid for
+	///		the lifetime of the reader.
+	///	</summary>
+	const void * Map(
+		size_t sBytes
+	);
+
+	///	<summary>
+	///		Advance to the next multiple of sAlignment bytes from the
+	///		start of the file.
+	///	</summary>
+	bool Align(
+		size_t sAlignment
+	);
+
+	///	<summary>
+	///		Advise the operating system that mapped data will be accessed
+	///		in random order, so pages are not read ahead.
+	///	</summary>
+	void AdviseRandom();
+
+protected:
+	///	<summary>
+	///		Unmap the file and mark the reader invalid.
+	///	</summary>
+	void Invalidate();
+
+protected:
+	///	<summary>
+	///		Mapped file contents, or NULL.
+	///	</summary>
+	const char * m_pData;
+
+	///	<summary>
+	///		Size of the mapping.
+	///	</summary>
+	size_t m_sSize;
+
+	///	<summary>
+	///		Current read offset.
+	///	</summary>
+	size_t m_sOffset;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+///	<summary>
+///		Remove the least recently used index files from the cache
+///		directory strDir until the files remaining total no more than
+///		sMaxBytes.  Files are ordered by modification time, which is
+///		updated whenever an index is read from the cache.
+///	</summary>
+void TrimIndexCache(
+	const std::string & strDir,
+	size_t sMaxBytes
+);
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // _INDEXCACHE_H_
+
@@ -9,12 +9,28 @@
 #define _QUADTREE_H_
 
 #include "Exception.h"
+#include "Announce.h"
+#include "ThreadPool.h"
+#include "IndexCache.h"
 
+#include <vector>
+#include <algorithm>
 #include <cmath>
+#include <cstddef>
+#include <stdint.h>
 
 ///////////////////////////////////////////////////////////////////////////////
 
-class QuadTreeNode {
+///	<summary>
+///		A pointer-free quadtree.  All nodes are stored contiguously in a
+///		single pool and refer to their children by 32-bit offset.  Points
+///		are stored in leaf buckets of up to QUADTREE_BUCKET_SIZE entries
+///		as single-precision coordinates.  Points are first collected with
+///		insert() and the tree is then constructed with build(), which
+///		sorts all points by Morton (Z-order) key so that every node
+///		covers a contiguous range of the sorted points.
+///	</summary>
+class QuadTree {
 
 public:
 	///	<summary>
@@ -22,159 +38,850 @@ public:
 	///	</summary>
 	static const int QUADTREE_MAX_LEVELS = 32;
 
+	///	<summary>
+	///		Maximum number of points in a leaf (unless at maximum depth).
+	///	</summary>
+	static const uint32_t QUADTREE_BUCKET_SIZE = 8;
+
+	///	<summary>
+	///		Value of Node::count used to identify an internal node.
+	///	</summary>
+	static const uint32_t QUADTREE_INTERNAL_NODE = static_cast<uint32_t>(-1);
+
+	///	<summary>
+	///		A node of the QuadTree.  For internal nodes first is the offset
+	///		of the first of four contiguous child nodes.  For leaf nodes
+	///		first is the offset of the first point in the bucket and count
+	///		is the number of points in the bucket.
+	///	</summary>
+	struct Node {
+		uint32_t first;
+		uint32_t count;
+
+		bool is_leaf() const {
+			return (count != QUADTREE_INTERNAL_NODE);
+		}
+
+		bool is_empty() const {
+			return (count == 0);
+		}
+	};
+
+	///	<summary>
+	///		A point index paired with its Morton key.
+	///	</summary>
+	struct MortonKey {
+		uint64_t key;
+		uint32_t index;
+
+		bool operator<(const MortonKey & mk) const {
+			if (key != mk.key) {
+				return (key < mk.key);
+			}
+			return (index < mk.index);
+		}
+	};
+
+	///	<summary>
+	///		A cursor for coherent traversal of the QuadTree.  The cursor
+	///		stores the path to the leaf found by the previous query, so
+	///		that the next query can start from the deepest node on that
+	///		path that also contains the new query point.  A cursor may only
+	///		be used with one QuadTree and by one thread at a time.
+	///	</summary>
+	struct Cursor {
+		///	<summary>
+		///		Constructor.
+		///	</summary>
+		Cursor() :
+			levels(-1),
+			exact(-1),
+			xi(0),
+			yi(0)
+		{ }
+
+		///	<summary>
+		///		Reset the cursor so the next query starts at the root.
+		///	</summary>
+		void reset() {
+			levels = (-1);
+			exact = (-1);
+		}
+
+		///	<summary>
+		///		Node offset at each level of the path.
+		///	</summary>
+		uint32_t path[QUADTREE_MAX_LEVELS + 1];
+
+		///	<summary>
+		///		Deepest level of the path (-1 if the path is empty).
+		///	</summary>
+		int levels;
+
+		///	<summary>
+		///		Deepest level of the path that is determined by the leading
+		///		bits of (xi, yi) alone, i.e. reached without falling back
+		///		to a sibling of an empty quadrant.
+		///	</summary>
+		int exact;
+
+		///	<summary>
+		///		Quantized X coordinate of the path.
+		///	</summary>
+		uint32_t xi;
+
+		///	<summary>
+		///		Quantized Y coordinate of the path.
+		///	</summary>
+		uint32_t yi;
+	};
+
 public:
 	///	<summary>
 	///		Constructor.
 	///	</summary>
-	QuadTreeNode(
+	QuadTree(
 		double dX0 = 0.0,
 		double dX1 = 360.0,
 		double dY0 = -180.0,
-		double dY1 = 180.0,
-		int iLevel = 0
+		double dY1 = 180.0
 	) :
 		m_dX0(dX0),
+		m_dX1(dX1),
 		m_dY0(dY0),
-		m_iLevel(iLevel)
+		m_dY1(dY1),
+		m_fBuilt(false),
+		m_iProgressBegin(-1),
+		m_iProgressEnd(-1),
+		m_iProgressLast(-1)
 	{
-		m_dXdelta = 0.5 * (dX1 - dX0);
-		m_dYdelta = 0.5 * (dY1 - dY0);
+		_ASSERT(dX1 > dX0);
+		_ASSERT(dY1 > dY0);
 
-		for (size_t i = 0; i < 4; i++) {
-			m_dXcoord[i] = 0.0;
-			m_dYcoord[i] = 0.0;
-			m_sIndex[i] = static_cast<size_t>(-1);
-			m_pChildren[i] = NULL;
-		}
+		m_dXscale = 4294967296.0 / (dX1 - dX0);
+		m_dYscale = 4294967296.0 / (dY1 - dY0);
 	}
 
 	///	<summary>
-	///		Destructor.
+	///		Delete all nodes and points in this QuadTree.
 	///	</summary>
-	~QuadTreeNode() {
-		clear();
+	void clear() {
+		std::vector<Node>().swap(m_vecNodes);
+		std::vector<float>().swap(m_vecX);
+		std::vector<float>().swap(m_vecY);
+		std::vector<uint32_t>().swap(m_vecIndex);
+		m_fBuilt = false;
 	}
 
 	///	<summary>
-	///		Delete all children of this QuadTreeNode.
+	///		Reserve space for the given number of points.
 	///	</summary>
-	void clear() {
-		for (int i = 0; i < 4; i++) {
-			if (m_pChildren[i] != NULL) {
-				delete m_pChildren[i];
-				m_pChildren[i] = NULL;
-			}
-		}
+	void reserve(
+		size_t sPoints
+	) {
+		m_vecX.reserve(sPoints);
+		m_vecY.reserve(sPoints);
+		m_vecIndex.reserve(sPoints);
+	}
+
+	///	<summary>
+	///		Number of points in the quadtree.
+	///	</summary>
+	size_t size() const {
+		return m_vecIndex.size();
+	}
+
+	///	<summary>
+	///		Number of nodes in the quadtree.
+	///	</summary>
+	size_t node_count() const {
+		return m_vecNodes.size();
+	}
+
+	///	<summary>
+	///		Memory used by the quadtree, in bytes.
+	///	</summary>
+	size_t memory_usage() const {
+		return
+			  m_vecNodes.capacity() * sizeof(Node)
+			+ m_vecX.capacity() * sizeof(float)
+			+ m_vecY.capacity() * sizeof(float)
+			+ m_vecIndex.capacity() * sizeof(uint32_t);
 	}
 
 	///	<summary>
-	///		Insert a point into the quadtree.
+	///		Add a point to the quadtree.  The point is not searchable
+	///		until build() is called.
 	///	</summary>
-	int insert(
+	void insert(
 		double dX,
 		double dY,
 		size_t sI
 	) {
-		size_t sXi = static_cast<size_t>((dX - m_dX0) / m_dXdelta);
-		size_t sYi = static_cast<size_t>((dY - m_dY0) / m_dYdelta);
-
-		if (sXi >= 2) {
-			if (fabs(dX - m_dX0 - 2.0 * m_dXdelta) < 1.0e-5) {
-				sXi = 1;
-			} else {
-				_EXCEPTION4("ERROR: QuadTree insertion out of range %lu %f %f %f\n",
-					sXi, dX, m_dX0, m_dXdelta);
-			}
+		if ((dX < m_dX0 - 1.0e-5) || (dX > m_dX1 + 1.0e-5)) {
+			_EXCEPTION3("ERROR: QuadTree insertion out of range %f [%f %f]\n",
+				dX, m_dX0, m_dX1);
 		}
-		if (sYi >= 2) {
-			if (fabs(dY - m_dY0 - 2.0 * m_dYdelta) < 1.0e-5) {
-				sYi = 1;
-			} else {
-				_EXCEPTION4("ERROR: QuadTree insertion out of range %lu %f %f %f\n",
-					sYi, dY, m_dY0, m_dYdelta);
-			}
+		if ((dY < m_dY0 - 1.0e-5) || (dY > m_dY1 + 1.0e-5)) {
+			_EXCEPTION3("ERROR: QuadTree insertion out of range %f [%f %f]\n",
+				dY, m_dY0, m_dY1);
+		}
+		if (sI >= static_cast<size_t>(QUADTREE_INTERNAL_NODE)) {
+			_EXCEPTION1("ERROR: QuadTree index out of range %lu\n", sI);
 		}
 
-		const size_t sIx = 2 * sYi + sXi;
+		m_vecX.push_back(static_cast<float>(dX));
+		m_vecY.push_back(static_cast<float>(dY));
+		m_vecIndex.push_back(static_cast<uint32_t>(sI));
+		m_fBuilt = false;
+	}
 
-		if (m_pChildren[sIx] != NULL) {
-			return (m_pChildren[sIx]->insert(dX, dY, sI) + 1);
+	///	<summary>
+	///		Report the progress of build() with AnnounceProgress, as a
+	///		percentage from iBegin to iEnd.  Disabled if iBegin is negative.
+	///	</summary>
+	void set_build_progress(
+		int iBegin,
+		int iEnd
+	) {
+		m_iProgressBegin = iBegin;
+		m_iProgressEnd = iEnd;
+		m_iProgressLast = (-1);
+	}
 
-		} else if (m_sIndex[sIx] == static_cast<size_t>(-1)) {
-			m_dXcoord[sIx] = dX;
-			m_dYcoord[sIx] = dY;
-			m_sIndex[sIx] = sI;
-			return 0;
+	///	<summary>
+	///		Build the quadtree from all inserted points.  Morton keys are
+	///		computed and sorted in parallel if a ThreadPool is given, and
+	///		nodes are then built bottom-up in one pass over the sorted keys.
+	///		Returns the maximum level of the tree, expressed as the level a
+	///		point would have been stored at in a tree with one point per
+	///		quadrant.
+	///	</summary>
+	int build(
+		ThreadPool * pThreadPool = NULL
+	) {
+		const size_t sPoints = m_vecIndex.size();
 
-		} else if (m_iLevel != QUADTREE_MAX_LEVELS) {
-			m_pChildren[sIx] =
-				new QuadTreeNode(
-					m_dX0 + static_cast<double>(sXi) * m_dXdelta,
-					m_dX0 + static_cast<double>(sXi+1) * m_dXdelta,
-					m_dY0 + static_cast<double>(sYi) * m_dYdelta,
-					m_dY0 + static_cast<double>(sYi+1) * m_dYdelta,
-					m_iLevel + 1);
+		std::vector<Node>().swap(m_vecNodes);
+		m_vecNodes.reserve(sPoints / (QUADTREE_BUCKET_SIZE / 2) + 1);
 
-			m_pChildren[sIx]->insert(m_dXcoord[sIx], m_dYcoord[sIx], m_sIndex[sIx]);
+		// Compute Morton keys of all points
+		std::vector<MortonKey> vecKeys(sPoints);
 
-			return (m_pChildren[sIx]->insert(dX, dY, sI) + 1);
+		parallel_for(pThreadPool, sPoints,
+			[&](size_t sBegin, size_t sEnd) {
+				for (size_t i = sBegin; i < sEnd; i++) {
+					vecKeys[i].key =
+						morton_key(quantize_x(m_vecX[i]), quantize_y(m_vecY[i]));
+					vecKeys[i].index = static_cast<uint32_t>(i);
+				}
+			});
+
+		report_build_progress(0.1);
+
+		// Sort by Morton key; ties are broken by insertion order
+		parallel_sort(pThreadPool, vecKeys);
+
+		report_build_progress(0.6);
+
+		// Reorder points into sorted order
+		{
+			std::vector<float> vecTempX(sPoints);
+			std::vector<float> vecTempY(sPoints);
+			std::vector<uint32_t> vecTempIndex(sPoints);
+
+			parallel_for(pThreadPool, sPoints,
+				[&](size_t sBegin, size_t sEnd) {
+					for (size_t i = sBegin; i < sEnd; i++) {
+						const uint32_t p = vecKeys[i].index;
+						vecTempX[i] = m_vecX[p];
+						vecTempY[i] = m_vecY[p];
+						vecTempIndex[i] = m_vecIndex[p];
+					}
+				});
+
+			m_vecX.swap(vecTempX);
+			m_vecY.swap(vecTempY);
+			m_vecIndex.swap(vecTempIndex);
 		}
 
-		return 0;
+		report_build_progress(0.7);
+
+		// Build nodes over the sorted points
+		int iMaxLevel = build_nodes(vecKeys);
+
+		std::vector<Node>(m_vecNodes).swap(m_vecNodes);
+
+		m_fBuilt = true;
+
+		return iMaxLevel;
 	}
 
 	///	<summary>
 	///		Inquire about closest point in quadtree, using inexact search.
+	///		The search descends to the leaf containing the query point and
+	///		returns the closest point in that leaf.  If the leaf is empty
+	///		the closest non-empty sibling is searched instead.
 	///	</summary>
 	size_t find_inexact(
 		double dX,
 		double dY,
 		double & dXref,
 		double & dYref
+	) const {
+		Cursor cursor;
+		return find_inexact(dX, dY, dXref, dYref, cursor);
+	}
+
+	///	<summary>
+	///		Inquire about closest point in quadtree, using inexact search
+	///		starting from the deepest node of the cursor path that contains
+	///		the query point.  The result is identical to a search from the
+	///		root.  On return the cursor holds the path to the leaf found.
+	///	</summary>
+	size_t find_inexact(
+		double dX,
+		double dY,
+		double & dXref,
+		double & dYref,
+		Cursor & cursor
 	) const {
 		static const int s_iLookup[4][3] = {{2,1,3}, {0,3,2}, {3,0,1}, {1,2,0}};
 
-		int iX = static_cast<int>((dX - m_dX0) / m_dXdelta);
-		int iY = static_cast<int>((dY - m_dY0) / m_dYdelta);
+		_ASSERT(m_fBuilt);
+
+		uint32_t uXi = quantize_x(dX);
+		uint32_t uYi = quantize_y(dY);
+
+		// Find the deepest node of the cursor path containing this point
+		int iLevel = 0;
+		if (cursor.levels >= 0) {
+			iLevel = std::min(
+				leading_zeros(uXi ^ cursor.xi),
+				leading_zeros(uYi ^ cursor.yi));
+			iLevel = std::min(iLevel, std::min(cursor.exact, cursor.levels));
+		} else {
+			cursor.path[0] = 0;
+		}
+
+		cursor.xi = uXi;
+		cursor.yi = uYi;
+		cursor.exact = (-1);
+
+		uint32_t uNode = cursor.path[iLevel];
+
+		while (!m_vecNodes[uNode].is_leaf()) {
+			const uint32_t uBit = static_cast<uint32_t>(1) << (31 - iLevel);
+			const uint32_t uMask = uBit - 1;
+
+			int iQuad = ((uYi & uBit) ? 2 : 0) + ((uXi & uBit) ? 1 : 0);
+			uint32_t uChild = m_vecNodes[uNode].first + iQuad;
+
+			if (m_vecNodes[uChild].is_empty()) {
+				int k = 0;
+				for (; k < 3; k++) {
+					const int iNeighbor = s_iLookup[iQuad][k];
+					if (!m_vecNodes[m_vecNodes[uNode].first + iNeighbor].is_empty()) {
+						break;
+					}
+				}
+				_ASSERT(k != 3);
+
+				// Deeper nodes are no longer determined by the query point
+				if (cursor.exact == (-1)) {
+					cursor.exact = iLevel;
+				}
+
+				// Clamp the query point to the closest edge of the neighbor
+				const int iNeighbor = s_iLookup[iQuad][k];
+				if ((iNeighbor & 1) > (iQuad & 1)) {
+					uXi = (uXi | uBit) & ~uMask;
+				} else if ((iNeighbor & 1) < (iQuad & 1)) {
+					uXi = (uXi & ~uBit) | uMask;
+				}
+				if ((iNeighbor & 2) > (iQuad & 2)) {
+					uYi = (uYi | uBit) & ~uMask;
+				} else if ((iNeighbor & 2) < (iQuad & 2)) {
+					uYi = (uYi & ~uBit) | uMask;
+				}
+
+				uChild = m_vecNodes[uNode].first + iNeighbor;
+			}
+
+			uNode = uChild;
+			iLevel++;
+			cursor.path[iLevel] = uNode;
+		}
+
+		cursor.levels = iLevel;
+		if (cursor.exact == (-1)) {
+			cursor.exact = iLevel;
+		}
+
+		const Node & node = m_vecNodes[uNode];
+		if (node.is_empty()) {
+			return static_cast<size_t>(-1);
+		}
+
+		const float flX = static_cast<float>(dX);
+		const float flY = static_cast<float>(dY);
+
+		uint32_t uNearest = node.first;
+		float flNearestDist2 = HUGE_VALF;
+		for (uint32_t i = node.first; i < node.first + node.count; i++) {
+			const float flDX = m_vecX[i] - flX;
+			const float flDY = m_vecY[i] - flY;
+			const float flDist2 = flDX * flDX + flDY * flDY;
+			if (flDist2 < flNearestDist2) {
+				flNearestDist2 = flDist2;
+				uNearest = i;
+			}
+		}
+
+		dXref = static_cast<double>(m_vecX[uNearest]);
+		dYref = static_cast<double>(m_vecY[uNearest]);
+		return static_cast<size_t>(m_vecIndex[uNearest]);
+	}
+
+	///	<summary>
+	///		Initialize the cursor with the path to the smallest node that
+	///		encloses the viewport [dX0, dX1] x [dY0, dY1], so that queries
+	///		within the viewport do not start from the root.
+	///	</summary>
+	void set_viewport(
+		Cursor & cursor,
+		double dX0,
+		double dX1,
+		double dY0,
+		double dY1
+	) const {
+		_ASSERT(m_fBuilt);
+
+		const uint32_t uXi0 = quantize_x(dX0);
+		const uint32_t uXi1 = quantize_x(dX1);
+		const uint32_t uYi0 = quantize_y(dY0);
+		const uint32_t uYi1 = quantize_y(dY1);
+
+		const int iCommonLevels =
+			std::min(
+				leading_zeros(uXi0 ^ uXi1),
+				leading_zeros(uYi0 ^ uYi1));
+
+		int iLevel = 0;
+		uint32_t uNode = 0;
+		cursor.path[0] = 0;
+
+		while ((iLevel < iCommonLevels) && !m_vecNodes[uNode].is_leaf()) {
+			const uint32_t uBit = static_cast<uint32_t>(1) << (31 - iLevel);
+			const int iQuad = ((uYi0 & uBit) ? 2 : 0) + ((uXi0 & uBit) ? 1 : 0);
+			const uint32_t uChild = m_vecNodes[uNode].first + iQuad;
+			if (m_vecNodes[uChild].is_empty()) {
+				break;
+			}
+			uNode = uChild;
+			iLevel++;
+			cursor.path[iLevel] = uNode;
+		}
+
+		cursor.levels = iLevel;
+		cursor.exact = iLevel;
+		cursor.xi = uXi0;
+		cursor.yi = uYi0;
+	}
+
+	///	<summary>
+	///		Write the built quadtree to an index cache.
+	///	</summary>
+	void write(
+		IndexCacheWriter & writer
+	) const {
+		_ASSERT(m_fBuilt);
+
+		writer.WriteValue(m_dX0);
+		writer.WriteValue(m_dX1);
+		writer.WriteValue(m_dY0);
+		writer.WriteValue(m_dY1);
+		writer.WriteVector(m_vecNodes);
+		writer.WriteVector(m_vecX);
+		writer.WriteVector(m_vecY);
+		writer.WriteVector(m_vecIndex);
+	}
+
+	///	<summary>
+	///		Read a built quadtree from an index cache.  Returns false and
+	///		leaves the quadtree empty if the cached tree is inconsistent
+	///		with the bounds of this quadtree.
+	///	</summary>
+	bool read(
+		IndexCacheReader & reader
+	) {
+		clear();
+
+		double dX0, dX1, dY0, dY1;
+		if (!reader.ReadValue(dX0) || !reader.ReadValue(dX1) ||
+		    !reader.ReadValue(dY0) || !reader.ReadValue(dY1)
+		) {
+			return false;
+		}
+		if ((dX0 != m_dX0) || (dX1 != m_dX1) || (dY0 != m_dY0) || (dY1 != m_dY1)) {
+			return false;
+		}
+		if (!reader.ReadVector(m_vecNodes) ||
+		    !reader.ReadVector(m_vecX) ||
+		    !reader.ReadVector(m_vecY) ||
+		    !reader.ReadVector(m_vecIndex)
+		) {
+			clear();
+			return false;
+		}
+		if ((m_vecNodes.size() == 0) ||
+		    (m_vecX.size() != m_vecIndex.size()) ||
+		    (m_vecY.size() != m_vecIndex.size())
+		) {
+			clear();
+			return false;
+		}
 
-		if (iX < 0) {
-			iX = 0;
-		} else if (iX > 1) {
-			iX = 1;
+		m_fBuilt = true;
+		return true;
+	}
+
+protected:
+	///	<summary>
+	///		Number of leading zero bits in a 32-bit integer.
+	///	</summary>
+	static int leading_zeros(
+		uint32_t u
+	) {
+		if (u == 0) {
+			return 32;
 		}
-		if (iY < 0) {
-			iY = 0;
-		} else if (iY > 1) {
-			iY = 1;
+#if defined(__GNUC__)
+		return __builtin_clz(u);
+#else
+		int n = 0;
+		while ((u & 0x80000000u) == 0) {
+			u <<= 1;
+			n++;
 		}
+		return n;
+#endif
+	}
 
-		const size_t sIx = static_cast<size_t>(2 * iY + iX);
+	///	<summary>
+	///		Quantize an X coordinate to a 32-bit integer.
+	///	</summary>
+	uint32_t quantize_x(
+		double dX
+	) const {
+		const double dXi = (dX - m_dX0) * m_dXscale;
+		if (!(dXi > 0.0)) {
+			return 0;
+		}
+		if (dXi >= 4294967295.0) {
+			return static_cast<uint32_t>(-1);
+		}
+		return static_cast<uint32_t>(dXi);
+	}
 
-		_ASSERT(sIx < 4);
+	///	<summary>
+	///		Quantize a Y coordinate to a 32-bit integer.
+	///	</summary>
+	uint32_t quantize_y(
+		double dY
+	) const {
+		const double dYi = (dY - m_dY0) * m_dYscale;
+		if (!(dYi > 0.0)) {
+			return 0;
+		}
+		if (dYi >= 4294967295.0) {
+			return static_cast<uint32_t>(-1);
+		}
+		return static_cast<uint32_t>(dYi);
+	}
 
-		if (m_pChildren[sIx] != NULL) {
-			return m_pChildren[sIx]->find_inexact(dX, dY, dXref, dYref);
+	///	<summary>
+	///		Interleave the bits of quantized coordinates into a Morton key,
+	///		with Y bits in the odd positions so that the two bits at each
+	///		level give the quadrant index 2 * y + x.
+	///	</summary>
+	static uint64_t morton_key(
+		uint32_t uXi,
+		uint32_t uYi
+	) {
+		return (spread_bits(uYi) << 1) | spread_bits(uXi);
+	}
+
+	///	<summary>
+	///		Spread the bits of a 32-bit integer into the even bits of
+	///		a 64-bit integer.
+	///	</summary>
+	static uint64_t spread_bits(
+		uint32_t u
+	) {
+		uint64_t x = u;
+		x = (x | (x << 16)) & 0x0000FFFF0000FFFFULL;
+		x = (x | (x << 8))  & 0x00FF00FF00FF00FFULL;
+		x = (x | (x << 4))  & 0x0F0F0F0F0F0F0F0FULL;
+		x = (x | (x << 2))  & 0x3333333333333333ULL;
+		x = (x | (x << 1))  & 0x5555555555555555ULL;
+		return x;
+	}
 
-		} else if (m_sIndex[sIx] != static_cast<size_t>(-1)) {
-			dXref = m_dXcoord[sIx];
-			dYref = m_dYcoord[sIx];
-			return m_sIndex[sIx];
+	///	<summary>
+	///		Report that the given fraction of build() is complete.
+	///	</summary>
+	void report_build_progress(
+		double dFraction
+	) const {
+		if (m_iProgressBegin < 0) {
+			return;
+		}
+		const int iPercent = m_iProgressBegin
+			+ static_cast<int>(dFraction * static_cast<double>(m_iProgressEnd - m_iProgressBegin));
+		if (iPercent != m_iProgressLast) {
+			m_iProgressLast = iPercent;
+			AnnounceProgress(iPercent);
+		}
+	}
 
+	///	<summary>
+	///		Execute fn over [0, sCount), in parallel if a ThreadPool is given.
+	///	</summary>
+	static void parallel_for(
+		ThreadPool * pThreadPool,
+		size_t sCount,
+		const ThreadPool::RangeFunction & fn
+	) {
+		if (pThreadPool == NULL) {
+			fn(0, sCount);
 		} else {
-			for (int k = 0; k < 3; k++) {
-				int ixNeighbor = s_iLookup[sIx][k];
-				if (m_pChildren[ixNeighbor] != NULL) {
-					return m_pChildren[ixNeighbor]->find_inexact(dX, dY, dXref, dYref);
-
-				} else if (m_sIndex[ixNeighbor] != static_cast<size_t>(-1)) {
-					dXref = m_dXcoord[ixNeighbor];
-					dYref = m_dYcoord[ixNeighbor];
-					return m_sIndex[ixNeighbor];
+			pThreadPool->ParallelFor(0, sCount, 65536, fn);
+		}
+	}
+
+	///	<summary>
+	///		Sort an array of Morton keys.  With a ThreadPool the array is
+	///		split into one chunk per thread, chunks are sorted in parallel
+	///		and then merged pairwise.  Progress is reported between 0.1
+	///		and 0.6 of the build.
+	///	</summary>
+	void parallel_sort(
+		ThreadPool * pThreadPool,
+		std::vector<MortonKey> & vecKeys
+	) const {
+		const size_t sPoints = vecKeys.size();
+
+		size_t sChunks = 1;
+		if (pThreadPool != NULL) {
+			sChunks = pThreadPool->GetThreadCount();
+		}
+		if ((sChunks == 1) || (sPoints < 65536 * sChunks)) {
+			std::sort(vecKeys.begin(), vecKeys.end());
+			return;
+		}
+
+		const size_t sChunkSize = (sPoints + sChunks - 1) / sChunks;
+
+		size_t sPasses = 1;
+		for (size_t sWidth = sChunkSize; sWidth < sPoints; sWidth *= 2) {
+			sPasses++;
+		}
+		size_t sPass = 0;
+
+		pThreadPool->ParallelFor(0, sChunks, 1,
+			[&](size_t sBegin, size_t sEnd) {
+				for (size_t c = sBegin; c < sEnd; c++) {
+					const size_t s0 = std::min(c * sChunkSize, sPoints);
+					const size_t s1 = std::min(s0 + sChunkSize, sPoints);
+					std::sort(vecKeys.begin() + s0, vecKeys.begin() + s1);
+				}
+			});
+
+		sPass++;
+		report_build_progress(0.1 + 0.5 * static_cast<double>(sPass) / static_cast<double>(sPasses));
+
+		std::vector<MortonKey> vecMerged(sPoints);
+		for (size_t sWidth = sChunkSize; sWidth < sPoints; sWidth *= 2) {
+			const size_t sPairs = (sPoints + 2 * sWidth - 1) / (2 * sWidth);
+
+			pThreadPool->ParallelFor(0, sPairs, 1,
+				[&](size_t sBegin, size_t sEnd) {
+					for (size_t p = sBegin; p < sEnd; p++) {
+						const size_t s0 = p * 2 * sWidth;
+						const size_t s1 = std::min(s0 + sWidth, sPoints);
+						const size_t s2 = std::min(s1 + sWidth, sPoints);
+						std::merge(
+							vecKeys.begin() + s0, vecKeys.begin() + s1,
+							vecKeys.begin() + s1, vecKeys.begin() + s2,
+							vecMerged.begin() + s0);
+					}
+				});
+
+			vecKeys.swap(vecMerged);
+
+			sPass++;
+			report_build_progress(0.1 + 0.5 * static_cast<double>(sPass) / static_cast<double>(sPasses));
+		}
+	}
+
+	///	<summary>
+	///		Check if two Morton keys are in the same node at the given level.
+	///	</summary>
+	static bool same_node(
+		uint64_t uKey0,
+		uint64_t uKey1,
+		int iLevel
+	) {
+		if (iLevel == 0) {
+			return true;
+		}
+		return (((uKey0 ^ uKey1) >> (64 - 2 * iLevel)) == 0);
+	}
+
+	///	<summary>
+	///		Update the maximum level with a leaf at iLevel holding uCount
+	///		points.
+	///	</summary>
+	static void update_max_level(
+		int iLevel,
+		uint32_t uCount,
+		int & iMaxLevel
+	) {
+		if (uCount == 0) {
+			return;
+		}
+		int iEquivLevel = iLevel - 1;
+		for (uint32_t c = 1; c < uCount; c *= 4) {
+			iEquivLevel++;
+		}
+		if (iEquivLevel > QUADTREE_MAX_LEVELS) {
+			iEquivLevel = QUADTREE_MAX_LEVELS;
+		}
+		if (iEquivLevel > iMaxLevel) {
+			iMaxLevel = iEquivLevel;
+		}
+	}
+
+	///	<summary>
+	///		Build all nodes bottom-up in a single pass over the sorted keys.
+	///		A node starting at key i holds more than QUADTREE_BUCKET_SIZE
+	///		points exactly when key i+QUADTREE_BUCKET_SIZE is in the same
+	///		node, so each leaf is found by descending from the innermost
+	///		open internal node, and internal nodes are closed once the next
+	///		key leaves them.  The four children of a node are created
+	///		together so they are contiguous, in the same depth-first order
+	///		as a recursive subdivision.  Returns the maximum level.
+	///	</summary>
+	int build_nodes(
+		const std::vector<MortonKey> & vecKeys
+	) {
+		const uint32_t uPoints = static_cast<uint32_t>(vecKeys.size());
+
+		int iMaxLevel = 0;
+
+		Node nodeRoot;
+		nodeRoot.first = 0;
+		nodeRoot.count = uPoints;
+		m_vecNodes.push_back(nodeRoot);
+
+		if (uPoints <= QUADTREE_BUCKET_SIZE) {
+			update_max_level(0, uPoints, iMaxLevel);
+			return iMaxLevel;
+		}
+
+		// Open internal nodes from the root down, with the next quadrant
+		// of each that has not been assigned any points
+		uint32_t uOpenNode[QUADTREE_MAX_LEVELS + 1];
+		int iOpenQuad[QUADTREE_MAX_LEVELS + 1];
+		int iOpenLevel = 0;
+
+		// Subdivide a node into four children starting at point i
+		auto subdivide = [&](uint32_t uNode, uint32_t i) {
+			const uint32_t uChildFirst = static_cast<uint32_t>(m_vecNodes.size());
+			for (int q = 0; q < 4; q++) {
+				Node nodeChild;
+				nodeChild.first = i;
+				nodeChild.count = 0;
+				m_vecNodes.push_back(nodeChild);
+			}
+			m_vecNodes[uNode].first = uChildFirst;
+			m_vecNodes[uNode].count = QUADTREE_INTERNAL_NODE;
+		};
+
+		// Empty quadrants begin where the next non-empty quadrant begins
+		auto close_quads = [&](int iLevel, int iQuadEnd, uint32_t i) {
+			const uint32_t uChildFirst = m_vecNodes[uOpenNode[iLevel]].first;
+			for (int q = iOpenQuad[iLevel]; q < iQuadEnd; q++) {
+				m_vecNodes[uChildFirst + q].first = i;
+			}
+			iOpenQuad[iLevel] = iQuadEnd;
+		};
+
+		subdivide(0, 0);
+		uOpenNode[0] = 0;
+		iOpenQuad[0] = 0;
+
+		const uint32_t uReportSize = std::max<uint32_t>(uPoints / 100, 1);
+		uint32_t uNextReport = uReportSize;
+
+		uint32_t i = 0;
+		while (i < uPoints) {
+			const uint64_t uKey = vecKeys[i].key;
+
+			// Close internal nodes that do not contain this key; all open
+			// nodes contain the previous key
+			while ((iOpenLevel > 0) && !same_node(uKey, vecKeys[i-1].key, iOpenLevel)) {
+				close_quads(iOpenLevel, 4, i);
+				iOpenLevel--;
+			}
+
+			// Descend to the leaf containing this key
+			for (;;) {
+				const int iQuad = static_cast<int>((uKey >> (62 - 2 * iOpenLevel)) & 3);
+				close_quads(iOpenLevel, iQuad, i);
+				iOpenQuad[iOpenLevel] = iQuad + 1;
+
+				const uint32_t uChild = m_vecNodes[uOpenNode[iOpenLevel]].first + iQuad;
+				const int iChildLevel = iOpenLevel + 1;
+
+				if ((iChildLevel < QUADTREE_MAX_LEVELS) &&
+				    (i + QUADTREE_BUCKET_SIZE < uPoints) &&
+				    same_node(uKey, vecKeys[i + QUADTREE_BUCKET_SIZE].key, iChildLevel)
+				) {
+					subdivide(uChild, i);
+					iOpenLevel = iChildLevel;
+					uOpenNode[iOpenLevel] = uChild;
+					iOpenQuad[iOpenLevel] = 0;
+					continue;
+				}
+
+				// Leaf holding all keys in this node
+				uint32_t uEnd = i + 1;
+				while ((uEnd < uPoints) && same_node(uKey, vecKeys[uEnd].key, iChildLevel)) {
+					uEnd++;
 				}
+
+				m_vecNodes[uChild].first = i;
+				m_vecNodes[uChild].count = uEnd - i;
+				update_max_level(iChildLevel, uEnd - i, iMaxLevel);
+
+				i = uEnd;
+				break;
+			}
+
+			if (i >= uNextReport) {
+				report_build_progress(0.7 + 0.3 * static_cast<double>(i) / static_cast<double>(uPoints));
+				uNextReport = i + uReportSize;
 			}
 		}
 
-		_EXCEPTION();
+		// Close all remaining internal nodes
+		for (; iOpenLevel >= 0; iOpenLevel--) {
+			close_quads(iOpenLevel, 4, uPoints);
+		}
+
+		return iMaxLevel;
 	}
 
 protected:
@@ -184,9 +891,9 @@ protected:
 	double m_dX0;
 
 	///	<summary>
-	///		Coordinate spacing (X direction).
+	///		Upper coordinate bound (X direction).
 	///	</summary>
-	double m_dXdelta;
+	double m_dX1;
 
 	///	<summary>
 	///		Lower coordinate bound (Y direction).
@@ -194,34 +901,55 @@ protected:
 	double m_dY0;
 
 	///	<summary>
-	///		Coordinate spacing (Y direction).
+	///		Upper coordinate bound (Y direction).
+	///	</summary>
+	double m_dY1;
+
+	///	<summary>
+	///		Scale from coordinate to quantized coordinate (X direction).
+	///	</summary>
+	double m_dXscale;
+
+	///	<summary>
+	///		Scale from coordinate to quantized coordinate (Y direction).
+	///	</summary>
+	double m_dYscale;
+
+	///	<summary>
+	///		Flag indicating the tree has been built.
+	///	</summary>
+	bool m_fBuilt;
+
+	///	<summary>
+	///		Range of percentages reported by build(), or (-1) if disabled.
 	///	</summary>
-	double m_dYdelta;
+	int m_iProgressBegin;
+	int m_iProgressEnd;
 
 	///	<summary>
-	///		Level of this node.
+	///		Percentage most recently reported by build().
 	///	</summary>
-	int m_iLevel;
+	mutable int m_iProgressLast;
 
 	///	<summary>
-	///		X coordinate in each child node.
+	///		Node pool; the root node is m_vecNodes[0].
 	///	</summary>
-	double m_dXcoord[4];
+	std::vector<Node> m_vecNodes;
 
 	///	<summary>
-	///		Y coordinate in each child node.
+	///		X coordinate of each point, in leaf order.
 	///	</summary>
-	double m_dYcoord[4];
+	std::vector<float> m_vecX;
 
 	///	<summary>
-	///		Index in each child node.
+	///		Y coordinate of each point, in leaf order.
 	///	</summary>
-	size_t m_sIndex[4];
+	std::vector<float> m_vecY;
 
 	///	<summary>
-	///		Pointers to child nodes.
+	///		Index of each point, in leaf order.
 	///	</summary>
-	QuadTreeNode * m_pChildren[4];
+	std::vector<uint32_t> m_vecIndex;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
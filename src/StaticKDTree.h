@@ -0,0 +1,602 @@
+///////////////////////////////////////////////////////////////////////////////
+///
+///	\file    StaticKDTree.h
+///	\author  Paul Ullrich
+///	\version October 16, 2026
+///
+
+#ifndef _STATICKDTREE_H_
+#define _STATICKDTREE_H_
+
+#include "Exception.h"
+#include "Announce.h"
+#include "IndexCache.h"
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdint.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+///	<summary>
+///		A static three-dimensional kd-tree.  Points are first collected with
+///		insert() and the tree is then built in place by median partitioning
+///		(std::nth_element) into a flat node array.  Leaf buckets are stored
+///		as single-precision structure-of-arrays, padded to the SIMD width,
+///		and scanned with SSE or AVX when available.  Queries perform no
+///		heap allocation.
+///	</summary>
+class StaticKDTree {
+
+public:
+	///	<summary>
+	///		Maximum number of points in a leaf (before padding).
+	///	</summary>
+	static const uint32_t KDTREE_BUCKET_SIZE = 16;
+
+	///	<summary>
+	///		Maximum depth of the tree.
+	///	</summary>
+	static const int KDTREE_MAX_DEPTH = 64;
+
+	///	<summary>
+	///		Number of points processed at once when scanning a leaf.
+	///	</summary>
+#if defined(__AVX__)
+	static const uint32_t KDTREE_SIMD_WIDTH = 8;
+#elif defined(__SSE__)
+	static const uint32_t KDTREE_SIMD_WIDTH = 4;
+#else
+	static const uint32_t KDTREE_SIMD_WIDTH = 1;
+#endif
+
+	///	<summary>
+	///		Value of Node::count used to identify an internal node.
+	///	</summary>
+	static const uint32_t KDTREE_INTERNAL_NODE = static_cast<uint32_t>(-1);
+
+	///	<summary>
+	///		A node of the StaticKDTree.  For internal nodes the left child
+	///		immediately follows the node, right is the offset of the right
+	///		child and first is the splitting axis.  For leaf nodes first is
+	///		the offset of the first point in the bucket and count is the
+	///		(padded) number of points in the bucket.
+	///	</summary>
+	struct Node {
+		float split;
+		uint32_t right;
+		uint32_t first;
+		uint32_t count;
+
+		bool is_leaf() const {
+			return (count != KDTREE_INTERNAL_NODE);
+		}
+	};
+
+protected:
+	///	<summary>
+	///		A point used during construction.
+	///	</summary>
+	struct BuildPoint {
+		float x[3];
+		uint32_t index;
+	};
+
+	///	<summary>
+	///		Comparator of BuildPoints along one axis.
+	///	</summary>
+	struct BuildPointLess {
+		int axis;
+
+		BuildPointLess(int a) : axis(a) { }
+
+		bool operator()(const BuildPoint & a, const BuildPoint & b) const {
+			return (a.x[axis] < b.x[axis]);
+		}
+	};
+
+public:
+	///	<summary>
+	///		Constructor.
+	///	</summary>
+	StaticKDTree() :
+		m_iProgressBegin(-1),
+		m_iProgressEnd(-1),
+		m_uNextReport(0)
+	{ }
+
+	///	<summary>
+	///		Delete all nodes and points in this StaticKDTree.
+	///	</summary>
+	void clear() {
+		std::vector<Node>().swap(m_vecNodes);
+		std::vector<float>().swap(m_vecX);
+		std::vector<float>().swap(m_vecY);
+		std::vector<float>().swap(m_vecZ);
+		std::vector<uint32_t>().swap(m_vecIndex);
+		std::vector<BuildPoint>().swap(m_vecBuildPoints);
+	}
+
+	///	<summary>
+	///		Reserve space for the given number of points.
+	///	</summary>
+	void reserve(
+		size_t sPoints
+	) {
+		m_vecBuildPoints.reserve(sPoints);
+	}
+
+	///	<summary>
+	///		Check if the tree contains no points.
+	///	</summary>
+	bool empty() const {
+		return (m_vecNodes.size() == 0);
+	}
+
+	///	<summary>
+	///		Memory used by the kd-tree, in bytes.
+	///	</summary>
+	size_t memory_usage() const {
+		return
+			  m_vecNodes.capacity() * sizeof(Node)
+			+ m_vecX.capacity() * sizeof(float)
+			+ m_vecY.capacity() * sizeof(float)
+			+ m_vecZ.capacity() * sizeof(float)
+			+ m_vecIndex.capacity() * sizeof(uint32_t);
+	}
+
+	///	<summary>
+	///		Add a point to the kd-tree.  The point is not searchable
+	///		until build() is called.
+	///	</summary>
+	void insert(
+		double dX,
+		double dY,
+		double dZ,
+		size_t sI
+	) {
+		if (sI >= static_cast<size_t>(KDTREE_INTERNAL_NODE)) {
+			_EXCEPTION1("ERROR: StaticKDTree index out of range %lu\n", sI);
+		}
+
+		BuildPoint pt;
+		pt.x[0] = static_cast<float>(dX);
+		pt.x[1] = static_cast<float>(dY);
+		pt.x[2] = static_cast<float>(dZ);
+		pt.index = static_cast<uint32_t>(sI);
+		m_vecBuildPoints.push_back(pt);
+	}
+
+	///	<summary>
+	///		Report the progress of build() with AnnounceProgress, as a
+	///		percentage from iBegin to iEnd.  Disabled if iBegin is negative.
+	///	</summary>
+	void set_build_progress(
+		int iBegin,
+		int iEnd
+	) {
+		m_iProgressBegin = iBegin;
+		m_iProgressEnd = iEnd;
+	}
+
+	///	<summary>
+	///		Build the kd-tree from all inserted points.  Progress is
+	///		reported as the fraction of points placed in leaves.
+	///	</summary>
+	void build() {
+		std::vector<Node>().swap(m_vecNodes);
+		m_vecX.clear();
+		m_vecY.clear();
+		m_vecZ.clear();
+		m_vecIndex.clear();
+
+		if (m_vecBuildPoints.size() != 0) {
+			const size_t sReserve =
+				m_vecBuildPoints.size()
+				+ (m_vecBuildPoints.size() / (KDTREE_BUCKET_SIZE / 2) + 1) * KDTREE_SIMD_WIDTH;
+
+			m_vecX.reserve(sReserve);
+			m_vecY.reserve(sReserve);
+			m_vecZ.reserve(sReserve);
+			m_vecIndex.reserve(sReserve);
+			m_vecNodes.reserve(2 * (m_vecBuildPoints.size() / (KDTREE_BUCKET_SIZE / 2) + 1));
+
+			m_uNextReport = 0;
+			build_node(0, static_cast<uint32_t>(m_vecBuildPoints.size()), 0);
+		}
+
+		std::vector<BuildPoint>().swap(m_vecBuildPoints);
+		std::vector<Node>(m_vecNodes).swap(m_vecNodes);
+		std::vector<float>(m_vecX).swap(m_vecX);
+		std::vector<float>(m_vecY).swap(m_vecY);
+		std::vector<float>(m_vecZ).swap(m_vecZ);
+		std::vector<uint32_t>(m_vecIndex).swap(m_vecIndex);
+	}
+
+	///	<summary>
+	///		Find the nearest point to (dX, dY, dZ).  If sHint is a valid
+	///		point index (such as the result of the previous query) the
+	///		distance to it is used as the initial search radius.  Returns
+	///		the position of the nearest point, which can be converted to an
+	///		index with index(), or static_cast<uint32_t>(-1) if the tree is
+	///		empty.
+	///	</summary>
+	uint32_t find_nearest(
+		float flX,
+		float flY,
+		float flZ,
+		uint32_t uHint = static_cast<uint32_t>(-1)
+	) const {
+		if (m_vecNodes.size() == 0) {
+			return static_cast<uint32_t>(-1);
+		}
+
+		uint32_t uBest = static_cast<uint32_t>(-1);
+		float flBestDist2 = HUGE_VALF;
+
+		if (uHint < m_vecIndex.size()) {
+			uBest = uHint;
+			flBestDist2 = dist2(uHint, flX, flY, flZ);
+		}
+
+		const float flQ[3] = {flX, flY, flZ};
+
+		// Stack of nodes remaining to visit and their distance lower bound
+		uint32_t uStackNode[KDTREE_MAX_DEPTH];
+		float flStackDist2[KDTREE_MAX_DEPTH];
+		int iStackSize = 0;
+
+		uint32_t uNode = 0;
+		for (;;) {
+			const Node & node = m_vecNodes[uNode];
+
+			if (node.is_leaf()) {
+				scan_leaf(node, flX, flY, flZ, uBest, flBestDist2);
+
+				// Pop the next node that may contain a closer point
+				bool fFound = false;
+				while (iStackSize > 0) {
+					iStackSize--;
+					if (flStackDist2[iStackSize] < flBestDist2) {
+						uNode = uStackNode[iStackSize];
+						fFound = true;
+						break;
+					}
+				}
+				if (!fFound) {
+					break;
+				}
+
+			} else {
+				const float flDiff = flQ[node.first] - node.split;
+				uint32_t uNear;
+				uint32_t uFar;
+				if (flDiff < 0.0f) {
+					uNear = uNode + 1;
+					uFar = node.right;
+				} else {
+					uNear = node.right;
+					uFar = uNode + 1;
+				}
+
+				const float flDiff2 = flDiff * flDiff;
+				if (flDiff2 < flBestDist2) {
+					_ASSERT(iStackSize < KDTREE_MAX_DEPTH);
+					uStackNode[iStackSize] = uFar;
+					flStackDist2[iStackSize] = flDiff2;
+					iStackSize++;
+				}
+				uNode = uNear;
+			}
+		}
+
+		return uBest;
+	}
+
+	///	<summary>
+	///		Find the nearest point to each of sPoints query points, storing
+	///		the index of each in pIndex.  Successive queries are seeded with
+	///		the previous result, so batches of nearby points are fastest.
+	///		Indices are static_cast<uint32_t>(-1) if the tree is empty.
+	///	</summary>
+	void find_nearest(
+		const float * pX,
+		const float * pY,
+		const float * pZ,
+		size_t sPoints,
+		uint32_t * pIndex
+	) const {
+		uint32_t uHint = static_cast<uint32_t>(-1);
+		for (size_t i = 0; i < sPoints; i++) {
+			uHint = find_nearest(pX[i], pY[i], pZ[i], uHint);
+			if (uHint == static_cast<uint32_t>(-1)) {
+				pIndex[i] = static_cast<uint32_t>(-1);
+			} else {
+				pIndex[i] = m_vecIndex[uHint];
+			}
+		}
+	}
+
+	///	<summary>
+	///		Index of the point at the given position.
+	///	</summary>
+	uint32_t index(
+		uint32_t uPos
+	) const {
+		return m_vecIndex[uPos];
+	}
+
+	///	<summary>
+	///		Write the built kd-tree to an index cache.  Leaf padding depends
+	///		on KDTREE_SIMD_WIDTH, so it is stored alongside the tree.
+	///	</summary>
+	void write(
+		IndexCacheWriter & writer
+	) const {
+		const uint32_t uSimdWidth = KDTREE_SIMD_WIDTH;
+		writer.WriteValue(uSimdWidth);
+		writer.WriteVector(m_vecNodes);
+		writer.WriteVector(m_vecX);
+		writer.WriteVector(m_vecY);
+		writer.WriteVector(m_vecZ);
+		writer.WriteVector(m_vecIndex);
+	}
+
+	///	<summary>
+	///		Read a built kd-tree from an index cache.  Returns false and
+	///		leaves the kd-tree empty if the cached tree was built with a
+	///		different SIMD width or is inconsistent.
+	///	</summary>
+	bool read(
+		IndexCacheReader & reader
+	) {
+		clear();
+
+		uint32_t uSimdWidth;
+		if (!reader.ReadValue(uSimdWidth) || (uSimdWidth != KDTREE_SIMD_WIDTH)) {
+			return false;
+		}
+		if (!reader.ReadVector(m_vecNodes) ||
+		    !reader.ReadVector(m_vecX) ||
+		    !reader.ReadVector(m_vecY) ||
+		    !reader.ReadVector(m_vecZ) ||
+		    !reader.ReadVector(m_vecIndex)
+		) {
+			clear();
+			return false;
+		}
+		if ((m_vecX.size() != m_vecIndex.size()) ||
+		    (m_vecY.size() != m_vecIndex.size()) ||
+		    (m_vecZ.size() != m_vecIndex.size())
+		) {
+			clear();
+			return false;
+		}
+		return true;
+	}
+
+protected:
+	///	<summary>
+	///		Squared distance between the point at the given position and
+	///		the query point.
+	///	</summary>
+	float dist2(
+		uint32_t uPos,
+		float flX,
+		float flY,
+		float flZ
+	) const {
+		const float flDX = m_vecX[uPos] - flX;
+		const float flDY = m_vecY[uPos] - flY;
+		const float flDZ = m_vecZ[uPos] - flZ;
+		return (flDX * flDX + flDY * flDY + flDZ * flDZ);
+	}
+
+	///	<summary>
+	///		Scan a leaf bucket for a point closer than flBestDist2.
+	///	</summary>
+	void scan_leaf(
+		const Node & node,
+		float flX,
+		float flY,
+		float flZ,
+		uint32_t & uBest,
+		float & flBestDist2
+	) const {
+		const uint32_t uEnd = node.first + node.count;
+
+#if defined(__AVX__)
+		const __m256 mX = _mm256_set1_ps(flX);
+		const __m256 mY = _mm256_set1_ps(flY);
+		const __m256 mZ = _mm256_set1_ps(flZ);
+		for (uint32_t i = node.first; i < uEnd; i += 8) {
+			const __m256 mDX = _mm256_sub_ps(_mm256_loadu_ps(&(m_vecX[i])), mX);
+			const __m256 mDY = _mm256_sub_ps(_mm256_loadu_ps(&(m_vecY[i])), mY);
+			const __m256 mDZ = _mm256_sub_ps(_mm256_loadu_ps(&(m_vecZ[i])), mZ);
+			const __m256 mDist2 =
+				_mm256_add_ps(
+					_mm256_add_ps(_mm256_mul_ps(mDX, mDX), _mm256_mul_ps(mDY, mDY)),
+					_mm256_mul_ps(mDZ, mDZ));
+			const int iMask =
+				_mm256_movemask_ps(
+					_mm256_cmp_ps(mDist2, _mm256_set1_ps(flBestDist2), _CMP_LT_OQ));
+			if (iMask != 0) {
+				float flDist2[8];
+				_mm256_storeu_ps(flDist2, mDist2);
+				for (int k = 0; k < 8; k++) {
+					if (flDist2[k] < flBestDist2) {
+						flBestDist2 = flDist2[k];
+						uBest = i + k;
+					}
+				}
+			}
+		}
+#elif defined(__SSE__)
+		const __m128 mX = _mm_set1_ps(flX);
+		const __m128 mY = _mm_set1_ps(flY);
+		const __m128 mZ = _mm_set1_ps(flZ);
+		for (uint32_t i = node.first; i < uEnd; i += 4) {
+			const __m128 mDX = _mm_sub_ps(_mm_loadu_ps(&(m_vecX[i])), mX);
+			const __m128 mDY = _mm_sub_ps(_mm_loadu_ps(&(m_vecY[i])), mY);
+			const __m128 mDZ = _mm_sub_ps(_mm_loadu_ps(&(m_vecZ[i])), mZ);
+			const __m128 mDist2 =
+				_mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(mDX, mDX), _mm_mul_ps(mDY, mDY)),
+					_mm_mul_ps(mDZ, mDZ));
+			const int iMask =
+				_mm_movemask_ps(_mm_cmplt_ps(mDist2, _mm_set1_ps(flBestDist2)));
+			if (iMask != 0) {
+				float flDist2[4];
+				_mm_storeu_ps(flDist2, mDist2);
+				for (int k = 0; k < 4; k++) {
+					if (flDist2[k] < flBestDist2) {
+						flBestDist2 = flDist2[k];
+						uBest = i + k;
+					}
+				}
+			}
+		}
+#else
+		for (uint32_t i = node.first; i < uEnd; i++) {
+			const float flDist2 = dist2(i, flX, flY, flZ);
+			if (flDist2 < flBestDist2) {
+				flBestDist2 = flDist2;
+				uBest = i;
+			}
+		}
+#endif
+	}
+
+	///	<summary>
+	///		Build the subtree containing m_vecBuildPoints[uBegin, uEnd).
+	///	</summary>
+	void build_node(
+		uint32_t uBegin,
+		uint32_t uEnd,
+		int iDepth
+	) {
+		const uint32_t uNode = static_cast<uint32_t>(m_vecNodes.size());
+		m_vecNodes.push_back(Node());
+
+		// Leaf node; pad the bucket to the SIMD width with copies of
+		// the last point
+		if ((uEnd - uBegin <= KDTREE_BUCKET_SIZE) || (iDepth == KDTREE_MAX_DEPTH - 1)) {
+			Node & node = m_vecNodes[uNode];
+			node.split = 0.0f;
+			node.right = 0;
+			node.first = static_cast<uint32_t>(m_vecIndex.size());
+
+			uint32_t uPadded = uEnd - uBegin;
+			if (uPadded % KDTREE_SIMD_WIDTH != 0) {
+				uPadded += KDTREE_SIMD_WIDTH - uPadded % KDTREE_SIMD_WIDTH;
+			}
+			node.count = uPadded;
+
+			for (uint32_t i = 0; i < uPadded; i++) {
+				const BuildPoint & pt =
+					m_vecBuildPoints[std::min(uBegin + i, uEnd - 1)];
+				m_vecX.push_back(pt.x[0]);
+				m_vecY.push_back(pt.x[1]);
+				m_vecZ.push_back(pt.x[2]);
+				m_vecIndex.push_back(pt.index);
+			}
+
+			// Report each time another percent of the points is placed
+			if ((m_iProgressBegin >= 0) && (uEnd >= m_uNextReport)) {
+				const size_t sPoints = m_vecBuildPoints.size();
+				AnnounceProgress(m_iProgressBegin
+					+ static_cast<int>(static_cast<double>(uEnd) / static_cast<double>(sPoints)
+						* static_cast<double>(m_iProgressEnd - m_iProgressBegin)));
+				m_uNextReport = uEnd + std::max<uint32_t>(static_cast<uint32_t>(sPoints / 100), 1);
+			}
+			return;
+		}
+
+		// Split along the axis of greatest extent
+		float flMin[3] = {HUGE_VALF, HUGE_VALF, HUGE_VALF};
+		float flMax[3] = {-HUGE_VALF, -HUGE_VALF, -HUGE_VALF};
+		for (uint32_t i = uBegin; i < uEnd; i++) {
+			for (int d = 0; d < 3; d++) {
+				flMin[d] = std::min(flMin[d], m_vecBuildPoints[i].x[d]);
+				flMax[d] = std::max(flMax[d], m_vecBuildPoints[i].x[d]);
+			}
+		}
+
+		int iAxis = 0;
+		for (int d = 1; d < 3; d++) {
+			if (flMax[d] - flMin[d] > flMax[iAxis] - flMin[iAxis]) {
+				iAxis = d;
+			}
+		}
+
+		const uint32_t uMid = uBegin + (uEnd - uBegin) / 2;
+		std::nth_element(
+			m_vecBuildPoints.begin() + uBegin,
+			m_vecBuildPoints.begin() + uMid,
+			m_vecBuildPoints.begin() + uEnd,
+			BuildPointLess(iAxis));
+
+		m_vecNodes[uNode].split = m_vecBuildPoints[uMid].x[iAxis];
+		m_vecNodes[uNode].first = static_cast<uint32_t>(iAxis);
+		m_vecNodes[uNode].count = KDTREE_INTERNAL_NODE;
+
+		build_node(uBegin, uMid, iDepth + 1);
+		m_vecNodes[uNode].right = static_cast<uint32_t>(m_vecNodes.size());
+		build_node(uMid, uEnd, iDepth + 1);
+	}
+
+protected:
+	///	<summary>
+	///		Node array; the root node is m_vecNodes[0].
+	///	</summary>
+	std::vector<Node> m_vecNodes;
+
+	///	<summary>
+	///		X coordinate of each point, in leaf order.
+	///	</summary>
+	std::vector<float> m_vecX;
+
+	///	<summary>
+	///		Y coordinate of each point, in leaf order.
+	///	</summary>
+	std::vector<float> m_vecY;
+
+	///	<summary>
+	///		Z coordinate of each point, in leaf order.
+	///	</summary>
+	std::vector<float> m_vecZ;
+
+	///	<summary>
+	///		Index of each point, in leaf order.
+	///	</summary>
+	std::vector<uint32_t> m_vecIndex;
+
+	///	<summary>
+	///		Points inserted but not yet built.
+	///	</summary>
+	std::vector<BuildPoint> m_vecBuildPoints;
+
+	///	<summary>
+	///		Range of percentages reported by build(), or (-1) if disabled.
+	///	</summary>
+	int m_iProgressBegin;
+	int m_iProgressEnd;
+
+	///	<summary>
+	///		Number of built points at which progress is next reported.
+	///	</summary>
+	uint32_t m_uNextReport;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // _STATICKDTREE_H_
+
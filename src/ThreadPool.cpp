@@ -0,0 +1,152 @@
+///////////////////////////////////////////////////////////////////////////////
+///
+///	\file    ThreadPool.cpp
+///	\author  Paul Ullrich
+///	\version October 16, 2026
+///
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+///////////////////////////////////////////////////////////////////////////////
+
+ThreadPool::ThreadPool(
+	size_t sThreads
+) :
+	m_pfn(NULL),
+	m_sEnd(0),
+	m_sGrain(1),
+	m_sNext(0),
+	m_sActiveWorkers(0),
+	m_sGeneration(0),
+	m_fShutdown(false)
+{
+	if (sThreads == 0) {
+		sThreads = std::thread::hardware_concurrency();
+	}
+	for (size_t i = 1; i < sThreads; i++) {
+		m_vecThreads.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+ThreadPool::~ThreadPool() {
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_fShutdown = true;
+	}
+	m_condWork.notify_all();
+
+	for (size_t i = 0; i < m_vecThreads.size(); i++) {
+		m_vecThreads[i].join();
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void ThreadPool::ParallelFor(
+	size_t sBegin,
+	size_t sEnd,
+	size_t sGrain,
+	const RangeFunction & fn
+) {
+	if (sEnd <= sBegin) {
+		return;
+	}
+	if (sGrain == 0) {
+		sGrain = 1;
+	}
+
+	// Serial execution
+	std::unique_lock<std::mutex> lockLoop(m_mutexLoop, std::try_to_lock);
+	if (!lockLoop.owns_lock() || (m_vecThreads.size() == 0) || (sEnd - sBegin <= sGrain)) {
+		for (size_t s = sBegin; s < sEnd; s += sGrain) {
+			fn(s, std::min(s + sGrain, sEnd));
+		}
+		return;
+	}
+
+	// Parallel execution
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_pfn = &fn;
+		m_sEnd = sEnd;
+		m_sGrain = sGrain;
+		m_sNext = sBegin;
+		m_sActiveWorkers = m_vecThreads.size();
+		m_sGeneration++;
+		m_excLoop = std::exception_ptr();
+	}
+	m_condWork.notify_all();
+
+	ProcessChunks();
+
+	std::exception_ptr excLoop;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (m_sActiveWorkers != 0) {
+			m_condDone.wait(lock);
+		}
+		m_pfn = NULL;
+		std::swap(excLoop, m_excLoop);
+	}
+
+	if (excLoop) {
+		std::rethrow_exception(excLoop);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void ThreadPool::ProcessChunks() {
+	try {
+		for (;;) {
+			size_t s = m_sNext.fetch_add(m_sGrain);
+			if (s >= m_sEnd) {
+				break;
+			}
+			(*m_pfn)(s, std::min(s + m_sGrain, m_sEnd));
+		}
+
+	} catch(...) {
+		// Keep the first exception and abandon the remaining chunks
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (!m_excLoop) {
+			m_excLoop = std::current_exception();
+		}
+		m_sNext = m_sEnd;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void ThreadPool::WorkerLoop() {
+	size_t sGeneration = 0;
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while (!m_fShutdown && (m_sGeneration == sGeneration)) {
+				m_condWork.wait(lock);
+			}
+			if (m_fShutdown) {
+				return;
+			}
+			sGeneration = m_sGeneration;
+		}
+
+		ProcessChunks();
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_sActiveWorkers--;
+			if (m_sActiveWorkers == 0) {
+				m_condDone.notify_one();
+			}
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
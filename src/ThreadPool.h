@@ -0,0 +1,153 @@
+///////////////////////////////////////////////////////////////////////////////
+///
+///	\file    ThreadPool.h
+///	\author  Paul Ullrich
+///	\version October 16, 2026
+///
+
+#ifndef _THREADPOOL_H_
+#define _THREADPOOL_H_
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+
+///////////////////////////////////////////////////////////////////////////////
+
+///	<summary>
+///		A fixed-size pool of worker threads used to execute parallel loops.
+///		The calling thread participates in each loop, so a pool with
+///		one thread executes all work serially on the calling thread.
+///	</summary>
+class ThreadPool {
+
+public:
+	///	<summary>
+	///		Type of a function that processes the range [begin, end).
+	///	</summary>
+	typedef std::function<void(size_t, size_t)> RangeFunction;
+
+public:
+	///	<summary>
+	///		Constructor.  The number of threads includes the calling thread;
+	///		if sThreads is zero the hardware concurrency is used.
+	///	</summary>
+	ThreadPool(
+		size_t sThreads = 0
+	);
+
+	///	<summary>
+	///		Destructor.
+	///	</summary>
+	~ThreadPool();
+
+	///	<summary>
+	///		Number of threads, including the calling thread.
+	///	</summary>
+	size_t GetThreadCount() const {
+		return m_vecThreads.size() + 1;
+	}
+
+	///	<summary>
+	///		Execute fn on the range [sBegin, sEnd) divided into chunks of
+	///		sGrain items and return once all chunks are complete.  If the
+	///		pool is already executing a loop (for instance if called from
+	///		within fn or from another thread) the range is processed
+	///		serially on the calling thread.  If fn throws, the remaining
+	///		chunks are skipped and the first exception is rethrown on the
+	///		calling thread.
+	///	</summary>
+	void ParallelFor(
+		size_t sBegin,
+		size_t sEnd,
+		size_t sGrain,
+		const RangeFunction & fn
+	);
+
+private:
+	///	<summary>
+	///		Main loop of each worker thread.
+	///	</summary>
+	void WorkerLoop();
+
+	///	<summary>
+	///		Process chunks of the current loop until none are left.
+	///	</summary>
+	void ProcessChunks();
+
+private:
+	///	<summary>
+	///		Worker threads.
+	///	</summary>
+	std::vector<std::thread> m_vecThreads;
+
+	///	<summary>
+	///		Mutex held for the duration of a ParallelFor call.
+	///	</summary>
+	std::mutex m_mutexLoop;
+
+	///	<summary>
+	///		Mutex protecting the loop state below.
+	///	</summary>
+	std::mutex m_mutex;
+
+	///	<summary>
+	///		Condition variable used to wake the workers.
+	///	</summary>
+	std::condition_variable m_condWork;
+
+	///	<summary>
+	///		Condition variable used to signal loop completion.
+	///	</summary>
+	std::condition_variable m_condDone;
+
+	///	<summary>
+	///		Function being executed by the current loop.
+	///	</summary>
+	const RangeFunction * m_pfn;
+
+	///	<summary>
+	///		End of the range of the current loop.
+	///	</summary>
+	size_t m_sEnd;
+
+	///	<summary>
+	///		Chunk size of the current loop.
+	///	</summary>
+	size_t m_sGrain;
+
+	///	<summary>
+	///		Start of the next unclaimed chunk of the current loop.
+	///	</summary>
+	std::atomic<size_t> m_sNext;
+
+	///	<summary>
+	///		Number of workers still processing the current loop.
+	///	</summary>
+	size_t m_sActiveWorkers;
+
+	///	<summary>
+	///		First exception thrown by the function in the current loop,
+	///		rethrown on the calling thread once all workers are done.
+	///	</summary>
+	std::exception_ptr m_excLoop;
+
+	///	<summary>
+	///		Loop counter, used by the workers to detect a new loop.
+	///	</summary>
+	size_t m_sGeneration;
+
+	///	<summary>
+	///		Flag indicating the workers should exit.
+	///	</summary>
+	bool m_fShutdown;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // _THREADPOOL_H_
+
@@ -60,7 +60,14 @@ bool wxNcVisApp::OnInit() {
 			if ((wxString("-g") == argv[iarg]) ||
 			    (wxString("-uxc") == argv[iarg]) ||
 			    (wxString("-uyc") == argv[iarg]) ||
-				(wxString("-mcr") == argv[iarg])
+				(wxString("-mcr") == argv[iarg]) ||
+				(wxString("-threads") == argv[iarg]) ||
+				(wxString("-cachedir") == argv[iarg]) ||
+				(wxString("-index-cache-mb") == argv[iarg]) ||
+				(wxString("-sampler-cache-mb") == argv[iarg]) ||
+				(wxString("-cache-mb") == argv[iarg]) ||
+				(wxString("-scratchdir") == argv[iarg]) ||
+				(wxString("-index-build-mb") == argv[iarg])
 			) {
 				if (iarg+1 == argc) {
 					std::cout << "Option " << argv[iarg] << " missing required parameter" << std::endl;
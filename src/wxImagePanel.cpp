@@ -15,6 +15,9 @@
 #include <wx/kbdstate.h>
 
 #include <map>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -23,6 +26,9 @@ EVT_PAINT(wxImagePanel::OnPaint)
 EVT_SIZE(wxImagePanel::OnSize)
 EVT_IDLE(wxImagePanel::OnIdle)
 EVT_LEFT_DCLICK(wxImagePanel::OnMouseLeftDoubleClick)
+EVT_LEFT_DOWN(wxImagePanel::OnMouseLeftDown)
+EVT_LEFT_UP(wxImagePanel::OnMouseLeftUp)
+EVT_MOUSE_CAPTURE_LOST(wxImagePanel::OnMouseCaptureLost)
 EVT_MOTION(wxImagePanel::OnMouseMotion)
 EVT_LEAVE_WINDOW(wxImagePanel::OnMouseLeaveWindow)
 END_EVENT_TABLE()
@@ -99,6 +105,22 @@ static const int TICKMARKLABEL_TICKLABELSPACING = 4;
 ///	</summary>
 static const int TICKMARKLABEL_FONTHEIGHT = 16;
 
+///	<summary>
+///		Image maps smaller than this are always sampled at full resolution.
+///	</summary>
+static const size_t PROGRESSIVE_MIN_PIXELS = 65536;
+
+///	<summary>
+///		Image maps at least this large are first sampled at 1/8 resolution
+///		rather than 1/4 resolution.
+///	</summary>
+static const size_t PROGRESSIVE_EIGHTH_PIXELS = 1048576;
+
+///	<summary>
+///		Approximate number of pixels refined per idle event.
+///	</summary>
+static const size_t PROGRESSIVE_REFINE_PIXELS = 65536;
+
 ////////////////////////////////////////////////////////////////////////////////
 
 wxImagePanel::wxImagePanel(
@@ -108,7 +130,9 @@ wxImagePanel::wxImagePanel(
 	m_dColorMapScalingFactor(1.0),
 	m_fEnableRedraw(true),
 	m_fGridLinesOn(false),
-	m_fResize(false)
+	m_fResize(false),
+	m_fDragging(false),
+	m_iRefineRow(-1)
 {
 	m_pncvisparent = dynamic_cast<wxNcVisFrame *>(GetParent());
 	_ASSERT(m_pncvisparent != NULL);
@@ -291,6 +315,11 @@ void wxImagePanel::OnIdle(wxIdleEvent & evt) {
 
 		// Generate coordinates
 		SetCoordinateRange(m_dXrange[0], m_dXrange[1], m_dYrange[0], m_dYrange[1], true);
+
+	} else if (m_iRefineRow >= 0) {
+		if (RefineImageMap()) {
+			evt.RequestMore();
+		}
 	}
 }
 
@@ -299,6 +328,26 @@ void wxImagePanel::OnIdle(wxIdleEvent & evt) {
 void wxImagePanel::OnMouseMotion(wxMouseEvent & evt) {
 	wxPoint posMouse = evt.GetPosition();
 
+	// Pan the map with the cursor
+	if (m_fDragging) {
+		if (!evt.Dragging() || !evt.LeftIsDown()) {
+			m_fDragging = false;
+			if (HasCapture()) {
+				ReleaseMouse();
+			}
+
+		} else {
+			int nPixelsX = posMouse.x - m_posDragLast.x;
+			int nPixelsY = posMouse.y - m_posDragLast.y;
+			m_posDragLast = posMouse;
+
+			if ((nPixelsX != 0) || (nPixelsY != 0)) {
+				PanImage(nPixelsX, nPixelsY, true);
+			}
+			return;
+		}
+	}
+
 	wxSize wxsMap;
 	wxPosition wxpMap;
 	GetMapPositionSize(wxsMap, wxpMap);
@@ -329,8 +378,12 @@ void wxImagePanel::OnMouseMotion(wxMouseEvent & evt) {
 		return;
 	}
 
+	// Report the index along the unstructured dimension, not into gathered data
+	int iIndex = m_imagemap[sI];
+	m_pncvisparent->UngatherImageMap(&iIndex, 1);
+
 	char szMessage[64];
-	snprintf(szMessage, 64, " (X: %f Y: %f I: %i) %f", dX, dY, m_imagemap[sI], data[m_imagemap[sI]]);
+	snprintf(szMessage, 64, " (X: %f Y: %f I: %i) %f", dX, dY, iIndex, data[m_imagemap[sI]]);
 
 	m_pncvisparent->SetStatusMessage(szMessage, true);
 }
@@ -343,6 +396,47 @@ void wxImagePanel::OnMouseLeaveWindow(wxMouseEvent & evt) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void wxImagePanel::OnMouseLeftDown(wxMouseEvent & evt) {
+	wxPoint pos = evt.GetPosition();
+
+	wxSize wxsMap;
+	wxPosition wxpMap;
+	GetMapPositionSize(wxsMap, wxpMap);
+
+	// Only start a drag from within the map
+	if ((pos.x < wxpMap.GetCol()) || (pos.x - wxpMap.GetCol() >= m_dSampleX.size())) {
+		return;
+	}
+	if ((pos.y < wxpMap.GetRow()) || (pos.y - wxpMap.GetRow() >= m_dSampleY.size())) {
+		return;
+	}
+
+	m_fDragging = true;
+	m_posDragLast = pos;
+
+	if (!HasCapture()) {
+		CaptureMouse();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void wxImagePanel::OnMouseLeftUp(wxMouseEvent & evt) {
+	m_fDragging = false;
+
+	if (HasCapture()) {
+		ReleaseMouse();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void wxImagePanel::OnMouseCaptureLost(wxMouseCaptureLostEvent & evt) {
+	m_fDragging = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 void wxImagePanel::OnMouseLeftDoubleClick(wxMouseEvent & evt) {
 	wxKeyboardState wxkeystate;
 
@@ -1125,6 +1219,10 @@ void wxImagePanel::SetColorMapScalingFactor(
 void wxImagePanel::ResampleData(
 	bool fRedraw
 ) {
+	CancelRefinement();
+
+	m_pncvisparent->UpdateDataWindow(m_dSampleX, m_dSampleY);
+
 	m_imagemap.resize(m_dSampleX.size() * m_dSampleY.size());
 
 	m_pncvisparent->SampleData(m_dSampleX, m_dSampleY, m_imagemap);
@@ -1136,6 +1234,268 @@ void wxImagePanel::ResampleData(
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void wxImagePanel::ResampleDataProgressive(
+	bool fRedraw
+) {
+	const size_t sMapWidth = m_dSampleX.size();
+	const size_t sMapHeight = m_dSampleY.size();
+	const size_t sPixels = sMapWidth * sMapHeight;
+
+	if (sPixels < PROGRESSIVE_MIN_PIXELS) {
+		ResampleData(fRedraw);
+		return;
+	}
+
+	const size_t sFactor = (sPixels >= PROGRESSIVE_EIGHTH_PIXELS)?(8):(4);
+
+	// Sample the center of each sFactor x sFactor block
+	const size_t sCoarseWidth = (sMapWidth + sFactor - 1) / sFactor;
+	const size_t sCoarseHeight = (sMapHeight + sFactor - 1) / sFactor;
+
+	std::vector<double> dCoarseX(sCoarseWidth);
+	for (size_t i = 0; i < sCoarseWidth; i++) {
+		dCoarseX[i] = m_dSampleX[std::min(i * sFactor + sFactor / 2, sMapWidth - 1)];
+	}
+	std::vector<double> dCoarseY(sCoarseHeight);
+	for (size_t j = 0; j < sCoarseHeight; j++) {
+		dCoarseY[j] = m_dSampleY[std::min(j * sFactor + sFactor / 2, sMapHeight - 1)];
+	}
+
+	std::vector<int> imagemapCoarse(sCoarseWidth * sCoarseHeight);
+
+	m_pncvisparent->UpdateDataWindow(m_dSampleX, m_dSampleY);
+
+	m_pncvisparent->SampleData(dCoarseX, dCoarseY, imagemapCoarse);
+
+	// Upscale by replication
+	m_imagemap.resize(sPixels);
+	for (size_t j = 0; j < sMapHeight; j++) {
+		const int * pCoarseRow = &(imagemapCoarse[(j / sFactor) * sCoarseWidth]);
+		int * pRow = &(m_imagemap[j * sMapWidth]);
+		for (size_t i = 0; i < sMapWidth; i++) {
+			pRow[i] = pCoarseRow[i / sFactor];
+		}
+	}
+
+	// Queue refinement; any earlier refinement refers to the previous view
+	// and is superseded
+	m_iRefineRow = 0;
+
+	if (fRedraw) {
+		GenerateImageFromImageMap(true);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool wxImagePanel::RefineImageMap() {
+	if (m_iRefineRow < 0) {
+		return false;
+	}
+
+	const size_t sMapWidth = m_dSampleX.size();
+	const size_t sMapHeight = m_dSampleY.size();
+
+	if ((sMapWidth == 0) || (m_imagemap.size() != sMapWidth * sMapHeight)) {
+		CancelRefinement();
+		return false;
+	}
+
+	size_t sRows = std::max<size_t>(1, PROGRESSIVE_REFINE_PIXELS / sMapWidth);
+	size_t sRow0 = static_cast<size_t>(m_iRefineRow);
+	size_t sRow1 = std::min(sRow0 + sRows, sMapHeight);
+
+	ResampleBlock(0, sMapWidth, sRow0, sRow1);
+
+	if (sRow1 < sMapHeight) {
+		m_iRefineRow = static_cast<int>(sRow1);
+		return true;
+	}
+
+	if (m_pncvisparent->IsVerbose()) {
+		std::cout << "REFINED" << std::endl;
+	}
+
+	CancelRefinement();
+	GenerateImageFromImageMap(true);
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void wxImagePanel::GenerateSampleCoords(
+	size_t sMapWidth,
+	size_t sMapHeight
+) {
+	m_dSampleX.resize(sMapWidth);
+	for (size_t i = 0; i < sMapWidth; i++) {
+		m_dSampleX[i] = m_dXrange[0] + (m_dXrange[1] - m_dXrange[0]) * (static_cast<double>(i) + 0.5) / static_cast<double>(sMapWidth);
+	}
+
+	m_dSampleY.resize(sMapHeight);
+	for (size_t j = 0; j < sMapHeight; j++) {
+		m_dSampleY[j] = m_dYrange[0] + (m_dYrange[1] - m_dYrange[0]) * (static_cast<double>(j) + 0.5) / static_cast<double>(sMapHeight);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void wxImagePanel::ResampleBlock(
+	size_t sX0,
+	size_t sX1,
+	size_t sY0,
+	size_t sY1
+) {
+	if ((sX0 >= sX1) || (sY0 >= sY1)) {
+		return;
+	}
+
+	const size_t sMapWidth = m_dSampleX.size();
+
+	_ASSERT(sX1 <= sMapWidth);
+	_ASSERT(sY1 <= m_dSampleY.size());
+
+	std::vector<double> dSampleX(m_dSampleX.begin() + sX0, m_dSampleX.begin() + sX1);
+	std::vector<double> dSampleY(m_dSampleY.begin() + sY0, m_dSampleY.begin() + sY1);
+	std::vector<int> imagemap(dSampleX.size() * dSampleY.size());
+
+	m_pncvisparent->SampleData(dSampleX, dSampleY, imagemap);
+
+	for (size_t j = 0; j < dSampleY.size(); j++) {
+		memcpy(
+			&(m_imagemap[(sY0 + j) * sMapWidth + sX0]),
+			&(imagemap[j * dSampleX.size()]),
+			dSampleX.size() * sizeof(int));
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void wxImagePanel::PanImage(
+	int nPixelsX,
+	int nPixelsY,
+	bool fRedraw
+) {
+	_ASSERT(m_pncvisparent != NULL);
+
+	const int nMapWidth = static_cast<int>(m_dSampleX.size());
+	const int nMapHeight = static_cast<int>(m_dSampleY.size());
+
+	if ((nMapWidth == 0) || (nMapHeight == 0)) {
+		return;
+	}
+	if (m_imagemap.size() != m_dSampleX.size() * m_dSampleY.size()) {
+		return;
+	}
+
+	const double dPixelX = (m_dXrange[1] - m_dXrange[0]) / static_cast<double>(nMapWidth);
+	const double dPixelY = (m_dYrange[1] - m_dYrange[0]) / static_cast<double>(nMapHeight);
+
+	// The map follows the cursor, so the sample grid moves opposite to the
+	// cursor in X; rows of the image map are stored bottom-up so the sample
+	// grid moves with the cursor in Y.
+	int nShiftX = -nPixelsX;
+	int nShiftY = nPixelsY;
+
+	// Impose bounds, without pulling in a view that is already out of bounds
+	if (!m_pncvisparent->IsDisplayedDimensionPeriodic(1)) {
+		double dXmin = m_pncvisparent->GetDisplayedDimensionMin(1);
+		double dXmax = m_pncvisparent->GetDisplayedDimensionMax(1);
+
+		int nShiftMin = static_cast<int>(std::ceil((dXmin - m_dXrange[0]) / dPixelX - 1.0e-6));
+		int nShiftMax = static_cast<int>(std::floor((dXmax - m_dXrange[1]) / dPixelX + 1.0e-6));
+
+		if (nShiftX < std::min(nShiftMin, 0)) {
+			nShiftX = std::min(nShiftMin, 0);
+		}
+		if (nShiftX > std::max(nShiftMax, 0)) {
+			nShiftX = std::max(nShiftMax, 0);
+		}
+	}
+	if (!m_pncvisparent->IsDisplayedDimensionPeriodic(0)) {
+		double dYmin = m_pncvisparent->GetDisplayedDimensionMin(0);
+		double dYmax = m_pncvisparent->GetDisplayedDimensionMax(0);
+
+		int nShiftMin = static_cast<int>(std::ceil((dYmin - m_dYrange[0]) / dPixelY - 1.0e-6));
+		int nShiftMax = static_cast<int>(std::floor((dYmax - m_dYrange[1]) / dPixelY + 1.0e-6));
+
+		if (nShiftY < std::min(nShiftMin, 0)) {
+			nShiftY = std::min(nShiftMin, 0);
+		}
+		if (nShiftY > std::max(nShiftMax, 0)) {
+			nShiftY = std::max(nShiftMax, 0);
+		}
+	}
+
+	if ((nShiftX == 0) && (nShiftY == 0)) {
+		return;
+	}
+
+	if (m_pncvisparent->IsVerbose()) {
+		std::cout << "PAN " << nShiftX << " " << nShiftY << std::endl;
+	}
+
+	m_dXrange[0] += static_cast<double>(nShiftX) * dPixelX;
+	m_dXrange[1] += static_cast<double>(nShiftX) * dPixelX;
+	m_dYrange[0] += static_cast<double>(nShiftY) * dPixelY;
+	m_dYrange[1] += static_cast<double>(nShiftY) * dPixelY;
+
+	GenerateSampleCoords(nMapWidth, nMapHeight);
+
+	m_pncvisparent->SetDisplayedBounds(m_dXrange[0], m_dXrange[1], m_dYrange[0], m_dYrange[1]);
+
+	// Nothing overlaps, or the data was read again to cover the new view;
+	// resample everything
+	if ((std::abs(nShiftX) >= nMapWidth) || (std::abs(nShiftY) >= nMapHeight) ||
+	    (m_pncvisparent->UpdateDataWindow(m_dSampleX, m_dSampleY))
+	) {
+		ResampleData(fRedraw);
+		return;
+	}
+
+	// Image map is partly coarse; restart progressive sampling
+	if (m_iRefineRow >= 0) {
+		ResampleDataProgressive(fRedraw);
+		return;
+	}
+
+	// Shift the overlapping portion of the image map in place, so that
+	// the new sample (i,j) takes the old sample (i+nShiftX,j+nShiftY).
+	// Rows are visited in the direction that never overwrites a source row.
+	const int nKeepX0 = std::max(-nShiftX, 0);
+	const int nKeepX1 = nMapWidth - std::max(nShiftX, 0);
+	const int nKeepY0 = std::max(-nShiftY, 0);
+	const int nKeepY1 = nMapHeight - std::max(nShiftY, 0);
+	const size_t sKeepWidth = static_cast<size_t>(nKeepX1 - nKeepX0);
+
+	for (int jj = 0; jj < nKeepY1 - nKeepY0; jj++) {
+		int j = (nShiftY >= 0)?(nKeepY0 + jj):(nKeepY1 - 1 - jj);
+		memmove(
+			&(m_imagemap[j * nMapWidth + nKeepX0]),
+			&(m_imagemap[(j + nShiftY) * nMapWidth + nKeepX0 + nShiftX]),
+			sKeepWidth * sizeof(int));
+	}
+
+	// Sample the exposed columns over all rows and the exposed rows over
+	// the retained columns
+	if (nShiftX > 0) {
+		ResampleBlock(nKeepX1, nMapWidth, 0, nMapHeight);
+	} else if (nShiftX < 0) {
+		ResampleBlock(0, nKeepX0, 0, nMapHeight);
+	}
+	if (nShiftY > 0) {
+		ResampleBlock(nKeepX0, nKeepX1, nKeepY1, nMapHeight);
+	} else if (nShiftY < 0) {
+		ResampleBlock(nKeepX0, nKeepX1, 0, nKeepY0);
+	}
+
+	if (fRedraw) {
+		GenerateImageFromImageMap(true);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 void wxImagePanel::SetCoordinateRange(
 	size_t sMapWidth,
 	size_t sMapHeight,
@@ -1150,19 +1510,17 @@ void wxImagePanel::SetCoordinateRange(
 	m_dYrange[0] = dY0;
 	m_dYrange[1] = dY1;
 
-	m_dSampleX.resize(sMapWidth);
-	for (size_t i = 0; i < sMapWidth; i++) {
-		m_dSampleX[i] = m_dXrange[0] + (m_dXrange[1] - m_dXrange[0]) * (static_cast<double>(i) + 0.5) / static_cast<double>(sMapWidth);
-	}
-
-	m_dSampleY.resize(sMapHeight);
-	for (size_t j = 0; j < sMapHeight; j++) {
-		m_dSampleY[j] = m_dYrange[0] + (m_dYrange[1] - m_dYrange[0]) * (static_cast<double>(j) + 0.5) / static_cast<double>(sMapHeight);
-	}
+	GenerateSampleCoords(sMapWidth, sMapHeight);
 
 	m_pncvisparent->SetDisplayedBounds(m_dXrange[0], m_dXrange[1], m_dYrange[0], m_dYrange[1]);
 
-	ResampleData(fRedraw);
+	// Interactive redraws may be rendered coarse-to-fine; images drawn
+	// without a redraw (such as exports) are always sampled in full
+	if (fRedraw && m_fEnableRedraw && m_pncvisparent->IsProgressive()) {
+		ResampleDataProgressive(fRedraw);
+	} else {
+		ResampleData(fRedraw);
+	}
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1518,6 +1876,9 @@ bool wxImagePanel::ExportToPNG(
 		}
 	}
 
+	// Complete any pending progressive refinement
+	while (RefineImageMap());
+
 	std::vector<unsigned char> pngimage(sImageWidth * sImageHeight * 4);
 
 	GenerateImageDataFromImageMap<4>(
@@ -91,6 +91,21 @@ public:
 	///	</summary>
 	void OnMouseLeftDoubleClick(wxMouseEvent & evt);
 
+	///	<summary>
+	///		Callback for when the left mouse button is pressed.
+	///	</summary>
+	void OnMouseLeftDown(wxMouseEvent & evt);
+
+	///	<summary>
+	///		Callback for when the left mouse button is released.
+	///	</summary>
+	void OnMouseLeftUp(wxMouseEvent & evt);
+
+	///	<summary>
+	///		Callback for when the mouse capture is lost during a drag.
+	///	</summary>
+	void OnMouseCaptureLost(wxMouseCaptureLostEvent & evt);
+
 public:
 	///	<summary>
 	///		Format a label bar label from a value.
@@ -176,6 +191,40 @@ public:
 		bool fRedraw = false
 	);
 
+	///	<summary>
+	///		Sample a coarse image map, upscale it and display it, then queue
+	///		refinement to full resolution during idle time.
+	///	</summary>
+	void ResampleDataProgressive(
+		bool fRedraw = false
+	);
+
+	///	<summary>
+	///		Refine the next band of rows of a progressive image map.
+	///	</summary>
+	///	<returns>
+	///		true if refinement is still pending, false otherwise.
+	///	</returns>
+	bool RefineImageMap();
+
+	///	<summary>
+	///		Cancel any pending progressive refinement.
+	///	</summary>
+	void CancelRefinement() {
+		m_iRefineRow = (-1);
+	}
+
+	///	<summary>
+	///		Translate the displayed region by a whole number of pixels.  The
+	///		overlapping portion of the image map is shifted in place and only
+	///		the newly exposed rows and columns are resampled.
+	///	</summary>
+	void PanImage(
+		int nPixelsX,
+		int nPixelsY,
+		bool fRedraw = false
+	);
+
 	///	<summary>
 	///		Resample the coordinate range.
 	///	</summary>
@@ -244,6 +293,25 @@ public:
 		m_fEnableRedraw = fEnableRedraw;
 	}
 
+protected:
+	///	<summary>
+	///		Generate the sample coordinates from the coordinate range.
+	///	</summary>
+	void GenerateSampleCoords(
+		size_t sMapWidth,
+		size_t sMapHeight
+	);
+
+	///	<summary>
+	///		Resample a rectangular block of the image map.
+	///	</summary>
+	void ResampleBlock(
+		size_t sX0,
+		size_t sX1,
+		size_t sY0,
+		size_t sY1
+	);
+
 public:
 	///	<summary>
 	///		Get the x coordinate range minimum.
@@ -273,6 +341,20 @@ public:
 		return m_dYrange[1];
 	}
 
+	///	<summary>
+	///		Get the sample points in the x direction.
+	///	</summary>
+	const std::vector<double> & GetSampleX() const {
+		return m_dSampleX;
+	}
+
+	///	<summary>
+	///		Get the sample points in the y direction.
+	///	</summary>
+	const std::vector<double> & GetSampleY() const {
+		return m_dSampleY;
+	}
+
 	///	<summary>
 	///		Get the data range minimum.
 	///	</summary>
@@ -287,6 +369,13 @@ public:
 		return m_dDataRange[1];
 	}
 
+	///	<summary>
+	///		Get the image map.
+	///	</summary>
+	std::vector<int> & GetImageMapRef() {
+		return m_imagemap;
+	}
+
 	///	<summary>
 	///		Get the overlay data.
 	///	</summary>
@@ -455,6 +544,22 @@ private:
 	///	</summary>
 	bool m_fResize;
 
+	///	<summary>
+	///		A flag indicating the map is being dragged.
+	///	</summary>
+	bool m_fDragging;
+
+	///	<summary>
+	///		Last mouse position during a drag.
+	///	</summary>
+	wxPoint m_posDragLast;
+
+	///	<summary>
+	///		Next row of the image map to refine to full resolution, or (-1)
+	///		if no refinement is pending.
+	///	</summary>
+	int m_iRefineRow;
+
 	DECLARE_EVENT_TABLE()
 };
 
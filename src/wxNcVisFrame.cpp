@@ -14,8 +14,11 @@
 #include "STLStringHelper.h"
 #include "ShpFile.h"
 #include "TimeObj.h"
+#include <algorithm>
+#include <cstdlib>
 #include <set>
 #include <limits>
+#include <sstream>
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -23,6 +26,48 @@ static const char * szVersion = "NcVis 2024.01.26";
 
 static const char * szDevInfo = "Supported by the U.S. Department of Energy Office of Science Regional and Global Model Analysis (RGMA) Project Simplifying ESM Analysis Through Standards (SEATS)";
 
+///	<summary>
+///		Number of mesh points at or above which the out-of-core sampler is
+///		used when no sampler is specified.
+///	</summary>
+static const size_t DiskIndexAutoPoints = static_cast<size_t>(1) << 28;
+
+///	<summary>
+///		Maximum number of chunks of streamed points read ahead of the
+///		worker thread building the out-of-core index.
+///	</summary>
+static const size_t DiskIndexStreamChunks = 4;
+
+///	<summary>
+///		Maximum number of data indices read per sample along each displayed
+///		dimension of a structured variable; denser fields are decimated.
+///	</summary>
+static const long DataWindowOversample = 2;
+
+///	<summary>
+///		Margin added to each side of the data read for a structured
+///		variable, as a fraction of the sampled index span, so that small
+///		pans do not require the data to be read again.
+///	</summary>
+static const double DataWindowMargin = 0.25;
+
+///	<summary>
+///		Number of points in the unstructured dimension at or above which
+///		only the indices referenced by the image map are read.
+///	</summary>
+static const size_t DataGatherMinPoints = 1024 * 1024;
+
+///	<summary>
+///		Number of indices of the unstructured dimension in each gathered
+///		unit if the variable is not stored in chunks.
+///	</summary>
+static const size_t DataGatherDefaultUnit = 4096;
+
+///	<summary>
+///		Number of slices read ahead along the animated or exported dimension.
+///	</summary>
+static const size_t DataPrefetchFrames = 4;
+
 ////////////////////////////////////////////////////////////////////////////////
 
 enum {
@@ -48,7 +93,8 @@ enum {
 	ID_AXESX = 1000,
 	ID_AXESY = 1100,
 	ID_AXESXY = 1200,
-	ID_DIMTIMER = 10000
+	ID_DIMTIMER = 10000,
+	ID_GDSTIMER = 10001
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -70,6 +116,7 @@ wxBEGIN_EVENT_TABLE(wxNcVisFrame, wxFrame)
 	EVT_COMBOBOX(ID_OVERLAYS, wxNcVisFrame::OnOverlaysCombo)
 	EVT_COMBOBOX(ID_SAMPLER, wxNcVisFrame::OnSamplerCombo)
 	EVT_TIMER(ID_DIMTIMER, wxNcVisFrame::OnDimTimer)
+	EVT_TIMER(ID_GDSTIMER, wxNcVisFrame::OnGridDataSamplerTimer)
 wxEND_EVENT_TABLE()
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -84,12 +131,19 @@ wxNcVisFrame::wxNcVisFrame(
 ) :
 	wxFrame(NULL, wxID_ANY, title, pos, size),
 	m_fVerbose(false),
+	m_fProgressive(false),
 	m_wxstrNcVisResourceDir(wxstrNcVisResourceDir),
 	m_mapOptions(mapOptions),
 	m_fRegional(false),
 	m_dMaxCellRadius(0.0),
+	m_pThreadPool(NULL),
+	m_fAdaptiveSampling(false),
+	m_sIndexCacheBytes(static_cast<size_t>(4096) * 1024 * 1024),
+	m_sIndexBuildBytes(GridDataSamplerUsingDiskIndex::DefaultBuildMemoryBytes),
 	m_colormaplib(wxstrNcVisResourceDir),
 	m_egdsoption(GridDataSamplerOption_QuadTree),
+	m_fDetectAnalyticGrids(true),
+	m_fAutoSelectSampler(false),
 	m_wxDataTransButton(NULL),
 	m_panelsizer(NULL),
 	m_ctrlsizer(NULL),
@@ -98,10 +152,28 @@ wxNcVisFrame::wxNcVisFrame(
 	m_imagepanel(NULL),
 	m_wxNcVisExportDialog(NULL),
 	m_wxDimTimer(this,ID_DIMTIMER),
+	m_wxGridDataSamplerTimer(this,ID_GDSTIMER),
+	m_pncfileActive(NULL),
 	m_varActive(NULL),
 	m_fIsVarActiveUnstructured(false),
 	m_lAnimatedDim(-1),
 	m_sColorMap(0),
+	m_sGridDataSamplerCacheBytes(1024 * 1024 * 1024),
+	m_pgdsPending(NULL),
+	m_egdsoptionPending(GridDataSamplerOption_QuadTree),
+	m_fGridDataSamplerChunksEnd(false),
+	m_fGridDataSamplerChunksAbort(false),
+	m_fGridDataSamplerBuilt(false),
+	m_varDataWindowLoaded(NULL),
+	m_sDataGatherPoints(0),
+	m_sDataGatherUnit(1),
+	m_varDataGatherLoaded(NULL),
+	m_fDataRangeFromGather(false),
+	m_varDataSlabs(NULL),
+	m_sDataSliceCacheBytes(256 * 1024 * 1024),
+	m_sDataSliceCacheUsage(0),
+	m_sDataSliceCacheHits(0),
+	m_sDataSliceCacheMisses(0),
 	m_fDataHasMissingValue(false)
 {
 	std::cout << szVersion << " Paul A. Ullrich" << std::endl;
@@ -122,6 +194,12 @@ wxNcVisFrame::wxNcVisFrame(
 	m_data.resize(1);
 	m_data[0] = 0.0;
 
+	for (int i = 0; i < 2; i++) {
+		m_datawindow.lBegin[i] = 0;
+		m_datawindow.lStride[i] = 1;
+		m_datawindow.lCount[i] = 0;
+	}
+
 	if (m_colormaplib.GetColorMapCount() == 0) {
 		_EXCEPTIONT("FATAL ERROR: At least one colormap must be specified");
 	}
@@ -132,6 +210,9 @@ wxNcVisFrame::wxNcVisFrame(
 	if (mapOptions.find("-r") != mapOptions.end()) {
 		m_fRegional = true;
 	}
+	if (mapOptions.find("-progressive") != mapOptions.end()) {
+		m_fProgressive = true;
+	}
 
 	auto itMCS = mapOptions.find("-mcr");
 	if (itMCS != mapOptions.end()) {
@@ -141,6 +222,106 @@ wxNcVisFrame::wxNcVisFrame(
 		}
 	}
 
+	size_t sThreads = 0;
+	auto itThreads = mapOptions.find("-threads");
+	if (itThreads != mapOptions.end()) {
+		int iThreads = stoi(itThreads->second.ToStdString());
+		if (iThreads < 1) {
+			_EXCEPTIONT("Number of threads (-threads) must be positive");
+		}
+		sThreads = static_cast<size_t>(iThreads);
+	}
+	m_pThreadPool = new ThreadPool(sThreads);
+	if (m_fVerbose) {
+		Announce("Sampling with %lu thread(s)", m_pThreadPool->GetThreadCount());
+	}
+
+	if (mapOptions.find("-adaptive") != mapOptions.end()) {
+		m_fAdaptiveSampling = true;
+	}
+
+	auto itSamplerCacheMB = mapOptions.find("-sampler-cache-mb");
+	if (itSamplerCacheMB != mapOptions.end()) {
+		int iSamplerCacheMB = stoi(itSamplerCacheMB->second.ToStdString());
+		if (iSamplerCacheMB < 0) {
+			_EXCEPTIONT("Sampler cache size (-sampler-cache-mb) must be nonnegative");
+		}
+		m_sGridDataSamplerCacheBytes = static_cast<size_t>(iSamplerCacheMB) * 1024 * 1024;
+	}
+
+	auto itCacheMB = mapOptions.find("-cache-mb");
+	if (itCacheMB != mapOptions.end()) {
+		int iCacheMB = stoi(itCacheMB->second.ToStdString());
+		if (iCacheMB < 0) {
+			_EXCEPTIONT("Slice cache size (-cache-mb) must be nonnegative");
+		}
+		m_sDataSliceCacheBytes = static_cast<size_t>(iCacheMB) * 1024 * 1024;
+	}
+
+	// Directory used for caching built sampler indices
+	wxString wxstrIndexCacheDir;
+	if (mapOptions.find("-nocache") == mapOptions.end()) {
+		auto itCacheDir = mapOptions.find("-cachedir");
+		if (itCacheDir != mapOptions.end()) {
+			wxstrIndexCacheDir = itCacheDir->second;
+		} else if (std::getenv("NCVIS_CACHE_DIR") != NULL) {
+			wxstrIndexCacheDir = wxString(std::getenv("NCVIS_CACHE_DIR"));
+		} else if (std::getenv("XDG_CACHE_HOME") != NULL) {
+			wxstrIndexCacheDir = wxString(std::getenv("XDG_CACHE_HOME")) + wxString("/ncvis");
+		} else if (std::getenv("HOME") != NULL) {
+			wxstrIndexCacheDir = wxString(std::getenv("HOME")) + wxString("/.cache/ncvis");
+		}
+	}
+	if (wxstrIndexCacheDir.length() != 0) {
+		if (!wxFileName::DirExists(wxstrIndexCacheDir) &&
+		    !wxFileName::Mkdir(wxstrIndexCacheDir, wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL)
+		) {
+			Announce("WARNING: Unable to create index cache directory \"%s\"",
+				wxstrIndexCacheDir.ToStdString().c_str());
+			wxstrIndexCacheDir = wxString("");
+		}
+	}
+	if (m_fVerbose && (wxstrIndexCacheDir.length() != 0)) {
+		Announce("Caching sampler indices in \"%s\"",
+			wxstrIndexCacheDir.ToStdString().c_str());
+	}
+
+	m_strIndexCacheDir = wxstrIndexCacheDir.ToStdString();
+
+	auto itIndexCacheMB = mapOptions.find("-index-cache-mb");
+	if (itIndexCacheMB != mapOptions.end()) {
+		int iIndexCacheMB = stoi(itIndexCacheMB->second.ToStdString());
+		if (iIndexCacheMB < 0) {
+			_EXCEPTIONT("Index cache size (-index-cache-mb) must be nonnegative");
+		}
+		m_sIndexCacheBytes = static_cast<size_t>(iIndexCacheMB) * 1024 * 1024;
+	}
+
+	if (m_strIndexCacheDir != "") {
+		TrimIndexCache(m_strIndexCacheDir, m_sIndexCacheBytes);
+	}
+
+	// Directory and memory used for building out-of-core indices
+	auto itScratchDir = mapOptions.find("-scratchdir");
+	if (itScratchDir != mapOptions.end()) {
+		m_strScratchDir = itScratchDir->second.ToStdString();
+	} else {
+		m_strScratchDir = wxFileName::GetTempDir().ToStdString();
+	}
+
+	auto itIndexBuildMB = mapOptions.find("-index-build-mb");
+	if (itIndexBuildMB != mapOptions.end()) {
+		int iIndexBuildMB = stoi(itIndexBuildMB->second.ToStdString());
+		if (iIndexBuildMB < 1) {
+			_EXCEPTIONT("Index build memory (-index-build-mb) must be positive");
+		}
+		m_sIndexBuildBytes = static_cast<size_t>(iIndexBuildMB) * 1024 * 1024;
+	}
+
+	for (int e = GridDataSamplerOption_First; e <= GridDataSamplerOption_Last; e++) {
+		ConfigureGridDataSampler(GetGridDataSampler((GridDataSamplerOption)(e)));
+	}
+
 	auto itUXC = mapOptions.find("-uxc");
 	auto itUYC = mapOptions.find("-uyc");
 
@@ -158,6 +339,24 @@ wxNcVisFrame::wxNcVisFrame(
 
 ////////////////////////////////////////////////////////////////////////////////
 
+wxNcVisFrame::~wxNcVisFrame() {
+	m_dataprefetcher.Stop();
+	if (m_thrGridDataSampler.joinable()) {
+		m_thrGridDataSampler.join();
+	}
+	if (m_pgdsPending != NULL) {
+		delete m_pgdsPending;
+	}
+	for (auto it = m_gdscache.begin(); it != m_gdscache.end(); it++) {
+		delete it->pgds;
+	}
+	if (m_pThreadPool != NULL) {
+		delete m_pThreadPool;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 bool wxNcVisFrame::GetLonLatVariableNameIter(
 	VariableNameFileIxMap::const_iterator & itLon,
 	VariableNameFileIxMap::const_iterator & itLat
@@ -201,15 +400,526 @@ bool wxNcVisFrame::GetLonLatDimDataIter(
 
 ////////////////////////////////////////////////////////////////////////////////
 
+std::string wxNcVisFrame::GetGridDataSamplerKey() const {
+
+	std::string strGridKey;
+
+	if (m_strVarActiveMultidimLon == "") {
+		VariableNameFileIxMap::const_iterator itLon;
+		VariableNameFileIxMap::const_iterator itLat;
+		bool fSuccess = GetLonLatVariableNameIter(itLon, itLat);
+		if (!fSuccess) {
+			return std::string("");
+		}
+
+		strGridKey = itLon->first + ";" + itLat->first;
+
+	} else {
+		if ((m_varActive == NULL) || (m_lDisplayedDims[0] < 0)) {
+			return std::string("");
+		}
+
+		DataPrefetcher::NetCDFLock lockNetCDF;
+
+		strGridKey =
+			m_strVarActiveMultidimLon + ";"
+			+ m_strVarActiveMultidimLat + ";"
+			+ m_varActive->get_dim(m_lDisplayedDims[0])->name();
+
+		long lCurvilinearDim = GetCurvilinearDim();
+		if (lCurvilinearDim != (-1)) {
+			strGridKey += std::string(";") + m_varActive->get_dim(lCurvilinearDim)->name();
+		}
+	}
+
+	if (m_fRegional) {
+		strGridKey += ";regional";
+	}
+
+	return strGridKey;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void wxNcVisFrame::ConfigureGridDataSampler(
+	GridDataSampler & gds
+) const {
+	gds.SetThreadPool(m_pThreadPool);
+	gds.SetIndexCacheDir(m_strIndexCacheDir);
+
+	// Cell polygons are rasterized exactly and never sampled adaptively
+	if (m_fAdaptiveSampling && (dynamic_cast<GridDataSamplerUsingCellPolygons *>(&gds) == NULL)) {
+		gds.SetAdaptiveTileSize(16);
+	}
+
+	GridDataSamplerUsingDiskIndex * pgdsdisk =
+		dynamic_cast<GridDataSamplerUsingDiskIndex *>(&gds);
+	if (pgdsdisk != NULL) {
+		pgdsdisk->SetScratchDir(m_strScratchDir);
+		pgdsdisk->SetBuildMemory(m_sIndexBuildBytes);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+GridDataSampler & wxNcVisFrame::GetGridDataSampler(
+	GridDataSamplerOption egdsoption
+) {
+	switch (egdsoption) {
+		case GridDataSamplerOption_QuadTree:
+			return m_gdsqt;
+		case GridDataSamplerOption_CubedSphereQuadTree:
+			return m_gdscsqt;
+		case GridDataSamplerOption_KDTree:
+			return m_gdskd;
+		case GridDataSamplerOption_MeshWalk:
+			return m_gdswalk;
+		case GridDataSamplerOption_CellPolygons:
+			return m_gdspoly;
+		case GridDataSamplerOption_CubedSphereLattice:
+			return m_gdscsl;
+		case GridDataSamplerOption_ReducedGaussian:
+			return m_gdsrg;
+		case GridDataSamplerOption_HEALPix:
+			return m_gdshp;
+		case GridDataSamplerOption_Curvilinear:
+			return m_gdscurv;
+		case GridDataSamplerOption_DiskIndex:
+			return m_gdsdisk;
+	}
+	_EXCEPTIONT("Invalid GridDataSamplerOption");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+///	<summary>
+///		Exchange the contents of gds with *pgds, allocating pgds if NULL.
+///	</summary>
+template <typename T>
+static GridDataSampler * SwapGridDataSamplerT(
+	T & gds,
+	GridDataSampler * pgds
+) {
+	T * pgdsT;
+	if (pgds == NULL) {
+		pgdsT = new T();
+	} else {
+		pgdsT = dynamic_cast<T *>(pgds);
+		_ASSERT(pgdsT != NULL);
+	}
+	std::swap(gds, *pgdsT);
+	return pgdsT;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+GridDataSampler * wxNcVisFrame::SwapGridDataSampler(
+	GridDataSamplerOption egdsoption,
+	GridDataSampler * pgds
+) {
+	switch (egdsoption) {
+		case GridDataSamplerOption_QuadTree:
+			return SwapGridDataSamplerT(m_gdsqt, pgds);
+		case GridDataSamplerOption_CubedSphereQuadTree:
+			return SwapGridDataSamplerT(m_gdscsqt, pgds);
+		case GridDataSamplerOption_KDTree:
+			return SwapGridDataSamplerT(m_gdskd, pgds);
+		case GridDataSamplerOption_MeshWalk:
+			return SwapGridDataSamplerT(m_gdswalk, pgds);
+		case GridDataSamplerOption_CellPolygons:
+			return SwapGridDataSamplerT(m_gdspoly, pgds);
+		case GridDataSamplerOption_CubedSphereLattice:
+			return SwapGridDataSamplerT(m_gdscsl, pgds);
+		case GridDataSamplerOption_ReducedGaussian:
+			return SwapGridDataSamplerT(m_gdsrg, pgds);
+		case GridDataSamplerOption_HEALPix:
+			return SwapGridDataSamplerT(m_gdshp, pgds);
+		case GridDataSamplerOption_Curvilinear:
+			return SwapGridDataSamplerT(m_gdscurv, pgds);
+		case GridDataSamplerOption_DiskIndex:
+			return SwapGridDataSamplerT(m_gdsdisk, pgds);
+	}
+	_EXCEPTIONT("Invalid GridDataSamplerOption");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void wxNcVisFrame::CacheGridDataSamplers() {
+
+	if (m_strGridDataSamplerKey != "") {
+		for (int e = GridDataSamplerOption_First; e <= GridDataSamplerOption_Last; e++) {
+			GridDataSamplerOption egdsoption = (GridDataSamplerOption)(e);
+
+			GridDataSampler & gds = GetGridDataSampler(egdsoption);
+			if (!gds.IsInitialized()) {
+				continue;
+			}
+
+			GridDataSamplerCacheEntry entry;
+			entry.strGridKey = m_strGridDataSamplerKey;
+			entry.egdsoption = egdsoption;
+			entry.pgds = SwapGridDataSampler(egdsoption, NULL);
+			entry.dLonBounds[0] = m_dgdsLonBounds[0];
+			entry.dLonBounds[1] = m_dgdsLonBounds[1];
+			entry.dLatBounds[0] = m_dgdsLatBounds[0];
+			entry.dLatBounds[1] = m_dgdsLatBounds[1];
+			entry.sMemoryUsage = entry.pgds->GetMemoryUsage();
+			m_gdscache.push_front(entry);
+
+			ConfigureGridDataSampler(gds);
+		}
+	}
+
+	// Evict least recently used GridDataSamplers
+	size_t sCacheBytes = 0;
+	for (auto it = m_gdscache.begin(); it != m_gdscache.end(); it++) {
+		sCacheBytes += it->sMemoryUsage;
+	}
+	while ((m_gdscache.size() != 0) && (sCacheBytes > m_sGridDataSamplerCacheBytes)) {
+		sCacheBytes -= m_gdscache.back().sMemoryUsage;
+		delete m_gdscache.back().pgds;
+		m_gdscache.pop_back();
+	}
+
+	if (m_fVerbose) {
+		Announce("GridDataSampler cache: %lu sampler(s), %1.2f MB",
+			m_gdscache.size(),
+			static_cast<double>(sCacheBytes) / (1024.0 * 1024.0));
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool wxNcVisFrame::RestoreGridDataSampler(
+	bool fAnyOption
+) {
+	for (auto it = m_gdscache.begin(); it != m_gdscache.end(); it++) {
+		if (it->strGridKey != m_strGridDataSamplerKey) {
+			continue;
+		}
+		if (!fAnyOption && (it->egdsoption != m_egdsoption)) {
+			continue;
+		}
+
+		m_egdsoption = it->egdsoption;
+
+		// The uninitialized GridDataSampler is returned in it->pgds
+		SwapGridDataSampler(it->egdsoption, it->pgds);
+		delete it->pgds;
+
+		m_dgdsLonBounds[0] = it->dLonBounds[0];
+		m_dgdsLonBounds[1] = it->dLonBounds[1];
+		m_dgdsLatBounds[0] = it->dLatBounds[0];
+		m_dgdsLatBounds[1] = it->dLatBounds[1];
+
+		m_gdscache.erase(it);
+
+		Announce("Reusing cached GridDataSampler");
+		return true;
+	}
+
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void wxNcVisFrame::ResetGridDataSamplerBounds() {
+	m_dgdsLonBounds[0] = std::numeric_limits<double>::max();
+	m_dgdsLonBounds[1] = -std::numeric_limits<double>::max();
+	m_dgdsLatBounds[0] = std::numeric_limits<double>::max();
+	m_dgdsLatBounds[1] = -std::numeric_limits<double>::max();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void wxNcVisFrame::UpdateGridDataSamplerBounds(
+	const double * pLon,
+	const double * pLat,
+	size_t sPoints,
+	double dFillValue
+) {
+	for (size_t i = 0; i < sPoints; i++) {
+		if ((pLon[i] == dFillValue) || (std::isnan(pLon[i]))) {
+			continue;
+		}
+		if ((pLat[i] == dFillValue) || (std::isnan(pLat[i]))) {
+			continue;
+		}
+
+		if (pLon[i] < m_dgdsLonBounds[0]) {
+			m_dgdsLonBounds[0] = pLon[i];
+		}
+		if (pLon[i] > m_dgdsLonBounds[1]) {
+			m_dgdsLonBounds[1] = pLon[i];
+		}
+		if (pLat[i] < m_dgdsLatBounds[0]) {
+			m_dgdsLatBounds[0] = pLat[i];
+		}
+		if (pLat[i] > m_dgdsLatBounds[1]) {
+			m_dgdsLatBounds[1] = pLat[i];
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void wxNcVisFrame::SnapGridDataSamplerBounds() {
+	if (m_fRegional) {
+		return;
+	}
+
+	if (fabs(m_dgdsLonBounds[1] - m_dgdsLonBounds[0] - 360.0) < 1.0) {
+		if (fabs(m_dgdsLonBounds[0]) < 1.0) {
+			m_dgdsLonBounds[0] = 0.0;
+		}
+		if (fabs(m_dgdsLonBounds[0] + 180.0) < 1.0) {
+			m_dgdsLonBounds[0] = -180.0;
+		}
+		m_dgdsLonBounds[1] = m_dgdsLonBounds[0] + 360.0;
+	}
+	if ((fabs(m_dgdsLatBounds[0] + 90.0) < 1.0) && (fabs(m_dgdsLatBounds[1] - 90.0) < 1.0)) {
+		m_dgdsLatBounds[0] = -90.0;
+		m_dgdsLatBounds[1] = 90.0;
+	}
+	if (fabs(m_dgdsLonBounds[1] - m_dgdsLonBounds[0] - 2.0 * M_PI) < 0.1) {
+		if (fabs(m_dgdsLonBounds[0]) < 0.1) {
+			m_dgdsLonBounds[0] = 0.0;
+		}
+		if (fabs(m_dgdsLonBounds[0] + M_PI) < 0.1) {
+			m_dgdsLonBounds[0] = - M_PI;
+		}
+		m_dgdsLonBounds[1] = m_dgdsLonBounds[0] + 2.0 * M_PI;
+	}
+	if ((fabs(m_dgdsLatBounds[0] + 0.5 * M_PI) < 0.1) && (fabs(m_dgdsLatBounds[1] - 0.5 * M_PI) < 0.1)) {
+		m_dgdsLatBounds[0] = - 0.5 * M_PI;
+		m_dgdsLatBounds[1] = 0.5 * M_PI;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+wxNcVisFrame::GridDataSamplerOption wxNcVisFrame::SelectGridDataSampler(
+	const std::vector<double> & dLon,
+	const std::vector<double> & dLat,
+	double dFillValue
+) {
+	// Maximum number of grid points each candidate is built on
+	static const size_t MaxSubsamplePoints = 256 * 1024;
+
+	// Queries form a tensor product grid sampled in rounds of rows
+	static const size_t QueryWidth = 512;
+	static const size_t QueryHeight = 256;
+	static const size_t QueryRounds = 32;
+
+	// Candidates this many times slower than the fastest are dropped
+	static const double DropFactor = 4.0;
+
+	static const size_t CandidateCount = 3;
+	static const GridDataSamplerOption egdsoptionCandidate[CandidateCount] = {
+		GridDataSamplerOption_QuadTree,
+		GridDataSamplerOption_CubedSphereQuadTree,
+		GridDataSamplerOption_KDTree
+	};
+	static const char * szCandidate[CandidateCount] = {"qt", "csqt", "kd"};
+
+	if ((dLon.size() == 0) ||
+	    (m_dgdsLonBounds[0] > m_dgdsLonBounds[1]) ||
+	    (m_dgdsLatBounds[0] > m_dgdsLatBounds[1])
+	) {
+		return GridDataSamplerOption_QuadTree;
+	}
+
+	AnnounceStartBlock("Selecting GridDataSampler");
+
+	// Subsample the grid with a fixed stride
+	const size_t sStride = (dLon.size() + MaxSubsamplePoints - 1) / MaxSubsamplePoints;
+
+	std::vector<double> dSubLon;
+	std::vector<double> dSubLat;
+	dSubLon.reserve(dLon.size() / sStride + 1);
+	dSubLat.reserve(dLat.size() / sStride + 1);
+	for (size_t i = 0; i < dLon.size(); i += sStride) {
+		dSubLon.push_back(dLon[i]);
+		dSubLat.push_back(dLat[i]);
+	}
+
+	// Queries at cell centers of a regular grid spanning the grid bounds
+	std::vector<double> dQueryLon(QueryWidth);
+	std::vector<double> dQueryLat(QueryHeight);
+	for (size_t i = 0; i < QueryWidth; i++) {
+		dQueryLon[i] = m_dgdsLonBounds[0]
+			+ (m_dgdsLonBounds[1] - m_dgdsLonBounds[0])
+				* (static_cast<double>(i) + 0.5) / static_cast<double>(QueryWidth);
+	}
+	for (size_t j = 0; j < QueryHeight; j++) {
+		dQueryLat[j] = m_dgdsLatBounds[0]
+			+ (m_dgdsLatBounds[1] - m_dgdsLatBounds[0])
+				* (static_cast<double>(j) + 0.5) / static_cast<double>(QueryHeight);
+	}
+
+	// Build the candidates
+	GridDataSamplerUsingQuadTree gdsqt;
+	GridDataSamplerUsingCubedSphereQuadTree gdscsqt;
+	GridDataSamplerUsingKDTree gdskd;
+
+	GridDataSampler * pgdsCandidate[CandidateCount] = {&gdsqt, &gdscsqt, &gdskd};
+	long lBuildTime[CandidateCount];
+
+	for (size_t c = 0; c < CandidateCount; c++) {
+
+		// Candidates are tuned as the selected GridDataSampler will be, but
+		// indices of the subsampled grid are not worth caching
+		ConfigureGridDataSampler(*(pgdsCandidate[c]));
+		pgdsCandidate[c]->SetIndexCacheDir("");
+
+		wxStopWatch sw;
+		if (egdsoptionCandidate[c] == GridDataSamplerOption_QuadTree) {
+			if (m_fRegional) {
+				gdsqt.SetRegionalBounds(
+					m_dgdsLonBounds[0],
+					m_dgdsLonBounds[1],
+					m_dgdsLatBounds[0],
+					m_dgdsLatBounds[1]);
+			}
+			gdsqt.Initialize(dSubLon, dSubLat, dFillValue, m_dMaxCellRadius);
+		} else if (egdsoptionCandidate[c] == GridDataSamplerOption_CubedSphereQuadTree) {
+			gdscsqt.Initialize(dSubLon, dSubLat, dFillValue, m_dMaxCellRadius);
+		} else {
+			gdskd.Initialize(dSubLon, dSubLat, dFillValue);
+		}
+		lBuildTime[c] = sw.Time();
+	}
+
+	// Sample the queries one round at a time, dropping candidates that
+	// fall far behind so that a pathological candidate is not timed on
+	// the whole batch
+	double dQueryTime[CandidateCount];
+	size_t sRoundsSampled[CandidateCount];
+	for (size_t c = 0; c < CandidateCount; c++) {
+		dQueryTime[c] = 0.0;
+		sRoundsSampled[c] = 0;
+	}
+
+	const size_t sRoundRows = QueryHeight / QueryRounds;
+
+	std::vector<double> dRoundLat(sRoundRows);
+	std::vector<int> imagemap;
+
+	for (size_t r = 0; r < QueryRounds; r++) {
+		for (size_t j = 0; j < sRoundRows; j++) {
+			dRoundLat[j] = dQueryLat[r * sRoundRows + j];
+		}
+
+		double dFastest = std::numeric_limits<double>::max();
+		for (size_t c = 0; c < CandidateCount; c++) {
+			if (sRoundsSampled[c] != r) {
+				continue;
+			}
+
+			wxStopWatch sw;
+			pgdsCandidate[c]->Sample(dQueryLon, dRoundLat, imagemap);
+			dQueryTime[c] += sw.TimeInMicro().ToDouble() / 1000.0;
+			sRoundsSampled[c]++;
+
+			if (dQueryTime[c] < dFastest) {
+				dFastest = dQueryTime[c];
+			}
+		}
+
+		for (size_t c = 0; c < CandidateCount; c++) {
+			if ((sRoundsSampled[c] == r + 1) && (dQueryTime[c] > DropFactor * dFastest)) {
+				sRoundsSampled[c] = QueryRounds + 1;
+			}
+		}
+	}
+
+	// The fastest candidate that sampled every query is selected
+	size_t sSelected = 0;
+	for (size_t c = 0; c < CandidateCount; c++) {
+		if (sRoundsSampled[c] != QueryRounds) {
+			Announce("%-4s build %ldms, dropped", szCandidate[c], lBuildTime[c]);
+			continue;
+		}
+		Announce("%-4s build %ldms, %lu queries %1.2fms",
+			szCandidate[c], lBuildTime[c], QueryWidth * QueryHeight, dQueryTime[c]);
+
+		if ((sRoundsSampled[sSelected] != QueryRounds) ||
+		    (dQueryTime[c] < dQueryTime[sSelected])
+		) {
+			sSelected = c;
+		}
+	}
+
+	AnnounceEndBlock("Selected \"%s\" from %lu of %lu grid points",
+		szCandidate[sSelected], dSubLon.size(), dLon.size());
+
+	return egdsoptionCandidate[sSelected];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void wxNcVisFrame::StartGridDataSamplerBuild(
+	long lElapsedMs
+) {
+	m_egdsoptionPending = m_egdsoption;
+	m_pgdsPending = SwapGridDataSampler(m_egdsoption, NULL);
+	ConfigureGridDataSampler(GetGridDataSampler(m_egdsoption));
+
+	AnnounceResetProgress();
+	m_fGridDataSamplerBuilt = false;
+	m_excGridDataSampler = std::exception_ptr();
+	m_swGridDataSampler.Start(lElapsedMs);
+	m_thrGridDataSampler =
+		std::thread(&wxNcVisFrame::BuildGridDataSampler, this);
+	m_wxGridDataSamplerTimer.Start(100);
+
+	SetStatusMessage(_T(" Building sampler index"), true);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 void wxNcVisFrame::InitializeGridDataSampler() {
 
+	// Finish any GridDataSampler still being built
+	WaitForGridDataSampler();
+
 	NcError error(NcError::silent_nonfatal);
 
 	std::vector<double> dLon;
 	std::vector<double> dLat;
 
+	std::string strUnstructDimName;
+
+	size_t sCurvilinearNy = 0;
+	size_t sCurvilinearNx = 0;
+
 	double dFillValue = std::numeric_limits<double>::max();
 
+	// Keep GridDataSamplers built for the previous grid in the cache and
+	// reuse a cached GridDataSampler for this grid if available
+	std::string strGridKey = GetGridDataSamplerKey();
+	if (strGridKey != m_strGridDataSamplerKey) {
+		CacheGridDataSamplers();
+		m_strGridDataSamplerKey = strGridKey;
+	}
+	if ((strGridKey != "") && GetGridDataSampler(m_egdsoption).IsInitialized()) {
+		return;
+	}
+
+	// Each new grid selects its own GridDataSampler, so the type chosen
+	// for the previous grid must not limit which cached sampler is reused
+	if (m_fAutoSelectSampler) {
+		m_egdsoption = GridDataSamplerOption_QuadTree;
+	}
+
+	if ((strGridKey != "") && RestoreGridDataSampler(m_fAutoSelectSampler)) {
+		wxComboBox * wxSamplerCombo = dynamic_cast<wxComboBox *>(FindWindow(ID_SAMPLER));
+		if (wxSamplerCombo != NULL) {
+			wxSamplerCombo->SetSelection((int)m_egdsoption);
+		}
+		return;
+	}
+
 	// Get the latitude and longitude variables
 	if (m_strVarActiveMultidimLon == "") {
 		VariableNameFileIxMap::const_iterator itLon;
@@ -222,33 +932,145 @@ void wxNcVisFrame::InitializeGridDataSampler() {
 		std::string strLonName(itLon->first);
 		std::string strLatName(itLat->first);
 
-		// Check if lat and lon are the same length
-		NcVar * varLon = m_vecpncfiles[itLon->second[0]]->get_var(strLonName.c_str());
-		_ASSERT(varLon != NULL);
-		NcVar * varLat = m_vecpncfiles[itLat->second[0]]->get_var(strLatName.c_str());
-		_ASSERT(varLat != NULL);
+		NcVar * varLon = NULL;
+		NcVar * varLat = NULL;
+		size_t sPoints = 0;
+		{
+			DataPrefetcher::NetCDFLock lockNetCDF;
 
-		if (varLon->get_dim(0)->size() != varLat->get_dim(0)->size()) {
-			return;
+			// Check if lat and lon are the same length
+			varLon = m_vecpncfiles[itLon->second[0]]->get_var(strLonName.c_str());
+			_ASSERT(varLon != NULL);
+			varLat = m_vecpncfiles[itLat->second[0]]->get_var(strLatName.c_str());
+			_ASSERT(varLat != NULL);
+
+			if (varLon->get_dim(0)->size() != varLat->get_dim(0)->size()) {
+				return;
+			}
+
+			strUnstructDimName = varLon->get_dim(0)->name();
+
+			NcAtt * attFillValue = varLon->get_att("_FillValue");
+			if (attFillValue != NULL) {
+				dFillValue = attFillValue->as_double(0);
+			}
+
+			sPoints = varLon->get_dim(0)->size();
 		}
 
-		// At this point we can assume that the mesh is unstructured
-		dLon.resize(varLon->get_dim(0)->size());
-		dLat.resize(varLat->get_dim(0)->size());
+		// Meshes this large are indexed out of core unless another
+		// sampler was requested
+		if (m_fDetectAnalyticGrids &&
+		    (m_egdsoption == GridDataSamplerOption_QuadTree) &&
+		    (sPoints >= DiskIndexAutoPoints)
+		) {
+			Announce("Mesh has %lu points; using out-of-core sampler", sPoints);
+			m_egdsoption = GridDataSamplerOption_DiskIndex;
+		}
 
-		varLon->get(&(dLon[0]), varLon->get_dim(0)->size());
-		varLat->get(&(dLat[0]), varLat->get_dim(0)->size());
+		// Stream lon/lat into the out-of-core index in chunks, so that
+		// the coordinates are never held in memory
+		if (m_egdsoption == GridDataSamplerOption_DiskIndex) {
+			wxStopWatch sw;
+
+			const size_t sChunkSize = GridDataSamplerUsingDiskIndex::InitializeChunkSize;
+
+			auto fnReadChunk = [&](size_t s) {
+				const size_t sChunk = std::min(sChunkSize, sPoints - s);
+
+				dLon.resize(sChunk);
+				dLat.resize(sChunk);
+
+				DataPrefetcher::NetCDFLock lockNetCDF;
+				varLon->set_cur(static_cast<long>(s));
+				varLat->set_cur(static_cast<long>(s));
+				varLon->get(&(dLon[0]), static_cast<long>(sChunk));
+				varLat->get(&(dLat[0]), static_cast<long>(sChunk));
+			};
+
+			// Hash the points first, so that a cached index is found
+			// before any runs are sorted and spilled
+			ResetGridDataSamplerBounds();
+			m_gdsdisk.BeginInitialize(dFillValue, sPoints);
+
+			const bool fHashed = m_gdsdisk.IsIndexCacheUsed();
+			if (fHashed) {
+				for (size_t s = 0; s < sPoints; s += sChunkSize) {
+					fnReadChunk(s);
+					UpdateGridDataSamplerBounds(&(dLon[0]), &(dLat[0]), dLon.size(), dFillValue);
+					m_gdsdisk.HashPoints(&(dLon[0]), &(dLat[0]), dLon.size());
+				}
+			}
 
-		NcAtt * attFillValue = varLon->get_att("_FillValue");
-		if (attFillValue != NULL) {
-			dFillValue = attFillValue->as_double(0);
+			if (m_data.size() != sPoints) {
+				m_data.resize(sPoints);
+			}
+
+			wxComboBox * wxSamplerCombo = dynamic_cast<wxComboBox *>(FindWindow(ID_SAMPLER));
+			if (wxSamplerCombo != NULL) {
+				wxSamplerCombo->SetSelection((int)m_egdsoption);
+			}
+
+			if (fHashed && m_gdsdisk.InitializeFromCache()) {
+				SnapGridDataSamplerBounds();
+				std::vector<double>().swap(dLon);
+				std::vector<double>().swap(dLat);
+				Announce("Initializing the GridDataSampler took %ldms", sw.Time());
+				return;
+			}
+
+			// Runs are sorted and spilled on the worker thread as this
+			// thread reads the chunks, which are only read here
+			{
+				std::lock_guard<std::mutex> lock(m_mutexGridDataSamplerChunks);
+				m_dequeGridDataSamplerChunks.clear();
+				m_fGridDataSamplerChunksEnd = false;
+				m_fGridDataSamplerChunksAbort = false;
+			}
+
+			m_gdsinput.dFillValue = dFillValue;
+			m_gdsinput.fStreamed = true;
+			StartGridDataSamplerBuild(sw.Time());
+
+			try {
+				for (size_t s = 0; s < sPoints; s += sChunkSize) {
+					fnReadChunk(s);
+					if (!fHashed) {
+						UpdateGridDataSamplerBounds(&(dLon[0]), &(dLat[0]), dLon.size(), dFillValue);
+					}
+					if (!PushGridDataSamplerChunk(dLon, dLat)) {
+						break;
+					}
+				}
+
+			} catch(...) {
+				EndGridDataSamplerChunks(true);
+				throw;
+			}
+			EndGridDataSamplerChunks(false);
+
+			SnapGridDataSamplerBounds();
+
+			std::vector<double>().swap(dLon);
+			std::vector<double>().swap(dLat);
+			return;
 		}
 
+		// At this point we can assume that the mesh is unstructured
+		dLon.resize(sPoints);
+		dLat.resize(sPoints);
+
+		DataPrefetcher::NetCDFLock lockNetCDF;
+		varLon->get(&(dLon[0]), sPoints);
+		varLat->get(&(dLat[0]), sPoints);
+
 	// Multidimensional latitude and longitude already specified
 	} else {
 		_ASSERT(m_strVarActiveMultidimLat != "");
 		_ASSERT(m_varActive != NULL);
 
+		DataPrefetcher::NetCDFLock lockNetCDF;
+
 		int nDims = m_varActive->num_dims();
 		VariableNameFileIxMap::const_iterator itLon =
 			m_mapVarNames[nDims].find(m_strVarActiveMultidimLon);
@@ -274,26 +1096,47 @@ void wxNcVisFrame::InitializeGridDataSampler() {
 		_ASSERT(m_lDisplayedDims[0] >= 0);
 		_ASSERT(m_lDisplayedDims[0] < m_varActive->num_dims());
 
-		dLon.resize(varLon->get_dim(m_lDisplayedDims[0])->size());
-		dLat.resize(varLat->get_dim(m_lDisplayedDims[0])->size());
+		strUnstructDimName = varLon->get_dim(m_lDisplayedDims[0])->name();
 
-		std::vector<long> vecSize(varLon->num_dims(), 1);
-		vecSize[m_lDisplayedDims[0]] = varLon->get_dim(m_lDisplayedDims[0])->size();
+		long lCurvilinearDim = GetCurvilinearDim();
 
-		varLon->set_cur(&(m_lVarActiveDims[0]));
-		varLat->set_cur(&(m_lVarActiveDims[0]));
-		if (m_lDisplayedDims[0] == varLon->num_dims()-1) {
+		// Curvilinear grid; load the full 2D slab of lon/lat in variable order
+		if (lCurvilinearDim != (-1)) {
+			long lDimJ = std::min(m_lDisplayedDims[0], lCurvilinearDim);
+			long lDimI = std::max(m_lDisplayedDims[0], lCurvilinearDim);
+
+			sCurvilinearNy = varLon->get_dim(lDimJ)->size();
+			sCurvilinearNx = varLon->get_dim(lDimI)->size();
+
+			dLon.resize(sCurvilinearNy * sCurvilinearNx);
+			dLat.resize(sCurvilinearNy * sCurvilinearNx);
+
+			std::vector<long> vecCur(m_lVarActiveDims);
+			vecCur[lDimJ] = 0;
+			vecCur[lDimI] = 0;
+
+			std::vector<long> vecSize(varLon->num_dims(), 1);
+			vecSize[lDimJ] = sCurvilinearNy;
+			vecSize[lDimI] = sCurvilinearNx;
+
+			varLon->set_cur(&(vecCur[0]));
+			varLat->set_cur(&(vecCur[0]));
 			varLon->get(&(dLon[0]), &(vecSize[0]));
 			varLat->get(&(dLat[0]), &(vecSize[0]));
 
+		// Otherwise load a single line of lon/lat along the unstructured dimension
 		} else {
-			std::vector<long> vecStride(varLon->num_dims(), 1);
-			for (long d = m_lDisplayedDims[0]+1; d < varLon->num_dims(); d++) {
-				vecStride[d] = varLon->get_dim(d)->size();
-			}
+			dLon.resize(varLon->get_dim(m_lDisplayedDims[0])->size());
+			dLat.resize(varLat->get_dim(m_lDisplayedDims[0])->size());
 
-			varLon->gets(&(dLon[0]), &(vecSize[0]), &(vecStride[0]));
-			varLat->gets(&(dLon[0]), &(vecSize[0]), &(vecStride[0]));
+			DataPrefetcher::Slab slab;
+			slab.vecCur = m_lVarActiveDims;
+			slab.vecSize.resize(varLon->num_dims(), 1);
+			slab.vecSize[m_lDisplayedDims[0]] = varLon->get_dim(m_lDisplayedDims[0])->size();
+			slab.sOffset = 0;
+
+			DataPrefetcher::ReadSlab(varLon, slab, &(dLon[0]));
+			DataPrefetcher::ReadSlab(varLat, slab, &(dLat[0]));
 		}
 	}
 
@@ -301,86 +1144,704 @@ void wxNcVisFrame::InitializeGridDataSampler() {
 	{
 		wxStopWatch sw;
 
-		m_dgdsLonBounds[0] = std::numeric_limits<double>::max();
-		m_dgdsLonBounds[1] = -std::numeric_limits<double>::max();
-		m_dgdsLatBounds[0] = std::numeric_limits<double>::max();
-		m_dgdsLatBounds[1] = -std::numeric_limits<double>::max();
-		for (size_t i = 0; i < dLon.size(); i++) {
-			if ((dLon[i] == dFillValue) || (std::isnan(dLon[i]))) {
+		ResetGridDataSamplerBounds();
+		if (dLon.size() != 0) {
+			UpdateGridDataSamplerBounds(&(dLon[0]), &(dLat[0]), dLon.size(), dFillValue);
+		}
+		SnapGridDataSamplerBounds();
+
+		// Grids with closed-form indexing need no search structure
+		if (m_fDetectAnalyticGrids && (m_egdsoption == GridDataSamplerOption_QuadTree)) {
+			if (sCurvilinearNx != 0) {
+				m_egdsoption = GridDataSamplerOption_Curvilinear;
+			} else if (m_gdshp.Initialize(dLon, dLat, dFillValue)) {
+				m_egdsoption = GridDataSamplerOption_HEALPix;
+			} else if (m_gdsrg.Initialize(dLon, dLat, dFillValue)) {
+				m_egdsoption = GridDataSamplerOption_ReducedGaussian;
+			}
+
+		} else if (m_egdsoption == GridDataSamplerOption_HEALPix) {
+			if (!m_gdshp.Initialize(dLon, dLat, dFillValue)) {
+				Announce("WARNING: Not a HEALPix grid; using quadtree sampler");
+				m_egdsoption = GridDataSamplerOption_QuadTree;
+			}
+
+		} else if (m_egdsoption == GridDataSamplerOption_ReducedGaussian) {
+			if (!m_gdsrg.Initialize(dLon, dLat, dFillValue)) {
+				Announce("WARNING: Not a reduced Gaussian grid; using quadtree sampler");
+				m_egdsoption = GridDataSamplerOption_QuadTree;
+			}
+
+		} else if (m_egdsoption == GridDataSamplerOption_Curvilinear) {
+			if (sCurvilinearNx == 0) {
+				Announce("WARNING: Not a curvilinear grid; using quadtree sampler");
+				m_egdsoption = GridDataSamplerOption_QuadTree;
+			}
+		}
+
+		// Time the samplers with search structures on this grid
+		if (m_fAutoSelectSampler && (m_egdsoption == GridDataSamplerOption_QuadTree)) {
+			m_egdsoption = SelectGridDataSampler(dLon, dLat, dFillValue);
+		}
+
+		// Read everything else the GridDataSampler needs here, since the
+		// netCDF library may only be called from this thread
+		if (m_egdsoption == GridDataSamplerOption_MeshWalk) {
+			if (!LoadMeshAdjacency(
+				strUnstructDimName,
+				dLon.size(),
+				m_gdsinput.vecAdjacencyFirst,
+				m_gdsinput.vecAdjacency)
+			) {
+				Announce("WARNING: No mesh adjacency found; using quadtree sampler");
+				m_egdsoption = GridDataSamplerOption_QuadTree;
+			}
+		}
+		if (m_egdsoption == GridDataSamplerOption_CellPolygons) {
+			if (!LoadCellPolygons(
+				strUnstructDimName,
+				dLon.size(),
+				m_gdsinput.vecVertexFirst,
+				m_gdsinput.dVertexLon,
+				m_gdsinput.dVertexLat)
+			) {
+				Announce("WARNING: No cell vertices found; using kd-tree sampler");
+				m_egdsoption = GridDataSamplerOption_KDTree;
+			}
+		}
+		if ((m_egdsoption == GridDataSamplerOption_QuadTree) && m_fRegional) {
+			//std::cout << m_dgdsLonBounds[0] << " " << m_dgdsLonBounds[1] << " " << m_dgdsLatBounds[0] << " " << m_dgdsLatBounds[1] << std::endl;
+			m_gdsqt.SetRegionalBounds(
+				m_dgdsLonBounds[0],
+				m_dgdsLonBounds[1],
+				m_dgdsLatBounds[0],
+				m_dgdsLatBounds[1]);
+		}
+
+		// Allocate data space
+		if (m_data.size() != dLon.size()) {
+			m_data.resize(dLon.size());
+		}
+
+		// Build the search structure on a worker thread; until it is done
+		// the sampler is swapped out and SampleData draws a placeholder
+		if (!GetGridDataSampler(m_egdsoption).IsInitialized()) {
+			m_gdsinput.dLon.swap(dLon);
+			m_gdsinput.dLat.swap(dLat);
+			m_gdsinput.dFillValue = dFillValue;
+			m_gdsinput.sCurvilinearNy = sCurvilinearNy;
+			m_gdsinput.sCurvilinearNx = sCurvilinearNx;
+			m_gdsinput.fStreamed = false;
+
+			StartGridDataSamplerBuild(sw.Time());
+
+		} else {
+			Announce("Initializing the GridDataSampler took %ldms", sw.Time());
+		}
+
+		// Initialization may have changed the sampler
+		wxComboBox * wxSamplerCombo = dynamic_cast<wxComboBox *>(FindWindow(ID_SAMPLER));
+		if (wxSamplerCombo != NULL) {
+			wxSamplerCombo->SetSelection((int)m_egdsoption);
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void wxNcVisFrame::BuildGridDataSampler() {
+
+	_ASSERT(m_pgdsPending != NULL);
+
+	const GridDataSamplerInput & in = m_gdsinput;
+
+	try {
+		switch (m_egdsoptionPending) {
+			case GridDataSamplerOption_QuadTree:
+				dynamic_cast<GridDataSamplerUsingQuadTree &>(*m_pgdsPending).Initialize(
+					in.dLon, in.dLat, in.dFillValue, m_dMaxCellRadius);
+				break;
+			case GridDataSamplerOption_CubedSphereQuadTree:
+				dynamic_cast<GridDataSamplerUsingCubedSphereQuadTree &>(*m_pgdsPending).Initialize(
+					in.dLon, in.dLat, in.dFillValue, m_dMaxCellRadius);
+				break;
+			case GridDataSamplerOption_KDTree:
+				dynamic_cast<GridDataSamplerUsingKDTree &>(*m_pgdsPending).Initialize(
+					in.dLon, in.dLat, in.dFillValue);
+				break;
+			case GridDataSamplerOption_CubedSphereLattice:
+				dynamic_cast<GridDataSamplerUsingCubedSphereLattice &>(*m_pgdsPending).Initialize(
+					in.dLon, in.dLat, in.dFillValue, m_dMaxCellRadius);
+				break;
+			case GridDataSamplerOption_Curvilinear:
+				dynamic_cast<GridDataSamplerUsingCurvilinear &>(*m_pgdsPending).Initialize(
+					in.dLon, in.dLat, in.sCurvilinearNy, in.sCurvilinearNx, in.dFillValue);
+				break;
+			case GridDataSamplerOption_DiskIndex:
+				if (in.fStreamed) {
+					GridDataSamplerUsingDiskIndex & gdsdisk =
+						dynamic_cast<GridDataSamplerUsingDiskIndex &>(*m_pgdsPending);
+
+					GridDataSamplerChunk chunk;
+					while (PopGridDataSamplerChunk(chunk)) {
+						gdsdisk.AddPoints(&(chunk.dLon[0]), &(chunk.dLat[0]), chunk.dLon.size());
+					}
+					{
+						std::lock_guard<std::mutex> lock(m_mutexGridDataSamplerChunks);
+						if (m_fGridDataSamplerChunksAbort) {
+							_EXCEPTIONT("Reading of the sampler coordinates was aborted");
+						}
+					}
+					gdsdisk.EndInitialize();
+
+				} else {
+					dynamic_cast<GridDataSamplerUsingDiskIndex &>(*m_pgdsPending).Initialize(
+						in.dLon, in.dLat, in.dFillValue);
+				}
+				break;
+			case GridDataSamplerOption_MeshWalk:
+				dynamic_cast<GridDataSamplerUsingMeshWalk &>(*m_pgdsPending).Initialize(
+					in.dLon, in.dLat, in.dFillValue, in.vecAdjacencyFirst, in.vecAdjacency);
+				break;
+			case GridDataSamplerOption_CellPolygons:
+				dynamic_cast<GridDataSamplerUsingCellPolygons &>(*m_pgdsPending).Initialize(
+					in.vecVertexFirst, in.dVertexLon, in.dVertexLat, in.dFillValue);
+				break;
+			default:
+				_EXCEPTIONT("GridDataSampler cannot be built in the background");
+		}
+
+	} catch(...) {
+		m_excGridDataSampler = std::current_exception();
+
+		// Stop any thread streaming points to this one
+		std::lock_guard<std::mutex> lock(m_mutexGridDataSamplerChunks);
+		m_fGridDataSamplerChunksAbort = true;
+		m_condGridDataSamplerChunks.notify_all();
+	}
+
+	m_fGridDataSamplerBuilt = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool wxNcVisFrame::PushGridDataSamplerChunk(
+	std::vector<double> & dLon,
+	std::vector<double> & dLat
+) {
+	std::unique_lock<std::mutex> lock(m_mutexGridDataSamplerChunks);
+
+	while ((m_dequeGridDataSamplerChunks.size() >= DiskIndexStreamChunks) &&
+	       (!m_fGridDataSamplerChunksAbort)
+	) {
+		m_condGridDataSamplerChunks.wait(lock);
+	}
+	if (m_fGridDataSamplerChunksAbort) {
+		return false;
+	}
+
+	m_dequeGridDataSamplerChunks.push_back(GridDataSamplerChunk());
+	m_dequeGridDataSamplerChunks.back().dLon.swap(dLon);
+	m_dequeGridDataSamplerChunks.back().dLat.swap(dLat);
+	m_condGridDataSamplerChunks.notify_all();
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void wxNcVisFrame::EndGridDataSamplerChunks(
+	bool fAbort
+) {
+	std::lock_guard<std::mutex> lock(m_mutexGridDataSamplerChunks);
+	m_fGridDataSamplerChunksEnd = true;
+	if (fAbort) {
+		m_fGridDataSamplerChunksAbort = true;
+	}
+	m_condGridDataSamplerChunks.notify_all();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool wxNcVisFrame::PopGridDataSamplerChunk(
+	GridDataSamplerChunk & chunk
+) {
+	std::unique_lock<std::mutex> lock(m_mutexGridDataSamplerChunks);
+
+	while (m_dequeGridDataSamplerChunks.empty() &&
+	       (!m_fGridDataSamplerChunksEnd) &&
+	       (!m_fGridDataSamplerChunksAbort)
+	) {
+		m_condGridDataSamplerChunks.wait(lock);
+	}
+	if (m_fGridDataSamplerChunksAbort || m_dequeGridDataSamplerChunks.empty()) {
+		return false;
+	}
+
+	std::swap(chunk, m_dequeGridDataSamplerChunks.front());
+	m_dequeGridDataSamplerChunks.pop_front();
+	m_condGridDataSamplerChunks.notify_all();
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void wxNcVisFrame::WaitForGridDataSampler() {
+
+	if (m_pgdsPending == NULL) {
+		return;
+	}
+
+	m_thrGridDataSampler.join();
+	m_wxGridDataSamplerTimer.Stop();
+
+	if (m_excGridDataSampler) {
+		std::exception_ptr exc = m_excGridDataSampler;
+		m_excGridDataSampler = std::exception_ptr();
+		delete m_pgdsPending;
+		m_pgdsPending = NULL;
+		std::rethrow_exception(exc);
+	}
+
+	// The unused GridDataSampler is returned in m_pgdsPending
+	delete SwapGridDataSampler(m_egdsoptionPending, m_pgdsPending);
+	m_pgdsPending = NULL;
+
+	m_gdsinput = GridDataSamplerInput();
+
+	Announce("Initializing the GridDataSampler took %ldms", m_swGridDataSampler.Time());
+
+	// The build may have added an index to the cache
+	if (m_strIndexCacheDir != "") {
+		TrimIndexCache(m_strIndexCacheDir, m_sIndexCacheBytes);
+	}
+
+	SetStatusMessage(_T(""), true);
+
+	if (m_fIsVarActiveUnstructured && (m_imagepanel != NULL)) {
+		m_imagepanel->ResampleData(true);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void wxNcVisFrame::OnGridDataSamplerTimer(
+	wxTimerEvent & event
+) {
+	if (m_pgdsPending == NULL) {
+		m_wxGridDataSamplerTimer.Stop();
+		return;
+	}
+	if (m_fGridDataSamplerBuilt) {
+		WaitForGridDataSampler();
+		return;
+	}
+
+	int iProgress = AnnounceGetProgress();
+	if (iProgress >= 0) {
+		SetStatusMessage(wxString::Format(" Building sampler index (%i%%)", iProgress), true);
+	} else {
+		SetStatusMessage(_T(" Building sampler index"), true);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+///	<summary>
+///		Get a text attribute of a variable, or an empty string.
+///	</summary>
+static std::string GetVarAttString(
+	NcVar * var,
+	const char * szAttName
+) {
+	DataPrefetcher::NetCDFLock lockNetCDF;
+
+	std::string str;
+	NcAtt * att = var->get_att(szAttName);
+	if (att != NULL) {
+		char * sz = att->as_string(0);
+		if (sz != NULL) {
+			str = sz;
+			delete[] sz;
+		}
+		delete att;
+	}
+	return str;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool wxNcVisFrame::LoadMeshAdjacency(
+	const std::string & strDimName,
+	size_t sPoints,
+	std::vector<uint32_t> & vecAdjacencyFirst,
+	std::vector<uint32_t> & vecAdjacency
+) {
+	DataPrefetcher::NetCDFLock lockNetCDF;
+	NcError error(NcError::silent_nonfatal);
+
+	vecAdjacencyFirst.clear();
+	vecAdjacency.clear();
+
+	if ((strDimName == "") || (sPoints == 0)) {
+		return false;
+	}
+
+	for (size_t f = 0; f < m_vecpncfiles.size(); f++) {
+		NcFile * pfile = m_vecpncfiles[f];
+
+		// MPAS: cellsOnCell(nCells, maxEdges) is one-based, with the valid
+		// entries of each row given by nEdgesOnCell(nCells)
+		NcVar * varCellsOnCell = pfile->get_var("cellsOnCell");
+		NcVar * varNEdgesOnCell = pfile->get_var("nEdgesOnCell");
+		if ((varCellsOnCell != NULL) &&
+		    (varNEdgesOnCell != NULL) &&
+		    (varCellsOnCell->num_dims() == 2) &&
+		    (strDimName == varCellsOnCell->get_dim(0)->name()) &&
+		    (varCellsOnCell->get_dim(0)->size() == sPoints)
+		) {
+			long lMaxEdges = varCellsOnCell->get_dim(1)->size();
+
+			std::vector<int> vecCellsOnCell(sPoints * lMaxEdges);
+			std::vector<int> vecNEdgesOnCell(sPoints);
+
+			varCellsOnCell->get(&(vecCellsOnCell[0]), sPoints, lMaxEdges);
+			varNEdgesOnCell->get(&(vecNEdgesOnCell[0]), sPoints);
+
+			vecAdjacencyFirst.resize(sPoints+1);
+			for (size_t i = 0; i < sPoints; i++) {
+				vecAdjacencyFirst[i] = static_cast<uint32_t>(vecAdjacency.size());
+
+				long lEdges = std::min<long>(vecNEdgesOnCell[i], lMaxEdges);
+				for (long k = 0; k < lEdges; k++) {
+					int iCell = vecCellsOnCell[i * lMaxEdges + k] - 1;
+					if ((iCell >= 0) && (iCell < static_cast<int>(sPoints))) {
+						vecAdjacency.push_back(static_cast<uint32_t>(iCell));
+					}
+				}
+			}
+			vecAdjacencyFirst[sPoints] = static_cast<uint32_t>(vecAdjacency.size());
+
+			Announce("Mesh adjacency from MPAS \"cellsOnCell\"");
+			return true;
+		}
+
+		// UGRID: locate the mesh topology whose face or node coordinates
+		// are the longitude variable
+		for (int v = 0; v < pfile->num_vars(); v++) {
+			NcVar * varMesh = pfile->get_var(v);
+
+			if (GetVarAttString(varMesh, "cf_role") != "mesh_topology") {
 				continue;
 			}
-			if ((dLat[i] == dFillValue) || (std::isnan(dLat[i]))) {
+
+			bool fOnFaces = false;
+			bool fOnNodes = false;
+
+			std::string strCoord;
+			std::istringstream issFaceCoords(GetVarAttString(varMesh, "face_coordinates"));
+			while (issFaceCoords >> strCoord) {
+				if (strCoord == m_strLonVarName) {
+					fOnFaces = true;
+				}
+			}
+			std::istringstream issNodeCoords(GetVarAttString(varMesh, "node_coordinates"));
+			while (issNodeCoords >> strCoord) {
+				if (strCoord == m_strLonVarName) {
+					fOnNodes = true;
+				}
+			}
+
+			std::string strConnectivity;
+			if (fOnFaces) {
+				strConnectivity = GetVarAttString(varMesh, "face_face_connectivity");
+			} else if (fOnNodes) {
+				strConnectivity = GetVarAttString(varMesh, "edge_node_connectivity");
+			}
+			if (strConnectivity == "") {
 				continue;
 			}
 
-			if (dLon[i] < m_dgdsLonBounds[0]) {
-				m_dgdsLonBounds[0] = dLon[i];
+			NcVar * varConnect = pfile->get_var(strConnectivity.c_str());
+			if ((varConnect == NULL) || (varConnect->num_dims() != 2)) {
+				continue;
 			}
-			if (dLon[i] > m_dgdsLonBounds[1]) {
-				m_dgdsLonBounds[1] = dLon[i];
+
+			long lRows = varConnect->get_dim(0)->size();
+			long lCols = varConnect->get_dim(1)->size();
+
+			if (fOnFaces && (lRows != static_cast<long>(sPoints))) {
+				continue;
 			}
-			if (dLat[i] < m_dgdsLatBounds[0]) {
-				m_dgdsLatBounds[0] = dLat[i];
+			if (fOnNodes && (lCols != 2)) {
+				continue;
 			}
-			if (dLat[i] > m_dgdsLatBounds[1]) {
-				m_dgdsLatBounds[1] = dLat[i];
+
+			std::vector<int> vecConnect(lRows * lCols);
+			varConnect->get(&(vecConnect[0]), lRows, lCols);
+
+			int iStartIndex = 0;
+			NcAtt * attStartIndex = varConnect->get_att("start_index");
+			if (attStartIndex != NULL) {
+				iStartIndex = attStartIndex->as_int(0);
+				delete attStartIndex;
 			}
-		}
 
-		if (!m_fRegional) {
-			if (fabs(m_dgdsLonBounds[1] - m_dgdsLonBounds[0] - 360.0) < 1.0) {
-				if (fabs(m_dgdsLonBounds[0]) < 1.0) {
-					m_dgdsLonBounds[0] = 0.0;
+			// Convert to zero-based indices, marking fill values as missing
+			for (size_t k = 0; k < vecConnect.size(); k++) {
+				vecConnect[k] -= iStartIndex;
+				if ((vecConnect[k] < 0) || (vecConnect[k] >= static_cast<int>(sPoints))) {
+					vecConnect[k] = (-1);
 				}
-				if (fabs(m_dgdsLonBounds[0] + 180.0) < 1.0) {
-					m_dgdsLonBounds[0] = -180.0;
+			}
+
+			// Neighboring faces are listed directly
+			if (fOnFaces) {
+				vecAdjacencyFirst.resize(sPoints+1);
+				for (size_t i = 0; i < sPoints; i++) {
+					vecAdjacencyFirst[i] = static_cast<uint32_t>(vecAdjacency.size());
+					for (long k = 0; k < lCols; k++) {
+						if (vecConnect[i * lCols + k] >= 0) {
+							vecAdjacency.push_back(static_cast<uint32_t>(vecConnect[i * lCols + k]));
+						}
+					}
+				}
+				vecAdjacencyFirst[sPoints] = static_cast<uint32_t>(vecAdjacency.size());
+
+			// Neighboring nodes are the two ends of each edge
+			} else {
+				vecAdjacencyFirst.resize(sPoints+1, 0);
+				for (long e = 0; e < lRows; e++) {
+					if ((vecConnect[2*e] >= 0) && (vecConnect[2*e+1] >= 0)) {
+						vecAdjacencyFirst[vecConnect[2*e]+1]++;
+						vecAdjacencyFirst[vecConnect[2*e+1]+1]++;
+					}
+				}
+				for (size_t i = 0; i < sPoints; i++) {
+					vecAdjacencyFirst[i+1] += vecAdjacencyFirst[i];
+				}
+
+				vecAdjacency.resize(vecAdjacencyFirst[sPoints]);
+
+				std::vector<uint32_t> vecNext(vecAdjacencyFirst.begin(), vecAdjacencyFirst.end()-1);
+				for (long e = 0; e < lRows; e++) {
+					int iA = vecConnect[2*e];
+					int iB = vecConnect[2*e+1];
+					if ((iA >= 0) && (iB >= 0)) {
+						vecAdjacency[vecNext[iA]++] = static_cast<uint32_t>(iB);
+						vecAdjacency[vecNext[iB]++] = static_cast<uint32_t>(iA);
+					}
 				}
-				m_dgdsLonBounds[1] = m_dgdsLonBounds[0] + 360.0;
 			}
-			if ((fabs(m_dgdsLatBounds[0] + 90.0) < 1.0) && (fabs(m_dgdsLatBounds[1] - 90.0) < 1.0)) {
-				m_dgdsLatBounds[0] = -90.0;
-				m_dgdsLatBounds[1] = 90.0;
+
+			Announce("Mesh adjacency from UGRID \"%s\"", strConnectivity.c_str());
+			return true;
+		}
+	}
+
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool wxNcVisFrame::LoadCellPolygons(
+	const std::string & strDimName,
+	size_t sPoints,
+	std::vector<uint32_t> & vecVertexFirst,
+	std::vector<double> & dVertexLon,
+	std::vector<double> & dVertexLat
+) {
+	DataPrefetcher::NetCDFLock lockNetCDF;
+	NcError error(NcError::silent_nonfatal);
+
+	vecVertexFirst.clear();
+	dVertexLon.clear();
+	dVertexLat.clear();
+
+	if ((strDimName == "") || (sPoints == 0)) {
+		return false;
+	}
+
+	// Build polygons from an index array conn(sPoints, lCols) into vertex
+	// coordinate arrays, skipping indices outside [0, vecLon.size())
+	auto fnGatherVertices = [&](
+		const std::vector<int> & vecConnect,
+		long lCols,
+		const std::vector<int> * pvecCount,
+		const std::vector<double> & vecLon,
+		const std::vector<double> & vecLat
+	) {
+		vecVertexFirst.resize(sPoints+1);
+		for (size_t i = 0; i < sPoints; i++) {
+			vecVertexFirst[i] = static_cast<uint32_t>(dVertexLon.size());
+
+			long lCount = lCols;
+			if (pvecCount != NULL) {
+				lCount = std::min<long>((*pvecCount)[i], lCols);
 			}
-			if (fabs(m_dgdsLonBounds[1] - m_dgdsLonBounds[0] - 2.0 * M_PI) < 0.1) {
-				if (fabs(m_dgdsLonBounds[0]) < 0.1) {
-					m_dgdsLonBounds[0] = 0.0;
+			for (long k = 0; k < lCount; k++) {
+				int iVertex = vecConnect[i * lCols + k];
+				if ((iVertex >= 0) && (iVertex < static_cast<int>(vecLon.size()))) {
+					dVertexLon.push_back(vecLon[iVertex]);
+					dVertexLat.push_back(vecLat[iVertex]);
 				}
-				if (fabs(m_dgdsLonBounds[0] + M_PI) < 0.1) {
-					m_dgdsLonBounds[0] = - M_PI;
+			}
+		}
+		vecVertexFirst[sPoints] = static_cast<uint32_t>(dVertexLon.size());
+	};
+
+	for (size_t f = 0; f < m_vecpncfiles.size(); f++) {
+		NcFile * pfile = m_vecpncfiles[f];
+
+		// CF: bounds variables lon_bnds(sPoints, nv) and lat_bnds(sPoints, nv)
+		NcVar * varLon = pfile->get_var(m_strLonVarName.c_str());
+		NcVar * varLat = pfile->get_var(m_strLatVarName.c_str());
+		if ((varLon != NULL) && (varLat != NULL)) {
+			std::string strLonBounds = GetVarAttString(varLon, "bounds");
+			std::string strLatBounds = GetVarAttString(varLat, "bounds");
+			if (strLonBounds == "") {
+				strLonBounds = m_strLonVarName + "_bnds";
+			}
+			if (strLatBounds == "") {
+				strLatBounds = m_strLatVarName + "_bnds";
+			}
+
+			NcVar * varLonBounds = pfile->get_var(strLonBounds.c_str());
+			NcVar * varLatBounds = pfile->get_var(strLatBounds.c_str());
+			if ((varLonBounds != NULL) &&
+			    (varLatBounds != NULL) &&
+			    (varLonBounds->num_dims() == 2) &&
+			    (varLatBounds->num_dims() == 2) &&
+			    (strDimName == varLonBounds->get_dim(0)->name()) &&
+			    (varLonBounds->get_dim(0)->size() == sPoints) &&
+			    (varLatBounds->get_dim(0)->size() == sPoints) &&
+			    (varLonBounds->get_dim(1)->size() == varLatBounds->get_dim(1)->size())
+			) {
+				long lVertices = varLonBounds->get_dim(1)->size();
+
+				dVertexLon.resize(sPoints * lVertices);
+				dVertexLat.resize(sPoints * lVertices);
+
+				varLonBounds->get(&(dVertexLon[0]), sPoints, lVertices);
+				varLatBounds->get(&(dVertexLat[0]), sPoints, lVertices);
+
+				vecVertexFirst.resize(sPoints+1);
+				for (size_t i = 0; i <= sPoints; i++) {
+					vecVertexFirst[i] = static_cast<uint32_t>(i * lVertices);
 				}
-				m_dgdsLonBounds[1] = m_dgdsLonBounds[0] + 2.0 * M_PI;
+
+				Announce("Cell polygons from \"%s\" and \"%s\"",
+					strLonBounds.c_str(), strLatBounds.c_str());
+				return true;
+			}
+		}
+
+		// MPAS: verticesOnCell(nCells, maxEdges) is one-based into
+		// lonVertex / latVertex, with nEdgesOnCell(nCells) valid entries
+		NcVar * varVerticesOnCell = pfile->get_var("verticesOnCell");
+		NcVar * varNEdgesOnCell = pfile->get_var("nEdgesOnCell");
+		NcVar * varLonVertex = pfile->get_var("lonVertex");
+		NcVar * varLatVertex = pfile->get_var("latVertex");
+		if ((varVerticesOnCell != NULL) &&
+		    (varNEdgesOnCell != NULL) &&
+		    (varLonVertex != NULL) &&
+		    (varLatVertex != NULL) &&
+		    (varVerticesOnCell->num_dims() == 2) &&
+		    (strDimName == varVerticesOnCell->get_dim(0)->name()) &&
+		    (varVerticesOnCell->get_dim(0)->size() == sPoints)
+		) {
+			long lMaxEdges = varVerticesOnCell->get_dim(1)->size();
+			long lVertices = varLonVertex->get_dim(0)->size();
+
+			std::vector<int> vecVerticesOnCell(sPoints * lMaxEdges);
+			std::vector<int> vecNEdgesOnCell(sPoints);
+			std::vector<double> vecLonVertex(lVertices);
+			std::vector<double> vecLatVertex(lVertices);
+
+			varVerticesOnCell->get(&(vecVerticesOnCell[0]), sPoints, lMaxEdges);
+			varNEdgesOnCell->get(&(vecNEdgesOnCell[0]), sPoints);
+			varLonVertex->get(&(vecLonVertex[0]), lVertices);
+			varLatVertex->get(&(vecLatVertex[0]), lVertices);
+
+			for (size_t k = 0; k < vecVerticesOnCell.size(); k++) {
+				vecVerticesOnCell[k]--;
 			}
-			if ((fabs(m_dgdsLatBounds[0] + 0.5 * M_PI) < 0.1) && (fabs(m_dgdsLatBounds[1] - 0.5 * M_PI) < 0.1)) {
-				m_dgdsLatBounds[0] = - 0.5 * M_PI;
-				m_dgdsLatBounds[1] = 0.5 * M_PI;
+
+			fnGatherVertices(vecVerticesOnCell, lMaxEdges, &vecNEdgesOnCell, vecLonVertex, vecLatVertex);
+
+			Announce("Cell polygons from MPAS \"verticesOnCell\"");
+			return true;
+		}
+
+		// UGRID: face_node_connectivity of the mesh topology whose face
+		// coordinates are the longitude variable
+		for (int v = 0; v < pfile->num_vars(); v++) {
+			NcVar * varMesh = pfile->get_var(v);
+
+			if (GetVarAttString(varMesh, "cf_role") != "mesh_topology") {
+				continue;
+			}
+
+			bool fOnFaces = false;
+
+			std::string strCoord;
+			std::istringstream issFaceCoords(GetVarAttString(varMesh, "face_coordinates"));
+			while (issFaceCoords >> strCoord) {
+				if (strCoord == m_strLonVarName) {
+					fOnFaces = true;
+				}
+			}
+			if (!fOnFaces) {
+				continue;
+			}
+
+			std::string strNodeLon;
+			std::string strNodeLat;
+			std::istringstream issNodeCoords(GetVarAttString(varMesh, "node_coordinates"));
+			issNodeCoords >> strNodeLon >> strNodeLat;
+
+			std::string strConnectivity = GetVarAttString(varMesh, "face_node_connectivity");
+
+			NcVar * varConnect = pfile->get_var(strConnectivity.c_str());
+			NcVar * varNodeLon = pfile->get_var(strNodeLon.c_str());
+			NcVar * varNodeLat = pfile->get_var(strNodeLat.c_str());
+			if ((varConnect == NULL) || (varNodeLon == NULL) || (varNodeLat == NULL)) {
+				continue;
+			}
+			if ((varConnect->num_dims() != 2) || (varConnect->get_dim(0)->size() != sPoints)) {
+				continue;
+			}
+
+			long lCols = varConnect->get_dim(1)->size();
+			long lNodes = varNodeLon->get_dim(0)->size();
+
+			std::vector<int> vecConnect(sPoints * lCols);
+			std::vector<double> vecNodeLon(lNodes);
+			std::vector<double> vecNodeLat(lNodes);
+
+			varConnect->get(&(vecConnect[0]), sPoints, lCols);
+			varNodeLon->get(&(vecNodeLon[0]), lNodes);
+			varNodeLat->get(&(vecNodeLat[0]), lNodes);
+
+			int iStartIndex = 0;
+			NcAtt * attStartIndex = varConnect->get_att("start_index");
+			if (attStartIndex != NULL) {
+				iStartIndex = attStartIndex->as_int(0);
+				delete attStartIndex;
 			}
-		}
 
-		if (m_egdsoption == GridDataSamplerOption_QuadTree) {
-			if (m_fRegional) {
-				//std::cout << m_dgdsLonBounds[0] << " " << m_dgdsLonBounds[1] << " " << m_dgdsLatBounds[0] << " " << m_dgdsLatBounds[1] << std::endl;
-				m_gdsqt.SetRegionalBounds(
-					m_dgdsLonBounds[0],
-					m_dgdsLonBounds[1],
-					m_dgdsLatBounds[0],
-					m_dgdsLatBounds[1]);
+			// Fill values fall outside the node range after this shift
+			for (size_t k = 0; k < vecConnect.size(); k++) {
+				vecConnect[k] -= iStartIndex;
 			}
 
-			m_gdsqt.Initialize(dLon, dLat, dFillValue, m_dMaxCellRadius);
-		}
-		if (m_egdsoption == GridDataSamplerOption_CubedSphereQuadTree) {
-			m_gdscsqt.Initialize(dLon, dLat, dFillValue, m_dMaxCellRadius);
-		}
-		if (m_egdsoption == GridDataSamplerOption_KDTree) {
-			m_gdskd.Initialize(dLon, dLat, dFillValue);
+			fnGatherVertices(vecConnect, lCols, NULL, vecNodeLon, vecNodeLat);
+
+			Announce("Cell polygons from UGRID \"%s\"", strConnectivity.c_str());
+			return true;
 		}
-		Announce("Initializing the GridDataSampler took %ldms", sw.Time());
 	}
 
-	// Allocate data space
-	if (m_data.size() != dLon.size()) {
-		m_data.resize(dLon.size());
-	}
+	return false;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -390,6 +1851,7 @@ void wxNcVisFrame::OpenFiles(
 ) {
 	_ASSERT(m_vecpncfiles.size() == 0);
 
+	DataPrefetcher::NetCDFLock lockNetCDF;
 	NcError error(NcError::silent_nonfatal);
 
 	m_vecFilenames = vecFilenames;
@@ -685,14 +2147,34 @@ void wxNcVisFrame::OpenFiles(
 	// Determine which GridDataSampler was specified on the command line
 	auto itGridDataSampler = m_mapOptions.find("-g");
 	if (itGridDataSampler != m_mapOptions.end()) {
+		m_fDetectAnalyticGrids = false;
+
 		if (itGridDataSampler->second == "qt") {
 			m_egdsoption = GridDataSamplerOption_QuadTree;
 		} else if (itGridDataSampler->second == "csqt") {
 			m_egdsoption = GridDataSamplerOption_CubedSphereQuadTree;
 		} else if (itGridDataSampler->second == "kd") {
 			m_egdsoption = GridDataSamplerOption_KDTree;
+		} else if (itGridDataSampler->second == "walk") {
+			m_egdsoption = GridDataSamplerOption_MeshWalk;
+		} else if (itGridDataSampler->second == "poly") {
+			m_egdsoption = GridDataSamplerOption_CellPolygons;
+		} else if (itGridDataSampler->second == "csl") {
+			m_egdsoption = GridDataSamplerOption_CubedSphereLattice;
+		} else if (itGridDataSampler->second == "rg") {
+			m_egdsoption = GridDataSamplerOption_ReducedGaussian;
+		} else if (itGridDataSampler->second == "healpix") {
+			m_egdsoption = GridDataSamplerOption_HEALPix;
+		} else if (itGridDataSampler->second == "curv") {
+			m_egdsoption = GridDataSamplerOption_Curvilinear;
+		} else if (itGridDataSampler->second == "disk") {
+			m_egdsoption = GridDataSamplerOption_DiskIndex;
+		} else if (itGridDataSampler->second == "auto") {
+			m_egdsoption = GridDataSamplerOption_QuadTree;
+			m_fDetectAnalyticGrids = true;
+			m_fAutoSelectSampler = true;
 		} else {
-			_EXCEPTIONT("Invalid value for option -g: Expected [csqt,qt,kd]");
+			_EXCEPTIONT("Invalid value for option -g: Expected [auto,csqt,qt,kd,walk,poly,csl,rg,healpix,curv,disk]");
 		}
 
 	} else {
@@ -795,6 +2277,13 @@ void wxNcVisFrame::InitializeWindow() {
 	wxSamplerCombo->Append(_T("QuadTree (fast)"));
 	wxSamplerCombo->Append(_T("CS QuadTree"));
 	wxSamplerCombo->Append(_T("kd-Tree (best)"));
+	wxSamplerCombo->Append(_T("Mesh walk"));
+	wxSamplerCombo->Append(_T("Cell polygons"));
+	wxSamplerCombo->Append(_T("CS lattice"));
+	wxSamplerCombo->Append(_T("Reduced Gaussian"));
+	wxSamplerCombo->Append(_T("HEALPix"));
+	wxSamplerCombo->Append(_T("Curvilinear"));
+	wxSamplerCombo->Append(_T("Out-of-core"));
 	wxSamplerCombo->SetSelection((int)m_egdsoption);
 	wxSamplerCombo->SetEditable(false);
 
@@ -886,121 +2375,716 @@ void wxNcVisFrame::InitializeWindow() {
 			}
 		}
 	}
-}
-
-////////////////////////////////////////////////////////////////////////////////
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+long wxNcVisFrame::GetCurvilinearDim() const {
+	if ((m_varActive == NULL) || (m_strCurvilinearDimName == "")) {
+		return (-1);
+	}
+	if ((m_lDisplayedDims[0] == (-1)) || (m_lDisplayedDims[1] != (-1))) {
+		return (-1);
+	}
+
+	DataPrefetcher::NetCDFLock lockNetCDF;
+	if (m_strUnstructDimName != m_varActive->get_dim(m_lDisplayedDims[0])->name()) {
+		return (-1);
+	}
+	for (long d = 0; d < m_varActive->num_dims(); d++) {
+		if ((d != m_lDisplayedDims[0]) && (m_strCurvilinearDimName == m_varActive->get_dim(d)->name())) {
+			return d;
+		}
+	}
+	return (-1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void wxNcVisFrame::LoadData() {
+	if (m_fVerbose) {
+		std::cout << "LOAD DATA" << std::endl;
+	}
+
+	DataPrefetcher::NetCDFLock lockNetCDF;
+
+	// Assume data is not unstructured
+	m_fIsVarActiveUnstructured = false;
+
+	// Assume data is not read through the hyperslab or gathered runs
+	m_varDataWindowLoaded = NULL;
+	m_varDataGatherLoaded = NULL;
+	m_varDataSlabs = NULL;
+
+	// 0D data
+	if (m_varActive->num_dims() == 0) {
+		m_data.resize(1);
+		m_varActive->get(&(m_data[0]), 1);
+		return;
+	}
+
+	// 1D data (including unstructured grid data)
+	if (m_lDisplayedDims[1] == (-1)) {
+		_ASSERT(m_lDisplayedDims[0] < m_varActive->num_dims());
+		_ASSERT(m_varActive->num_dims() == m_lVarActiveDims.size());
+
+		if (m_strUnstructDimName == m_varActive->get_dim(m_lDisplayedDims[0])->name()) {
+			m_fIsVarActiveUnstructured = true;
+		}
+
+		// Curvilinear data is loaded as the full 2D slab in variable order
+		long lCurvilinearDim = GetCurvilinearDim();
+		if (lCurvilinearDim != (-1)) {
+			std::vector<long> vecCur(m_lVarActiveDims);
+			vecCur[m_lDisplayedDims[0]] = 0;
+			vecCur[lCurvilinearDim] = 0;
+
+			std::vector<long> vecSize(m_varActive->num_dims(), 1);
+			vecSize[m_lDisplayedDims[0]] = m_varActive->get_dim(m_lDisplayedDims[0])->size();
+			vecSize[lCurvilinearDim] = m_varActive->get_dim(lCurvilinearDim)->size();
+
+			std::vector<DataPrefetcher::Slab> vecSlabs(1);
+			vecSlabs[0].vecCur = vecCur;
+			vecSlabs[0].vecSize = vecSize;
+			vecSlabs[0].sOffset = 0;
+
+			ReadData(vecSlabs, vecSize[m_lDisplayedDims[0]] * vecSize[lCurvilinearDim]);
+			return;
+		}
+
+		// Large unstructured data is gathered for the units referenced by
+		// the image map, which is remapped to the new runs
+		if (IsDataGathered()) {
+			std::vector<int> & imagemap = m_imagepanel->GetImageMapRef();
+			if (imagemap.size() != 0) {
+				UngatherImageMap(&(imagemap[0]), imagemap.size());
+			}
+
+			ResetDataGather();
+
+			if (imagemap.size() != 0) {
+				GatherImageMap(&(imagemap[0]), imagemap.size());
+			}
+
+			std::vector<DataPrefetcher::Slab> vecSlabs;
+			GetDataGatherSlabs(0, vecSlabs);
+
+			ReadData(vecSlabs, m_data.size());
+
+			m_varDataGatherLoaded = m_varActive;
+
+			if (m_data.size() == 0) {
+				m_data.resize(1);
+				m_data[0] = 0.0;
+			}
+
+			if (m_fVerbose) {
+				std::cout << "GATHERED " << m_data.size() << " OF " << m_sDataGatherPoints
+					<< " IN " << m_vecDataGatherRuns.size() << " RUNS" << std::endl;
+			}
+			return;
+		}
+
+		// Load data
+		std::vector<DataPrefetcher::Slab> vecSlabs(1);
+		vecSlabs[0].vecCur = m_lVarActiveDims;
+		vecSlabs[0].vecSize.resize(m_varActive->num_dims(), 1);
+		vecSlabs[0].vecSize[m_lDisplayedDims[0]] = m_varActive->get_dim(m_lDisplayedDims[0])->size();
+		vecSlabs[0].sOffset = 0;
+
+		ReadData(vecSlabs, vecSlabs[0].vecSize[m_lDisplayedDims[0]]);
+
+	// 2D data
+	} else {
+		_ASSERT(m_lDisplayedDims[0] != m_lDisplayedDims[1]);
+		_ASSERT(m_lDisplayedDims[0] < m_varActive->num_dims());
+		_ASSERT(m_lDisplayedDims[1] < m_varActive->num_dims());
+		_ASSERT(m_varActive->num_dims() == m_lVarActiveDims.size());
+
+		// Choose the hyperslab from the current view if the displayed
+		// dimensions have changed
+		if (!IsDataWindowValid()) {
+			long lIndexMin[2];
+			long lIndexMax[2];
+			ComputeDataWindow(
+				m_imagepanel->GetSampleX(),
+				m_imagepanel->GetSampleY(),
+				m_datawindow,
+				lIndexMin,
+				lIndexMax);
+
+			InvalidateDataSliceCache(m_varActive);
+		}
+
+		// Load data, laid out with the X dimension varying fastest
+		std::vector<DataPrefetcher::Slab> vecSlabs(1);
+		vecSlabs[0].vecCur = m_lVarActiveDims;
+		vecSlabs[0].vecSize.resize(m_varActive->num_dims(), 1);
+		vecSlabs[0].vecOrder.resize(2);
+		vecSlabs[0].vecOrder[0] = m_lDisplayedDims[0];
+		vecSlabs[0].vecOrder[1] = m_lDisplayedDims[1];
+		vecSlabs[0].sOffset = 0;
+		for (int i = 0; i < 2; i++) {
+			vecSlabs[0].vecCur[m_lDisplayedDims[i]] = m_datawindow.lBegin[i];
+			vecSlabs[0].vecSize[m_lDisplayedDims[i]] = m_datawindow.lCount[i];
+		}
+		if ((m_datawindow.lStride[0] != 1) || (m_datawindow.lStride[1] != 1)) {
+			vecSlabs[0].vecStride.resize(m_varActive->num_dims(), 1);
+			for (int i = 0; i < 2; i++) {
+				vecSlabs[0].vecStride[m_lDisplayedDims[i]] = m_datawindow.lStride[i];
+			}
+		}
+
+		ReadData(vecSlabs, m_datawindow.lCount[0] * m_datawindow.lCount[1]);
+
+		m_varDataWindowLoaded = m_varActive;
+
+		if (m_fVerbose) {
+			std::cout << "LOADED WINDOW "
+				<< m_datawindow.lBegin[0] << ":" << m_datawindow.lStride[0] << ":" << m_datawindow.lCount[0] << " "
+				<< m_datawindow.lBegin[1] << ":" << m_datawindow.lStride[1] << ":" << m_datawindow.lCount[1] << std::endl;
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool wxNcVisFrame::IsDataWindowValid() const {
+	if ((m_varActive == NULL) || (m_lDisplayedDims[0] == (-1)) || (m_lDisplayedDims[1] == (-1))) {
+		return false;
+	}
+
+	DataPrefetcher::NetCDFLock lockNetCDF;
+	for (int i = 0; i < 2; i++) {
+		NcDim * dim = m_varActive->get_dim(m_lDisplayedDims[i]);
+		if (m_datawindow.strDimName[i] != dim->name()) {
+			return false;
+		}
+		if ((m_datawindow.lCount[i] < 1) ||
+		    (m_datawindow.lBegin[i] + (m_datawindow.lCount[i] - 1) * m_datawindow.lStride[i] >= dim->size())
+		) {
+			return false;
+		}
+	}
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void wxNcVisFrame::ComputeDataWindow(
+	const std::vector<double> & dSampleX,
+	const std::vector<double> & dSampleY,
+	DataWindow & datawindow,
+	long lIndexMin[2],
+	long lIndexMax[2]
+) {
+	_ASSERT(m_varActive != NULL);
+	_ASSERT((m_lDisplayedDims[0] != (-1)) && (m_lDisplayedDims[1] != (-1)));
+
+	// Note that dimension 0 corresponds to Y and dimension 1 to X
+	const std::vector<double> * pdSample[2] = {&dSampleY, &dSampleX};
+
+	DataPrefetcher::NetCDFLock lockNetCDF;
+
+	for (int i = 0; i < 2; i++) {
+		NcDim * dim = m_varActive->get_dim(m_lDisplayedDims[i]);
+		long lDimSize = dim->size();
+
+		datawindow.strDimName[i] = dim->name();
+
+		// Without samples the full extent is read
+		if (pdSample[i]->size() == 0) {
+			lIndexMin[i] = 0;
+			lIndexMax[i] = lDimSize-1;
+			datawindow.lBegin[i] = 0;
+			datawindow.lStride[i] = 1;
+			datawindow.lCount[i] = lDimSize;
+			continue;
+		}
+
+		std::vector<int> veccoordmap;
+		MapSampleCoords1DFromActiveVar(*(pdSample[i]), m_lDisplayedDims[i], veccoordmap);
+
+		lIndexMin[i] = veccoordmap[0];
+		lIndexMax[i] = veccoordmap[0];
+		for (size_t s = 1; s < veccoordmap.size(); s++) {
+			if (veccoordmap[s] < lIndexMin[i]) {
+				lIndexMin[i] = veccoordmap[s];
+			}
+			if (veccoordmap[s] > lIndexMax[i]) {
+				lIndexMax[i] = veccoordmap[s];
+			}
+		}
+
+		// Decimate fields much denser than the samples
+		long lSpan = lIndexMax[i] - lIndexMin[i] + 1;
+		long lStride = lSpan / (DataWindowOversample * static_cast<long>(pdSample[i]->size()));
+		if (lStride < 1) {
+			lStride = 1;
+		}
+
+		// Add a margin, keeping the first index a multiple of the stride
+		// so that the same indices are read as the view is panned
+		long lMargin = static_cast<long>(DataWindowMargin * static_cast<double>(lSpan));
+
+		long lBegin = std::max<long>(0, lIndexMin[i] - lMargin);
+		lBegin -= lBegin % lStride;
+
+		long lEnd = std::min<long>(lDimSize-1, lIndexMax[i] + lMargin);
+
+		datawindow.lBegin[i] = lBegin;
+		datawindow.lStride[i] = lStride;
+		datawindow.lCount[i] = (lEnd - lBegin) / lStride + 1;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool wxNcVisFrame::UpdateDataWindow(
+	const std::vector<double> & dSampleX,
+	const std::vector<double> & dSampleY
+) {
+	if ((m_varActive == NULL) || (m_lDisplayedDims[0] == (-1)) || (m_lDisplayedDims[1] == (-1))) {
+		return false;
+	}
+	if ((dSampleX.size() == 0) || (dSampleY.size() == 0)) {
+		return false;
+	}
+
+	DataWindow datawindow;
+	long lIndexMin[2];
+	long lIndexMax[2];
+	ComputeDataWindow(dSampleX, dSampleY, datawindow, lIndexMin, lIndexMax);
+
+	// Keep the current hyperslab if it covers the samples at least as finely
+	bool fValid = IsDataWindowValid();
+	if (fValid) {
+		bool fCovers = true;
+		for (int i = 0; i < 2; i++) {
+			long lLast = m_datawindow.lBegin[i] + (m_datawindow.lCount[i] - 1) * m_datawindow.lStride[i];
+			if ((m_datawindow.lStride[i] > datawindow.lStride[i]) ||
+			    (m_datawindow.lBegin[i] > lIndexMin[i]) ||
+			    (lLast + m_datawindow.lStride[i] - 1 < lIndexMax[i])
+			) {
+				fCovers = false;
+			}
+		}
+		if (fCovers) {
+			return false;
+		}
+	}
+
+	m_datawindow = datawindow;
+
+	// Slices read through the previous hyperslab are no longer used
+	InvalidateDataSliceCache(m_varActive);
+
+	// If the displayed dimensions have changed the data is loaded by the
+	// caller once the remaining dimension indices are known
+	if (!fValid || (m_varDataWindowLoaded != m_varActive)) {
+		return false;
+	}
+
+	LoadData();
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool wxNcVisFrame::IsDataGathered() const {
+	if (!m_fIsVarActiveUnstructured || (m_varActive == NULL)) {
+		return false;
+	}
+	if ((m_lDisplayedDims[0] == (-1)) || (m_lDisplayedDims[1] != (-1))) {
+		return false;
+	}
+	if (GetCurvilinearDim() != (-1)) {
+		return false;
+	}
+
+	DataPrefetcher::NetCDFLock lockNetCDF;
+	return (m_varActive->get_dim(m_lDisplayedDims[0])->size() >= DataGatherMinPoints);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void wxNcVisFrame::ResetDataGather() {
+	_ASSERT(m_varActive != NULL);
+	_ASSERT(m_lDisplayedDims[0] != (-1));
+
+	DataPrefetcher::NetCDFLock lockNetCDF;
+
+	m_sDataGatherPoints = m_varActive->get_dim(m_lDisplayedDims[0])->size();
+
+	// Gather whole storage chunks, since the library decompresses whole
+	// chunks regardless of how much of each is read
+	m_sDataGatherUnit = DataGatherDefaultUnit;
+	if (m_pncfileActive != NULL) {
+		int iStorage;
+		std::vector<size_t> vecChunkSizes(m_varActive->num_dims(), 0);
+		int iError =
+			nc_inq_var_chunking(
+				m_pncfileActive->id(),
+				m_varActive->id(),
+				&iStorage,
+				&(vecChunkSizes[0]));
+
+		if ((iError == NC_NOERR) &&
+		    (iStorage == NC_CHUNKED) &&
+		    (vecChunkSizes[m_lDisplayedDims[0]] != 0)
+		) {
+			m_sDataGatherUnit = vecChunkSizes[m_lDisplayedDims[0]];
+		}
+	}
+
+	size_t sUnits = (m_sDataGatherPoints + m_sDataGatherUnit - 1) / m_sDataGatherUnit;
+	m_vecDataGatherOffset.assign(sUnits, (-1));
+	m_vecDataGatherRuns.clear();
+	m_data.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void wxNcVisFrame::GatherImageMap(
+	int * pImageMap,
+	size_t sPoints
+) {
+	_ASSERT(m_varActive != NULL);
+
+	size_t sPointsActive;
+	{
+		DataPrefetcher::NetCDFLock lockNetCDF;
+		sPointsActive = m_varActive->get_dim(m_lDisplayedDims[0])->size();
+	}
+	if (m_sDataGatherPoints != sPointsActive) {
+		ResetDataGather();
+	}
+
+	const size_t sUnit = m_sDataGatherUnit;
+
+	// Find units referenced by the image map that have not been gathered;
+	// these are marked with (-2) until they are assigned an offset
+	std::vector<size_t> vecNewUnits;
+	for (size_t s = 0; s < sPoints; s++) {
+		if ((pImageMap[s] < 0) || (static_cast<size_t>(pImageMap[s]) >= m_sDataGatherPoints)) {
+			pImageMap[s] = 0;
+		}
+		size_t sU = static_cast<size_t>(pImageMap[s]) / sUnit;
+		if (m_vecDataGatherOffset[sU] == (-1)) {
+			m_vecDataGatherOffset[sU] = (-2);
+			vecNewUnits.push_back(sU);
+		}
+	}
+
+	// Coalesce new units into runs, appended to the end of m_data
+	if (vecNewUnits.size() != 0) {
+		std::sort(vecNewUnits.begin(), vecNewUnits.end());
+
+		size_t sFirstRun = m_vecDataGatherRuns.size();
+		size_t sOffset = 0;
+		if (sFirstRun != 0) {
+			const DataGatherRun & runLast = m_vecDataGatherRuns[sFirstRun-1];
+			sOffset = runLast.sOffset + runLast.sCount;
+		}
+
+		for (size_t u = 0; u < vecNewUnits.size(); u++) {
+			size_t sBegin = vecNewUnits[u] * sUnit;
+			size_t sEnd = std::min(sBegin + sUnit, m_sDataGatherPoints);
+
+			m_vecDataGatherOffset[vecNewUnits[u]] = static_cast<long>(sOffset);
+
+			if ((m_vecDataGatherRuns.size() != sFirstRun) &&
+			    (vecNewUnits[u] == vecNewUnits[u-1] + 1)
+			) {
+				m_vecDataGatherRuns.back().sCount += sEnd - sBegin;
+			} else {
+				DataGatherRun run;
+				run.sBegin = sBegin;
+				run.sCount = sEnd - sBegin;
+				run.sOffset = sOffset;
+				m_vecDataGatherRuns.push_back(run);
+			}
+			sOffset += sEnd - sBegin;
+		}
+
+		m_data.resize(sOffset);
+
+		if (m_varDataGatherLoaded == m_varActive) {
+			InvalidateDataSliceCache(m_varActive);
+			ReadDataGatherRuns(sFirstRun);
+		}
+	}
+
+	// Remap the image map into m_data
+	for (size_t s = 0; s < sPoints; s++) {
+		size_t sU = static_cast<size_t>(pImageMap[s]) / sUnit;
+		pImageMap[s] = static_cast<int>(
+			m_vecDataGatherOffset[sU] + (pImageMap[s] - static_cast<long>(sU * sUnit)));
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void wxNcVisFrame::UngatherImageMap(
+	int * pImageMap,
+	size_t sPoints
+) const {
+	if (m_vecDataGatherRuns.size() == 0) {
+		return;
+	}
+
+	// Runs are in order of increasing offset; consecutive points usually
+	// lie in the same run
+	size_t r = 0;
+	for (size_t s = 0; s < sPoints; s++) {
+		size_t sOffset = static_cast<size_t>(std::max(pImageMap[s], 0));
+
+		const DataGatherRun * prun = &(m_vecDataGatherRuns[r]);
+		if ((sOffset < prun->sOffset) || (sOffset >= prun->sOffset + prun->sCount)) {
+			r = 0;
+			size_t r1 = m_vecDataGatherRuns.size();
+			while (r1 - r > 1) {
+				size_t rMid = (r + r1) / 2;
+				if (m_vecDataGatherRuns[rMid].sOffset <= sOffset) {
+					r = rMid;
+				} else {
+					r1 = rMid;
+				}
+			}
+			prun = &(m_vecDataGatherRuns[r]);
+		}
+
+		if (sOffset >= prun->sOffset + prun->sCount) {
+			pImageMap[s] = 0;
+		} else {
+			pImageMap[s] = static_cast<int>(prun->sBegin + (sOffset - prun->sOffset));
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void wxNcVisFrame::GetDataGatherSlabs(
+	size_t sFirstRun,
+	std::vector<DataPrefetcher::Slab> & vecSlabs
+) const {
+	_ASSERT(m_varActive != NULL);
+
+	DataPrefetcher::NetCDFLock lockNetCDF;
+	_ASSERT(m_varActive->num_dims() == m_lVarActiveDims.size());
+
+	vecSlabs.clear();
+	for (size_t r = sFirstRun; r < m_vecDataGatherRuns.size(); r++) {
+		const DataGatherRun & run = m_vecDataGatherRuns[r];
+
+		DataPrefetcher::Slab slab;
+		slab.vecCur = m_lVarActiveDims;
+		slab.vecSize.resize(m_varActive->num_dims(), 1);
+		slab.vecCur[m_lDisplayedDims[0]] = static_cast<long>(run.sBegin);
+		slab.vecSize[m_lDisplayedDims[0]] = static_cast<long>(run.sCount);
+		slab.sOffset = run.sOffset;
+
+		vecSlabs.push_back(slab);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void wxNcVisFrame::ReadDataGatherRuns(
+	size_t sFirstRun
+) {
+	std::vector<DataPrefetcher::Slab> vecSlabs;
+	GetDataGatherSlabs(sFirstRun, vecSlabs);
+
+	if (vecSlabs.size() != 0) {
+		_ASSERT(vecSlabs.back().sOffset + vecSlabs.back().vecSize[m_lDisplayedDims[0]] <= m_data.size());
+		DataPrefetcher::ReadSlabs(m_varActive, vecSlabs, (-1), 0, &(m_data[0]));
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void wxNcVisFrame::ReadData(
+	const std::vector<DataPrefetcher::Slab> & vecSlabs,
+	size_t sSize
+) {
+	_ASSERT(m_varActive != NULL);
+
+	// Exchange the slice read ahead, if it is the one requested
+	if (m_dataprefetcher.IsRunning()) {
+		if (m_dataprefetcher.Matches(m_varActive, vecSlabs, sSize)) {
+			if (m_dataprefetcher.Take(m_lVarActiveDims[m_dataprefetcher.GetDim()], m_data)) {
+				m_vecDataSlabs = vecSlabs;
+				m_varDataSlabs = m_varActive;
+				CacheDataSlice(vecSlabs);
+				return;
+			}
+		} else {
+			m_dataprefetcher.Stop();
+		}
+	}
 
-void wxNcVisFrame::LoadData() {
-	if (m_fVerbose) {
-		std::cout << "LOAD DATA" << std::endl;
+	if (sSize == 0) {
+		m_data.clear();
+		return;
 	}
 
-	// Assume data is not unstructured
-	m_fIsVarActiveUnstructured = false;
+	if (FindDataSlice(vecSlabs)) {
+		_ASSERT(m_data.size() == sSize);
 
-	// 0D data
-	if (m_varActive->num_dims() == 0) {
-		m_data.resize(1);
-		m_varActive->get(&(m_data[0]), 1);
-		return;
+	} else {
+		if (m_data.size() != sSize) {
+			m_data.resize(sSize);
+		}
+
+		DataPrefetcher::ReadSlabs(m_varActive, vecSlabs, (-1), 0, &(m_data[0]));
+
+		CacheDataSlice(vecSlabs);
 	}
 
-	// 1D data (including unstructured grid data)
-	if (m_lDisplayedDims[1] == (-1)) {
-		_ASSERT(m_lDisplayedDims[0] < m_varActive->num_dims());
-		_ASSERT(m_varActive->num_dims() == m_lVarActiveDims.size());
+	m_vecDataSlabs = vecSlabs;
+	m_varDataSlabs = m_varActive;
 
-		if (m_strUnstructDimName == m_varActive->get_dim(m_lDisplayedDims[0])->name()) {
-			m_fIsVarActiveUnstructured = true;
+	// Read ahead along the animated dimension
+	if ((m_lAnimatedDim != (-1)) && !m_dataprefetcher.IsRunning()) {
+		long lDimSize;
+		{
+			DataPrefetcher::NetCDFLock lockNetCDF;
+			lDimSize = m_varActive->get_dim(m_lAnimatedDim)->size();
+		}
+		if (lDimSize > 1) {
+			StartDataPrefetch(
+				m_lAnimatedDim,
+				0,
+				lDimSize-1,
+				(m_lVarActiveDims[m_lAnimatedDim] + 1) % lDimSize,
+				true);
 		}
+	}
+}
 
-		// Reallocate space, if necessary
-		std::vector<long> vecSize(m_varActive->num_dims(), 1);
-		vecSize[m_lDisplayedDims[0]] = m_varActive->get_dim(m_lDisplayedDims[0])->size();
+////////////////////////////////////////////////////////////////////////////////
 
-		if (m_data.size() != vecSize[m_lDisplayedDims[0]]) {
-			m_data.resize(vecSize[m_lDisplayedDims[0]]);
+bool wxNcVisFrame::FindDataSlice(
+	const std::vector<DataPrefetcher::Slab> & vecSlabs
+) {
+	for (auto it = m_dataslicecache.begin(); it != m_dataslicecache.end(); it++) {
+		if ((it->pncfile != m_pncfileActive) ||
+		    (it->var != m_varActive) ||
+		    (it->vecSlabs != vecSlabs)
+		) {
+			continue;
 		}
 
-		// Load data
-		m_varActive->set_cur(&(m_lVarActiveDims[0]));
-		if (m_lDisplayedDims[0] == m_varActive->num_dims()-1) {
-			m_varActive->get(&(m_data[0]), &(vecSize[0]));
+		m_data = it->data;
 
-		} else {
-			std::vector<long> vecStride(m_varActive->num_dims(), 1);
-			for (long d = m_lDisplayedDims[0]+1; d < m_varActive->num_dims(); d++) {
-				vecStride[d] = m_varActive->get_dim(d)->size();
-			}
+		// Move to the front of the list
+		m_dataslicecache.splice(m_dataslicecache.begin(), m_dataslicecache, it);
 
-			m_varActive->gets(&(m_data[0]), &(vecSize[0]), &(vecStride[0]));
+		m_sDataSliceCacheHits++;
+		if (m_fVerbose) {
+			Announce("Slice cache hit (%lu hits, %lu misses, %1.2f MB)",
+				m_sDataSliceCacheHits,
+				m_sDataSliceCacheMisses,
+				static_cast<double>(m_sDataSliceCacheUsage) / (1024.0 * 1024.0));
 		}
+		return true;
+	}
 
-	// 2D data
-	} else {
-		_ASSERT(m_lDisplayedDims[0] != m_lDisplayedDims[1]);
-		_ASSERT(m_lDisplayedDims[0] < m_varActive->num_dims());
-		_ASSERT(m_lDisplayedDims[1] < m_varActive->num_dims());
-		_ASSERT(m_varActive->num_dims() == m_lVarActiveDims.size());
-
-		// Reallocate space, if necessary
-		std::vector<long> vecSize(m_varActive->num_dims(), 1);
-		vecSize[m_lDisplayedDims[0]] = m_varActive->get_dim(m_lDisplayedDims[0])->size();
-		vecSize[m_lDisplayedDims[1]] = m_varActive->get_dim(m_lDisplayedDims[1])->size();
+	m_sDataSliceCacheMisses++;
+	if (m_fVerbose) {
+		Announce("Slice cache miss (%lu hits, %lu misses, %1.2f MB)",
+			m_sDataSliceCacheHits,
+			m_sDataSliceCacheMisses,
+			static_cast<double>(m_sDataSliceCacheUsage) / (1024.0 * 1024.0));
+	}
+	return false;
+}
 
-		if (m_data.size() != vecSize[m_lDisplayedDims[0]] * vecSize[m_lDisplayedDims[1]]) {
-			m_data.resize(vecSize[m_lDisplayedDims[0]] * vecSize[m_lDisplayedDims[1]]);
-		}
+////////////////////////////////////////////////////////////////////////////////
 
-		// Load data
-		m_varActive->set_cur(&(m_lVarActiveDims[0]));
-		if ((m_lDisplayedDims[0] == m_varActive->num_dims()-2) &&
-		    (m_lDisplayedDims[1] == m_varActive->num_dims()-1)
-		) {
-			m_varActive->get(&(m_data[0]), &(vecSize[0]));
+void wxNcVisFrame::CacheDataSlice(
+	const std::vector<DataPrefetcher::Slab> & vecSlabs
+) {
+	const size_t sSliceBytes = m_data.size() * sizeof(float);
+	if (sSliceBytes > m_sDataSliceCacheBytes) {
+		return;
+	}
 
-		} else if (
-			(m_lDisplayedDims[1] == m_varActive->num_dims()-2) &&
-		    (m_lDisplayedDims[0] == m_varActive->num_dims()-1)
+	// Replace the slice if already cached
+	for (auto it = m_dataslicecache.begin(); it != m_dataslicecache.end(); it++) {
+		if ((it->pncfile == m_pncfileActive) &&
+		    (it->var == m_varActive) &&
+		    (it->vecSlabs == vecSlabs)
 		) {
-			m_varActive->get(&(m_data[0]), &(vecSize[0]));
+			m_sDataSliceCacheUsage -= it->data.size() * sizeof(float);
+			m_dataslicecache.erase(it);
+			break;
+		}
+	}
 
-		} else {
-			std::vector<long> vecStride(m_varActive->num_dims(), 1);
+	DataSliceCacheEntry entry;
+	entry.pncfile = m_pncfileActive;
+	entry.var = m_varActive;
+	entry.vecSlabs = vecSlabs;
+	m_dataslicecache.push_front(entry);
+	m_dataslicecache.front().data = m_data;
+	m_sDataSliceCacheUsage += sSliceBytes;
+
+	// Evict least recently used slices
+	while (m_sDataSliceCacheUsage > m_sDataSliceCacheBytes) {
+		m_sDataSliceCacheUsage -= m_dataslicecache.back().data.size() * sizeof(float);
+		m_dataslicecache.pop_back();
+	}
+}
 
-			long lDisplayedDimsMin = m_lDisplayedDims[0];
-			long lDisplayedDimsMax = m_lDisplayedDims[1];
-			if (lDisplayedDimsMin > lDisplayedDimsMax) {
-				lDisplayedDimsMin = m_lDisplayedDims[1];
-				lDisplayedDimsMax = m_lDisplayedDims[0];
-			}
+////////////////////////////////////////////////////////////////////////////////
 
-			for (long d = lDisplayedDimsMin+1; d < m_varActive->num_dims(); d++) {
-				if (d != lDisplayedDimsMax) {
-					vecStride[d] = m_varActive->get_dim(d)->size();
-				}
-			}
-/*
-			std::cout << m_lDisplayedDims[0] << " : " << m_lDisplayedDims[1] << std::endl;
+void wxNcVisFrame::InvalidateDataSliceCache(
+	NcVar * var
+) {
+	auto it = m_dataslicecache.begin();
+	while (it != m_dataslicecache.end()) {
+		if (it->var == var) {
+			m_sDataSliceCacheUsage -= it->data.size() * sizeof(float);
+			it = m_dataslicecache.erase(it);
+		} else {
+			it++;
+		}
+	}
+}
 
-			for (long d = 0; d < vecSize.size(); d++) {
-				std::cout << m_lVarActiveDims[d] << ",";
-			}
-			std::cout << std::endl;
+////////////////////////////////////////////////////////////////////////////////
 
-			for (long d = 0; d < vecSize.size(); d++) {
-				std::cout << vecSize[d] << ",";
-			}
-			std::cout << std::endl;
+void wxNcVisFrame::StartDataPrefetch(
+	long lDim,
+	long lBegin,
+	long lEnd,
+	long lFirst,
+	bool fCyclic
+) {
+	if ((m_varActive == NULL) || (m_varDataSlabs != m_varActive) || (m_vecDataSlabs.size() == 0)) {
+		return;
+	}
 
-			for (long d = 0; d < vecStride.size(); d++) {
-				std::cout << vecStride[d] << ",";
-			}
-			std::cout << std::endl;
-*/
-			m_varActive->gets(&(m_data[0]), &(vecSize[0]), &(vecStride[0]));
+	// Slices along a displayed dimension cannot be read ahead
+	for (size_t i = 0; i < m_vecDataSlabs.size(); i++) {
+		if (m_vecDataSlabs[i].vecSize[lDim] != 1) {
+			return;
 		}
 	}
+
+	m_dataprefetcher.Start(
+		m_varActive,
+		m_vecDataSlabs,
+		m_data.size(),
+		lDim,
+		lBegin,
+		lEnd,
+		lFirst,
+		fCyclic,
+		DataPrefetchFrames);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1010,6 +3094,8 @@ void wxNcVisFrame::MapSampleCoords1DFromActiveVar(
 	long lDim,
 	std::vector<int> & veccoordmap
 ) {
+	DataPrefetcher::NetCDFLock lockNetCDF;
+
 	_ASSERT(lDim < m_varActive->num_dims());
 
 	veccoordmap.resize(dSample.size(), 0);
@@ -1038,47 +3124,101 @@ void wxNcVisFrame::MapSampleCoords1DFromActiveVar(
 		return;
 	}
 
-	// Monotone increasing coordinate
-	if ((*pvecDimValues)[1] > (*pvecDimValues)[0]) {
-		for (size_t s = 0; s < dSample.size(); s++) {
-			for (size_t t = 1; t < pvecDimValues->size()-1; t++) {
-				double dLeft = 0.5 * ((*pvecDimValues)[t-1] + (*pvecDimValues)[t]);
-				double dRight = 0.5 * ((*pvecDimValues)[t] + (*pvecDimValues)[t+1]);
-				if ((t == 1) && (dSample[s] < dLeft)) {
-					veccoordmap[s] = 0;
-					break;
-				}
-				if ((t == pvecDimValues->size()-2) && (dSample[s] > dRight)) {
-					veccoordmap[s] = pvecDimValues->size()-1;
-					break;
-				}
-				if ((dSample[s] >= dLeft) && (dSample[s] <= dRight)) {
-					veccoordmap[s] = t;
-					break;
-				}
+	// Compute midpoints between coordinate values on first use
+	auto itDimMidpoints = m_mapDimMidpoints.find(strDim);
+	if ((itDimMidpoints == m_mapDimMidpoints.end()) ||
+	    (itDimMidpoints->second.dMid.size() != pvecDimValues->size()-1)
+	) {
+		const std::vector<double> & vecDimValues = *pvecDimValues;
+		const size_t sValues = vecDimValues.size();
+
+		DimMidpoints & dimmid = m_mapDimMidpoints[strDim];
+		dimmid.dSign = (vecDimValues[1] > vecDimValues[0])?(1.0):(-1.0);
+		dimmid.dFirst = dimmid.dSign * vecDimValues[0];
+		dimmid.dDelta = dimmid.dSign * (vecDimValues[sValues-1] - vecDimValues[0])
+			/ static_cast<double>(sValues-1);
+
+		dimmid.dMid.resize(sValues-1);
+		for (size_t t = 0; t < sValues-1; t++) {
+			dimmid.dMid[t] = 0.5 * dimmid.dSign * (vecDimValues[t] + vecDimValues[t+1]);
+
+			double dSpacing = dimmid.dSign * (vecDimValues[t+1] - vecDimValues[t]);
+			if (fabs(dSpacing - dimmid.dDelta) > 1.0e-6 * fabs(dimmid.dDelta)) {
+				dimmid.dDelta = 0.0;
 			}
 		}
 
-	// Monotone decreasing coordinate
-	} else {
-		for (size_t s = 0; s < dSample.size(); s++) {
-			for (size_t t = 1; t < pvecDimValues->size()-1; t++) {
-				double dLeft = 0.5 * ((*pvecDimValues)[t-1] + (*pvecDimValues)[t]);
-				double dRight = 0.5 * ((*pvecDimValues)[t] + (*pvecDimValues)[t+1]);
-				if ((t == 1) && (dSample[s] > dLeft)) {
-					veccoordmap[s] = 0;
-					break;
-				}
-				if ((t == pvecDimValues->size()-2) && (dSample[s] < dRight)) {
-					veccoordmap[s] = pvecDimValues->size()-1;
-					break;
-				}
-				if ((dSample[s] <= dLeft) && (dSample[s] >= dRight)) {
-					veccoordmap[s] = t;
-					break;
-				}
+		itDimMidpoints = m_mapDimMidpoints.find(strDim);
+	}
+
+	const DimMidpoints & dimmid = itDimMidpoints->second;
+	const std::vector<double> & dMid = dimmid.dMid;
+	const size_t sLast = dMid.size();
+
+	// Coordinate index t satisfies dMid[t-1] < x <= dMid[t].  On uniform
+	// axes the index is computed directly; otherwise the index of the
+	// previous sample is used as a guess, since samples are sorted.
+	size_t t = 0;
+	for (size_t s = 0; s < dSample.size(); s++) {
+		double dX = dimmid.dSign * dSample[s];
+		if (std::isnan(dX)) {
+			veccoordmap[s] = 0;
+			continue;
+		}
+
+		if (dimmid.dDelta != 0.0) {
+			double dT = ceil((dX - dimmid.dFirst) / dimmid.dDelta - 0.5);
+			if (dT <= 0.0) {
+				t = 0;
+			} else if (dT >= static_cast<double>(sLast)) {
+				t = sLast;
+			} else {
+				t = static_cast<size_t>(dT);
+			}
+		}
+
+		// Correct the guess by one step, or search if it is further off
+		bool fBelow = (t > 0) && (dX <= dMid[t-1]);
+		bool fAbove = (t < sLast) && (dX > dMid[t]);
+		if (fBelow) {
+			if ((t == 1) || (dX > dMid[t-2])) {
+				t--;
+			} else {
+				t = std::lower_bound(dMid.begin(), dMid.begin() + (t-1), dX) - dMid.begin();
 			}
+		} else if (fAbove) {
+			if ((t+1 == sLast) || (dX <= dMid[t+1])) {
+				t++;
+			} else {
+				t = std::lower_bound(dMid.begin() + (t+1), dMid.end(), dX) - dMid.begin();
+			}
+		}
+
+		veccoordmap[s] = static_cast<int>(t);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+///	<summary>
+///		Convert indices along a dimension of the active variable to indices
+///		of the nearest point in a hyperslab with the given first index,
+///		stride and count.
+///	</summary>
+static void MapCoordsToDataWindow(
+	long lBegin,
+	long lStride,
+	long lCount,
+	std::vector<int> & veccoordmap
+) {
+	for (size_t s = 0; s < veccoordmap.size(); s++) {
+		long lT = (static_cast<long>(veccoordmap[s]) - lBegin + lStride / 2) / lStride;
+		if (lT < 0) {
+			lT = 0;
+		} else if (lT >= lCount) {
+			lT = lCount-1;
 		}
+		veccoordmap[s] = static_cast<int>(lT);
 	}
 }
 
@@ -1098,16 +3238,49 @@ void wxNcVisFrame::SampleData(
 
 	// Active variable is an unstructured variable; use sampling
 	if (m_fIsVarActiveUnstructured) {
-		if (m_egdsoption == GridDataSamplerOption_QuadTree) {
+		if (!GetGridDataSampler(m_egdsoption).IsInitialized()) {
+			for (size_t s = 0; s < imagemap.size(); s++) {
+				imagemap[s] = 0;
+			}
+		} else if (m_egdsoption == GridDataSamplerOption_QuadTree) {
 			m_gdsqt.Sample(dSampleX, dSampleY, imagemap);
 		} else if (m_egdsoption == GridDataSamplerOption_CubedSphereQuadTree) {
 			m_gdscsqt.Sample(dSampleX, dSampleY, imagemap);
 		} else if (m_egdsoption == GridDataSamplerOption_KDTree) {
 			m_gdskd.Sample(dSampleX, dSampleY, imagemap);
+		} else if (m_egdsoption == GridDataSamplerOption_MeshWalk) {
+			m_gdswalk.Sample(dSampleX, dSampleY, imagemap);
+		} else if (m_egdsoption == GridDataSamplerOption_CellPolygons) {
+			m_gdspoly.Sample(dSampleX, dSampleY, imagemap);
+		} else if (m_egdsoption == GridDataSamplerOption_CubedSphereLattice) {
+			m_gdscsl.Sample(dSampleX, dSampleY, imagemap);
+		} else if (m_egdsoption == GridDataSamplerOption_ReducedGaussian) {
+			m_gdsrg.Sample(dSampleX, dSampleY, imagemap);
+		} else if (m_egdsoption == GridDataSamplerOption_HEALPix) {
+			m_gdshp.Sample(dSampleX, dSampleY, imagemap);
+		} else if (m_egdsoption == GridDataSamplerOption_Curvilinear) {
+			m_gdscurv.Sample(dSampleX, dSampleY, imagemap);
+		} else if (m_egdsoption == GridDataSamplerOption_DiskIndex) {
+			m_gdsdisk.Sample(dSampleX, dSampleY, imagemap);
 		} else {
 			_EXCEPTIONT("No GridDataSampler initialized");
 		}
 
+		if (IsDataGathered()) {
+			GatherImageMap(&(imagemap[0]), dSampleX.size() * dSampleY.size());
+
+			// The gathered data now covers the image
+			if (m_fDataRangeFromGather &&
+			    (m_varDataGatherLoaded == m_varActive) &&
+			    GetGridDataSampler(m_egdsoption).IsInitialized()
+			) {
+				SetDataRangeByMinMax(false);
+			}
+
+		} else {
+			m_vecDataGatherRuns.clear();
+		}
+
 	// No displayed variables
 	} else if ((m_lDisplayedDims[0] == (-1)) && (m_lDisplayedDims[1] == (-1))) {
 		for (size_t s = 0; s < imagemap.size(); s++) {
@@ -1142,25 +3315,32 @@ void wxNcVisFrame::SampleData(
 		MapSampleCoords1DFromActiveVar(dSampleY, m_lDisplayedDims[0], veccoordmapY);
 		MapSampleCoords1DFromActiveVar(dSampleX, m_lDisplayedDims[1], veccoordmapX);
 
-		size_t sDimYSize = m_varActive->get_dim(m_lDisplayedDims[0])->size();
-		size_t sDimXSize = m_varActive->get_dim(m_lDisplayedDims[1])->size();
+		// Data is stored for the hyperslab chosen for the view; without
+		// one the full extent is read
+		if (!IsDataWindowValid()) {
+			long lIndexMin[2];
+			long lIndexMax[2];
+			ComputeDataWindow(
+				std::vector<double>(),
+				std::vector<double>(),
+				m_datawindow,
+				lIndexMin,
+				lIndexMax);
+		}
+
+		MapCoordsToDataWindow(m_datawindow.lBegin[0], m_datawindow.lStride[0], m_datawindow.lCount[0], veccoordmapY);
+		MapCoordsToDataWindow(m_datawindow.lBegin[1], m_datawindow.lStride[1], m_datawindow.lCount[1], veccoordmapX);
 
-		// Assemble the image map
+		size_t sDimXSize = m_datawindow.lCount[1];
+
+		// Assemble the image map; data is laid out with X varying fastest
+		// regardless of the order of the displayed dimensions
 		size_t s = 0;
-		if (m_lDisplayedDims[0] < m_lDisplayedDims[1]) {
-			for (size_t j = 0; j < dSampleY.size(); j++) {
-			for (size_t i = 0; i < dSampleX.size(); i++) {
-				imagemap[s] = veccoordmapY[j] * sDimXSize + veccoordmapX[i];
-				s++;
-			}
-			}
-		} else {
-			for (size_t j = 0; j < dSampleY.size(); j++) {
-			for (size_t i = 0; i < dSampleX.size(); i++) {
-				imagemap[s] = veccoordmapX[i] * sDimYSize + veccoordmapY[j];
-				s++;
-			}
-			}
+		for (size_t j = 0; j < dSampleY.size(); j++) {
+		for (size_t i = 0; i < dSampleX.size(); i++) {
+			imagemap[s] = veccoordmapY[j] * sDimXSize + veccoordmapX[i];
+			s++;
+		}
 		}
 	}
 }
@@ -1222,6 +3402,8 @@ void wxNcVisFrame::ResetBounds(
 		m_imagepanel->SetCoordinateRange(dXmin[1], dXmax[1], dXmin[0], dXmax[0], fRedraw);
 		return;
 	}
+
+	DataPrefetcher::NetCDFLock lockNetCDF;
 	if (m_varActive->num_dims() == 0) {
 		m_imagepanel->SetCoordinateRange(0.0, 1.0, 0.0, 1.0, fRedraw);
 		return;
@@ -1387,6 +3569,8 @@ void wxNcVisFrame::SetDisplayedDataRange(
 void wxNcVisFrame::SetDataRangeByMinMax(
 	bool fRedraw
 ) {
+	m_fDataRangeFromGather = false;
+
 	if (m_data.size() == 0) {
 		return;
 	}
@@ -1456,7 +3640,11 @@ void wxNcVisFrame::SetDisplayedDimensionValue(
 	m_vecwxDimIndex[lDim]->ChangeValue(wxString::Format("%li", lValue));
 
 	if (m_vecwxDimValue[lDim] != NULL) {
-		std::string strDimName(m_varActive->get_dim(lDim)->name());
+		std::string strDimName;
+		{
+			DataPrefetcher::NetCDFLock lockNetCDF;
+			strDimName = m_varActive->get_dim(lDim)->name();
+		}
 		auto it = m_mapDimData.find(strDimName);
 		if (it != m_mapDimData.end()) {
 			std::string strDimUnits(it->second.units());
@@ -1623,14 +3811,20 @@ void wxNcVisFrame::OnExportClicked(
 		return;
 	}
 
+	// Exported frames must be sampled with the finished GridDataSampler
+	WaitForGridDataSampler();
+
 	std::vector< wxString > vecDimNames;
 	std::vector< std::pair<long,long> > vecDimBounds;
-	for (long d = 0; d < m_varActive->num_dims(); d++) {
-		if ((d == m_lDisplayedDims[0]) || (d == m_lDisplayedDims[1])) {
-			continue;
+	{
+		DataPrefetcher::NetCDFLock lockNetCDF;
+		for (long d = 0; d < m_varActive->num_dims(); d++) {
+			if ((d == m_lDisplayedDims[0]) || (d == m_lDisplayedDims[1])) {
+				continue;
+			}
+			vecDimNames.push_back(wxString(m_varActive->get_dim(d)->name()));
+			vecDimBounds.push_back(std::pair<long,long>(0,m_varActive->get_dim(d)->size()-1));
 		}
-		vecDimNames.push_back(wxString(m_varActive->get_dim(d)->name()));
-		vecDimBounds.push_back(std::pair<long,long>(0,m_varActive->get_dim(d)->size()-1));
 	}
 
 	// Initialize export dialog
@@ -1688,10 +3882,13 @@ void wxNcVisFrame::OnExportClicked(
 		long lExportDimEnd = m_wxNcVisExportDialog->GetExportDimEnd();
 
 		long lActiveDim = (-1);
-		for (long d = 0; d < m_varActive->num_dims(); d++) {
-			if (wxstrExportDimName == m_varActive->get_dim(d)->name()) {
-				lActiveDim = d;
-				break;
+		{
+			DataPrefetcher::NetCDFLock lockNetCDF;
+			for (long d = 0; d < m_varActive->num_dims(); d++) {
+				if (wxstrExportDimName == m_varActive->get_dim(d)->name()) {
+					lActiveDim = d;
+					break;
+				}
 			}
 		}
 		_ASSERT(lActiveDim != (-1));
@@ -1708,6 +3905,11 @@ void wxNcVisFrame::OnExportClicked(
 			SetDisplayedDimensionValue(lActiveDim, i);
 			LoadData();
 
+			// Read the remaining frames ahead while frames are rendered
+			if ((i < lExportDimEnd) && !m_dataprefetcher.IsRunning()) {
+				StartDataPrefetch(lActiveDim, lExportDimBegin, lExportDimEnd, i+1, false);
+			}
+
 			wxFileName wxfile(wxstrExportFilePath, wxString::Format(wxstrExportFilePattern, static_cast<int>(ix)));
 
 			std::cout << "Exporting frame to " << wxfile.GetFullPath() << std::endl;
@@ -1723,6 +3925,8 @@ void wxNcVisFrame::OnExportClicked(
 			}
 		}
 
+		m_dataprefetcher.Stop();
+
 		m_lVarActiveDims[lActiveDim] = lDisplayedValueBackup;
 		SetDisplayedDimensionValue(lActiveDim, lDisplayedValueBackup);
 		LoadData();
@@ -1761,8 +3965,19 @@ void wxNcVisFrame::GenerateDimensionControls() {
 
 	m_vardimsizer->Clear(true);
 
-	for (long d = 0; d < m_varActive->num_dims(); d++) {
-		wxString strDim = wxString(m_varActive->get_dim(d)->name()) + ":";
+	long lCurvilinearDim = GetCurvilinearDim();
+
+	std::vector<std::string> vecDimNames;
+	{
+		DataPrefetcher::NetCDFLock lockNetCDF;
+		for (long d = 0; d < m_varActive->num_dims(); d++) {
+			vecDimNames.push_back(m_varActive->get_dim(d)->name());
+		}
+	}
+	const long lVarActiveDims = static_cast<long>(vecDimNames.size());
+
+	for (long d = 0; d < lVarActiveDims; d++) {
+		wxString strDim = wxString(vecDimNames[d]) + ":";
 
 		wxBoxSizer * vardimboxsizerxy = new wxBoxSizer(wxHORIZONTAL);
 		m_vecwxActiveAxes[d][0] = new wxButton(this, ID_AXESX + d, _T("X"), wxDefaultPosition, wxSquareSize);
@@ -1778,19 +3993,19 @@ void wxNcVisFrame::GenerateDimensionControls() {
 		vardimboxsizerxy->Add(m_vecwxActiveAxes[d][2], 0, wxEXPAND | wxALL, 2);
 		m_vardimsizer->Add(vardimboxsizerxy, 0, wxEXPAND | wxALL, 2);
 
-		m_vardimsizer->Add(new wxStaticText(this, -1, wxString(m_varActive->get_dim(d)->name()), wxDefaultPosition, wxSize(60,nCtrlHeight), wxST_ELLIPSIZE_END | wxALIGN_CENTRE_HORIZONTAL | wxALIGN_CENTER_VERTICAL), 1, wxALIGN_CENTER_VERTICAL | wxEXPAND | wxALL, 4);
+		m_vardimsizer->Add(new wxStaticText(this, -1, wxString(vecDimNames[d]), wxDefaultPosition, wxSize(60,nCtrlHeight), wxST_ELLIPSIZE_END | wxALIGN_CENTRE_HORIZONTAL | wxALIGN_CENTER_VERTICAL), 1, wxALIGN_CENTER_VERTICAL | wxEXPAND | wxALL, 4);
 
-		if (m_strUnstructDimName != m_varActive->get_dim(d)->name()) {
+		if (m_strUnstructDimName != vecDimNames[d]) {
 			m_vecwxActiveAxes[d][2]->Enable(false);
 		} else {
 			m_vecwxActiveAxes[d][0]->Enable(false);
 			m_vecwxActiveAxes[d][1]->Enable(false);
 		}
-		if ((m_varActive->num_dims() < 3) && (m_fIsVarActiveUnstructured)) {
+		if ((lVarActiveDims < 3) && (m_fIsVarActiveUnstructured)) {
 			m_vecwxActiveAxes[d][0]->Enable(false);
 			m_vecwxActiveAxes[d][1]->Enable(false);
 		}
-		if (m_varActive->num_dims() < 2) {
+		if (lVarActiveDims < 2) {
 			m_vecwxActiveAxes[d][0]->Enable(false);
 			m_vecwxActiveAxes[d][1]->Enable(false);
 		}
@@ -1798,7 +4013,7 @@ void wxNcVisFrame::GenerateDimensionControls() {
 		if (d == m_lDisplayedDims[0]) {
 
 			// Dimension is the XY coordinate on the plot (unstructured)
-			if (m_strUnstructDimName == m_varActive->get_dim(d)->name()) {
+			if (m_strUnstructDimName == vecDimNames[d]) {
 				m_vecwxActiveAxes[d][2]->SetLabelMarkup(_T("<span color=\"red\" weight=\"bold\">XY</span>"));
 
 				wxBoxSizer * vardimboxsizerminmax = new wxBoxSizer(wxHORIZONTAL);
@@ -1819,7 +4034,7 @@ void wxNcVisFrame::GenerateDimensionControls() {
 
 			// Dimension is the Y coordinate on the plot or variable is 1D
 			} else {
-				if (m_varActive->num_dims() >= 2) {
+				if (lVarActiveDims >= 2) {
 					m_vecwxActiveAxes[d][1]->SetLabelMarkup(_T("<span color=\"red\" weight=\"bold\">Y</span>"));
 				}
 
@@ -1852,6 +4067,16 @@ void wxNcVisFrame::GenerateDimensionControls() {
 			wxDimReset->Bind(wxEVT_BUTTON, &wxNcVisFrame::OnDimButtonClicked, this);
 			m_vardimsizer->Add(wxDimReset, 0, wxEXPAND | wxALL, 0);
 
+		// Dimension is displayed together with the unstructured dimension
+		} else if (d == lCurvilinearDim) {
+			m_vecwxActiveAxes[d][2]->SetLabelMarkup(_T("<span color=\"red\">XY</span>"));
+			m_vecwxDimIndex[d] = NULL;
+			m_vecwxDimValue[d] = NULL;
+			m_vecwxPlayButton[d] = NULL;
+
+			m_vardimsizer->Add(new wxStaticText(this, -1, _T("")), 0, wxEXPAND | wxALL, 0);
+			m_vardimsizer->Add(new wxStaticText(this, -1, _T("")), 0, wxEXPAND | wxALL, 0);
+
 		// Dimension is freely specified
 		} else {
 			wxBoxSizer * vardimboxsizer = new wxBoxSizer(wxHORIZONTAL);
@@ -1902,6 +4127,8 @@ void wxNcVisFrame::GenerateDimensionControls() {
 
 	SetDataRangeByMinMax(false);
 
+	m_fDataRangeFromGather = IsDataGathered();
+
 	// Resize window if needed
 	if (m_panelsizer->GetMinSize().GetHeight() > m_panelsizer->GetSize().GetHeight()) {
 		SetSizerAndFit(m_panelsizer);
@@ -1926,130 +4153,204 @@ void wxNcVisFrame::OnVariableSelected(
 	// Turn off animation if active
 	StopAnimation();
 
-	// Store a map between current dimnames and dimvalues
-	if ((m_varActive != NULL) && (m_lVarActiveDims.size() == m_varActive->num_dims())) {
-		for (long d = 0; d < m_varActive->num_dims(); d++) {
-			auto itDimBookmark = m_mapDimBookmarks.find(m_varActive->get_dim(d)->name());
-			if (itDimBookmark == m_mapDimBookmarks.end()) {
-				m_mapDimBookmarks.insert(
-					std::pair<std::string, long>(
-						m_varActive->get_dim(d)->name(),
-						m_lVarActiveDims[d]));
-			} else {
-				itDimBookmark->second = m_lVarActiveDims[d];
+	std::string strPreviousDimName[2];
+	bool fReinitializeGridDataSampler = false;
+	std::vector<std::string> vecDimNames;
+	{
+		DataPrefetcher::NetCDFLock lockNetCDF;
+
+		// Store a map between current dimnames and dimvalues
+		if ((m_varActive != NULL) && (m_lVarActiveDims.size() == m_varActive->num_dims())) {
+			for (long d = 0; d < m_varActive->num_dims(); d++) {
+				auto itDimBookmark = m_mapDimBookmarks.find(m_varActive->get_dim(d)->name());
+				if (itDimBookmark == m_mapDimBookmarks.end()) {
+					m_mapDimBookmarks.insert(
+						std::pair<std::string, long>(
+							m_varActive->get_dim(d)->name(),
+							m_lVarActiveDims[d]));
+				} else {
+					itDimBookmark->second = m_lVarActiveDims[d];
+				}
 			}
 		}
-	}
 
-	// Store current active variable dimensions
-	std::string strPreviousDimName[2];
-	if (m_varActive != NULL) {
-		if (m_lDisplayedDims[0] != (-1)) {
-			strPreviousDimName[0] = m_varActive->get_dim(m_lDisplayedDims[0])->name();
-		}
-		if (m_lDisplayedDims[1] != (-1)) {
-			strPreviousDimName[1] = m_varActive->get_dim(m_lDisplayedDims[1])->name();
+		// Store current active variable dimensions
+		if (m_varActive != NULL) {
+			if (m_lDisplayedDims[0] != (-1)) {
+				strPreviousDimName[0] = m_varActive->get_dim(m_lDisplayedDims[0])->name();
+			}
+			if (m_lDisplayedDims[1] != (-1)) {
+				strPreviousDimName[1] = m_varActive->get_dim(m_lDisplayedDims[1])->name();
+			}
 		}
-	}
 
-	// Change the active variable
-	std::string strValue = event.GetString().ToStdString();
+		// Change the active variable
+		std::string strValue = event.GetString().ToStdString();
 
-	int vc = static_cast<int>(event.GetId() - ID_VARSELECTOR);
-	_ASSERT((vc >= 0) && (vc < NcVarMaximumDimensions));
-	auto itVar = m_mapVarNames[vc].find(strValue);
-	m_varActive = m_vecpncfiles[itVar->second[0]]->get_var(strValue.c_str());
-	_ASSERT(m_varActive != NULL);
+		int vc = static_cast<int>(event.GetId() - ID_VARSELECTOR);
+		_ASSERT((vc >= 0) && (vc < NcVarMaximumDimensions));
+		auto itVar = m_mapVarNames[vc].find(strValue);
+		m_pncfileActive = m_vecpncfiles[itVar->second[0]];
+		m_varActive = m_pncfileActive->get_var(strValue.c_str());
+		_ASSERT(m_varActive != NULL);
 
-	// Check for multidimensional longitudes/latitudes
-	bool fReinitializeGridDataSampler = false;
-	{
-		std::string strDims;
-		for (int d = 0; d < m_varActive->num_dims(); d++) {
-			strDims += m_varActive->get_dim(d)->name();
-			if (d != m_varActive->num_dims()-1) {
-				strDims += ", ";
+		// Check for multidimensional longitudes/latitudes
+		{
+			std::string strDims;
+			for (int d = 0; d < m_varActive->num_dims(); d++) {
+				strDims += m_varActive->get_dim(d)->name();
+				if (d != m_varActive->num_dims()-1) {
+					strDims += ", ";
+				}
 			}
-		}
 
-		auto itMultidimLon = m_mapMultidimLonVars.find(strDims);
-		auto itMultidimLat = m_mapMultidimLatVars.find(strDims);
+			auto itMultidimLon = m_mapMultidimLonVars.find(strDims);
+			auto itMultidimLat = m_mapMultidimLatVars.find(strDims);
+
+			if ((itMultidimLon != m_mapMultidimLonVars.end()) && (itMultidimLat != m_mapMultidimLatVars.end())) {
+				_ASSERT(m_varActive->num_dims() > 0);
+				int nMaxDim = 0;
+				int nMaxDimSize = m_varActive->get_dim(0)->size();
+				for (int d = 1; d < m_varActive->num_dims(); d++) {
+					if (m_varActive->get_dim(d)->size() > nMaxDimSize) {
+						nMaxDimSize = m_varActive->get_dim(d)->size();
+						nMaxDim = d;
+					}
+				}
+				m_strUnstructDimName = m_varActive->get_dim(nMaxDim)->name();
 
-		if ((itMultidimLon != m_mapMultidimLonVars.end()) && (itMultidimLat != m_mapMultidimLatVars.end())) {
-			_ASSERT(m_varActive->num_dims() > 0);
-			int nMaxDim = 0;
-			int nMaxDimSize = m_varActive->get_dim(0)->size();
-			for (int d = 1; d < m_varActive->num_dims(); d++) {
-				if (m_varActive->get_dim(d)->size() > nMaxDimSize) {
-					nMaxDimSize = m_varActive->get_dim(d)->size();
-					nMaxDim = d;
+				// Curvilinear grids are spanned by the largest dimension and an
+				// adjacent one; spatial dimensions come last by convention
+				int nPairDim = nMaxDim + 1;
+				if (nPairDim == m_varActive->num_dims()) {
+					nPairDim = nMaxDim - 1;
 				}
-			}
-			m_strUnstructDimName = m_varActive->get_dim(nMaxDim)->name();
 
-			if ((m_strVarActiveMultidimLon != itMultidimLon->second) ||
-			    (m_strVarActiveMultidimLat != itMultidimLat->second)
-			) {
-				fReinitializeGridDataSampler = true;
-				m_strVarActiveMultidimLon = itMultidimLon->second;
-				m_strVarActiveMultidimLat = itMultidimLat->second;
-			}
+				// The adjacent dimension is only spatial if lon/lat vary along
+				// it (compare its first two rows); otherwise, e.g. for lon(time,
+				// ncol), treat the grid as unstructured
+				auto fnVariesAlongPairDim = [&](const std::string & strVarName) {
+					auto itVar = m_mapVarNames[m_varActive->num_dims()].find(strVarName);
+					if (itVar == m_mapVarNames[m_varActive->num_dims()].end()) {
+						return false;
+					}
+					NcVar * var = m_vecpncfiles[itVar->second[0]]->get_var(strVarName.c_str());
+					if ((var == NULL) || (var->num_dims() != m_varActive->num_dims())) {
+						return false;
+					}
 
-			Announce("Multidimensional lon/lat found: %s %s", itMultidimLon->second.c_str(), itMultidimLat->second.c_str());
-			Announce("Assumed unstructured dim: %s", m_strUnstructDimName.c_str());
+					DataPrefetcher::Slab slab;
+					slab.vecCur.resize(var->num_dims(), 0);
+					slab.vecSize.resize(var->num_dims(), 1);
+					slab.vecSize[nMaxDim] = nMaxDimSize;
+					slab.vecSize[nPairDim] = 2;
+					slab.sOffset = 0;
 
-		} else {
-			if (m_strVarActiveMultidimLon != "") {
-				m_strVarActiveMultidimLon = "";
-				m_strVarActiveMultidimLat = "";
-				m_strUnstructDimName = m_strDefaultUnstructDimName;
-				fReinitializeGridDataSampler = true;
+					std::vector<double> dRows(2 * nMaxDimSize);
+					if (!DataPrefetcher::ReadSlab(var, slab, &(dRows[0]))) {
+						return false;
+					}
+
+					// Rows are laid out in variable order
+					for (int i = 0; i < nMaxDimSize; i++) {
+						if (nPairDim < nMaxDim) {
+							if (dRows[i] != dRows[nMaxDimSize + i]) {
+								return true;
+							}
+						} else {
+							if (dRows[2*i] != dRows[2*i+1]) {
+								return true;
+							}
+						}
+					}
+					return false;
+				};
+
+				std::string strCurvilinearDimName;
+				if ((nPairDim >= 0) && (m_varActive->get_dim(nPairDim)->size() > 1)) {
+					if (fnVariesAlongPairDim(itMultidimLon->second) ||
+					    fnVariesAlongPairDim(itMultidimLat->second)
+					) {
+						strCurvilinearDimName = m_varActive->get_dim(nPairDim)->name();
+					}
+				}
+
+				if ((m_strVarActiveMultidimLon != itMultidimLon->second) ||
+				    (m_strVarActiveMultidimLat != itMultidimLat->second) ||
+				    (m_strCurvilinearDimName != strCurvilinearDimName)
+				) {
+					fReinitializeGridDataSampler = true;
+					m_strVarActiveMultidimLon = itMultidimLon->second;
+					m_strVarActiveMultidimLat = itMultidimLat->second;
+					m_strCurvilinearDimName = strCurvilinearDimName;
+				}
+
+				Announce("Multidimensional lon/lat found: %s %s", itMultidimLon->second.c_str(), itMultidimLat->second.c_str());
+				Announce("Assumed unstructured dim: %s", m_strUnstructDimName.c_str());
+				if (m_strCurvilinearDimName != "") {
+					Announce("Assumed curvilinear dim: %s", m_strCurvilinearDimName.c_str());
+				}
+
+			} else {
+				if (m_strVarActiveMultidimLon != "") {
+					m_strVarActiveMultidimLon = "";
+					m_strVarActiveMultidimLat = "";
+					m_strCurvilinearDimName = "";
+					m_strUnstructDimName = m_strDefaultUnstructDimName;
+					fReinitializeGridDataSampler = true;
+				}
 			}
 		}
-	}
 
-	// Generate title
-	{
-		NcError error(NcError::silent_nonfatal);
-		NcAtt * attLongName = m_varActive->get_att("long_name");
-		if (attLongName != NULL) {
-			m_strVarActiveTitle = std::string("[") + m_varActive->name() + std::string("] ") + attLongName->as_string(0);
-		} else {
-			m_strVarActiveTitle = m_varActive->name();
-		}
+		// Generate title
+		{
+			NcError error(NcError::silent_nonfatal);
+			NcAtt * attLongName = m_varActive->get_att("long_name");
+			if (attLongName != NULL) {
+				m_strVarActiveTitle = std::string("[") + m_varActive->name() + std::string("] ") + attLongName->as_string(0);
+			} else {
+				m_strVarActiveTitle = m_varActive->name();
+			}
 
-		if (m_strVarActiveTitle.length() > 60) {
-			m_strVarActiveTitle = m_strVarActiveTitle.substr(0,60);
-			m_strVarActiveTitle += "...";
-		}
+			if (m_strVarActiveTitle.length() > 60) {
+				m_strVarActiveTitle = m_strVarActiveTitle.substr(0,60);
+				m_strVarActiveTitle += "...";
+			}
 
-		NcAtt * attUnits = m_varActive->get_att("units");
-		if (attUnits != NULL) {
-			m_strVarActiveUnits = attUnits->as_string(0);
-		} else {
-			m_strVarActiveUnits = "";
-		}
+			NcAtt * attUnits = m_varActive->get_att("units");
+			if (attUnits != NULL) {
+				m_strVarActiveUnits = attUnits->as_string(0);
+			} else {
+				m_strVarActiveUnits = "";
+			}
+
+			if (m_strVarActiveUnits.length() > 20) {
+				m_strVarActiveUnits = m_strVarActiveUnits.substr(0,20);
+				m_strVarActiveUnits += "...";
+			}
 
-		if (m_strVarActiveUnits.length() > 20) {
-			m_strVarActiveUnits = m_strVarActiveUnits.substr(0,20);
-			m_strVarActiveUnits += "...";
 		}
 
-	}
+		// Check for missing value
+		{
+			NcError error(NcError::silent_nonfatal);
+			NcAtt * attMissingValue = m_varActive->get_att("_FillValue");
+			if (attMissingValue != NULL) {
+				m_fDataHasMissingValue = true;
+				m_dMissingValueFloat = attMissingValue->as_float(0);
+			} else {
+				m_fDataHasMissingValue = false;
+			}
+		}
 
-	// Check for missing value
-	{
-		NcError error(NcError::silent_nonfatal);
-		NcAtt * attMissingValue = m_varActive->get_att("_FillValue");
-		if (attMissingValue != NULL) {
-			m_fDataHasMissingValue = true;
-			m_dMissingValueFloat = attMissingValue->as_float(0);
-		} else {
-			m_fDataHasMissingValue = false;
+		// Dimensions of the new active variable
+		for (long d = 0; d < m_varActive->num_dims(); d++) {
+			vecDimNames.push_back(m_varActive->get_dim(d)->name());
 		}
 	}
+	const long lVarActiveDims = static_cast<long>(vecDimNames.size());
 
-	m_lVarActiveDims.resize(m_varActive->num_dims());
+	m_lVarActiveDims.resize(lVarActiveDims);
 
 	// Initialize displayed dimension(s) and active dimensions
 	m_lDisplayedDims[0] = (-1);
@@ -2057,18 +4358,18 @@ void wxNcVisFrame::OnVariableSelected(
 
 	// First check if previously selected dimensions already exist in data
 	if ((strPreviousDimName[0] != "") && (strPreviousDimName[1] != "")) {
-		for (long d = 0; d < m_varActive->num_dims(); d++) {
-			if (strPreviousDimName[0] == m_varActive->get_dim(d)->name()) {
+		for (long d = 0; d < lVarActiveDims; d++) {
+			if (strPreviousDimName[0] == vecDimNames[d]) {
 				m_lDisplayedDims[0] = d;
 			}
-			if (strPreviousDimName[1] == m_varActive->get_dim(d)->name()) {
+			if (strPreviousDimName[1] == vecDimNames[d]) {
 				m_lDisplayedDims[1] = d;
 			}
 		}
 
 	} else if (strPreviousDimName[0] != "") {
-		for (long d = 0; d < m_varActive->num_dims(); d++) {
-			if (strPreviousDimName[0] == m_varActive->get_dim(d)->name()) {
+		for (long d = 0; d < lVarActiveDims; d++) {
+			if (strPreviousDimName[0] == vecDimNames[d]) {
 				m_lDisplayedDims[0] = d;
 			}
 		}
@@ -2076,8 +4377,8 @@ void wxNcVisFrame::OnVariableSelected(
 
 	// Otherwise select new dimensions by variable type
 	if ((m_lDisplayedDims[0] == (-1)) && (m_lDisplayedDims[1] == (-1))) {
-		for (long d = 0; d < m_varActive->num_dims(); d++) {
-			if (m_strUnstructDimName == m_varActive->get_dim(d)->name()) {
+		for (long d = 0; d < lVarActiveDims; d++) {
+			if (m_strUnstructDimName == vecDimNames[d]) {
 				m_lDisplayedDims[0] = d;
 				m_fIsVarActiveUnstructured = true;
 			}
@@ -2088,24 +4389,24 @@ void wxNcVisFrame::OnVariableSelected(
 		}
 
 		if (m_lDisplayedDims[0] == (-1)) {
-			if (m_varActive->num_dims() == 0) {
+			if (lVarActiveDims == 0) {
 				m_lDisplayedDims[1] = (-1);
-			} else if (m_varActive->num_dims() == 1) {
+			} else if (lVarActiveDims == 1) {
 				m_lDisplayedDims[0] = 0;
 			} else {
-				m_lDisplayedDims[0] = m_varActive->num_dims()-2;
-				m_lDisplayedDims[1] = m_varActive->num_dims()-1;
+				m_lDisplayedDims[0] = lVarActiveDims-2;
+				m_lDisplayedDims[1] = lVarActiveDims-1;
 			}
 		}
 		ResetBounds();
 
 	} else if (m_lDisplayedDims[0] == (-1)) {
-		_ASSERT(m_varActive->num_dims() >= 1);
-		if (m_varActive->num_dims() == 1) {
+		_ASSERT(lVarActiveDims >= 1);
+		if (lVarActiveDims == 1) {
 			m_lDisplayedDims[0] = m_lDisplayedDims[1];
 			m_lDisplayedDims[1] = (-1);
 		} else {
-			for (long d = m_varActive->num_dims()-1; d >= 0; d--) {
+			for (long d = lVarActiveDims-1; d >= 0; d--) {
 				if (d != m_lDisplayedDims[1]) {
 					m_lDisplayedDims[0] = d;
 					break;
@@ -2115,10 +4416,10 @@ void wxNcVisFrame::OnVariableSelected(
 		}
 
 	} else if (m_lDisplayedDims[1] == (-1)) {
-		_ASSERT(m_varActive->num_dims() >= 1);
-		if (m_strUnstructDimName == m_varActive->get_dim(m_lDisplayedDims[0])->name()) {
-		} else if (m_varActive->num_dims() != 1) {
-			for (long d = m_varActive->num_dims()-1; d >= 0; d--) {
+		_ASSERT(lVarActiveDims >= 1);
+		if (m_strUnstructDimName == vecDimNames[m_lDisplayedDims[0]]) {
+		} else if (lVarActiveDims != 1) {
+			for (long d = lVarActiveDims-1; d >= 0; d--) {
 				if (d != m_lDisplayedDims[0]) {
 					m_lDisplayedDims[1] = d;
 					break;
@@ -2129,11 +4430,11 @@ void wxNcVisFrame::OnVariableSelected(
 	}
 
 	// Set lVarActiveDims using bookmarked indices
-	for (long d = 0; d < m_varActive->num_dims(); d++) {
+	for (long d = 0; d < lVarActiveDims; d++) {
 		if ((d == m_lDisplayedDims[0]) || (d == m_lDisplayedDims[1])) {
 			m_lVarActiveDims[d] = 0;
 		} else {
-			auto itDimCurrent = m_mapDimBookmarks.find(m_varActive->get_dim(d)->name());
+			auto itDimCurrent = m_mapDimBookmarks.find(vecDimNames[d]);
 			if (itDimCurrent != m_mapDimBookmarks.end()) {
 				m_lVarActiveDims[d] = itDimCurrent->second;
 			} else {
@@ -2147,7 +4448,7 @@ void wxNcVisFrame::OnVariableSelected(
 
 	// Revert all other combo boxes
 	for (int vc = 0; vc < NcVarMaximumDimensions; vc++) {
-		if ((m_vecwxVarSelector[vc] != NULL) && (vc != m_varActive->num_dims())) {
+		if ((m_vecwxVarSelector[vc] != NULL) && (vc != lVarActiveDims)) {
 			m_vecwxVarSelector[vc]->ChangeValue(
 				wxString::Format("(%lu) %iD vars", m_mapVarNames[vc].size(), vc));
 		}
@@ -2253,6 +4554,8 @@ void wxNcVisFrame::OnRangeChanged(
 		dRangeMin = dRangeMax;
 	}
 
+	m_fDataRangeFromGather = false;
+
 	m_imagepanel->SetDataRange(dRangeMin, dRangeMax, true);
 }
 
@@ -2274,7 +4577,11 @@ void wxNcVisFrame::OnDimTimer(wxTimerEvent & event) {
 
 	_ASSERT(m_varActive != NULL);
 
-	long lDimSize = m_varActive->get_dim(m_lAnimatedDim)->size();
+	long lDimSize;
+	{
+		DataPrefetcher::NetCDFLock lockNetCDF;
+		lDimSize = m_varActive->get_dim(m_lAnimatedDim)->size();
+	}
 	if (m_lVarActiveDims[m_lAnimatedDim] == lDimSize-1) {
 		m_lVarActiveDims[m_lAnimatedDim] = 0;
 	} else {
@@ -2303,6 +4610,8 @@ void wxNcVisFrame::StartAnimation(long d) {
 ////////////////////////////////////////////////////////////////////////////////
 
 void wxNcVisFrame::StopAnimation() {
+	m_dataprefetcher.Stop();
+
 	if (m_lAnimatedDim != (-1)) {
 		if (m_vecwxPlayButton[m_lAnimatedDim] != NULL) {
 			m_vecwxPlayButton[m_lAnimatedDim]->SetLabel(wxString::Format("%lc",(wchar_t)(0x25B6)));
@@ -2336,7 +4645,11 @@ void wxNcVisFrame::OnDimButtonClicked(wxCommandEvent & event) {
 		eDimCommand = DIMCOMMAND_DECREMENT;
 		d -= ID_DIMDOWN;
 
-		long lDimSize = m_varActive->get_dim(d)->size();
+		long lDimSize;
+		{
+			DataPrefetcher::NetCDFLock lockNetCDF;
+			lDimSize = m_varActive->get_dim(d)->size();
+		}
 		if (m_lVarActiveDims[d] == 0) {
 			m_lVarActiveDims[d] = lDimSize-1;
 		} else {
@@ -2350,7 +4663,11 @@ void wxNcVisFrame::OnDimButtonClicked(wxCommandEvent & event) {
 		eDimCommand = DIMCOMMAND_INCREMENT;
 		d -= ID_DIMUP;
 
-		long lDimSize = m_varActive->get_dim(d)->size();
+		long lDimSize;
+		{
+			DataPrefetcher::NetCDFLock lockNetCDF;
+			lDimSize = m_varActive->get_dim(d)->size();
+		}
 		if (m_lVarActiveDims[d] == lDimSize-1) {
 			m_lVarActiveDims[d] = 0;
 		} else {
@@ -2377,11 +4694,16 @@ void wxNcVisFrame::OnDimButtonClicked(wxCommandEvent & event) {
 
 		std::string strDimValue = m_vecwxDimIndex[d]->GetValue().ToStdString();
 		if ((strDimValue == "") || (STLStringHelper::IsInteger(strDimValue))) {
+			long lDimSize;
+			{
+				DataPrefetcher::NetCDFLock lockNetCDF;
+				lDimSize = m_varActive->get_dim(d)->size();
+			}
 			m_lVarActiveDims[d] = std::stoi(strDimValue);
 			if (m_lVarActiveDims[d] < 0) {
 				m_lVarActiveDims[d] = 0;
-			} else if (m_lVarActiveDims[d] >= m_varActive->get_dim(d)->size()) {
-				m_lVarActiveDims[d] = m_varActive->get_dim(d)->size()-1;
+			} else if (m_lVarActiveDims[d] >= lDimSize) {
+				m_lVarActiveDims[d] = lDimSize-1;
 			}
 		}
 
@@ -2444,6 +4766,7 @@ void wxNcVisFrame::OnAxesButtonClicked(wxCommandEvent & event) {
 		m_lVarActiveDims[d] = 0;
 
 		if (m_lDisplayedDims[0] != (-1)) {
+			DataPrefetcher::NetCDFLock lockNetCDF;
 			if (m_strUnstructDimName == m_varActive->get_dim(m_lDisplayedDims[0])->name()) {
 				for (long d = m_varActive->num_dims()-1; d >= 0; d--) {
 					if ((d != m_lDisplayedDims[1]) && (m_strUnstructDimName != m_varActive->get_dim(d)->name())) {
@@ -2470,6 +4793,7 @@ void wxNcVisFrame::OnAxesButtonClicked(wxCommandEvent & event) {
 		m_lVarActiveDims[d] = 0;
 
 		if (m_lDisplayedDims[1] != (-1)) {
+			DataPrefetcher::NetCDFLock lockNetCDF;
 			if (m_strUnstructDimName == m_varActive->get_dim(m_lDisplayedDims[1])->name()) {
 				for (long d = m_varActive->num_dims()-1; d >= 0; d--) {
 					if ((d != m_lDisplayedDims[0]) && (m_strUnstructDimName != m_varActive->get_dim(d)->name())) {
@@ -2607,6 +4931,8 @@ void wxNcVisFrame::OnSamplerCombo(wxCommandEvent & event) {
 	}
 
 	m_egdsoption = (GridDataSamplerOption)(iSamplerSelection);
+	m_fDetectAnalyticGrids = false;
+	m_fAutoSelectSampler = false;
 
 	if ((m_egdsoption == GridDataSamplerOption_QuadTree) && (!m_gdsqt.IsInitialized())) {
 		InitializeGridDataSampler();
@@ -2617,6 +4943,27 @@ void wxNcVisFrame::OnSamplerCombo(wxCommandEvent & event) {
 	if ((m_egdsoption == GridDataSamplerOption_KDTree) && (!m_gdskd.IsInitialized())) {
 		InitializeGridDataSampler();
 	}
+	if ((m_egdsoption == GridDataSamplerOption_MeshWalk) && (!m_gdswalk.IsInitialized())) {
+		InitializeGridDataSampler();
+	}
+	if ((m_egdsoption == GridDataSamplerOption_CubedSphereLattice) && (!m_gdscsl.IsInitialized())) {
+		InitializeGridDataSampler();
+	}
+	if ((m_egdsoption == GridDataSamplerOption_CellPolygons) && (!m_gdspoly.IsInitialized())) {
+		InitializeGridDataSampler();
+	}
+	if ((m_egdsoption == GridDataSamplerOption_ReducedGaussian) && (!m_gdsrg.IsInitialized())) {
+		InitializeGridDataSampler();
+	}
+	if ((m_egdsoption == GridDataSamplerOption_HEALPix) && (!m_gdshp.IsInitialized())) {
+		InitializeGridDataSampler();
+	}
+	if ((m_egdsoption == GridDataSamplerOption_Curvilinear) && (!m_gdscurv.IsInitialized())) {
+		InitializeGridDataSampler();
+	}
+	if ((m_egdsoption == GridDataSamplerOption_DiskIndex) && (!m_gdsdisk.IsInitialized())) {
+		InitializeGridDataSampler();
+	}
 
 	m_imagepanel->ResampleData(true);
 }
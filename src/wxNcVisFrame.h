@@ -17,8 +17,16 @@
 #include "ColorMap.h"
 #include "GridDataSampler.h"
 #include "NcVisPlotOptions.h"
+#include "DataPrefetcher.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <list>
 #include <map>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -48,7 +56,14 @@ public:
 		GridDataSamplerOption_QuadTree = 0,
 		GridDataSamplerOption_CubedSphereQuadTree = 1,
 		GridDataSamplerOption_KDTree = 2,
-		GridDataSamplerOption_Last = 2
+		GridDataSamplerOption_MeshWalk = 3,
+		GridDataSamplerOption_CellPolygons = 4,
+		GridDataSamplerOption_CubedSphereLattice = 5,
+		GridDataSamplerOption_ReducedGaussian = 6,
+		GridDataSamplerOption_HEALPix = 7,
+		GridDataSamplerOption_Curvilinear = 8,
+		GridDataSamplerOption_DiskIndex = 9,
+		GridDataSamplerOption_Last = 9
 	};
 
 public:
@@ -88,11 +103,192 @@ public:
 	///	</summary>
 	typedef std::map<std::string, DimDataFileIdAndCoordMap> DimDataMap;
 
+	///	<summary>
+	///		Midpoints between consecutive values of a dimension variable,
+	///		used for mapping sample coordinates to indices.  Values are
+	///		multiplied by dSign so that the midpoints are increasing.
+	///	</summary>
+	struct DimMidpoints {
+		///	<summary>
+		///		1 for increasing coordinates, -1 for decreasing coordinates.
+		///	</summary>
+		double dSign;
+
+		///	<summary>
+		///		First coordinate value (times dSign).
+		///	</summary>
+		double dFirst;
+
+		///	<summary>
+		///		Spacing between coordinate values (times dSign) if uniform,
+		///		or zero otherwise.
+		///	</summary>
+		double dDelta;
+
+		///	<summary>
+		///		Midpoints between coordinate values (times dSign).
+		///	</summary>
+		std::vector<double> dMid;
+	};
+
+	///	<summary>
+	///		A map between a dimension name and its midpoints.
+	///	</summary>
+	typedef std::map<std::string, DimMidpoints> DimMidpointsMap;
+
 	///	<summary>
 	///		A map between a variable name and file index.
 	///	</summary>
 	typedef std::map<std::string, std::vector<size_t> > VariableNameFileIxMap;
 
+	///	<summary>
+	///		A GridDataSampler that has been built for a grid that is not
+	///		currently displayed, along with the grid properties needed to
+	///		make it active again.
+	///	</summary>
+	struct GridDataSamplerCacheEntry {
+		///	<summary>
+		///		Key identifying the grid (see GetGridDataSamplerKey).
+		///	</summary>
+		std::string strGridKey;
+
+		///	<summary>
+		///		Type of the GridDataSampler.
+		///	</summary>
+		GridDataSamplerOption egdsoption;
+
+		///	<summary>
+		///		The GridDataSampler, owned by the cache.
+		///	</summary>
+		GridDataSampler * pgds;
+
+		///	<summary>
+		///		Longitude and latitude bounds of the grid.
+		///	</summary>
+		double dLonBounds[2];
+		double dLatBounds[2];
+
+		///	<summary>
+		///		Approximate memory used by the GridDataSampler, in bytes.
+		///	</summary>
+		size_t sMemoryUsage;
+	};
+
+	///	<summary>
+	///		A list of cached GridDataSamplers, most recently used first.
+	///	</summary>
+	typedef std::list<GridDataSamplerCacheEntry> GridDataSamplerCache;
+
+	///	<summary>
+	///		A slice of a variable read by LoadData, identified by the file,
+	///		the variable and the hyperslabs read, which encode the fixed
+	///		dimension indices, the displayed dimensions and the read window.
+	///	</summary>
+	struct DataSliceCacheEntry {
+		///	<summary>
+		///		File and variable the slice was read from.
+		///	</summary>
+		NcFile * pncfile;
+		NcVar * var;
+
+		///	<summary>
+		///		Hyperslabs read.
+		///	</summary>
+		std::vector<DataPrefetcher::Slab> vecSlabs;
+
+		///	<summary>
+		///		Values of the slice.
+		///	</summary>
+		std::vector<float> data;
+	};
+
+	///	<summary>
+	///		A list of cached slices, most recently used first.
+	///	</summary>
+	typedef std::list<DataSliceCacheEntry> DataSliceCache;
+
+	///	<summary>
+	///		A chunk of longitudes and latitudes streamed to the worker
+	///		thread building a GridDataSamplerUsingDiskIndex.
+	///	</summary>
+	struct GridDataSamplerChunk {
+		std::vector<double> dLon;
+		std::vector<double> dLat;
+	};
+
+	///	<summary>
+	///		Data read from file that is needed to build a GridDataSampler
+	///		on a worker thread.
+	///	</summary>
+	struct GridDataSamplerInput {
+		///	<summary>
+		///		Longitudes and latitudes of the grid.
+		///	</summary>
+		std::vector<double> dLon;
+		std::vector<double> dLat;
+
+		///	<summary>
+		///		Fill value of the longitudes.
+		///	</summary>
+		double dFillValue;
+
+		///	<summary>
+		///		Dimensions of a curvilinear grid.
+		///	</summary>
+		size_t sCurvilinearNy;
+		size_t sCurvilinearNx;
+
+		///	<summary>
+		///		Mesh adjacency (GridDataSamplerUsingMeshWalk only).
+		///	</summary>
+		std::vector<uint32_t> vecAdjacencyFirst;
+		std::vector<uint32_t> vecAdjacency;
+
+		///	<summary>
+		///		Cell polygons (GridDataSamplerUsingCellPolygons only).
+		///	</summary>
+		std::vector<uint32_t> vecVertexFirst;
+		std::vector<double> dVertexLon;
+		std::vector<double> dVertexLat;
+
+		///	<summary>
+		///		Points are streamed to the worker thread through
+		///		PushGridDataSamplerChunk (GridDataSamplerUsingDiskIndex
+		///		only) and dLon, dLat are empty.
+		///	</summary>
+		bool fStreamed;
+	};
+
+	///	<summary>
+	///		A hyperslab of the two displayed dimensions of a structured
+	///		variable.  Index i along displayed dimension d of the hyperslab
+	///		is index lBegin[d] + i * lStride[d] of the variable.
+	///	</summary>
+	struct DataWindow {
+		///	<summary>
+		///		Names of the displayed dimensions the window applies to.
+		///	</summary>
+		std::string strDimName[2];
+
+		///	<summary>
+		///		First index, stride and number of indices read along each
+		///		displayed dimension.
+		///	</summary>
+		long lBegin[2];
+		long lStride[2];
+		long lCount[2];
+	};
+
+	///	<summary>
+	///		A run of consecutive indices of the unstructured dimension of the
+	///		active variable, stored in m_data starting at sOffset.
+	///	</summary>
+	struct DataGatherRun {
+		size_t sBegin;
+		size_t sCount;
+		size_t sOffset;
+	};
+
 public:
 	///	<summary>
 	///		Constructor.
@@ -106,6 +302,11 @@ public:
 		const std::vector<wxString> & vecFilenames
 	);
 
+	///	<summary>
+	///		Destructor.
+	///	</summary>
+	~wxNcVisFrame();
+
 	///	<summary>
 	///		Get an iterator to m_mapVarNames containing the longitude
 	///		and latitude variables.
@@ -131,10 +332,182 @@ public:
 	) const;
 
 	///	<summary>
-	///		Initialize the GridDataSampler.
+	///		Key identifying the grid of the active variable by its
+	///		coordinate variables, or an empty string if there is no grid.
+	///	</summary>
+	std::string GetGridDataSamplerKey() const;
+
+	///	<summary>
+	///		Apply command-line settings to a GridDataSampler.
+	///	</summary>
+	void ConfigureGridDataSampler(
+		GridDataSampler & gds
+	) const;
+
+	///	<summary>
+	///		Get the GridDataSampler of the given type.
+	///	</summary>
+	GridDataSampler & GetGridDataSampler(
+		GridDataSamplerOption egdsoption
+	);
+
+	///	<summary>
+	///		Exchange the contents of the GridDataSampler of the given type
+	///		with a heap-allocated GridDataSampler of the same type, which is
+	///		allocated if pgds is NULL.  Returns the heap-allocated sampler.
+	///	</summary>
+	GridDataSampler * SwapGridDataSampler(
+		GridDataSamplerOption egdsoption,
+		GridDataSampler * pgds
+	);
+
+	///	<summary>
+	///		Move all initialized GridDataSamplers into the cache under the
+	///		current grid key, evicting the least recently used entries if
+	///		the cache exceeds its memory budget.
+	///	</summary>
+	void CacheGridDataSamplers();
+
+	///	<summary>
+	///		Restore the GridDataSampler of type m_egdsoption for the
+	///		current grid key from the cache.  If fAnyOption is set the most
+	///		recently cached GridDataSampler of any type is restored and
+	///		m_egdsoption is updated to match.
+	///	</summary>
+	///	<returns>
+	///		true if the GridDataSampler was found in the cache.
+	///	</returns>
+	bool RestoreGridDataSampler(
+		bool fAnyOption
+	);
+
+	///	<summary>
+	///		Initialize the GridDataSampler.  Samplers that require a search
+	///		structure are built on a worker thread and installed by
+	///		OnGridDataSamplerTimer when ready.
 	///	</summary>
 	void InitializeGridDataSampler();
 
+	///	<summary>
+	///		Check if a GridDataSampler is being built on a worker thread.
+	///	</summary>
+	bool IsGridDataSamplerPending() const {
+		return (m_pgdsPending != NULL);
+	}
+
+	///	<summary>
+	///		Wait for the GridDataSampler being built on a worker thread (if
+	///		any) and install it.
+	///	</summary>
+	void WaitForGridDataSampler();
+
+protected:
+	///	<summary>
+	///		Reset the longitude and latitude bounds of the grid.
+	///	</summary>
+	void ResetGridDataSamplerBounds();
+
+	///	<summary>
+	///		Extend the longitude and latitude bounds of the grid to
+	///		include the given points, ignoring fill values.
+	///	</summary>
+	void UpdateGridDataSamplerBounds(
+		const double * pLon,
+		const double * pLat,
+		size_t sPoints,
+		double dFillValue
+	);
+
+	///	<summary>
+	///		Snap the longitude and latitude bounds of a global grid to
+	///		the full sphere.
+	///	</summary>
+	void SnapGridDataSamplerBounds();
+
+	///	<summary>
+	///		Select the fastest GridDataSampler for a grid with a search
+	///		structure.  Each candidate is built on a subsample of the grid
+	///		and timed on a fixed batch of queries spanning the grid bounds.
+	///	</summary>
+	GridDataSamplerOption SelectGridDataSampler(
+		const std::vector<double> & dLon,
+		const std::vector<double> & dLat,
+		double dFillValue
+	);
+
+	///	<summary>
+	///		Swap out the GridDataSampler of type m_egdsoption and start
+	///		building it from m_gdsinput on a worker thread.
+	///	</summary>
+	void StartGridDataSamplerBuild(
+		long lElapsedMs
+	);
+
+	///	<summary>
+	///		Build m_pgdsPending from m_gdsinput.  Called on the worker thread.
+	///	</summary>
+	void BuildGridDataSampler();
+
+	///	<summary>
+	///		Pass a chunk of streamed points to the worker thread, waiting
+	///		while too many chunks are queued.  The vectors are swapped into
+	///		the queue.  Returns false if the worker thread has stopped.
+	///	</summary>
+	bool PushGridDataSamplerChunk(
+		std::vector<double> & dLon,
+		std::vector<double> & dLat
+	);
+
+	///	<summary>
+	///		Mark the end of the streamed points, or stop the worker thread
+	///		if the points could not be read.
+	///	</summary>
+	void EndGridDataSamplerChunks(
+		bool fAbort
+	);
+
+	///	<summary>
+	///		Take the next chunk of streamed points on the worker thread,
+	///		waiting until one is available.  Returns false once all chunks
+	///		have been taken or the stream has been stopped.
+	///	</summary>
+	bool PopGridDataSamplerChunk(
+		GridDataSamplerChunk & chunk
+	);
+
+public:
+
+	///	<summary>
+	///		Load the mesh adjacency of the unstructured dimension from MPAS
+	///		cellsOnCell or UGRID face_face_connectivity / edge_node_connectivity,
+	///		in the compressed row form used by GridDataSamplerUsingMeshWalk.
+	///	</summary>
+	///	<returns>
+	///		true if adjacency was found, false otherwise.
+	///	</returns>
+	bool LoadMeshAdjacency(
+		const std::string & strDimName,
+		size_t sPoints,
+		std::vector<uint32_t> & vecAdjacencyFirst,
+		std::vector<uint32_t> & vecAdjacency
+	);
+
+	///	<summary>
+	///		Load the cell polygons of the unstructured dimension from CF
+	///		bounds, MPAS verticesOnCell or UGRID face_node_connectivity, in
+	///		the compressed row form used by GridDataSamplerUsingCellPolygons.
+	///	</summary>
+	///	<returns>
+	///		true if cell polygons were found, false otherwise.
+	///	</returns>
+	bool LoadCellPolygons(
+		const std::string & strDimName,
+		size_t sPoints,
+		std::vector<uint32_t> & vecVertexFirst,
+		std::vector<double> & dVertexLon,
+		std::vector<double> & dVertexLat
+	);
+
 	///	<summary>
 	///		Open the specified files.
 	///	</summary>
@@ -154,6 +527,13 @@ public:
 		return m_fVerbose;
 	}
 
+	///	<summary>
+	///		Get the progressive rendering flag.
+	///	</summary>
+	bool IsProgressive() const {
+		return m_fProgressive;
+	}
+
 	///	<summary>
 	///		Get the NcVis resource directory.
 	///	</summary>
@@ -168,6 +548,12 @@ public:
 		return m_colormaplib;
 	}
 
+	///	<summary>
+	///		Get the curvilinear dimension of the active variable that is
+	///		displayed together with the unstructured dimension, or (-1).
+	///	</summary>
+	long GetCurvilinearDim() const;
+
 	///	<summary>
 	///		Load data from the active variable.
 	///	</summary>
@@ -204,6 +590,134 @@ public:
 		std::vector<int> & veccoordmap
 	);
 
+	///	<summary>
+	///		Check if m_datawindow applies to the displayed dimensions of the
+	///		active variable.
+	///	</summary>
+	bool IsDataWindowValid() const;
+
+	///	<summary>
+	///		Compute the hyperslab of the displayed dimensions of the active
+	///		variable that covers the given samples.  The range of indices
+	///		referenced by the samples along each displayed dimension is
+	///		stored in lIndexMin and lIndexMax.
+	///	</summary>
+	void ComputeDataWindow(
+		const std::vector<double> & dSampleX,
+		const std::vector<double> & dSampleY,
+		DataWindow & datawindow,
+		long lIndexMin[2],
+		long lIndexMax[2]
+	);
+
+	///	<summary>
+	///		Choose the hyperslab of a structured 2D variable read by
+	///		LoadData so that it covers the given samples (with a margin)
+	///		at no more than DataWindowOversample indices per sample, and
+	///		reload the data if the hyperslab changes.
+	///	</summary>
+	///	<returns>
+	///		true if the data was reloaded.
+	///	</returns>
+	bool UpdateDataWindow(
+		const std::vector<double> & dSampleX,
+		const std::vector<double> & dSampleY
+	);
+
+	///	<summary>
+	///		Check if the active variable is unstructured and large enough
+	///		that only the indices referenced by the image map are read.
+	///	</summary>
+	bool IsDataGathered() const;
+
+	///	<summary>
+	///		Discard all gathered runs and choose the gather unit from the
+	///		storage chunks of the active variable.
+	///	</summary>
+	void ResetDataGather();
+
+	///	<summary>
+	///		Replace indices of the unstructured dimension in the image map
+	///		with indices into m_data, adding runs for any units that have
+	///		not yet been gathered.  New runs are read if the gathered data
+	///		is loaded for the active variable.
+	///	</summary>
+	void GatherImageMap(
+		int * pImageMap,
+		size_t sPoints
+	);
+
+	///	<summary>
+	///		Replace indices into m_data in the image map with indices of the
+	///		unstructured dimension.
+	///	</summary>
+	void UngatherImageMap(
+		int * pImageMap,
+		size_t sPoints
+	) const;
+
+	///	<summary>
+	///		Get the hyperslabs of the active variable holding the gathered
+	///		runs from sFirstRun onward.
+	///	</summary>
+	void GetDataGatherSlabs(
+		size_t sFirstRun,
+		std::vector<DataPrefetcher::Slab> & vecSlabs
+	) const;
+
+	///	<summary>
+	///		Read gathered runs from sFirstRun onward from the active variable.
+	///	</summary>
+	void ReadDataGatherRuns(
+		size_t sFirstRun
+	);
+
+	///	<summary>
+	///		Read sSize values of the active variable into m_data from the
+	///		given hyperslabs, using the slice read ahead if available, and
+	///		read ahead along the animated dimension.
+	///	</summary>
+	void ReadData(
+		const std::vector<DataPrefetcher::Slab> & vecSlabs,
+		size_t sSize
+	);
+
+	///	<summary>
+	///		Start reading slices of the active variable ahead along dimension
+	///		lDim from index lFirst, with the hyperslabs last read by ReadData.
+	///	</summary>
+	void StartDataPrefetch(
+		long lDim,
+		long lBegin,
+		long lEnd,
+		long lFirst,
+		bool fCyclic
+	);
+
+	///	<summary>
+	///		Copy the slice of the active variable read with the given
+	///		hyperslabs from the slice cache into m_data, if present.
+	///	</summary>
+	bool FindDataSlice(
+		const std::vector<DataPrefetcher::Slab> & vecSlabs
+	);
+
+	///	<summary>
+	///		Add m_data, read from the active variable with the given
+	///		hyperslabs, to the slice cache and evict least recently used
+	///		slices beyond the memory budget.
+	///	</summary>
+	void CacheDataSlice(
+		const std::vector<DataPrefetcher::Slab> & vecSlabs
+	);
+
+	///	<summary>
+	///		Remove all slices of var from the slice cache.
+	///	</summary>
+	void InvalidateDataSliceCache(
+		NcVar * var
+	);
+
 	///	<summary>
 	///		Sample the data.
 	///	</summary>
@@ -378,6 +892,11 @@ private:
 	///	</summary>
 	void OnDimTimer(wxTimerEvent & event);
 
+	///	<summary>
+	///		Callback triggered when the GridDataSampler timer is triggered.
+	///	</summary>
+	void OnGridDataSamplerTimer(wxTimerEvent & event);
+
 	///	<summary>
 	///		Start animation of the specified dimension.
 	///	</summary>
@@ -514,12 +1033,22 @@ private:
 	///	</summary>
 	wxTimer m_wxDimTimer;
 
+	///	<summary>
+	///		Timer polling the GridDataSampler being built.
+	///	</summary>
+	wxTimer m_wxGridDataSamplerTimer;
+
 private:
 	///	<summary>
 	///		Flag indicating verbose output is desired.
 	///	</summary>
 	bool m_fVerbose;
 
+	///	<summary>
+	///		Flag indicating coarse-to-fine rendering of the image map.
+	///	</summary>
+	bool m_fProgressive;
+
 	///	<summary>
 	///		Directory containing ncvis resources.
 	///	</summary>
@@ -540,6 +1069,36 @@ private:
 	///	</summary>
 	double m_dMaxCellRadius;
 
+	///	<summary>
+	///		Pool of threads used for sampling.
+	///	</summary>
+	ThreadPool * m_pThreadPool;
+
+	///	<summary>
+	///		Flag indicating adaptive sampling is enabled.
+	///	</summary>
+	bool m_fAdaptiveSampling;
+
+	///	<summary>
+	///		Directory in which built sampler indices are cached.
+	///	</summary>
+	std::string m_strIndexCacheDir;
+
+	///	<summary>
+	///		Maximum size of the sampler index cache on disk, in bytes.
+	///	</summary>
+	size_t m_sIndexCacheBytes;
+
+	///	<summary>
+	///		Directory in which out-of-core indices are built.
+	///	</summary>
+	std::string m_strScratchDir;
+
+	///	<summary>
+	///		Memory used for building out-of-core indices, in bytes.
+	///	</summary>
+	size_t m_sIndexBuildBytes;
+
 	///	<summary>
 	///		Name of the longitude variable via command-line override.
 	///	</summary>
@@ -580,6 +1139,18 @@ private:
 	///	</summary>
 	GridDataSamplerOption m_egdsoption;
 
+	///	<summary>
+	///		Replace the default sampler with an analytic sampler if the
+	///		grid has a reduced Gaussian or HEALPix layout.
+	///	</summary>
+	bool m_fDetectAnalyticGrids;
+
+	///	<summary>
+	///		Select the GridDataSampler for each grid by timing candidates
+	///		(-g auto).
+	///	</summary>
+	bool m_fAutoSelectSampler;
+
 	///	<summary>
 	///		Shapefiles present in ncvis resource dir.
 	///	</summary>
@@ -600,6 +1171,11 @@ private:
 	///	</summary>
 	DimDataMap m_mapDimData;
 
+	///	<summary>
+	///		Dimension midpoints, computed on first use.
+	///	</summary>
+	DimMidpointsMap m_mapDimMidpoints;
+
 	///	<summary>
 	///		(Current) unstructured index dimension name.
 	///	</summary>
@@ -610,6 +1186,17 @@ private:
 	///	</summary>
 	std::string m_strDefaultUnstructDimName;
 
+	///	<summary>
+	///		Second dimension of a curvilinear grid, displayed together with
+	///		the unstructured dimension (empty if not curvilinear).
+	///	</summary>
+	std::string m_strCurvilinearDimName;
+
+	///	<summary>
+	///		NetCDF file containing the variable currently loaded.
+	///	</summary>
+	NcFile * m_pncfileActive;
+
 	///	<summary>
 	///		NetCDF variable currently loaded.
 	///	</summary>
@@ -707,11 +1294,194 @@ private:
 	///	</summary>
 	GridDataSamplerUsingKDTree m_gdskd;
 
+	///	<summary>
+	///		Class for sampling data on the grid by walking mesh adjacency.
+	///	</summary>
+	GridDataSamplerUsingMeshWalk m_gdswalk;
+
+	///	<summary>
+	///		Class for sampling data on the grid by rasterizing cell polygons.
+	///	</summary>
+	GridDataSamplerUsingCellPolygons m_gdspoly;
+
+	///	<summary>
+	///		Class for sampling data on the grid using a cubed-sphere lattice.
+	///	</summary>
+	GridDataSamplerUsingCubedSphereLattice m_gdscsl;
+
+	///	<summary>
+	///		Class for sampling data on a reduced Gaussian grid.
+	///	</summary>
+	GridDataSamplerUsingReducedGaussian m_gdsrg;
+
+	///	<summary>
+	///		Class for sampling data on a HEALPix grid.
+	///	</summary>
+	GridDataSamplerUsingHEALPix m_gdshp;
+
+	///	<summary>
+	///		Class for sampling data on a curvilinear grid by walking quads.
+	///	</summary>
+	GridDataSamplerUsingCurvilinear m_gdscurv;
+
+	///	<summary>
+	///		Class for sampling data on the grid using an out-of-core index.
+	///	</summary>
+	GridDataSamplerUsingDiskIndex m_gdsdisk;
+
+	///	<summary>
+	///		Key of the grid the GridDataSamplers above were built for.
+	///	</summary>
+	std::string m_strGridDataSamplerKey;
+
+	///	<summary>
+	///		GridDataSamplers built for other grids.
+	///	</summary>
+	GridDataSamplerCache m_gdscache;
+
+	///	<summary>
+	///		Memory budget of m_gdscache, in bytes.
+	///	</summary>
+	size_t m_sGridDataSamplerCacheBytes;
+
+	///	<summary>
+	///		Worker thread building m_pgdsPending.
+	///	</summary>
+	std::thread m_thrGridDataSampler;
+
+	///	<summary>
+	///		GridDataSampler being built on the worker thread, or NULL.
+	///	</summary>
+	GridDataSampler * m_pgdsPending;
+
+	///	<summary>
+	///		Type of m_pgdsPending.
+	///	</summary>
+	GridDataSamplerOption m_egdsoptionPending;
+
+	///	<summary>
+	///		Data used to build m_pgdsPending.
+	///	</summary>
+	GridDataSamplerInput m_gdsinput;
+
+	///	<summary>
+	///		Chunks of streamed points waiting for the worker thread, and
+	///		flags marking the end of the stream and a stopped worker.
+	///	</summary>
+	std::deque<GridDataSamplerChunk> m_dequeGridDataSamplerChunks;
+	bool m_fGridDataSamplerChunksEnd;
+	bool m_fGridDataSamplerChunksAbort;
+
+	///	<summary>
+	///		Mutex and condition guarding the streamed chunks.
+	///	</summary>
+	std::mutex m_mutexGridDataSamplerChunks;
+	std::condition_variable m_condGridDataSamplerChunks;
+
+	///	<summary>
+	///		Flag set by the worker thread when m_pgdsPending is built.
+	///	</summary>
+	std::atomic<bool> m_fGridDataSamplerBuilt;
+
+	///	<summary>
+	///		Exception thrown on the worker thread, rethrown when installing.
+	///	</summary>
+	std::exception_ptr m_excGridDataSampler;
+
+	///	<summary>
+	///		Stopwatch timing the GridDataSampler build.
+	///	</summary>
+	wxStopWatch m_swGridDataSampler;
+
 	///	<summary>
 	///		Data being visualized.
 	///	</summary>
 	std::vector<float> m_data;
 
+	///	<summary>
+	///		Hyperslab of the active variable held in m_data, if the active
+	///		variable is structured with two displayed dimensions.
+	///	</summary>
+	DataWindow m_datawindow;
+
+	///	<summary>
+	///		Variable most recently read into m_data through m_datawindow.
+	///	</summary>
+	NcVar * m_varDataWindowLoaded;
+
+	///	<summary>
+	///		Number of indices of the unstructured dimension covered by the
+	///		gathered units.
+	///	</summary>
+	size_t m_sDataGatherPoints;
+
+	///	<summary>
+	///		Number of indices of the unstructured dimension in each gathered
+	///		unit, matched to the storage chunks of the variable.
+	///	</summary>
+	size_t m_sDataGatherUnit;
+
+	///	<summary>
+	///		Offset in m_data of the first index of each unit of the
+	///		unstructured dimension, or (-1) if the unit is not gathered.
+	///	</summary>
+	std::vector<long> m_vecDataGatherOffset;
+
+	///	<summary>
+	///		Runs of the unstructured dimension held in m_data, in order of
+	///		increasing offset.
+	///	</summary>
+	std::vector<DataGatherRun> m_vecDataGatherRuns;
+
+	///	<summary>
+	///		Variable most recently read into m_data through the gathered runs.
+	///	</summary>
+	NcVar * m_varDataGatherLoaded;
+
+	///	<summary>
+	///		The data range was computed from gathered data that may not
+	///		cover the displayed image (e.g. before the image map of a new
+	///		variable or grid was sampled); recompute it once it does.
+	///	</summary>
+	bool m_fDataRangeFromGather;
+
+	///	<summary>
+	///		Reader of upcoming slices along the animated or exported
+	///		dimension.
+	///	</summary>
+	DataPrefetcher m_dataprefetcher;
+
+	///	<summary>
+	///		Hyperslabs most recently read into m_data by ReadData.
+	///	</summary>
+	std::vector<DataPrefetcher::Slab> m_vecDataSlabs;
+
+	///	<summary>
+	///		Variable most recently read into m_data by ReadData.
+	///	</summary>
+	NcVar * m_varDataSlabs;
+
+	///	<summary>
+	///		Slices recently read by LoadData.
+	///	</summary>
+	DataSliceCache m_dataslicecache;
+
+	///	<summary>
+	///		Memory budget of m_dataslicecache, in bytes.
+	///	</summary>
+	size_t m_sDataSliceCacheBytes;
+
+	///	<summary>
+	///		Memory used by m_dataslicecache, in bytes.
+	///	</summary>
+	size_t m_sDataSliceCacheUsage;
+
+	///	<summary>
+	///		Number of slices found and not found in m_dataslicecache.
+	///	</summary>
+	size_t m_sDataSliceCacheHits;
+	size_t m_sDataSliceCacheMisses;
+
 	///	<summary>
 	///		A flag indicating the data has missing values.
 	///	</summary>